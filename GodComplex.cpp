@@ -420,6 +420,10 @@ void WINAPI	EntryPoint()
 		ExitProcess( ErrorCode );
 	}
 
+	// Start the worker threads used by the procedural generators
+	JobSystem::Init();
+	InitFrameArenas();
+
 	IntroProgressDelegate	Progress = { &gs_WindowInfos, ShowProgress };
 	if ( (ErrorCode = IntroInit( Progress )) )
 	{
@@ -464,8 +468,9 @@ void WINAPI	EntryPoint()
 #endif
 
 #ifdef SURE_DEBUG
-		// Check for hash collisions => We must never have too many of them !
-		ASSERT( DictionaryU32::ms_MaxCollisionsCount < 2, "Too many collisions in hash tables! Either increase size or use different hashing scheme!" );
+		// Check for long probe sequences in hash tables => We must never have too many of them !
+		// (this is the longest open-addressing probe sequence, not a bucket's chain length, so it's allowed to grow a bit longer than the former 2 colliding entries)
+		ASSERT( DictionaryU32::ms_MaxCollisionsCount < 16, "Too many collisions in hash tables! Use a different hashing scheme!" );
 
 		// Reload in-file constants
 		ReloadChangedTweakableValues();
@@ -477,6 +482,7 @@ void WINAPI	EntryPoint()
 #endif
 
 		// Run the intro
+		BeginFrameArenas();
 		bFinished |= !IntroDo( Time, DeltaTime );
 
 // This was in iQ's framework, I don't know what it's for. I believe it's useful when using OpenGL but with DirectX it makes everything slow as hell (attempts to load/unload DLLs every frame) !
@@ -493,6 +499,9 @@ void WINAPI	EntryPoint()
 
  	IntroExit();
 
+	ExitFrameArenas();
+	JobSystem::Exit();
+
 	WindowExit();
 
 	// Clean exit...
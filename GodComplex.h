@@ -37,6 +37,7 @@
 #include "Utility/Events.h"
 #endif
 #include "Utility/Memory.h"
+#include "Utility/LinearAllocator.h"
 #include "Utility/Random.h"
 #include "Utility/Resources.h"
 #include "Utility/Camera.h"
@@ -44,10 +45,12 @@
 #include "Utility/tweakval.h"
 #include "Utility/MemoryMappedFile.h"
 #include "Utility/Profiling.h"
+#include "Utility/JobSystem.h"
 #include "Utility/FPSCamera.h"
 #include "Utility/Video.h"
 #include "Utility/TextureFilePOM.h"
 #include "Utility/Octree.h"
+#include "Utility/LinearOctree.h"
 
 // DirectX Renderer
 #include "RendererD3D11/Device.h"
@@ -73,6 +76,10 @@
 
 // 3D Procedural
 #include "Procedural/GeometryBuilder.h"
+#include "Procedural/MeshOptimizer.h"
+#include "Procedural/MeshSimplifier.h"
+#include "Procedural/MeshletBuilder.h"
+#include "Procedural/BVH.h"
 #include "Procedural/RayTracer.h"
 
 // Scene loading
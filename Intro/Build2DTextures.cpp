@@ -83,28 +83,6 @@ void	FillScratch( const DrawUtils::DrawInfos& i, Pixel& P, float _Distance, floa
 	P.Blend( Pixel( Color ), Color.w );
 }
 
-void	FillSplotch( const DrawUtils::DrawInfos& i, Pixel& P )
-{
- 	Noise&	N = *((Noise*) i.pData);
-
-	float2	UV = i.UV;
-	UV.x -= 0.5f;
-	UV.y -= 0.5f;
-
-	float	Scale = 1.0f + 1.0f * N.Perlin( float2( 0.005f * i.x / i.w, 0.005f * i.y / i.h ) );
-	UV.x *= Scale;
-	UV.y *= Scale;
-
-	float	Distance2Center = UV.Length();
-
-	float	C = 1.2f * (1.0f - 2.0f * Distance2Center);
-			C = SATURATE( C );
-	float	A = C * C * i.Coverage;
-	float4	Color( C, C, C, A );
-
-	P.Blend( Pixel( Color ), Color.w );
-}
-
 int	Build2DTextures( IntroProgressDelegate& _Delegate )
 {
 return 0;
@@ -152,6 +130,7 @@ return 0;
 //* Test advanced drawing
 
  		Noise	N( 1 );
+		Draw.BeginBatch();	// Gather all the strokes and draw them in parallel tiles at the end
 		// Draw scratches
 		for ( int i=0; i < 10; i++ )
 		{
@@ -193,7 +172,7 @@ return 0;
 			for ( int X=0; X < Count; X++ )
 			{
 				Draw.SetupTransform( Pos.x, Pos.y, Angle );
-				Draw.DrawRectangle( 0.0f, 0.0f, Size.x, Size.y, 0.1f * Size.Min(), 0.0f, FillSplotch, &N );
+				Draw.DrawSplotch( 0.5f * Size, Size, 0.0f, N, 1.0f );	// Pivot about the corner of the splotch, like the rectangles we used to draw
 
 				Angle += DeltaAngle;
 				float	AngleRad = DEG2RAD( Angle );
@@ -202,9 +181,14 @@ return 0;
 			}
 		}
 
-// Draw.DrawRectangle( 0.0f, 0.0f, 100.0f, 100.0f, 10.0f, 0.0f, FillSplotch, &N );
+		Draw.EndBatch();
+
+		// Grade the grime in a single pass
+		FilterChain	Chain;
+		Chain.BrightnessContrastGamma( 0.1f, 0.7f, 2.0f );
+		Chain.Remap( 0.0f, 1.0f, 0.05f, 0.95f );
+		Chain.Apply( TB );
 
-//			Filters::BrightnessContrastGamma( TB, 0.1f, 0.7f, 2.0f );
 //			Filters::Erode( TB, 3 );
 //*/
 
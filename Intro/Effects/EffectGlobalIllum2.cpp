@@ -74,6 +74,10 @@
 //#define	LOAD_PROBES			// Define this to load probes instead of computing them
 //#define USE_WHITE_TEXTURES	// Define this to use a single white texture for the entire scene (low patate machines)
 #define	USE_NORMAL_MAPS			// Define this to use normal maps
+#define	SCENE_LODS_COUNT	3		// Amount of LODs built for each scene primitive at load time (1 to always render the full resolution meshes)
+#define	LOD_MAX_PIXEL_ERROR	1.0f	// Maximum screen-space error (in pixels) tolerated when selecting a mesh LOD
+#define	USE_MESHLET_CULLING		// Define this to cull the meshlets of the full resolution meshes against the main camera
+//#define	BENCHMARK_RAY_TRACER	// Define this to print the throughput of the CPU ray tracer on the scene at load time (DEBUG only)
 
 // Scene selection (also think about changing the scene in the .RC!)
 #ifdef SCENE_CORRIDOR
@@ -115,9 +119,11 @@ EffectGlobalIllum2::EffectGlobalIllum2( Device& _Device, Texture2D& _RTHDR, Prim
 	, m_Device( _Device )
 	, m_RTTarget( _RTHDR )
 	, m_ScreenQuad( _ScreenQuad )
+	, m_Camera( _Camera )
 	, m_pVertexStreamProbeIDs( NULL )
 	, m_pPrimProbeIDs( NULL )
 	, m_ProbeUpdateIndex( 0 )
+	, m_bCullMeshlets( false )
 {
 	//////////////////////////////////////////////////////////////////////////
 	// Create the materials
@@ -426,8 +432,25 @@ m_pCSComputeShadowMapBounds = NULL;	// TODO!
 	m_TotalFacesCount = 0;
 	m_TotalVerticesCount = 0;
 	m_TotalPrimitivesCount = 0;
+	m_PrimitiveFaceOffsets.Clear();
+	m_PrimitiveVertexOffsets.Clear();
 	m_EmissiveMaterialsCount = 0;
-	m_Scene.Load( IDR_SCENE_GI, *this );
+#ifdef USE_MESHLET_CULLING
+	m_Scene.Load( IDR_SCENE_GI, *this, false, SCENE_LODS_COUNT, true );
+#else
+	m_Scene.Load( IDR_SCENE_GI, *this, false, SCENE_LODS_COUNT );
+#endif
+
+#if defined(_DEBUG) && defined(BENCHMARK_RAY_TRACER)
+	{	// Trace the full resolution scene with coherent & incoherent rays (the benchmark prints its throughputs)
+		RayTracer	Tracer;
+		Tracer.InitScene( m_Scene );
+
+		RayTracer::BenchmarkResults	TracerBenchmark;
+		Tracer.Benchmark( 1 << 18, TracerBenchmark );
+		print( "RayTracer: %d meshes, %d instances, %d rays disagree with the brute-force tracing\n", Tracer.GetMeshesCount(), Tracer.GetInstancesCount(), TracerBenchmark.ErrorsCount );
+	}
+#endif
 
 	// Upload static lights once and for all
 	m_pSB_LightsStatic->Write( m_pCB_Scene->m.StaticLightsCount );
@@ -458,7 +481,10 @@ m_pCSComputeShadowMapBounds = NULL;	// TODO!
 		m_Scene.ForEach( Visitor0 );
 
 		m_ppCachedMeshes = new Scene::Mesh*[m_MeshesCount];
-		m_pProbes = new ProbeStruct[m_ProbesCount];
+		{
+			MemoryTagScope	Tag( MEMORY_TAG_PROBES );
+			m_pProbes = new ProbeStruct[m_ProbesCount];
+		}
 
 		m_MeshesCount = 0;
 		m_ProbesCount = 0;
@@ -1072,7 +1098,9 @@ void	EffectGlobalIllum2::Render( float _Time, float _DeltaTime )
  	m_Device.SetRenderTarget( m_RTTarget, &m_Device.DefaultDepthStencil() );
 	m_Device.SetStates( m_Device.m_pRS_CullBack, m_Device.m_pDS_ReadWriteLess, m_Device.m_pBS_Disabled );
 
+	m_bCullMeshlets = true;	// Only the main camera culls meshlets, shadow maps & probes need the entire scene
 	m_Scene.Render( *this );
+	m_bCullMeshlets = false;
 
 
 	//////////////////////////////////////////////////////////////////////////
@@ -1095,17 +1123,24 @@ void	EffectGlobalIllum2::Render( float _Time, float _DeltaTime )
 
 		m_pTexDynamicNormalMap->SetPS( 11 );
 
+		// Update objects' positions
+		// TODO!
+		float3	pPositions[MAX_DYNAMIC_OBJECTS];
 		for ( U32 DynamicObjectIndex=0; DynamicObjectIndex < m_CachedCopy.DynamicObjectsCount; DynamicObjectIndex++ )
 		{
 			DynamicObject&	DynObj = m_pDynamicObjects[DynamicObjectIndex];
+			pPositions[DynamicObjectIndex] = DynObj.PositionStart + (DynObj.PositionEnd - DynObj.PositionStart) * t;
+		}
 
-			// Update object's position
-			// TODO!
-			m_pCB_DynamicObject->m.Position = DynObj.PositionStart + (DynObj.PositionEnd - DynObj.PositionStart) * t;
+		// Retrieve nearest probes in a single batch
+		const ProbeStruct* const*	pppNearestProbes[MAX_DYNAMIC_OBJECTS];
+		m_ProbeOctree.FetchNearest( m_CachedCopy.DynamicObjectsCount, pPositions, pppNearestProbes, NULL, m_pNearestProbeHints );
 
-			// Retrieve nearest probe
-			float				ProbeDistance;
-			const ProbeStruct* const*	ppNearestProbe = m_ProbeOctree.FetchNearest( m_pCB_DynamicObject->m.Position, ProbeDistance );
+		for ( U32 DynamicObjectIndex=0; DynamicObjectIndex < m_CachedCopy.DynamicObjectsCount; DynamicObjectIndex++ )
+		{
+			m_pCB_DynamicObject->m.Position = pPositions[DynamicObjectIndex];
+
+			const ProbeStruct* const*	ppNearestProbe = pppNearestProbes[DynamicObjectIndex];
 			m_pCB_DynamicObject->m.ProbeID = ppNearestProbe != NULL ? (*ppNearestProbe)->ProbeID : 0xFFFFFFFFU;
 
 			m_pCB_DynamicObject->UpdateData();
@@ -1180,6 +1215,7 @@ static void	CopyProbeNetworkConnection( int _EntryIndex, EffectGlobalIllum2::Run
 
 void	EffectGlobalIllum2::PreComputeProbes()
 {
+	MemoryTagScope	Tag( MEMORY_TAG_PROBES );
 
 #ifdef LOAD_PROBES	// Define this to load probe sets from disk
 
@@ -1485,9 +1521,12 @@ void	EffectGlobalIllum2::PreComputeProbes()
 			};
 			m_Device.SetRenderTargets( CUBE_MAP_SIZE, CUBE_MAP_SIZE, 3, ppViews, pRTCubeMapDepth->GetDSV() );
 
-			// Render scene
+			// Render scene at full resolution (face IDs stored in the cube maps are only valid for LOD 0)
 			for ( U32 MeshIndex=0; MeshIndex < m_MeshesCount; MeshIndex++ )
+			{
+				m_ppCachedMeshes[MeshIndex]->m_LODIndex = 0;
 				RenderMesh( *m_ppCachedMeshes[MeshIndex], m_pMatRenderCubeMap, true );
+			}
 
 
 			//////////////////////////////////////////////////////////////////////////
@@ -1682,7 +1721,15 @@ pRTCubeMap->SetPS( 64 );
 
 	float	MaxDimension = (m_SceneBBoxMax - m_SceneBBoxMin).Max();
 
+#ifdef _DEBUG
+	TimeProfile	OctreeBuildProfile;
+	OctreeBuildProfile.Start();
+#endif
+
 	m_ProbeOctree.Init( m_SceneBBoxMin, MaxDimension, 4.0f, m_ProbesCount );
+	for ( int DynamicObjectIndex=0; DynamicObjectIndex < MAX_DYNAMIC_OBJECTS; DynamicObjectIndex++ )
+		m_pNearestProbeHints[DynamicObjectIndex] = Octree<const ProbeStruct*>::NearestHint();	// Previous answers are meaningless in the new octree
+
 	int		MaxNodesCount = 0;
 	int		TotalNodesCount = 0;
 	U32		MaxNodesProbeIndex = ~0;
@@ -1702,6 +1749,34 @@ pRTCubeMap->SetPS( 64 );
 
 	float	AverageNodesCount = float(TotalNodesCount) / m_ProbesCount;
 
+#ifdef _DEBUG
+	double	OctreeBuildTime = OctreeBuildProfile.Stop();
+
+	// Compare the exact nearest probe queries with the approximate ones
+	Octree<const ProbeStruct*>::BenchmarkResults	OctreeBenchmark;
+	m_ProbeOctree.BenchmarkNearest( 10000, OctreeBenchmark );
+	print( "Probe octree: exact queries %.2fms, approximate queries %.2fms (%d wrong, max extra distance %.3f)\n", OctreeBenchmark.ExactTime, OctreeBenchmark.ApproximateTime, OctreeBenchmark.ApproximateErrorsCount, OctreeBenchmark.ApproximateMaxError );
+
+	// Compare with the linear octree
+	LinearOctree<const ProbeStruct*>	ProbeLinearOctree;
+	ProbeLinearOctree.Init( m_SceneBBoxMin, MaxDimension, 4.0f, m_ProbesCount );
+	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ )
+	{
+		ProbeStruct&	Probe = m_pProbes[ProbeIndex];
+		ProbeLinearOctree.Append( Probe.pSceneProbe->m_Local2World.GetRow( 3 ), Probe.MaxDistance, &Probe );
+	}
+	ProbeLinearOctree.Build();
+
+	LinearOctree<const ProbeStruct*>::BenchmarkResults	LinearOctreeBenchmark;
+	ProbeLinearOctree.BenchmarkNearest( 10000, LinearOctreeBenchmark );
+	print( "Probe linear octree: built in %.2fms (octree %.2fms), exact queries %.2fms, approximate queries %.2fms (%d wrong, max extra distance %.3f)\n", ProbeLinearOctree.m_BuildTime, OctreeBuildTime, LinearOctreeBenchmark.ExactTime, LinearOctreeBenchmark.ApproximateTime, LinearOctreeBenchmark.ApproximateErrorsCount, LinearOctreeBenchmark.ApproximateMaxError );
+
+	// Allocations churn of the octrees and hashtables
+	MemoryChurnBenchmarkResults	ChurnBenchmark;
+	BenchmarkMemoryChurn( 10, ChurnBenchmark );
+	print( "Memory churn: dictionaries %.2fms (%d system allocations), octrees %.2fms (%d system allocations)\n", ChurnBenchmark.DictionariesTime, ChurnBenchmark.DictionariesSystemAllocations, ChurnBenchmark.OctreesTime, ChurnBenchmark.OctreesSystemAllocations );
+#endif
+
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build initial positions for dynamic dummy objects
@@ -1732,7 +1807,7 @@ pRTCubeMap->SetPS( 64 );
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build the probes network debug mesh
-	Dictionary<RuntimeProbeNetworkInfos>	Connections;
+	Dictionary<RuntimeProbeNetworkInfos>	Connections( m_ProbesCount * MAX_PROBE_NEIGHBORS / 2 );	// Each connection is shared by 2 probes
 	for ( U32 ProbeIndex=0; ProbeIndex < m_ProbesCount; ProbeIndex++ )
 	{
 		ProbeStruct&	Probe = m_pProbes[ProbeIndex];
@@ -2021,7 +2096,7 @@ void*	EffectGlobalIllum2::TagPrimitive( const Scene& _Owner, Scene::Mesh& _Mesh,
 	}
 	ASSERT( pVertexFormat != NULL, "Unsupported vertex format!" );
 
-	Primitive*	pPrim = new Primitive( m_Device, _Primitive.m_VerticesCount, _Primitive.m_pVertices, 3*_Primitive.m_FacesCount, _Primitive.m_pFaces, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, *pVertexFormat );
+	Primitive*	pPrim = new Primitive( m_Device, _Primitive.m_VerticesCount, _Primitive.m_pVertices, 3*_Primitive.m_TotalFacesCount, _Primitive.m_pFaces, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, *pVertexFormat );
 
 #ifdef USE_PER_VERTEX_PROBE_ID
 	// Bind it additional buffer infos
@@ -2030,10 +2105,10 @@ void*	EffectGlobalIllum2::TagPrimitive( const Scene& _Owner, Scene::Mesh& _Mesh,
 
 	// Tag the primitive with the face offset
 	pPrim->m_pTag = (void*) m_TotalFacesCount;
-	m_pPrimitiveFaceOffset[m_TotalPrimitivesCount] = m_TotalFacesCount;		// Store face offset for each primitive
-	m_pPrimitiveVertexOffset[m_TotalPrimitivesCount] = m_TotalVerticesCount;// Sotre vertex offset also
+	m_PrimitiveFaceOffsets.Append( m_TotalFacesCount );						// Store face offset for each primitive
+	m_PrimitiveVertexOffsets.Append( m_TotalVerticesCount );				// Sotre vertex offset also
 	m_TotalVerticesCount += pPrim->GetVerticesCount();						// Increase total amount of vertices
-	m_TotalFacesCount += pPrim->GetFacesCount();							// Increase total amount of faces
+	m_TotalFacesCount += _Primitive.m_FacesCount;							// Increase total amount of faces (only LOD 0 faces have an absolute index, simplified LODs are appended after them)
 	m_TotalPrimitivesCount++;
 
 #ifdef _DEBUG
@@ -2050,6 +2125,18 @@ void	EffectGlobalIllum2::RenderMesh( const Scene::Mesh& _Mesh, Material* _pMater
 	memcpy( &m_pCB_Object->m.Local2World, &_Mesh.m_Local2World, sizeof(float4x4) );
 	m_pCB_Object->UpdateData();
 
+#ifdef USE_MESHLET_CULLING
+	// Meshlets are tested in the mesh's local space
+	bool		bCullMeshlets = m_bCullMeshlets && _Mesh.m_LODIndex == 0;
+	float4x4	Local2Proj;
+	float3		LocalCameraPosition;
+	if ( bCullMeshlets )
+	{
+		Local2Proj = _Mesh.m_Local2World * m_Camera.GetCB().World2Proj;
+		LocalCameraPosition = float4( m_Camera.GetCB().Camera2World.GetRow( 3 ), 1.0f ) * _Mesh.m_Local2World.Inverse();
+	}
+#endif
+
 	for ( int PrimitiveIndex=0; PrimitiveIndex < _Mesh.m_PrimitivesCount; PrimitiveIndex++ )
 	{
 		Scene::Mesh::Primitive&	ScenePrimitive = _Mesh.m_pPrimitives[PrimitiveIndex];
@@ -2105,9 +2192,33 @@ void	EffectGlobalIllum2::RenderMesh( const Scene::Mesh& _Mesh, Material* _pMater
 			pMat->Use();
 		}
 
-		// Render
-		pPrim->Render( *pMat );
+		// Render the LOD selected by the scene (faces of all the LODs were uploaded, the simplified ones share the vertices of LOD 0)
+		const Scene::Mesh::Primitive::LOD&	L = ScenePrimitive.GetLOD( _Mesh.m_LODIndex );
+#ifdef USE_MESHLET_CULLING
+		if ( bCullMeshlets && ScenePrimitive.m_MeshletsCount > 0 )
+		{	// Only draw the ranges of visible meshlets
+			LinearAllocator&		Scratch = GetThreadScratch();
+			LinearAllocator::Scope	ScratchScope( Scratch );
+
+			MeshletBuilder::DrawRange*	pRanges = Scratch.Allocate<MeshletBuilder::DrawRange>( ScenePrimitive.m_MeshletsCount );
+			int		RangesCount = MeshletBuilder::Cull( ScenePrimitive.m_pMeshlets, ScenePrimitive.m_MeshletsCount, Local2Proj, LocalCameraPosition, pRanges );
+			for ( int RangeIndex=0; RangeIndex < RangesCount; RangeIndex++ )
+				pPrim->Render( *pMat, 0, pPrim->GetVerticesCount(), 3*pRanges[RangeIndex].StartFace, 3*pRanges[RangeIndex].FacesCount, 0 );
+			continue;
+		}
+#endif
+		pPrim->Render( *pMat, 0, pPrim->GetVerticesCount(), 3*L.StartFace, 3*L.FacesCount, 0 );
 	}
 }
 
+// Selects the coarsest LOD that stays below a pixel of screen-space error from the current camera
+int		EffectGlobalIllum2::SelectLOD( const Scene::Mesh& _Mesh )
+{
+	float3	CameraPosition = m_Camera.GetCB().Camera2World.GetRow( 3 );
+	float	TanHalfFOV = m_Camera.GetCB().Params.y;
+	float	PixelsPerUnit = 0.5f * RESY / TanHalfFOV;	// Pixels covered by a unit length at unit distance
+
+	return _Mesh.ComputeLOD( CameraPosition, PixelsPerUnit, LOD_MAX_PIXEL_ERROR );
+}
+
 #pragma endregion
\ No newline at end of file
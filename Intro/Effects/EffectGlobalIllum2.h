@@ -9,8 +9,6 @@ class EffectGlobalIllum2 : public Scene::ISceneTagger, public Scene::ISceneRende
 {
 private:	// CONSTANTS
 
-	static const U32		MAX_SCENE_PRIMITIVES = 1024;		// We handle a maximum of 1024 scene primitives. That's not because the tech is limited but simply because I don't have a dynamic list class! ^^
-
 	static const U32		CUBE_MAP_SIZE = 128;
 
 	static const U32		MAX_LIGHTS = 64;
@@ -200,6 +198,7 @@ private:	// FIELDS
 	Device&				m_Device;
 	Texture2D&			m_RTTarget;
 	Primitive&			m_ScreenQuad;
+	Camera&				m_Camera;
 
 	Material*			m_pMatRender;				// Displays the scene
 	Material*			m_pMatRenderEmissive;		// Displays the scene's emissive objects (area lights)
@@ -222,6 +221,7 @@ private:	// FIELDS
 	float3				m_SceneBBoxMax;
 	CompositeVertexFormatDescriptor	m_SceneVertexFormatDesc;
 	bool				m_bDeleteSceneTags;
+	bool				m_bCullMeshlets;			// True while rendering the scene from the main camera
 	Primitive*			m_pPrimSphere;
 	Primitive*			m_pPrimPoint;
 
@@ -237,8 +237,8 @@ private:	// FIELDS
 	U32					m_TotalVerticesCount;
 	U32					m_TotalFacesCount;
 	U32					m_TotalPrimitivesCount;
-	U32					m_pPrimitiveFaceOffset[MAX_SCENE_PRIMITIVES];
-	U32					m_pPrimitiveVertexOffset[MAX_SCENE_PRIMITIVES];
+	List<U32>			m_PrimitiveFaceOffsets;
+	List<U32>			m_PrimitiveVertexOffsets;
 
 		// Optional vertex stream containing probe IDs for each vertex
 	U32					m_VertexStreamProbeIDsLength;
@@ -251,6 +251,7 @@ private:	// FIELDS
 
 		// Dynamic objects
 	DynamicObject		m_pDynamicObjects[MAX_DYNAMIC_OBJECTS];
+	Octree<const ProbeStruct*>::NearestHint	m_pNearestProbeHints[MAX_DYNAMIC_OBJECTS];	// Nearest probes of the previous frame
 
 
 	// Textures
@@ -384,6 +385,7 @@ public:		// METHODS
 
 	// ISceneRenderer Implementation
 	virtual void	RenderMesh( const Scene::Mesh& _Mesh, Material* _pMaterialOverride, bool _SetMaterial ) override;
+	virtual int		SelectLOD( const Scene::Mesh& _Mesh ) override;
 
 private:
 
@@ -125,7 +125,7 @@ EffectVolumetric::EffectVolumetric( Device& _Device, Texture2D& _RTHDR, Primitiv
 
 #ifdef SHOW_TERRAIN
 	{
-		m_pPrimTerrain = new Primitive( m_Device, VertexFormatP3::DESCRIPTOR );
+		m_pPrimTerrain = new Primitive( m_Device, VertexFormatP3::DESCRIPTOR, true );
 		GeometryBuilder::BuildPlane( 200, 200, float3::UnitX, -float3::UnitZ, *m_pPrimTerrain );
 	}
 #endif
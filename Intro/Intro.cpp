@@ -15,6 +15,20 @@
 // #include "Effects/Scene/Scene.h"
 // #include "Effects/Scene/EffectScene.h"
 
+#ifdef _DEBUG
+#define MEMORY_SNAPSHOTS_FILE	"./MemorySnapshots.txt"	// Memory snapshots are dumped at each milestone of the intro's initialization (comment this out to disable them)
+#endif
+
+#ifdef MEMORY_SNAPSHOTS_FILE
+#define MEMORY_SNAPSHOT( Milestone )	DumpMemorySnapshot( MEMORY_SNAPSHOTS_FILE, Milestone )
+#else
+#define MEMORY_SNAPSHOT( Milestone )
+#endif
+
+//#define BENCHMARK_JOB_SYSTEM	// Define this to print the scheduling overhead of the job system at startup (DEBUG only)
+//#define BENCHMARK_DRAW_UTILS	// Define this to print the throughput of the 2D rasterizer at startup (DEBUG only)
+//#define BENCHMARK_LISTS			// Define this to print the timings of List and InlineList compared to the former List and std::vector at startup (DEBUG only)
+
 #define CHECK_MATERIAL( pMaterial, ErrorCode )		if ( (pMaterial)->HasErrors() ) return ErrorCode;
 #define CHECK_EFFECT( pEffect, ErrorCode )			{ int EffectError = (pEffect)->GetErrorCode(); if ( EffectError != 0 ) return ErrorCode + EffectError; }
 
@@ -97,6 +111,43 @@ int	IntroInit( IntroProgressDelegate& _Delegate )
 	}
 */
 
+	//////////////////////////////////////////////////////////////////////////
+	// Setup memory budgets (a warning is issued whenever a tag goes over budget)
+	SetMemoryBudget( MEMORY_TAG_TEXTURES, 256*1024*1024 );
+	SetMemoryBudget( MEMORY_TAG_FAT_PIXELS, 128*1024*1024 );
+	SetMemoryBudget( MEMORY_TAG_PROBES, 64*1024*1024 );
+	SetMemoryBudget( MEMORY_TAG_SCENE, 128*1024*1024 );
+	MEMORY_SNAPSHOT( "Intro start" );
+
+#if defined(_DEBUG) && defined(BENCHMARK_JOB_SYSTEM)
+	JobSystem::BenchmarkResults	JobsBenchmark;
+	JobSystem::Benchmark( 10000, JobsBenchmark );
+	print( "Job system (%d threads): empty job %.2fus, parallel-for item %.2fus, dependent job %.2fus\n", JobsBenchmark.ThreadsCount, JobsBenchmark.RunTime, JobsBenchmark.ParallelForTime, JobsBenchmark.DependencyTime );
+#endif
+
+#if defined(_DEBUG) && defined(BENCHMARK_DRAW_UTILS)
+	{
+		TextureBuilder	TB( 512, 512 );
+		DrawUtils		Draw;
+		Draw.SetupSurface( TB );
+
+		DrawUtils::BenchmarkResults	DrawBenchmark;
+		Draw.Benchmark( 20000, 20, DrawBenchmark );
+		print( "DrawUtils: 20000 thin lines %.2fms (solid %.2fms), 20 large quads %.2fms (solid %.2fms)\n", DrawBenchmark.ThinLinesTime, DrawBenchmark.SolidThinLinesTime, DrawBenchmark.LargeQuadsTime, DrawBenchmark.SolidLargeQuadsTime );
+	}
+#endif
+
+#if defined(_DEBUG) && defined(BENCHMARK_LISTS)
+	{
+		ListBenchmarkResults	ListsBenchmark;
+		BenchmarkLists( 1 << 20, ListsBenchmark );
+
+		const char*	ppContainerNames[ListBenchmarkResults::CONTAINERS_COUNT] = { "List", "InlineList", "Former List", "std::vector" };
+		for ( int ContainerIndex=0; ContainerIndex < ListBenchmarkResults::CONTAINERS_COUNT; ContainerIndex++ )
+			print( "%s: append %.2fms, small lists %.2fms, emplace %.2fms, remove %.2fms, iterate %.2fms\n", ppContainerNames[ContainerIndex], ListsBenchmark.AppendTime[ContainerIndex], ListsBenchmark.SmallListsTime[ContainerIndex], ListsBenchmark.EmplaceTime[ContainerIndex], ListsBenchmark.RemoveTime[ContainerIndex], ListsBenchmark.IterateTime[ContainerIndex] );
+	}
+#endif
+
 	//////////////////////////////////////////////////////////////////////////
 	// Attempt to create the video capture object
 // 	gs_pVideo = new Video( gs_Device, gs_WindowInfos.hWnd );
@@ -131,6 +182,7 @@ int	IntroInit( IntroProgressDelegate& _Delegate )
 		Build2DTextures( _Delegate );
 		Build3DTextures( _Delegate );
 	}
+	MEMORY_SNAPSHOT( "Textures built" );
 
 	//////////////////////////////////////////////////////////////////////////
 	// Create primitives
@@ -174,12 +226,14 @@ int	IntroInit( IntroProgressDelegate& _Delegate )
 
 //		CHECK_EFFECT( gs_pEffectDOF = new EffectDOF( gs_Device, *gs_pRTHDR, *gs_pPrimQuad, *gs_pCamera ), ERR_EFFECT_DOF );
 	}
+	MEMORY_SNAPSHOT( "Effects created" );
 
 
 	//////////////////////////////////////////////////////////////////////////
 	// Initialize the scene last so it gives us the opportunity to fix shader errors first instead of waiting for the scene to be ready!
 #ifdef TEST_SCENE
 	PrepareScene();
+	MEMORY_SNAPSHOT( "Test scene prepared" );
 #endif
 
 
@@ -188,6 +242,8 @@ int	IntroInit( IntroProgressDelegate& _Delegate )
 
 void	IntroExit()
 {
+	MEMORY_SNAPSHOT( "Intro exit" );
+
 	// Release effects
 //	delete gs_pEffectDOF;
  	delete gs_pEffectGI;
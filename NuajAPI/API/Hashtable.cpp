@@ -11,106 +11,143 @@ int	DictionaryU32::ms_MaxCollisionsCount = 0;
 #endif
 
 DictionaryU32::DictionaryU32( int _Size )
+	: m_pEntries( NULL )
+	, m_EntriesCount( 0 )
 {
-	m_Size = _Size;
-	m_ppTable = new Node*[m_Size];
-	memset( m_ppTable, 0, m_Size*sizeof(Node*) );
+	m_Capacity = HTCapacity( _Size );
+	m_Mask = m_Capacity - 1;
 }
 DictionaryU32::~DictionaryU32()
 {
-	for ( int i=0; i < m_Size; i++ )
-	{
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL )
-		{
-			Node*	pOld = pNode;
-			pNode = pNode->pNext;
-
-			delete pOld;
-		}
-	}
-
-	delete[] m_ppTable;
+	delete[] m_pEntries;
 }
 
 void*	DictionaryU32::Get( U32 _Key ) const
 {
-	U32		idx = _Key % m_Size;
-	Node*	pNode = m_ppTable[idx];
+	if ( !m_EntriesCount )
+		return NULL;
 
-#ifdef _DEBUG
-	int		CollisionsCount = 0;
-	while ( pNode != NULL )
+	U32		idx = HTSlot( _Key, m_Mask );
+	for ( U32 Distance=1; ; Distance++, idx=(idx+1) & m_Mask )
 	{
-		if ( _Key == pNode->Key )
+		const Entry&	E = m_pEntries[idx];
+		if ( E.Distance < Distance )
+			return NULL;	// Empty slot or an entry closer to its ideal slot than we are: the key would have been stored before
+
+		if ( E.Key == _Key )
 		{
-			if ( CollisionsCount > ms_MaxCollisionsCount )
-				ms_MaxCollisionsCount = CollisionsCount;
-			return pNode->pValue;
+#ifdef _DEBUG
+			if ( int(Distance-1) > ms_MaxCollisionsCount )
+				ms_MaxCollisionsCount = Distance-1;
+#endif
+			return E.pValue;
 		}
- 
-		pNode = pNode->pNext;
-		CollisionsCount++;
 	}
-#else
-	while ( pNode != NULL )
-	{
-		if ( _Key == pNode->Key )
-			return pNode->pValue;
- 
-		pNode = pNode->pNext;
-	}
-#endif
- 
-	return NULL;
 }
 
 void	DictionaryU32::Add( U32 _Key, void* _pValue )
 {
-	U32		idx = _Key % m_Size;
- 
-	Node*	pNode = new Node();
-	pNode->Key = _Key;
-	pNode->pValue = _pValue;
- 
-	pNode->pNext = m_ppTable[idx];	// Here, we could add a check for m_ppTable[idx] == NULL to ensure no collision...
-	m_ppTable[idx] = pNode;
+	if ( 4*(m_EntriesCount+1) > 3*int(m_Capacity) || m_pEntries == NULL )
+		Grow();
+
+	m_EntriesCount++;
+
+	Insert( _Key, _pValue );
 }
 
 void	DictionaryU32::Remove( U32 _Key )
 {
-	U32		idx = _Key % m_Size;
- 
-	Node*	pPrevious = NULL;
-	Node*	pCurrent = m_ppTable[idx];
-	while ( pCurrent != NULL )
+	if ( !m_EntriesCount )
+		return;
+
+	U32		idx = HTSlot( _Key, m_Mask );
+	for ( U32 Distance=1; ; Distance++, idx=(idx+1) & m_Mask )
 	{
-		if ( _Key == pCurrent->Key )
-		{
-			if ( pPrevious != NULL )
-				pPrevious->pNext = pCurrent->pNext;	// Link over...
-			else
-				m_ppTable[idx] = pCurrent->pNext;	// We replaced the root key...
- 
-			delete pCurrent;
- 			return;
-		}
- 
-		pPrevious = pCurrent;
-		pCurrent = pCurrent->pNext;
+		const Entry&	E = m_pEntries[idx];
+		if ( E.Distance < Distance )
+			return;	// Not found
+
+		if ( E.Key == _Key )
+			break;
 	}
+
+	// Shift the following entries back until we find an empty slot or an entry already in its ideal slot
+	U32	Next = (idx+1) & m_Mask;
+	while ( m_pEntries[Next].Distance > 1 )
+	{
+		m_pEntries[idx] = m_pEntries[Next];
+		m_pEntries[idx].Distance--;
+		idx = Next;
+		Next = (Next+1) & m_Mask;
+	}
+	m_pEntries[idx].Distance = 0;
+
+	m_EntriesCount--;
 }
 
 void	DictionaryU32::ForEach( VisitorDelegate _pDelegate, void* _pUserData )
 {
+	if ( m_pEntries == NULL )
+		return;
+
 	int	EntryIndex = 0;
-	for ( int i=0; i < m_Size; i++ )
+	for ( U32 i=0; i < m_Capacity; i++ )
+		if ( m_pEntries[i].Distance != 0 )
+			(*_pDelegate)( EntryIndex++, m_pEntries[i].pValue, _pUserData );
+}
+
+void	DictionaryU32::Insert( U32 _Key, void* _pValue )
+{
+	Entry	Inserted;
+	Inserted.Distance = 1;
+	Inserted.Key = _Key;
+	Inserted.pValue = _pValue;
+
+	U32	idx = HTSlot( _Key, m_Mask );
+	while ( true )
 	{
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL )
-		{
-			(*_pDelegate)( EntryIndex++, pNode->pValue, _pUserData );
-			pNode = pNode->pNext;
+		Entry&	E = m_pEntries[idx];
+		if ( E.Distance == 0 )
+		{	// Found an empty slot
+			E = Inserted;
+			return;
 		}
+		if ( E.Distance < Inserted.Distance || (E.Distance == Inserted.Distance && E.Key == Inserted.Key) )
+		{	// Steal the slot of that richer entry (or of an older entry with the same key, so the newest is found first) and carry on with it
+			Entry	Temp = E;
+			E = Inserted;
+			Inserted = Temp;
+		}
+
+		Inserted.Distance++;
+		idx = (idx+1) & m_Mask;
 	}
-}
\ No newline at end of file
+}
+
+void	DictionaryU32::Grow()
+{
+	Entry*	pOldEntries = m_pEntries;
+	U32		OldCapacity = m_Capacity;
+	if ( pOldEntries != NULL )
+		m_Capacity *= 2;
+	m_Mask = m_Capacity - 1;
+
+	m_pEntries = new Entry[m_Capacity];
+	memset( m_pEntries, 0, m_Capacity*sizeof(Entry) );
+
+	if ( pOldEntries == NULL )
+		return;
+
+	// Reinsert backward in probe order, starting from an empty slot, so entries sharing a key keep their newest-first order
+	U32	Start = 0;
+	while ( pOldEntries[Start].Distance != 0 )
+		Start++;
+	for ( U32 i=OldCapacity; i > 0; i-- )
+	{
+		const Entry&	E = pOldEntries[(Start+i) & (OldCapacity-1)];
+		if ( E.Distance != 0 )
+			Insert( E.Key, E.pValue );
+	}
+
+	delete[] pOldEntries;
+}
@@ -4,37 +4,51 @@
 #include "ASMHelpers.h"
 #include "../Math/Math.h"
 
-// Source: http://blog.2of1.org/2011/07/11/simple-c-hashtable-code/
+//////////////////////////////////////////////////////////////////////////
+// Open-addressing hashtables (Robin Hood hashing)
 //
-// simple hashtable
-// David Kaplan <david[at]2of1.org>, 2011
-// 
-// mem = (16 + 8 * size + 24 * entries) bytes [64-bit]
-// mem = (8 + 4 * size + 12 * entries) bytes [32-bit]
-// 
-// some sizes for reference [64-bit]
-// 2^8  = 16K [probably too small - depending on use]
-// 2^16 = 512K [even bigger would be better]
-// 2^24 = 128MB [probably a bit too much]
-// 2^32 = 32GB [whooooa! watch that heap space!]
-// 
-// the hashtable uses basic linked-lists for handling collisions
-// 
-#define HT_DEFAULT_SIZE	8192//(1 << 13)	// Default size if 8Kb
+// Entries are stored inline in a single power-of-two array, no allocation per entry.
+// Each entry remembers its distance to its ideal slot: on insertion an entry takes the slot of any richer entry (i.e. closer to its own ideal slot)
+//	which keeps all the probe sequences short and lets lookups stop as soon as they meet an entry richer than the key they're looking for.
+// Removal shifts the following entries back instead of leaving tombstones.
+// The array doubles when it's more than 3/4 full.
+//
+// WARNING: Values move when the table grows or when an entry is removed, so don't keep pointers to values while adding or removing entries!
+//
+// Adding an existing key doesn't replace its value but stores another entry (use AddUnique() for strings to avoid that)
+//	that is stored in front of the older ones, so Get() and Remove() find the newest entry first like the former chained buckets did.
+//
+// In DEBUG, ms_MaxCollisionsCount records the longest probe sequence met by a lookup (i.e. the amount of slots visited past the ideal one)
+//	rather than the length of a bucket's chain: with a 3/4 max load factor and well distributed keys it stays below 16.
+//
+#define HT_DEFAULT_SIZE	16		// Default initial capacity (the array is only allocated on the first insertion)
 #define HT_MAX_KEYLEN	1024
 
 #if defined(_DEBUG) || !defined(GODCOMPLEX)
 
 // Hashtable of strings, only used to access constants & uniforms by name in the shaders in DEBUG mode
+// The hash of each key is stored along with it so most comparisons with other keys are made without touching the strings.
+// Keys are copied into pages owned by the dictionary, unless the dictionary is created with interned keys, in which case the dictionary
+//	only stores the pointers and the keys must outlive their entries (e.g. string literals or strings owned by the values)
 template<typename T> class	DictionaryString
 {
 protected:	// NESTED TYPES
 
-	struct	Node
+	struct	Entry
+	{
+		U32			Distance;	// 1 + distance to the ideal slot, 0 if the slot is empty
+		U32			Hash;
+		const char*	pKey;
+		T			Value;
+	};
+
+	// A page of copied keys
+	struct	KeysPage
 	{
-		struct Node*	pNext;
-		char*			pKey;
-		T				Value;
+		KeysPage*	pPrevious;
+		int			Size;
+		int			Used;
+		// Followed by the keys...
 	};
 
 public:
@@ -43,15 +57,20 @@ public:
 
 protected:	// FIELDS
 
-	Node**	m_ppTable;
-	int		m_Size;
-	int		m_EntriesCount;
+	Entry*		m_pEntries;
+	U32			m_Capacity;
+	U32			m_Mask;
+	int			m_EntriesCount;
+	bool		m_bInternedKeys;
+	KeysPage*	m_pKeysPage;
 
 public:		// METHODS
 
-	DictionaryString( int _Size=HT_DEFAULT_SIZE );
+	DictionaryString( int _Size=HT_DEFAULT_SIZE, bool _bInternedKeys=false );
 	~DictionaryString();
 
+	int		GetEntriesCount() const		{return m_EntriesCount; }	// Amount of entries in the dictionary
+
 	T*		Get( const char* _pKey ) const;					// retrieve entry
 	T&		Add( const char* _pKey );						// store entry
 	T&		AddUnique( const char* _pKey );					// store entry
@@ -64,6 +83,12 @@ public:
 
 	static U32	Hash( const char* _pKey );
 	static U32	Hash( U32 _Key );
+
+protected:
+
+	T&			Insert( U32 _Hash, const char* _pKey, const T& _Value );
+	void		Grow();
+	const char*	CopyKey( const char* _pKey );
 };
 
 #endif
@@ -73,11 +98,11 @@ template<typename T> class	Dictionary
 {
 protected:	// NESTED TYPES
 
-	struct	Node
+	struct	Entry
 	{
-		struct Node*	pNext;
-		U32				Key;
-		T				Value;
+		U32		Distance;	// 1 + distance to the ideal slot, 0 if the slot is empty
+		U32		Key;
+		T		Value;
 	};
 
 public:
@@ -87,13 +112,14 @@ public:
 
 protected:	// FIELDS
 
-	Node**	m_ppTable;
-	int		m_Size;
+	Entry*	m_pEntries;
+	U32		m_Capacity;
+	U32		m_Mask;
 	int		m_EntriesCount;
 
 #ifdef _DEBUG
 public:
-	static int	ms_MaxCollisionsCount;	// You can examine this to know if one of the dictionaries has too many collisions (i.e. size too small)
+	static int	ms_MaxCollisionsCount;	// You can examine this to know if one of the dictionaries has too long probe sequences (i.e. bad keys distribution)
 #endif
 
 public:		// METHODS
@@ -108,6 +134,11 @@ public:		// METHODS
 	T&		Add( U32 _Key, const T& _Value );	// store entry
 	void	Remove( U32 _Key );					// remove entry
 	void	ForEach( VisitorDelegate _pDelegate, void* _pUserData );
+
+protected:
+
+	T&		Insert( U32 _Key, const T& _Value );
+	void	Grow();
 };
 
 // General dictionary storing blind values
@@ -115,25 +146,27 @@ class	DictionaryU32
 {
 protected:	// NESTED TYPES
 
-	struct	Node
+	struct	Entry
 	{
-		struct Node*	pNext;
-		U32				Key;
-		void*			pValue;
+		U32		Distance;	// 1 + distance to the ideal slot, 0 if the slot is empty
+		U32		Key;
+		void*	pValue;
 	};
- 
+
 public:
 
 	typedef void	(*VisitorDelegate)( int _EntryIndex, void*& _pValue, void* _pUserData );
 
 protected:	// FIELDS
 
-	Node**	m_ppTable;
-	int		m_Size;
+	Entry*	m_pEntries;
+	U32		m_Capacity;
+	U32		m_Mask;
+	int		m_EntriesCount;
 
 #ifdef _DEBUG
 public:
-	static int	ms_MaxCollisionsCount;	// You can examine this to know if one of the dictionaries has too many collisions (i.e. size too small)
+	static int	ms_MaxCollisionsCount;	// You can examine this to know if one of the dictionaries has too long probe sequences (i.e. bad keys distribution)
 #endif
 
 public:		// METHODS
@@ -141,11 +174,34 @@ public:		// METHODS
 	DictionaryU32( int _Size=HT_DEFAULT_SIZE );
 	~DictionaryU32();
 
+	int		GetEntriesCount() const		{return m_EntriesCount; }	// Amount of entries in the dictionary
+
 	void*	Get( U32 _Key ) const;				// retrieve entry
 	void	Add( U32 _Key, void* _pValue );	// store entry
 	void	Remove( U32 _Key );			// remove entry
 	void	ForEach( VisitorDelegate _pDelegate, void* _pUserData );
+
+protected:
+
+	void	Insert( U32 _Key, void* _pValue );
+	void	Grow();
 };
 
+// Returns the power of two capacity required to store the specified amount of entries without exceeding the max load factor
+inline U32	HTCapacity( int _EntriesCount )
+{
+	U32	Capacity = HT_DEFAULT_SIZE;
+	while ( 3*Capacity < 4*U32(_EntriesCount) )
+		Capacity <<= 1;
+	return Capacity;
+}
+
+// Fibonacci hashing: scrambles all the bits of the key into the upper bits, which are then folded onto the table's mask
+inline U32	HTSlot( U32 _Hash, U32 _Mask )
+{
+	U32	Scrambled = _Hash * 0x9E3779B9U;
+	return (Scrambled ^ (Scrambled >> 16)) & _Mask;
+}
+
 
 #include "Hashtable.inl"
@@ -2,30 +2,25 @@
 
 //////////////////////////////////////////////////////////////////////////
 // String version
-template<typename T> DictionaryString<T>::DictionaryString( int _Size ) : m_EntriesCount( 0 )
+template<typename T> DictionaryString<T>::DictionaryString( int _Size, bool _bInternedKeys )
+	: m_pEntries( NULL )
+	, m_EntriesCount( 0 )
+	, m_bInternedKeys( _bInternedKeys )
+	, m_pKeysPage( NULL )
 {
-	m_Size = _Size;
-	m_ppTable = new Node*[m_Size];
-	memset( m_ppTable, 0, m_Size*sizeof(Node*) );
+	m_Capacity = HTCapacity( _Size );
+	m_Mask = m_Capacity - 1;
 }
 template<typename T> DictionaryString<T>::~DictionaryString()
 {
-	for ( int i=0; i < m_Size; i++ )
-	{
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL )
-		{
-			Node*	pOld = pNode;
-			pNode = pNode->pNext;
- 
-			delete pOld->pKey;
-			pOld->pKey = NULL;
+	delete[] m_pEntries;
 
-			delete pOld;
-		}
+	while ( m_pKeysPage != NULL )
+	{
+		KeysPage*	pPrevious = m_pKeysPage->pPrevious;
+		delete[] (char*) m_pKeysPage;
+		m_pKeysPage = pPrevious;
 	}
-
-	delete[] m_ppTable;
 }
 
 template<typename T> T*	DictionaryString<T>::Get( const char* _pKey ) const
@@ -33,35 +28,27 @@ template<typename T> T*	DictionaryString<T>::Get( const char* _pKey ) const
 	if ( !m_EntriesCount )
 		return NULL;
 
-	U32		idx = Hash( _pKey ) % m_Size;
-	Node*	pNode = m_ppTable[idx];
-	while ( pNode != NULL )
+	U32		KeyHash = Hash( _pKey );
+	U32		idx = HTSlot( KeyHash, m_Mask );
+	for ( U32 Distance=1; ; Distance++, idx=(idx+1) & m_Mask )
 	{
-		if ( !strncmp( _pKey, pNode->pKey, HT_MAX_KEYLEN ) )
-			return &pNode->Value;
- 
-		pNode = pNode->pNext;
+		Entry&	E = m_pEntries[idx];
+		if ( E.Distance < Distance )
+			return NULL;	// Empty slot or an entry closer to its ideal slot than we are: the key would have been stored before
+
+		if ( E.Hash == KeyHash && (E.pKey == _pKey || !strncmp( _pKey, E.pKey, HT_MAX_KEYLEN )) )
+			return &E.Value;
 	}
- 
-	return NULL;
 }
 
 template<typename T> T&	DictionaryString<T>::Add( const char* _pKey )
 {
-	U32		idx = Hash( _pKey ) % m_Size;
- 
-	Node*	pNode = new Node();
-
-	int		KeyLength = strnlen( _pKey, HT_MAX_KEYLEN ) + 1;
-	pNode->pKey = new char[KeyLength];
-	strcpy_s( pNode->pKey, KeyLength, _pKey );
- 
-	pNode->pNext = m_ppTable[idx];
-	m_ppTable[idx] = pNode;
+	if ( 4*(m_EntriesCount+1) > 3*int(m_Capacity) || m_pEntries == NULL )
+		Grow();
 
 	m_EntriesCount++;
 
-	return pNode->Value;
+	return Insert( Hash( _pKey ), m_bInternedKeys ? _pKey : CopyKey( _pKey ), T() );
 }
 
 template<typename T> T&	DictionaryString<T>::AddUnique( const char* _pKey )
@@ -87,30 +74,34 @@ template<typename T> void	DictionaryString<T>::AddUnique( const char* _pKey, con
 
 template<typename T> void	DictionaryString<T>::Remove( const char* _pKey )
 {
-	U32		idx = Hash( _pKey ) % m_Size;
- 
-	Node*	pPrevious = NULL;
-	Node*	pCurrent = m_ppTable[idx];
-	while ( pCurrent != NULL )
+	if ( !m_EntriesCount )
+		return;
+
+	U32		KeyHash = Hash( _pKey );
+	U32		idx = HTSlot( KeyHash, m_Mask );
+	for ( U32 Distance=1; ; Distance++, idx=(idx+1) & m_Mask )
 	{
-		if ( !strncmp( _pKey, pCurrent->pKey, HT_MAX_KEYLEN ) )
-		{
-			if ( pPrevious != NULL )
-				pPrevious->pNext = pCurrent->pNext;	// Link over...
-			else
-				m_ppTable[idx] = pCurrent->pNext;	// We replaced the root key...
- 
-			delete pCurrent->pKey;
-			delete pCurrent;
- 
-			m_EntriesCount--;
-
-			return;
-		}
- 
-		pPrevious = pCurrent;
-		pCurrent = pCurrent->pNext;
+		Entry&	E = m_pEntries[idx];
+		if ( E.Distance < Distance )
+			return;	// Not found
+
+		if ( E.Hash == KeyHash && (E.pKey == _pKey || !strncmp( _pKey, E.pKey, HT_MAX_KEYLEN )) )
+			break;
+	}
+
+	// Shift the following entries back until we find an empty slot or an entry already in its ideal slot
+	// (the copied key stays in its page until the dictionary is destroyed)
+	U32	Next = (idx+1) & m_Mask;
+	while ( m_pEntries[Next].Distance > 1 )
+	{
+		m_pEntries[idx] = m_pEntries[Next];
+		m_pEntries[idx].Distance--;
+		idx = Next;
+		Next = (Next+1) & m_Mask;
 	}
+	m_pEntries[idx].Distance = 0;
+
+	m_EntriesCount--;
 }
 
 template<typename T> U32	DictionaryString<T>::Hash( const char* _pKey )
@@ -118,10 +109,10 @@ template<typename T> U32	DictionaryString<T>::Hash( const char* _pKey )
   /* djb2 */
   U32 hash = 5381;
   int c;
- 
+
   while ( c = *_pKey++ )
     hash = ((hash << 5) + hash) + c;
- 
+
   return hash;
 }
 
@@ -139,16 +130,95 @@ template<typename T> U32	DictionaryString<T>::Hash( U32 _Key )
 
 template<typename T> void	DictionaryString<T>::ForEach( VisitorDelegate _pDelegate, void* _pUserData )
 {
+	if ( m_pEntries == NULL )
+		return;
+
 	int	EntryIndex = 0;
-	for ( int i=0; i < m_Size; i++ )
+	for ( U32 i=0; i < m_Capacity; i++ )
+		if ( m_pEntries[i].Distance != 0 )
+			(*_pDelegate)( EntryIndex++, m_pEntries[i].Value, _pUserData );
+}
+
+template<typename T> T&	DictionaryString<T>::Insert( U32 _Hash, const char* _pKey, const T& _Value )
+{
+	Entry	Inserted;
+	Inserted.Distance = 1;
+	Inserted.Hash = _Hash;
+	Inserted.pKey = _pKey;
+	Inserted.Value = _Value;
+
+	T*	pResult = NULL;
+	U32	idx = HTSlot( _Hash, m_Mask );
+	while ( true )
 	{
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL )
-		{
-			(*_pDelegate)( EntryIndex++, pNode->Value, _pUserData );
-			pNode = pNode->pNext;
+		Entry&	E = m_pEntries[idx];
+		if ( E.Distance == 0 )
+		{	// Found an empty slot
+			E = Inserted;
+			return pResult != NULL ? *pResult : E.Value;
+		}
+		if ( E.Distance < Inserted.Distance || (E.Distance == Inserted.Distance && E.Hash == Inserted.Hash && !strncmp( E.pKey, Inserted.pKey, HT_MAX_KEYLEN )) )
+		{	// Steal the slot of that richer entry (or of an older entry with the same key, so the newest is found first) and carry on with it
+			Entry	Temp = E;
+			E = Inserted;
+			Inserted = Temp;
+			if ( pResult == NULL )
+				pResult = &E.Value;
 		}
+
+		Inserted.Distance++;
+		idx = (idx+1) & m_Mask;
+	}
+}
+
+template<typename T> void	DictionaryString<T>::Grow()
+{
+	Entry*	pOldEntries = m_pEntries;
+	U32		OldCapacity = m_Capacity;
+	if ( pOldEntries != NULL )
+		m_Capacity *= 2;
+	m_Mask = m_Capacity - 1;
+
+	m_pEntries = new Entry[m_Capacity];
+	for ( U32 i=0; i < m_Capacity; i++ )
+		m_pEntries[i].Distance = 0;
+
+	if ( pOldEntries == NULL )
+		return;
+
+	// Reinsert backward in probe order, starting from an empty slot, so entries sharing a key keep their newest-first order
+	U32	Start = 0;
+	while ( pOldEntries[Start].Distance != 0 )
+		Start++;
+	for ( U32 i=OldCapacity; i > 0; i-- )
+	{
+		const Entry&	E = pOldEntries[(Start+i) & (OldCapacity-1)];
+		if ( E.Distance != 0 )
+			Insert( E.Hash, E.pKey, E.Value );
+	}
+
+	delete[] pOldEntries;
+}
+
+template<typename T> const char*	DictionaryString<T>::CopyKey( const char* _pKey )
+{
+	int		KeyLength = strnlen( _pKey, HT_MAX_KEYLEN ) + 1;
+	if ( m_pKeysPage == NULL || m_pKeysPage->Used + KeyLength > m_pKeysPage->Size )
+	{	// Allocate a new page
+		int			PageSize = MAX( 4096, int(sizeof(KeysPage)) + KeyLength );
+		KeysPage*	pPage = (KeysPage*) new char[PageSize];
+		pPage->pPrevious = m_pKeysPage;
+		pPage->Size = PageSize - sizeof(KeysPage);
+		pPage->Used = 0;
+		m_pKeysPage = pPage;
 	}
+
+	char*	pCopy = ((char*) (m_pKeysPage+1)) + m_pKeysPage->Used;
+	memcpy( pCopy, _pKey, KeyLength-1 );
+	pCopy[KeyLength-1] = '\0';
+	m_pKeysPage->Used += KeyLength;
+
+	return pCopy;
 }
 
 #endif
@@ -160,27 +230,16 @@ template<typename T> void	DictionaryString<T>::ForEach( VisitorDelegate _pDelega
 template<typename T> int	Dictionary<T>::ms_MaxCollisionsCount = 0;
 #endif
 
-template<typename T> Dictionary<T>::Dictionary( int _Size ) : m_EntriesCount( 0 )
+template<typename T> Dictionary<T>::Dictionary( int _Size )
+	: m_pEntries( NULL )
+	, m_EntriesCount( 0 )
 {
-	m_Size = _Size;
-	m_ppTable = new Node*[m_Size];
-	memset( m_ppTable, 0, m_Size*sizeof(Node*) );
+	m_Capacity = HTCapacity( _Size );
+	m_Mask = m_Capacity - 1;
 }
 template<typename T> Dictionary<T>::~Dictionary()
 {
-	for ( int i=0; i < m_Size; i++ )
-	{
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL )
-		{
-			Node*	pOld = pNode;
-			pNode = pNode->pNext;
-
-			delete pOld;
-		}
-	}
-
-	delete[] m_ppTable;
+	delete[] m_pEntries;
 }
 
 template<typename T> T*	Dictionary<T>::Get( U32 _Key ) const
@@ -188,94 +247,135 @@ template<typename T> T*	Dictionary<T>::Get( U32 _Key ) const
 	if ( !m_EntriesCount )
 		return NULL;
 
-	U32		idx = _Key % m_Size;
-	Node*	pNode = m_ppTable[idx];
-
-#ifdef _DEBUG
-	int		CollisionsCount = 0;
-	while ( pNode != NULL )
+	U32		idx = HTSlot( _Key, m_Mask );
+	for ( U32 Distance=1; ; Distance++, idx=(idx+1) & m_Mask )
 	{
-		if ( _Key == pNode->Key )
+		Entry&	E = m_pEntries[idx];
+		if ( E.Distance < Distance )
+			return NULL;	// Empty slot or an entry closer to its ideal slot than we are: the key would have been stored before
+
+		if ( E.Key == _Key )
 		{
-			ms_MaxCollisionsCount = MAX( ms_MaxCollisionsCount, CollisionsCount );
-			return &pNode->Value;
+#ifdef _DEBUG
+			ms_MaxCollisionsCount = MAX( ms_MaxCollisionsCount, int(Distance-1) );
+#endif
+			return &E.Value;
 		}
- 
-		pNode = pNode->pNext;
-		CollisionsCount++;
 	}
-#else
-	while ( pNode != NULL )
-	{
-		if ( _Key == pNode->Key )
-			return &pNode->Value;
- 
-		pNode = pNode->pNext;
-	}
-#endif
-
-	return NULL;
 }
 
 template<typename T> T&	Dictionary<T>::Add( U32 _Key )
 {
-	U32		idx = _Key % m_Size;
- 
-	Node*	pNode = new Node();
-	pNode->Key = _Key;
-	pNode->pNext = m_ppTable[idx];	// Here, we could add a check for m_ppTable[idx] == NULL to ensure no collision...
-	m_ppTable[idx] = pNode;
-
-	m_EntriesCount++;
-
-	return pNode->Value;
+	return Add( _Key, T() );
 }
 
 template<typename T> T&	Dictionary<T>::Add( U32 _Key, const T& _Value )
 {
-	T&	Value = Add( _Key );
-	memcpy( &Value, &_Value, sizeof(T) );
+	if ( 4*(m_EntriesCount+1) > 3*int(m_Capacity) || m_pEntries == NULL )
+		Grow();
 
-	return Value;
+	m_EntriesCount++;
+
+	return Insert( _Key, _Value );
 }
 
 template<typename T> void	Dictionary<T>::Remove( U32 _Key )
 {
-	U32		idx = _Key % m_Size;
- 
-	Node*	pPrevious = NULL;
-	Node*	pCurrent = m_ppTable[idx];
-	while ( pCurrent != NULL )
-	{
-		if ( _Key == pCurrent->Key )
-		{
-			if ( pPrevious != NULL )
-				pPrevious->pNext = pCurrent->pNext;	// Link over...
-			else
-				m_ppTable[idx] = pCurrent->pNext;	// We replaced the root key...
+	if ( !m_EntriesCount )
+		return;
 
-			delete pCurrent;
+	U32		idx = HTSlot( _Key, m_Mask );
+	for ( U32 Distance=1; ; Distance++, idx=(idx+1) & m_Mask )
+	{
+		Entry&	E = m_pEntries[idx];
+		if ( E.Distance < Distance )
+			return;	// Not found
 
-			m_EntriesCount--;
+		if ( E.Key == _Key )
+			break;
+	}
 
- 			return;
-		}
- 
-		pPrevious = pCurrent;
-		pCurrent = pCurrent->pNext;
+	// Shift the following entries back until we find an empty slot or an entry already in its ideal slot
+	U32	Next = (idx+1) & m_Mask;
+	while ( m_pEntries[Next].Distance > 1 )
+	{
+		m_pEntries[idx] = m_pEntries[Next];
+		m_pEntries[idx].Distance--;
+		idx = Next;
+		Next = (Next+1) & m_Mask;
 	}
+	m_pEntries[idx].Distance = 0;
+
+	m_EntriesCount--;
 }
 
 template<typename T> void	Dictionary<T>::ForEach( VisitorDelegate _pDelegate, void* _pUserData )
 {
+	if ( m_pEntries == NULL )
+		return;
+
 	int	EntryIndex = 0;
-	for ( int i=0; i < m_Size; i++ )
+	for ( U32 i=0; i < m_Capacity; i++ )
+		if ( m_pEntries[i].Distance != 0 )
+			(*_pDelegate)( EntryIndex++, m_pEntries[i].Value, _pUserData );
+}
+
+template<typename T> T&	Dictionary<T>::Insert( U32 _Key, const T& _Value )
+{
+	Entry	Inserted;
+	Inserted.Distance = 1;
+	Inserted.Key = _Key;
+	Inserted.Value = _Value;
+
+	T*	pResult = NULL;
+	U32	idx = HTSlot( _Key, m_Mask );
+	while ( true )
 	{
-		Node*	pNode = m_ppTable[i];
-		while ( pNode != NULL )
-		{
-			(*_pDelegate)( EntryIndex++, pNode->Value, _pUserData );
-			pNode = pNode->pNext;
+		Entry&	E = m_pEntries[idx];
+		if ( E.Distance == 0 )
+		{	// Found an empty slot
+			E = Inserted;
+			return pResult != NULL ? *pResult : E.Value;
+		}
+		if ( E.Distance < Inserted.Distance || (E.Distance == Inserted.Distance && E.Key == Inserted.Key) )
+		{	// Steal the slot of that richer entry (or of an older entry with the same key, so the newest is found first) and carry on with it
+			Entry	Temp = E;
+			E = Inserted;
+			Inserted = Temp;
+			if ( pResult == NULL )
+				pResult = &E.Value;
 		}
+
+		Inserted.Distance++;
+		idx = (idx+1) & m_Mask;
+	}
+}
+
+template<typename T> void	Dictionary<T>::Grow()
+{
+	Entry*	pOldEntries = m_pEntries;
+	U32		OldCapacity = m_Capacity;
+	if ( pOldEntries != NULL )
+		m_Capacity *= 2;
+	m_Mask = m_Capacity - 1;
+
+	m_pEntries = new Entry[m_Capacity];
+	for ( U32 i=0; i < m_Capacity; i++ )
+		m_pEntries[i].Distance = 0;
+
+	if ( pOldEntries == NULL )
+		return;
+
+	// Reinsert backward in probe order, starting from an empty slot, so entries sharing a key keep their newest-first order
+	U32	Start = 0;
+	while ( pOldEntries[Start].Distance != 0 )
+		Start++;
+	for ( U32 i=OldCapacity; i > 0; i-- )
+	{
+		const Entry&	E = pOldEntries[(Start+i) & (OldCapacity-1)];
+		if ( E.Distance != 0 )
+			Insert( E.Key, E.Value );
 	}
+
+	delete[] pOldEntries;
 }
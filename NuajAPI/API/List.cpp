@@ -0,0 +1,158 @@
+#include "../../GodComplex.h"
+
+#ifdef _DEBUG
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Micro-benchmarks
+namespace
+{
+	struct	Element
+	{
+		float	x, y;
+		int		Index;
+		int		Padding;
+
+		Element()											{}
+		Element( float _x, float _y, int _Index ) : x( _x ), y( _y ), Index( _Index ), Padding( 0 )	{}
+	};
+
+	// The List as it was before the rewrite (memcpy'ed elements and no move), only RemoveAt() also decrements the count as it was never done
+	template<typename T> class	FormerList
+	{
+		T*		m_pList;
+		U32		m_Size;
+		U32		m_Count;
+
+	public:
+
+		FormerList() : m_pList( NULL ), m_Size( 0 ), m_Count( 0 )	{}
+		~FormerList()							{ delete[] m_pList; }
+
+		int			GetCount() const			{ return m_Count; }
+		T&			operator[]( U32 _Index )	{ return m_pList[_Index]; }
+		void		Append( const T& _Value )	{ Allocate( m_Count+1 ); memcpy( &m_pList[m_Count-1], &_Value, sizeof(T) ); }
+		T&			Append()					{ Allocate( m_Count+1 ); return m_pList[m_Count-1]; }
+		void		RemoveAt( U32 _Index )		{ memcpy( &m_pList[_Index], &m_pList[_Index+1], (m_Count-_Index-1)*sizeof(T) ); m_Count--; }
+
+	private:
+		void		Allocate( U32 _NewCount )
+		{
+			if ( _NewCount <= m_Size )
+			{
+				m_Count = _NewCount;
+				return;
+			}
+
+			T*	pOldList = m_pList;
+			int	OldSize = m_Size;
+			m_Size = m_Size != 0 ? 2*m_Size : 8;
+			m_pList = new T[m_Size];
+			memset( m_pList, 0, m_Size*sizeof(T) );
+			if ( pOldList != NULL )
+				memcpy( m_pList, pOldList, OldSize*sizeof(T) );
+			m_Count = _NewCount;
+
+			delete[] pOldList;
+		}
+	};
+
+	// Gives the 4 containers the same interface
+	void	Append( List<Element>& _List, const Element& _Value )			{ _List.Append( _Value ); }
+	void	Append( FormerList<Element>& _List, const Element& _Value )		{ _List.Append( _Value ); }
+	void	Append( std::vector<Element>& _List, const Element& _Value )	{ _List.push_back( _Value ); }
+
+	void	Emplace( List<Element>& _List, float _x, float _y, int _Index )			{ _List.Emplace( _x, _y, _Index ); }
+	void	Emplace( FormerList<Element>& _List, float _x, float _y, int _Index )	{ Element& E = _List.Append(); E.x = _x; E.y = _y; E.Index = _Index; E.Padding = 0; }
+	void	Emplace( std::vector<Element>& _List, float _x, float _y, int _Index )	{ _List.emplace_back( _x, _y, _Index ); }
+
+	void	RemoveAt( List<Element>& _List, int _Index )			{ _List.RemoveAt( _Index ); }
+	void	RemoveAt( FormerList<Element>& _List, int _Index )		{ _List.RemoveAt( _Index ); }
+	void	RemoveAt( std::vector<Element>& _List, int _Index )		{ _List.erase( _List.begin() + _Index ); }
+
+	int		GetCount( const List<Element>& _List )					{ return _List.GetCount(); }
+	int		GetCount( const FormerList<Element>& _List )			{ return _List.GetCount(); }
+	int		GetCount( const std::vector<Element>& _List )			{ return int(_List.size()); }
+
+	volatile int	gs_BenchmarkSink;	// Keeps the compiler from discarding the benchmarks' results
+
+	template<typename LIST> void	BenchmarkList( int _ElementsCount, ListBenchmarkResults& _Results, int _Container )
+	{
+		TimeProfile	Profile;
+
+		// Single list
+		Profile.Start();
+		{
+			LIST	L;
+			for ( int i=0; i < _ElementsCount; i++ )
+				Append( L, Element( float(i), 0.0f, i ) );
+			gs_BenchmarkSink = GetCount( L );
+		}
+		_Results.AppendTime[_Container] = Profile.Stop();
+
+		// Short-lived small lists
+		Profile.Start();
+		for ( int ListIndex=0; ListIndex < _ElementsCount/8; ListIndex++ )
+		{
+			LIST	L;
+			for ( int i=0; i < 8; i++ )
+				Append( L, Element( float(i), 0.0f, i ) );
+			gs_BenchmarkSink = L[7].Index;
+		}
+		_Results.SmallListsTime[_Container] = Profile.Stop();
+
+		// In-place construction
+		Profile.Start();
+		{
+			LIST	L;
+			for ( int i=0; i < _ElementsCount; i++ )
+				Emplace( L, float(i), 0.0f, i );
+			gs_BenchmarkSink = GetCount( L );
+		}
+		_Results.EmplaceTime[_Container] = Profile.Stop();
+
+		// Ordered removal
+		{
+			LIST	L;
+			double	RemoveTime = 0.0;
+			for ( int ListIndex=0; ListIndex < _ElementsCount/256; ListIndex++ )
+			{
+				for ( int i=0; i < 256; i++ )
+					Append( L, Element( float(i), 0.0f, i ) );
+
+				Profile.Start();
+				while ( GetCount( L ) > 0 )
+					RemoveAt( L, GetCount( L ) / 2 );
+				RemoveTime += Profile.Stop();
+			}
+			_Results.RemoveTime[_Container] = RemoveTime;
+		}
+
+		// Iteration
+		{
+			LIST	L;
+			for ( int i=0; i < _ElementsCount; i++ )
+				Append( L, Element( float(i), 0.0f, i ) );
+
+			Profile.Start();
+			int	Sum = 0;
+			for ( int Pass=0; Pass < 16; Pass++ )
+			{
+				int	Count = GetCount( L );
+				for ( int i=0; i < Count; i++ )
+					Sum += L[i].Index;
+			}
+			gs_BenchmarkSink = Sum;
+			_Results.IterateTime[_Container] = Profile.Stop();
+		}
+	}
+}
+
+void	BenchmarkLists( int _ElementsCount, ListBenchmarkResults& _Results )
+{
+	BenchmarkList< List<Element> >( _ElementsCount, _Results, ListBenchmarkResults::LIST );
+	BenchmarkList< InlineList<Element,8> >( _ElementsCount, _Results, ListBenchmarkResults::INLINE_LIST );
+	BenchmarkList< FormerList<Element> >( _ElementsCount, _Results, ListBenchmarkResults::FORMER_LIST );
+	BenchmarkList< std::vector<Element> >( _ElementsCount, _Results, ListBenchmarkResults::STD_VECTOR );
+}
+#endif
@@ -3,7 +3,15 @@
 #include "Types.h"
 #include "ASMHelpers.h"
 
+// Placement new used to construct the elements in the list's raw storage (so we don't depend on <new>)
+struct	ListPlacement	{};
+inline void*	operator new( size_t, ListPlacement, void* _pMemory )	{ return _pMemory; }
+inline void		operator delete( void*, ListPlacement, void* )			{}
+
 // Simple list class
+// Only the first GetCount() elements of the allocated list are constructed, elements are moved (not memcpy'ed) when the list grows
+//	so any copyable type can be stored
+// WARNING: Adding elements may re-allocate the list, don't keep pointers to elements while appending!
 template<typename T> class	List
 {
 protected:	// NESTED TYPES
@@ -12,34 +20,108 @@ public:
 
 protected:	// FIELDS
 
-	T*		m_pList;	// List of allocated elements
-	U32		m_Size;		// Size of the allocated list
-	U32		m_Count;	// Amount of non empty elements
+	T*		m_pList;		// List of allocated elements
+	U32		m_Size;			// Size of the allocated list
+	U32		m_Count;		// Amount of non empty elements
+
+	T*		m_pInlineList;	// Optional buffer provided by InlineList, used as long as it's large enough (NULL otherwise)
+	U32		m_InlineSize;
 
 public:		// PROPERTIES
 
-	int		GetCount() const			{ return m_Count; }
-	int		GetAllocatedSize() const	{ return m_Size; }
+	int			GetCount() const			{ return m_Count; }
+	int			GetAllocatedSize() const	{ return m_Size; }
+	T*			GetData()					{ return m_pList; }
+	const T*	GetData() const				{ return m_pList; }
 
 
 public:		// METHODS
 
 	List();
 	List( U32 _InitialSize );
+	List( const List& _Other );
+	List( List&& _Other );
 	~List();
 
-	void		Init( U32 _Size );
+	List&		operator=( const List& _Other );
+	List&		operator=( List&& _Other );
+
+	void		Init( U32 _Size );		// Clears the list and allocates exactly _Size elements
+	void		Reserve( U32 _Size );	// Makes sure we can store _Size elements without re-allocating
+	void		Shrink();				// Re-allocates the list to the exact amount of elements
 
 	T&			operator[]( U32 _Index );
 	const T&	operator[]( U32 _Index ) const;
 	T&			Insert( U32 _Index );
 	void		Append( const T& _Value );
+	void		Append( T&& _Value );
 	T&			Append();
-	void		RemoveAt( U32 _Index );
-	void		Clear()	{ m_Count = 0; }
+	void		Append( const T* _pValues, U32 _Count );
+	void		RemoveAt( U32 _Index );				// Keeps the order of the elements
+	void		RemoveAtUnordered( U32 _Index );	// Replaces the element by the last one (O(1))
+	void		Clear();
+
+	// Constructs an element in place from the provided arguments
+	template<typename A0> T&						Emplace( A0&& _Arg0 );
+	template<typename A0, typename A1> T&			Emplace( A0&& _Arg0, A1&& _Arg1 );
+	template<typename A0, typename A1, typename A2> T&	Emplace( A0&& _Arg0, A1&& _Arg1, A2&& _Arg2 );
+
+protected:
+
+	List( T* _pInlineList, U32 _InlineSize );
 
 private:
-	void		Allocate( U32 _NewCount );
+	T*			Allocate( U32 _NewCount );			// Makes room for _NewCount elements and returns the address of the first new element
+	void		Grow( U32 _RequiredSize );			// Kept apart from the inline Allocate() so appending to a list that has room stays small
+	void		Reallocate( U32 _NewSize );
 };
 
-#include "List.inl"
\ No newline at end of file
+// List with an inline buffer for the first INLINE_SIZE elements, so small lists don't allocate at all
+// The inline buffer is only aligned like a double (__declspec(align()) only takes literals), so over-aligned types must use a List
+template<typename T, U32 INLINE_SIZE> class	InlineList : public List<T>
+{
+	static_assert( __alignof(T) <= __alignof(double), "InlineList can't store types with an alignment larger than a double's!" );
+
+protected:	// FIELDS
+
+	union
+	{
+		U8		m_pInlineBuffer[INLINE_SIZE*sizeof(T)];
+		double	m_Alignment;
+	};
+
+public:		// METHODS
+
+	InlineList() : List<T>( (T*) m_pInlineBuffer, INLINE_SIZE )	{}
+	InlineList( const InlineList& _Other ) : List<T>( (T*) m_pInlineBuffer, INLINE_SIZE )	{ List<T>::operator=( _Other ); }
+	InlineList( InlineList&& _Other ) : List<T>( (T*) m_pInlineBuffer, INLINE_SIZE )		{ List<T>::operator=( static_cast<List<T>&&>( _Other ) ); }
+
+	InlineList&	operator=( const InlineList& _Other )	{ List<T>::operator=( _Other ); return *this; }
+	InlineList&	operator=( InlineList&& _Other )		{ List<T>::operator=( static_cast<List<T>&&>( _Other ) ); return *this; }
+};
+
+#ifdef _DEBUG
+// Compares List and InlineList with the former List implementation and std::vector
+struct	ListBenchmarkResults
+{
+	enum	CONTAINER
+	{
+		LIST,
+		INLINE_LIST,	// InlineList with 8 inline elements
+		FORMER_LIST,
+		STD_VECTOR,
+		CONTAINERS_COUNT
+	};
+
+	// Milliseconds, per container
+	double	AppendTime[CONTAINERS_COUNT];		// Appending all the elements to a single list
+	double	SmallListsTime[CONTAINERS_COUNT];	// Appending all the elements to short-lived lists of 8 elements
+	double	EmplaceTime[CONTAINERS_COUNT];		// Constructing all the elements in place in a single list
+	double	RemoveTime[CONTAINERS_COUNT];		// Removing the middle element of lists of 256 elements until they're empty
+	double	IterateTime[CONTAINERS_COUNT];		// Reading all the elements of a single list 16 times
+};
+
+void	BenchmarkLists( int _ElementsCount, ListBenchmarkResults& _Results );
+#endif
+
+#include "List.inl"
@@ -1,8 +1,9 @@
-
 template<typename T> List<T>::List()
 	: m_pList( NULL )
 	, m_Size( 0 )
 	, m_Count( 0 )
+	, m_pInlineList( NULL )
+	, m_InlineSize( 0 )
 {
 
 }
@@ -11,22 +12,106 @@ template<typename T> List<T>::List( U32 _InitialSize )
 	: m_pList( NULL )
 	, m_Size( 0 )
 	, m_Count( 0 )
+	, m_pInlineList( NULL )
+	, m_InlineSize( 0 )
 {
 	Init( _InitialSize );
 }
 
-template<typename T> void	List<T>::Init( U32 _Size )
+template<typename T> List<T>::List( T* _pInlineList, U32 _InlineSize )
+	: m_pList( _pInlineList )
+	, m_Size( _InlineSize )
+	, m_Count( 0 )
+	, m_pInlineList( _pInlineList )
+	, m_InlineSize( _InlineSize )
 {
-	delete[] m_pList;
 
-	m_Size = _Size;
-	m_pList = new T[m_Size];
-	m_Count = 0;
+}
+
+template<typename T> List<T>::List( const List& _Other )
+	: m_pList( NULL )
+	, m_Size( 0 )
+	, m_Count( 0 )
+	, m_pInlineList( NULL )
+	, m_InlineSize( 0 )
+{
+	*this = _Other;
+}
+
+template<typename T> List<T>::List( List&& _Other )
+	: m_pList( NULL )
+	, m_Size( 0 )
+	, m_Count( 0 )
+	, m_pInlineList( NULL )
+	, m_InlineSize( 0 )
+{
+	*this = static_cast<List&&>( _Other );
 }
 
 template<typename T> List<T>::~List()
 {
-	delete[] m_pList;
+	Clear();
+	if ( m_pList != m_pInlineList )
+		delete[] (U8*) m_pList;
+}
+
+template<typename T> List<T>&	List<T>::operator=( const List& _Other )
+{
+	if ( &_Other == this )
+		return *this;
+
+	Clear();
+	Append( _Other.m_pList, _Other.m_Count );
+
+	return *this;
+}
+
+template<typename T> List<T>&	List<T>::operator=( List&& _Other )
+{
+	if ( &_Other == this )
+		return *this;
+
+	Clear();
+	if ( _Other.m_pList != _Other.m_pInlineList )
+	{	// Steal the other list's allocation
+		if ( m_pList != m_pInlineList )
+			delete[] (U8*) m_pList;
+
+		m_pList = _Other.m_pList;
+		m_Size = _Other.m_Size;
+		m_Count = _Other.m_Count;
+
+		_Other.m_pList = _Other.m_pInlineList;
+		_Other.m_Size = _Other.m_InlineSize;
+		_Other.m_Count = 0;
+	}
+	else
+	{	// The other list's elements are in its inline buffer, move them one by one
+		T*	pTarget = Allocate( _Other.m_Count );
+		for ( U32 i=0; i < _Other.m_Count; i++ )
+			new( ListPlacement(), pTarget+i ) T( static_cast<T&&>( _Other.m_pList[i] ) );
+		_Other.Clear();
+	}
+
+	return *this;
+}
+
+template<typename T> void	List<T>::Init( U32 _Size )
+{
+	Clear();
+	Reallocate( _Size );
+}
+
+template<typename T> void	List<T>::Reserve( U32 _Size )
+{
+	if ( _Size > m_Size )
+		Reallocate( _Size );
+}
+
+template<typename T> void	List<T>::Shrink()
+{
+	if ( m_Count < m_Size && m_pList != m_pInlineList )
+		Reallocate( m_Count );
 }
 
 template<typename T> T&			List<T>::operator[]( U32 _Index )
@@ -41,57 +126,144 @@ template<typename T> const T&	List<T>::operator[]( U32 _Index ) const
 	return m_pList[_Index];
 }
 
-template<typename T> void		List<T>::Append( const T& _Value )
+template<typename T> inline void		List<T>::Append( const T& _Value )
 {
-	Allocate( m_Count+1 );
-	memcpy( &m_pList[m_Count-1], &_Value, sizeof(T) );
+	if ( m_Count == m_Size )
+	{	// The value may belong to the list so copy it before re-allocating
+		T	Copy( _Value );
+		new( ListPlacement(), Allocate( 1 ) ) T( static_cast<T&&>( Copy ) );
+		return;
+	}
+
+	new( ListPlacement(), Allocate( 1 ) ) T( _Value );
 }
 
-template<typename T> T&			List<T>::Append()
+template<typename T> inline void		List<T>::Append( T&& _Value )
 {
-	Allocate( m_Count+1 );
-	return m_pList[m_Count-1];
+	if ( m_Count == m_Size )
+	{
+		T	Copy( static_cast<T&&>( _Value ) );
+		new( ListPlacement(), Allocate( 1 ) ) T( static_cast<T&&>( Copy ) );
+		return;
+	}
+
+	new( ListPlacement(), Allocate( 1 ) ) T( static_cast<T&&>( _Value ) );
+}
+
+template<typename T> inline T&			List<T>::Append()
+{
+	return *new( ListPlacement(), Allocate( 1 ) ) T();
+}
+
+template<typename T> void		List<T>::Append( const T* _pValues, U32 _Count )
+{
+	ASSERT( _pValues < m_pList || _pValues >= m_pList + m_Size || _Count == 0, "Can't append a part of the list to itself!" );
+	T*	pTarget = Allocate( _Count );
+	for ( U32 i=0; i < _Count; i++ )
+		new( ListPlacement(), pTarget+i ) T( _pValues[i] );
 }
 
 template<typename T> T&			List<T>::Insert( U32 _Index )
 {
 	if ( _Index == m_Count )
-		return Append( _Index );
+		return Append();
 
 	ASSERT( _Index < m_Count, "Index out of range!" );
-	Allocate( m_Count+1 );
+	T*	pLast = Allocate( 1 );
+
+	// Shift the elements after the index
+	new( ListPlacement(), pLast ) T( static_cast<T&&>( pLast[-1] ) );
+	for ( U32 i=m_Count-2; i > _Index; i-- )
+		m_pList[i] = static_cast<T&&>( m_pList[i-1] );
 
-	memcpy( &m_pList[_Index+1], &m_pList[_Index], (m_Count-1-_Index)*sizeof(T) );
+	m_pList[_Index] = T();
 	return m_pList[_Index];
 }
 
 template<typename T> void		List<T>::RemoveAt( U32 _Index )
 {
 	ASSERT( _Index < m_Count, "Index out of range!" );
-	memcpy( &m_pList[_Index], &m_pList[_Index+1], (m_Count-_Index-1)*sizeof(T) );
+	for ( U32 i=_Index+1; i < m_Count; i++ )
+		m_pList[i-1] = static_cast<T&&>( m_pList[i] );
+
+	m_pList[--m_Count].~T();
 }
 
-template<typename T> void		List<T>::Allocate( U32 _NewCount )
+template<typename T> void		List<T>::RemoveAtUnordered( U32 _Index )
 {
-	if ( _NewCount <= m_Size )
-	{	// No need to re-allocate...
-		m_Count = _NewCount;
-		return;
-	}
+	ASSERT( _Index < m_Count, "Index out of range!" );
+	m_Count--;
+	if ( _Index != m_Count )
+		m_pList[_Index] = static_cast<T&&>( m_pList[m_Count] );
+
+	m_pList[m_Count].~T();
+}
+
+template<typename T> void		List<T>::Clear()
+{
+	for ( U32 i=0; i < m_Count; i++ )
+		m_pList[i].~T();
+	m_Count = 0;
+}
+
+template<typename T> template<typename A0> inline T&	List<T>::Emplace( A0&& _Arg0 )
+{
+	return *new( ListPlacement(), Allocate( 1 ) ) T( static_cast<A0&&>( _Arg0 ) );
+}
+
+template<typename T> template<typename A0, typename A1> inline T&	List<T>::Emplace( A0&& _Arg0, A1&& _Arg1 )
+{
+	return *new( ListPlacement(), Allocate( 1 ) ) T( static_cast<A0&&>( _Arg0 ), static_cast<A1&&>( _Arg1 ) );
+}
+
+template<typename T> template<typename A0, typename A1, typename A2> inline T&	List<T>::Emplace( A0&& _Arg0, A1&& _Arg1, A2&& _Arg2 )
+{
+	return *new( ListPlacement(), Allocate( 1 ) ) T( static_cast<A0&&>( _Arg0 ), static_cast<A1&&>( _Arg1 ), static_cast<A2&&>( _Arg2 ) );
+}
+
+template<typename T> inline T*			List<T>::Allocate( U32 _NewCount )
+{
+	U32	RequiredSize = m_Count + _NewCount;
+	if ( RequiredSize > m_Size )
+		Grow( RequiredSize );
+
+	T*	pFirstNew = m_pList + m_Count;
+	m_Count = RequiredSize;
+
+	return pFirstNew;
+}
+
+template<typename T> void		List<T>::Grow( U32 _RequiredSize )
+{	// Grow geometrically
+	U32	NewSize = m_Size != 0 ? 2*m_Size : 8;	// Arbitrary...
+	Reallocate( NewSize > _RequiredSize ? NewSize : _RequiredSize );
+}
+
+template<typename T> void		List<T>::Reallocate( U32 _NewSize )
+{
+	ASSERT( _NewSize >= m_Count, "Can't re-allocate less than the amount of elements!" );
 
 	T*	pOldList = m_pList;
-	int	OldSize = m_Size;
+	if ( _NewSize <= m_InlineSize )
+	{	// Go back to the inline buffer
+		if ( pOldList == m_pInlineList )
+			return;
 
-	if ( m_Size != 0 )
-		m_Size *= 2;
+		m_pList = m_pInlineList;
+		_NewSize = m_InlineSize;
+	}
 	else
-		m_Size = 8;	// Arbitrary...
+		m_pList = _NewSize > 0 ? (T*) new U8[_NewSize*sizeof(T)] : NULL;
+
+	// Move the elements to the new list
+	for ( U32 i=0; i < m_Count; i++ )
+	{
+		new( ListPlacement(), m_pList+i ) T( static_cast<T&&>( pOldList[i] ) );
+		pOldList[i].~T();
+	}
 
-	m_pList = new T[m_Size];
-	memset( m_pList, 0, m_Size*sizeof(T) );
-	if ( pOldList != NULL )
-		memcpy( m_pList, pOldList, OldSize*sizeof(T) );
-	m_Count = _NewCount;
+	if ( pOldList != m_pInlineList )
+		delete[] (U8*) pOldList;
 
-	delete[] pOldList;
+	m_Size = _NewSize;
 }
@@ -0,0 +1,421 @@
+#include "../GodComplex.h"
+
+const float	BVH::BOX_EXIT_SCALE = 1.0f + 2.0f * 1.8e-7f;	// 1 + 2*gamma(3) with gamma(n) = n*eps / (1 - n*eps)
+const float	BVH::REBUILD_THRESHOLD = 1.5f;
+
+// Relative costs used by the SAH
+static const float	TRAVERSAL_COST = 1.0f;
+static const float	INTERSECTION_COST = 1.0f;
+
+// Beyond that depth, nodes are split in halves without the SAH so no tree is ever deeper than MAX_DEPTH (halving 2^31 primitives takes 31 levels)
+static const int	MAX_SAH_DEPTH = BVH::MAX_DEPTH - 32;
+
+BVH::BVH()
+	: m_NodesCount( 0 )
+	, m_pNodes( NULL )
+	, m_PrimitivesCount( 0 )
+	, m_pPrimitiveIndices( NULL )
+	, m_pBuildCosts( NULL )
+	, m_BuildTime( 0.0 )
+{
+}
+BVH::~BVH()
+{
+	Exit();
+}
+
+void	BVH::Exit()
+{
+	delete[] m_pNodes;
+	m_pNodes = NULL;
+	m_NodesCount = 0;
+	delete[] m_pPrimitiveIndices;
+	m_pPrimitiveIndices = NULL;
+	m_PrimitivesCount = 0;
+	delete[] m_pBuildCosts;
+	m_pBuildCosts = NULL;
+}
+
+namespace
+{
+	float	SurfaceArea( const float3& _Min, const float3& _Max )
+	{
+		float3	Size = _Max - _Min;
+		return Size.x < 0.0f ? 0.0f : 2.0f * (Size.x * Size.y + Size.y * Size.z + Size.z * Size.x);
+	}
+
+	struct	BuildContext
+	{
+		const float3*	pBBoxMin;
+		const float3*	pBBoxMax;
+		float3*			pCentroids;
+		int*			pIndices;
+		BVH::Node*		pNodes;
+		int				NodesCount;
+	};
+
+	void	BuildNode( BuildContext& _Context, int _NodeIndex, int _Start, int _Count, int _Depth )
+	{
+		BVH::Node&	N = _Context.pNodes[_NodeIndex];
+
+		// Compute the bounds of the primitives and of their centroids
+		float3	BBoxMin = float3::MaxFlt, BBoxMax = -float3::MaxFlt;
+		float3	CentroidMin = float3::MaxFlt, CentroidMax = -float3::MaxFlt;
+		for ( int i=_Start; i < _Start+_Count; i++ )
+		{
+			int	PrimitiveIndex = _Context.pIndices[i];
+			BBoxMin = BBoxMin.Min( _Context.pBBoxMin[PrimitiveIndex] );
+			BBoxMax = BBoxMax.Max( _Context.pBBoxMax[PrimitiveIndex] );
+			CentroidMin = CentroidMin.Min( _Context.pCentroids[PrimitiveIndex] );
+			CentroidMax = CentroidMax.Max( _Context.pCentroids[PrimitiveIndex] );
+		}
+		N.BBoxMin = BBoxMin;
+		N.BBoxMax = BBoxMax;
+
+		// Find the best split among the bins of each axis
+		float	LeafCost = INTERSECTION_COST * _Count;
+		float	BestCost = FLOAT32_MAX;
+		int		BestAxis = -1;
+		int		BestBin = 0;
+		if ( _Count > 1 && _Depth < MAX_SAH_DEPTH )
+		{
+			float	InvArea = 1.0f / MAX( 1e-20f, SurfaceArea( BBoxMin, BBoxMax ) );
+			for ( int Axis=0; Axis < 3; Axis++ )
+			{
+				float	AxisMin = (&CentroidMin.x)[Axis];
+				float	AxisExtent = (&CentroidMax.x)[Axis] - AxisMin;
+				if ( AxisExtent <= 0.0f )
+					continue;
+				float	BinScale = BVH::BINS_COUNT / AxisExtent;
+
+				int		pBinCounts[BVH::BINS_COUNT];
+				float3	pBinMin[BVH::BINS_COUNT], pBinMax[BVH::BINS_COUNT];
+				for ( int BinIndex=0; BinIndex < BVH::BINS_COUNT; BinIndex++ )
+				{
+					pBinCounts[BinIndex] = 0;
+					pBinMin[BinIndex] = float3::MaxFlt;
+					pBinMax[BinIndex] = -float3::MaxFlt;
+				}
+				for ( int i=_Start; i < _Start+_Count; i++ )
+				{
+					int	PrimitiveIndex = _Context.pIndices[i];
+					int	BinIndex = MIN( BVH::BINS_COUNT-1, int( BinScale * ((&_Context.pCentroids[PrimitiveIndex].x)[Axis] - AxisMin) ) );
+					pBinCounts[BinIndex]++;
+					pBinMin[BinIndex] = pBinMin[BinIndex].Min( _Context.pBBoxMin[PrimitiveIndex] );
+					pBinMax[BinIndex] = pBinMax[BinIndex].Max( _Context.pBBoxMax[PrimitiveIndex] );
+				}
+
+				// Sweep from the right to accumulate the right side's areas, then from the left to evaluate each split
+				float	pRightAreas[BVH::BINS_COUNT];
+				int		pRightCounts[BVH::BINS_COUNT];
+				float3	RightMin = float3::MaxFlt, RightMax = -float3::MaxFlt;
+				int		RightCount = 0;
+				for ( int BinIndex=BVH::BINS_COUNT-1; BinIndex > 0; BinIndex-- )
+				{
+					RightMin = RightMin.Min( pBinMin[BinIndex] );
+					RightMax = RightMax.Max( pBinMax[BinIndex] );
+					RightCount += pBinCounts[BinIndex];
+					pRightAreas[BinIndex] = SurfaceArea( RightMin, RightMax );
+					pRightCounts[BinIndex] = RightCount;
+				}
+
+				float3	LeftMin = float3::MaxFlt, LeftMax = -float3::MaxFlt;
+				int		LeftCount = 0;
+				for ( int BinIndex=1; BinIndex < BVH::BINS_COUNT; BinIndex++ )
+				{
+					LeftMin = LeftMin.Min( pBinMin[BinIndex-1] );
+					LeftMax = LeftMax.Max( pBinMax[BinIndex-1] );
+					LeftCount += pBinCounts[BinIndex-1];
+					if ( LeftCount == 0 || pRightCounts[BinIndex] == 0 )
+						continue;
+
+					float	Cost = TRAVERSAL_COST + INTERSECTION_COST * InvArea * (LeftCount * SurfaceArea( LeftMin, LeftMax ) + pRightCounts[BinIndex] * pRightAreas[BinIndex]);
+					if ( Cost < BestCost )
+					{
+						BestCost = Cost;
+						BestAxis = Axis;
+						BestBin = BinIndex;
+					}
+				}
+			}
+		}
+
+		// Make a leaf if splitting isn't worth it
+		if ( _Count == 1 || (_Count <= BVH::MAX_LEAF_PRIMITIVES && BestCost >= LeafCost) )
+		{
+			N.Offset = _Start;
+			N.PrimitivesCount = U16(_Count);
+			N.Axis = 0;
+			return;
+		}
+
+		// Partition primitives
+		int	Middle = _Start;
+		if ( BestAxis != -1 )
+		{
+			float	AxisMin = (&CentroidMin.x)[BestAxis];
+			float	BinScale = BVH::BINS_COUNT / ((&CentroidMax.x)[BestAxis] - AxisMin);
+			int		End = _Start + _Count - 1;
+			while ( Middle <= End )
+			{
+				int	PrimitiveIndex = _Context.pIndices[Middle];
+				int	BinIndex = MIN( BVH::BINS_COUNT-1, int( BinScale * ((&_Context.pCentroids[PrimitiveIndex].x)[BestAxis] - AxisMin) ) );
+				if ( BinIndex < BestBin )
+					Middle++;
+				else
+				{
+					_Context.pIndices[Middle] = _Context.pIndices[End];
+					_Context.pIndices[End--] = PrimitiveIndex;
+				}
+			}
+		}
+		if ( Middle == _Start || Middle == _Start + _Count )
+		{	// All centroids are at the same position (or the tree is getting too deep), split in the middle
+			BestAxis = 0;
+			Middle = _Start + _Count / 2;
+		}
+
+		// Build children
+		N.PrimitivesCount = 0;
+		N.Axis = U16(BestAxis);
+
+		int	LeftIndex = _Context.NodesCount++;
+		ASSERT( LeftIndex == _NodeIndex+1, "Left child should follow its parent!" );
+		BuildNode( _Context, LeftIndex, _Start, Middle - _Start, _Depth+1 );
+
+		int	RightIndex = _Context.NodesCount++;
+		_Context.pNodes[_NodeIndex].Offset = RightIndex;
+		BuildNode( _Context, RightIndex, Middle, _Start + _Count - Middle, _Depth+1 );
+	}
+
+	// Computes the SAH cost of each subtree, relative to the area of its root
+	// Children always come after their parent so a reverse loop sees them first
+	void	ComputeSubtreeCosts( const BVH::Node* _pNodes, int _NodesCount, float* _pCosts )
+	{
+		for ( int NodeIndex=_NodesCount-1; NodeIndex >= 0; NodeIndex-- )
+		{	// Accumulate costs weighted by the nodes' areas
+			const BVH::Node&	N = _pNodes[NodeIndex];
+			float	Area = SurfaceArea( N.BBoxMin, N.BBoxMax );
+			_pCosts[NodeIndex] = N.IsLeaf() ? Area * INTERSECTION_COST * N.PrimitivesCount : Area * TRAVERSAL_COST + _pCosts[NodeIndex+1] + _pCosts[N.Offset];
+		}
+		for ( int NodeIndex=0; NodeIndex < _NodesCount; NodeIndex++ )
+		{
+			const BVH::Node&	N = _pNodes[NodeIndex];
+			_pCosts[NodeIndex] = N.IsLeaf() ? INTERSECTION_COST * N.PrimitivesCount : _pCosts[NodeIndex] / MAX( 1e-20f, SurfaceArea( N.BBoxMin, N.BBoxMax ) );
+		}
+	}
+}
+
+void	BVH::Build( int _PrimitivesCount, const float3* _pBBoxMin, const float3* _pBBoxMax )
+{
+	Exit();
+	if ( _PrimitivesCount == 0 )
+		return;
+
+#ifdef _DEBUG
+	TimeProfile	Profile( m_BuildTime );
+#endif
+
+	m_PrimitivesCount = _PrimitivesCount;
+	m_pPrimitiveIndices = new int[_PrimitivesCount];
+	for ( int PrimitiveIndex=0; PrimitiveIndex < _PrimitivesCount; PrimitiveIndex++ )
+		m_pPrimitiveIndices[PrimitiveIndex] = PrimitiveIndex;
+
+	BuildContext	Context;
+	Context.pBBoxMin = _pBBoxMin;
+	Context.pBBoxMax = _pBBoxMax;
+	Context.pCentroids = new float3[_PrimitivesCount];
+	for ( int PrimitiveIndex=0; PrimitiveIndex < _PrimitivesCount; PrimitiveIndex++ )
+		Context.pCentroids[PrimitiveIndex] = 0.5f * (_pBBoxMin[PrimitiveIndex] + _pBBoxMax[PrimitiveIndex]);
+	Context.pIndices = m_pPrimitiveIndices;
+	Context.pNodes = new Node[2*_PrimitivesCount-1];
+	Context.NodesCount = 1;
+
+	BuildNode( Context, 0, 0, _PrimitivesCount, 0 );
+
+	// Shrink the nodes array to its actual size
+	m_NodesCount = Context.NodesCount;
+	m_pNodes = new Node[m_NodesCount];
+	memcpy( m_pNodes, Context.pNodes, m_NodesCount*sizeof(Node) );
+
+	delete[] Context.pNodes;
+	delete[] Context.pCentroids;
+
+	m_pBuildCosts = new float[m_NodesCount];
+	ComputeSubtreeCosts( m_pNodes, m_NodesCount, m_pBuildCosts );
+}
+
+void	BVH::Refit( const float3* _pBBoxMin, const float3* _pBBoxMax )
+{
+	for ( int NodeIndex=m_NodesCount-1; NodeIndex >= 0; NodeIndex-- )
+	{
+		Node&	N = m_pNodes[NodeIndex];
+		if ( N.IsLeaf() )
+		{
+			N.BBoxMin = float3::MaxFlt;
+			N.BBoxMax = -float3::MaxFlt;
+			for ( U32 i=N.Offset; i < N.Offset + N.PrimitivesCount; i++ )
+			{
+				int	PrimitiveIndex = m_pPrimitiveIndices[i];
+				N.BBoxMin = N.BBoxMin.Min( _pBBoxMin[PrimitiveIndex] );
+				N.BBoxMax = N.BBoxMax.Max( _pBBoxMax[PrimitiveIndex] );
+			}
+		}
+		else
+		{
+			const Node&	Left = m_pNodes[NodeIndex+1];
+			const Node&	Right = m_pNodes[N.Offset];
+			N.BBoxMin = Left.BBoxMin.Min( Right.BBoxMin );
+			N.BBoxMax = Left.BBoxMax.Max( Right.BBoxMax );
+		}
+	}
+}
+
+int		BVH::Update( const float3* _pBBoxMin, const float3* _pBBoxMax, int* _pRebuiltPrimitivesCount )
+{
+	if ( _pRebuiltPrimitivesCount != NULL )
+		*_pRebuiltPrimitivesCount = 0;
+	if ( m_NodesCount == 0 )
+		return 0;
+
+	Refit( _pBBoxMin, _pBBoxMax );
+
+	// Find the topmost subtrees that degraded too much
+	// Nodes are visited depth-first, left child first, which is their storage order so the subtrees are found in ascending order
+	float*	pCosts = new float[m_NodesCount];
+	ComputeSubtreeCosts( m_pNodes, m_NodesCount, pCosts );
+
+	int*	pDegradedNodes = new int[2*m_NodesCount];	// Root index + depth of each degraded subtree
+	int		DegradedNodesCount = 0;
+	int		pStack[2*MAX_DEPTH];
+	int		StackSize = 0;
+	int		NodeIndex = 0;
+	int		Depth = 0;
+	while ( true )
+	{
+		const Node&	N = m_pNodes[NodeIndex];
+		if ( !N.IsLeaf() )
+		{
+			if ( pCosts[NodeIndex] <= REBUILD_THRESHOLD * m_pBuildCosts[NodeIndex] )
+			{	// Still good, check the children
+				ASSERT( StackSize < 2*MAX_DEPTH, "Stack overflow!" );
+				pStack[StackSize++] = N.Offset;
+				pStack[StackSize++] = ++Depth;
+				NodeIndex++;
+				continue;
+			}
+			pDegradedNodes[2*DegradedNodesCount+0] = NodeIndex;
+			pDegradedNodes[2*DegradedNodesCount+1] = Depth;
+			DegradedNodesCount++;
+		}
+
+		if ( StackSize == 0 )
+			break;
+		Depth = pStack[--StackSize];
+		NodeIndex = pStack[--StackSize];
+	}
+	delete[] pCosts;
+
+	if ( DegradedNodesCount == 0 )
+	{
+		delete[] pDegradedNodes;
+		return 0;
+	}
+
+	BuildContext	Context;
+	Context.pBBoxMin = _pBBoxMin;
+	Context.pBBoxMax = _pBBoxMax;
+	Context.pCentroids = new float3[m_PrimitivesCount];
+	Context.pIndices = m_pPrimitiveIndices;
+
+	// Rebuild the subtrees in descending order as rebuilding one shifts the nodes that follow it
+	for ( int i=DegradedNodesCount-1; i >= 0; i-- )
+	{
+		int	RootIndex = pDegradedNodes[2*i+0];
+		int	RootDepth = pDegradedNodes[2*i+1];
+
+		// The subtree's nodes range from its root to its rightmost leaf, and its primitives from its leftmost leaf to its rightmost leaf
+		int	FirstLeafIndex = RootIndex;
+		while ( !m_pNodes[FirstLeafIndex].IsLeaf() )
+			FirstLeafIndex++;
+		int	LastLeafIndex = RootIndex;
+		while ( !m_pNodes[LastLeafIndex].IsLeaf() )
+			LastLeafIndex = m_pNodes[LastLeafIndex].Offset;
+
+		int	OldNodesCount = LastLeafIndex + 1 - RootIndex;
+		int	Start = m_pNodes[FirstLeafIndex].Offset;
+		int	Count = m_pNodes[LastLeafIndex].Offset + m_pNodes[LastLeafIndex].PrimitivesCount - Start;
+		if ( _pRebuiltPrimitivesCount != NULL )
+			*_pRebuiltPrimitivesCount += Count;
+
+		// Build the new subtree
+		for ( int j=Start; j < Start+Count; j++ )
+		{
+			int	PrimitiveIndex = m_pPrimitiveIndices[j];
+			Context.pCentroids[PrimitiveIndex] = 0.5f * (_pBBoxMin[PrimitiveIndex] + _pBBoxMax[PrimitiveIndex]);
+		}
+		Context.pNodes = new Node[2*Count-1];
+		Context.NodesCount = 1;
+
+		BuildNode( Context, 0, Start, Count, RootDepth );
+
+		float*	pSubtreeCosts = new float[Context.NodesCount];
+		ComputeSubtreeCosts( Context.pNodes, Context.NodesCount, pSubtreeCosts );
+
+		// Splice it in place of the old one
+		int		Delta = Context.NodesCount - OldNodesCount;
+		Node*	pNodes = new Node[m_NodesCount + Delta];
+		float*	pBuildCosts = new float[m_NodesCount + Delta];
+		for ( int j=0; j < RootIndex; j++ )
+		{
+			pNodes[j] = m_pNodes[j];
+			if ( !pNodes[j].IsLeaf() && int(pNodes[j].Offset) > LastLeafIndex )
+				pNodes[j].Offset += Delta;
+			pBuildCosts[j] = m_pBuildCosts[j];
+		}
+		for ( int j=0; j < Context.NodesCount; j++ )
+		{
+			pNodes[RootIndex+j] = Context.pNodes[j];
+			if ( !pNodes[RootIndex+j].IsLeaf() )
+				pNodes[RootIndex+j].Offset += RootIndex;
+			pBuildCosts[RootIndex+j] = pSubtreeCosts[j];
+		}
+		for ( int j=LastLeafIndex+1; j < m_NodesCount; j++ )
+		{
+			pNodes[j+Delta] = m_pNodes[j];
+			if ( !pNodes[j+Delta].IsLeaf() )
+				pNodes[j+Delta].Offset += Delta;
+			pBuildCosts[j+Delta] = m_pBuildCosts[j];
+		}
+
+		delete[] m_pNodes;
+		delete[] m_pBuildCosts;
+		m_pNodes = pNodes;
+		m_pBuildCosts = pBuildCosts;
+		m_NodesCount += Delta;
+
+		delete[] pSubtreeCosts;
+		delete[] Context.pNodes;
+	}
+
+	delete[] Context.pCentroids;
+	delete[] pDegradedNodes;
+
+	return DegradedNodesCount;
+}
+
+float	BVH::ComputeSAHCost() const
+{
+	if ( m_NodesCount == 0 )
+		return 0.0f;
+
+	float	Cost = 0.0f;
+	for ( int NodeIndex=0; NodeIndex < m_NodesCount; NodeIndex++ )
+	{
+		const Node&	N = m_pNodes[NodeIndex];
+		float	Area = SurfaceArea( N.BBoxMin, N.BBoxMax );
+		Cost += Area * (N.IsLeaf() ? INTERSECTION_COST * N.PrimitivesCount : TRAVERSAL_COST);
+	}
+
+	return Cost / MAX( 1e-20f, SurfaceArea( m_pNodes[0].BBoxMin, m_pNodes[0].BBoxMax ) );
+}
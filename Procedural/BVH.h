@@ -0,0 +1,95 @@
+//////////////////////////////////////////////////////////////////////////
+// Bounding Volume Hierarchy built with the binned Surface Area Heuristic (Wald "On fast Construction of SAH-based Bounding Volume Hierarchies")
+// The hierarchy only knows about the bounding boxes of the primitives, intersecting the primitives themselves is up to the user
+//	(e.g. the RayTracer)
+// Moving primitives are handled by refitting the boxes, and subtrees whose quality degraded too much are rebuilt in place
+//
+#pragma once
+
+class	BVH
+{
+public:		// CONSTANTS
+
+	static const int	MAX_LEAF_PRIMITIVES = 16;	// Nodes with more primitives than that are always split, whatever the SAH says
+	static const int	BINS_COUNT = 16;
+	static const int	MAX_DEPTH = 64;				// Size of the traversal stacks (Build() and Update() never make deeper trees)
+	static const float	BOX_EXIT_SCALE;				// Scale applied to the exit distance of the box test to make it conservative despite rounding errors
+	static const float	REBUILD_THRESHOLD;			// Update() rebuilds the subtrees whose SAH cost grew by more than that factor since they were built
+
+public:		// NESTED TYPES
+
+	// Flattened node (32 bytes)
+	// Nodes are stored depth-first so the left child of an interior node immediately follows its parent
+	struct	Node
+	{
+		float3	BBoxMin;
+		U32		Offset;				// Leaf: index of the first primitive in m_pPrimitiveIndices. Interior: index of the right child
+		float3	BBoxMax;
+		U16		PrimitivesCount;	// 0 for interior nodes
+		U16		Axis;				// Split axis of interior nodes, used to visit the nearest child first
+
+		bool	IsLeaf() const		{ return PrimitivesCount != 0; }
+	};
+
+public:		// FIELDS
+
+	int			m_NodesCount;
+	Node*		m_pNodes;
+
+	int			m_PrimitivesCount;
+	int*		m_pPrimitiveIndices;	// Indices of the primitives referenced by the leaves
+
+	float*		m_pBuildCosts;			// SAH cost of each subtree (relative to its root's area) when it was built, to monitor the degradation caused by refits
+
+	double		m_BuildTime;			// Duration of the last build in milliseconds (only measured in DEBUG)
+
+public:		// METHODS
+
+	BVH();
+	~BVH();
+
+	// Builds the hierarchy from the bounding boxes of the primitives
+	void		Build( int _PrimitivesCount, const float3* _pBBoxMin, const float3* _pBBoxMax );
+	void		Exit();
+
+	// Computes the SAH cost of the hierarchy (i.e. the expected cost of tracing a random ray, relative to the cost of intersecting a primitive)
+	float		ComputeSAHCost() const;
+
+	// Updates the bounding boxes of the nodes bottom-up from the new bounding boxes of the primitives (given in the same order as for Build())
+	void		Refit( const float3* _pBBoxMin, const float3* _pBBoxMax );
+
+	// Refits the hierarchy then rebuilds the subtrees whose SAH cost degraded by more than REBUILD_THRESHOLD
+	// WARNING: Rebuilt subtrees reorder m_pPrimitiveIndices within their range of leaves so primitives stored in leaf order must be gathered again
+	//	_pRebuiltPrimitivesCount, optional, receives the amount of primitives in the rebuilt subtrees
+	// Returns the amount of rebuilt subtrees
+	int			Update( const float3* _pBBoxMin, const float3* _pBBoxMax, int* _pRebuiltPrimitivesCount=NULL );
+
+	// Intersects a ray with a bounding box
+	// The exit distance is slightly enlarged (Ize "Robust BVH Ray Traversal") so we never miss a primitive touching the box's faces (e.g. flat triangles)
+	//	_InvDirection, the inverse of the ray direction
+	//	_MaxDistance, the distance beyond which we're not interested in a hit
+	static bool	IntersectBox( const float3& _BBoxMin, const float3& _BBoxMax, const float3& _Position, const float3& _InvDirection, float _MaxDistance )
+	{
+		float	t0x = (_BBoxMin.x - _Position.x) * _InvDirection.x;
+		float	t1x = (_BBoxMax.x - _Position.x) * _InvDirection.x;
+		float	t0y = (_BBoxMin.y - _Position.y) * _InvDirection.y;
+		float	t1y = (_BBoxMax.y - _Position.y) * _InvDirection.y;
+		float	t0z = (_BBoxMin.z - _Position.z) * _InvDirection.z;
+		float	t1z = (_BBoxMax.z - _Position.z) * _InvDirection.z;
+		float	tMin = MAX( MAX( MIN( t0x, t1x ), MIN( t0y, t1y ) ), MAX( MIN( t0z, t1z ), 0.0f ) );
+		float	tMax = MIN( MIN( MAX( t0x, t1x ), MAX( t0y, t1y ) ), MIN( MAX( t0z, t1z ), _MaxDistance ) );
+		return tMin <= BOX_EXIT_SCALE * tMax;
+	}
+	static bool	IntersectBox( const Node& _Node, const float3& _Position, const float3& _InvDirection, float _MaxDistance )
+	{
+		return IntersectBox( _Node.BBoxMin, _Node.BBoxMax, _Position, _InvDirection, _MaxDistance );
+	}
+
+	// Computes the inverse of a ray direction, avoiding divisions by 0
+	static float3	ComputeInvDirection( const float3& _Direction )
+	{
+		return float3(	_Direction.x != 0.0f ? 1.0f / _Direction.x : FLOAT32_MAX,
+						_Direction.y != 0.0f ? 1.0f / _Direction.y : FLOAT32_MAX,
+						_Direction.z != 0.0f ? 1.0f / _Direction.z : FLOAT32_MAX );
+	}
+};
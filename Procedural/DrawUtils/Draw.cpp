@@ -7,6 +7,21 @@ DrawUtils::DrawUtils()
 	m_ContextLINE.pOwner = this;
 	m_ContextELLIPSE.pOwner = this;
 	m_ContextSCRATCH.pOwner = this;
+	m_ContextSOLIDRECT.pOwner = this;
+	m_ContextSOLIDLINE.pOwner = this;
+	m_ContextSPLOTCH.pOwner = this;
+
+	m_ContextRECT.bAntiAliasY = true;
+	m_ContextLINE.bAntiAliasY = true;
+	m_ContextELLIPSE.bAntiAliasY = true;
+	m_ContextSCRATCH.bAntiAliasY = false;	// Scratches are made of abutting quads that must not produce seams
+	m_ContextSOLIDRECT.bAntiAliasY = true;
+	m_ContextSOLIDLINE.bAntiAliasY = true;
+	m_ContextSPLOTCH.bAntiAliasY = true;
+
+	m_bBatching = false;
+	m_TileSize = 64;
+	m_bClip = false;
 
 	m_X = float2::UnitX;
 	m_Y = float2::UnitY;
@@ -59,11 +74,20 @@ void	DrawUtils::DrawRectangle( float x, float y, float w, float h, float border,
 
 	DrawQuad( pVertices, m_ContextRECT );
 }
-void	DrawUtils::DrawContextRECT::DrawPixel()
+void	DrawUtils::DrawRectangle( float x, float y, float w, float h, const Pixel& _Color ) const
 {
-	int	WrappedX = X % pOwner->m_Width;
-		WrappedX = WrappedX < 0 ? WrappedX + pOwner->m_Width : WrappedX;
+	m_ContextSOLIDRECT.Color = _Color;
 
+	float4	pVertices[4];
+	pVertices[0].Set( x, y, 0, 0 );
+	pVertices[1].Set( x, y + h, 0, 1 );
+	pVertices[2].Set( x + w, y + h, 1, 1 );
+	pVertices[3].Set( x + w, y, 1, 0 );
+
+	DrawQuad( pVertices, m_ContextSOLIDRECT );
+}
+void	DrawUtils::DrawContextRECT::DrawPixel( Pixel& _Pixel )
+{
 	pOwner->m_Infos.x = X;
 	pOwner->m_Infos.UV.Set( P.z, P.w );
 	pOwner->m_Infos.Coverage = Coverage;
@@ -99,7 +123,7 @@ void	DrawUtils::DrawContextRECT::DrawPixel()
 	pOwner->m_Infos.Distance = D;
 
 	// Invoke pixel drawing
-	pFiller( pOwner->m_Infos, pScanline[WrappedX] );
+	pFiller( pOwner->m_Infos, _Pixel );
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -110,32 +134,46 @@ void	DrawUtils::DrawLine( float x0, float y0, float x1, float y1, float thicknes
 	// Setup line-specific parameters
 	m_ContextLINE.pFiller = _Filler;
 
-	// Build quad vertices
+	float4	pVertices[4];
+	if ( !BuildLineQuad( x0, y0, x1, y1, thickness, pVertices, m_ContextLINE.dU ) )
+		return;
+
+	DrawQuad( pVertices, m_ContextLINE );
+}
+void	DrawUtils::DrawLine( float x0, float y0, float x1, float y1, float thickness, const Pixel& _Color ) const
+{
+	m_ContextSOLIDLINE.Color = _Color;
+	m_ContextSOLIDLINE.Thickness = thickness;
+
+	float4	pVertices[4];
+	if ( !BuildLineQuad( x0, y0, x1, y1, thickness, pVertices, m_ContextSOLIDLINE.dU ) )
+		return;
+
+	DrawQuad( pVertices, m_ContextSOLIDLINE );
+}
+bool	DrawUtils::BuildLineQuad( float x0, float y0, float x1, float y1, float thickness, float4 _pVertices[], float& _dU ) const
+{
 	float2	P0( x0, y0 );
 	float2	P1( x1, y1 );
 	float2	U = P1 - P0;
 	float		L = U.Length();
 	if ( L == 0.0f )
-		return;
+		return false;
 
-	m_ContextLINE.dU = thickness / (2.0f * thickness + L);	// This is the U offset to reach the start/end points of the line
+	_dU = thickness / (2.0f * thickness + L);	// This is the U offset to reach the start/end points of the line
 
 	U = U / L;
 	float2	V( -U.y, U.x );
 
-	float4	pVertices[4];
-	pVertices[0] = float4( P0 + thickness * (V - U), 0, 1 );
-	pVertices[1] = float4( P1 + thickness * (V + U), 1, 1 );
-	pVertices[2] = float4( P1 + thickness * (U - V), 1, 0 );
-	pVertices[3] = float4( P0 - thickness * (U + V), 0, 0 );
+	_pVertices[0] = float4( P0 + thickness * (V - U), 0, 1 );
+	_pVertices[1] = float4( P1 + thickness * (V + U), 1, 1 );
+	_pVertices[2] = float4( P1 + thickness * (U - V), 1, 0 );
+	_pVertices[3] = float4( P0 - thickness * (U + V), 0, 0 );
 
-	DrawQuad( pVertices, m_ContextLINE );
+	return true;
 }
-void	DrawUtils::DrawContextLINE::DrawPixel()
+void	DrawUtils::DrawContextLINE::DrawPixel( Pixel& _Pixel )
 {
-	int	WrappedX = X % pOwner->m_Width;
-		WrappedX = WrappedX < 0 ? WrappedX + pOwner->m_Width : WrappedX;
-
 	pOwner->m_Infos.x = X;
 	pOwner->m_Infos.UV.Set( P.z, P.w );
 	pOwner->m_Infos.Coverage = Coverage;
@@ -147,7 +185,19 @@ void	DrawUtils::DrawContextLINE::DrawPixel()
 	pOwner->m_Infos.Distance = sqrtf( Du*Du + Dv*Dv );
 
 	// Invoke pixel drawing
-	pFiller( pOwner->m_Infos, pScanline[WrappedX] );
+	pFiller( pOwner->m_Infos, _Pixel );
+}
+void	DrawUtils::DrawContextSOLIDLINE::DrawPixel( Pixel& _Pixel )
+{
+	float	U = CLAMP( P.z, dU, 1.0f - dU );
+	float	Du = (P.z - U) / dU;
+	float	Dv = 2.0f * (P.w - 0.5f);
+	float	D = sqrtf( Du*Du + Dv*Dv );
+
+	// Distance to the border in pixels gives the anti-aliased coverage of the round-capped line
+	float	Alpha = SATURATE( (1.0f - D) * Thickness ) * Color.RGBA.w;
+	if ( Alpha > 0.0f )
+		_Pixel.Blend( Color, Alpha );
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -171,11 +221,8 @@ void	DrawUtils::DrawEllipse( float x, float y, float w, float h, float border, f
 
 	DrawQuad( pVertices, m_ContextELLIPSE );
 }
-void	DrawUtils::DrawContextELLIPSE::DrawPixel()
+void	DrawUtils::DrawContextELLIPSE::DrawPixel( Pixel& _Pixel )
 {
-	int	WrappedX = X % pOwner->m_Width;
-		WrappedX = WrappedX < 0 ? WrappedX + pOwner->m_Width : WrappedX;
-
 	pOwner->m_Infos.x = X;
 	pOwner->m_Infos.UV.Set( P.z, P.w );
 	pOwner->m_Infos.Coverage = Coverage;
@@ -191,7 +238,7 @@ void	DrawUtils::DrawContextELLIPSE::DrawPixel()
 	pOwner->m_Infos.Distance = D * InvDu;
 
 	// Invoke pixel drawing
-	pFiller( pOwner->m_Infos, pScanline[WrappedX] );
+	pFiller( pOwner->m_Infos, _Pixel );
 }
 
 
@@ -251,11 +298,8 @@ void	DrawUtils::DrawScratch( const float2& _Position, const float2& _Direction,
 	}
 }
 
-void	DrawUtils::DrawContextSCRATCH::DrawPixel()
+void	DrawUtils::DrawContextSCRATCH::DrawPixel( Pixel& _Pixel )
 {
-	int	WrappedX = X % pOwner->m_Width;
-		WrappedX = WrappedX < 0 ? WrappedX + pOwner->m_Width : WrappedX;
-
 	pOwner->m_Infos.x = X;
 	pOwner->m_Infos.UV.Set( P.z, P.w );
 	pOwner->m_Infos.Coverage = Coverage;
@@ -264,11 +308,211 @@ void	DrawUtils::DrawContextSCRATCH::DrawPixel()
 	pOwner->m_Infos.Distance = 2.0f * (pOwner->m_Infos.UV.y - 0.5f);
 
 	// Invoke pixel drawing
-	pFiller( pOwner->m_Infos, pScanline[WrappedX], Distance + P.z * StepDistance, U + P.z * StepU );
+	pFiller( pOwner->m_Infos, _Pixel, Distance + P.z * StepDistance, U + P.z * StepU );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Splotches
+void	DrawUtils::DrawSplotch( const float2& _Position, const float2& _Size, float _Angle, const Noise& _Noise, float _Perturbation ) const
+{
+	m_ContextSPLOTCH.pNoise = &_Noise;
+	m_ContextSPLOTCH.Perturbation = _Perturbation;
+
+	// Build rotated quad vertices
+	_Angle = DEG2RAD( _Angle );
+	float	c = cosf(_Angle), s = sinf(_Angle);
+	float2	X = (0.5f * _Size.x) * float2(  c, s );
+	float2	Y = (0.5f * _Size.y) * float2( -s, c );
+
+	float4	pVertices[4];
+	pVertices[0] = float4( _Position - X - Y, 0, 0 );
+	pVertices[1] = float4( _Position - X + Y, 0, 1 );
+	pVertices[2] = float4( _Position + X + Y, 1, 1 );
+	pVertices[3] = float4( _Position + X - Y, 1, 0 );
+
+	DrawQuad( pVertices, m_ContextSPLOTCH );
+}
+
+void	DrawUtils::DrawContextSPLOTCH::DrawPixel( Pixel& _Pixel )
+{
+	// Perturb the distance to the center with some noise
+	float	Scale = 1.0f + Perturbation * pNoise->Perlin( float2( 0.005f * X / pOwner->m_Width, 0.005f * Y / pOwner->m_Height ) );
+	float2	UV( Scale * (P.z - 0.5f), Scale * (P.w - 0.5f) );
+	float	Distance2Center = UV.Length();
+
+	float	C = SATURATE( 1.2f * (1.0f - 2.0f * Distance2Center) );
+	float	A = C * C * Coverage;
+	if ( A > 0.0f )
+		_Pixel.Blend( Pixel( float4( C, C, C, A ) ), A );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+// Batched drawing
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//
+void	DrawUtils::BeginBatch( int _TileSize )
+{
+	ASSERT( !m_bBatching, "A batch is already started!" );
+	ASSERT( _TileSize > 0, "Invalid tile size!" );
+
+	m_bBatching = true;
+	m_TileSize = _TileSize;
+	m_BatchPrimitives.Clear();
+}
+
+struct	__DrawTilesStruct
+{
+	DrawUtils*	pOwner;
+	int			TilesCountX;
+	const int*	pTileStart;			// Index of the first primitive index of each tile (there are TilesCount+1 entries)
+	const int*	pPrimitiveIndices;	// Indices of the primitives overlapping each tile, in submission order
+};
+
+void	DrawUtils::EndBatch()
+{
+	ASSERT( m_bBatching, "BeginBatch() was not called!" );
+	m_bBatching = false;
+
+	int	PrimitivesCount = m_BatchPrimitives.GetCount();
+	if ( PrimitivesCount == 0 )
+		return;
+
+	int		TilesCountX = (m_Width + m_TileSize-1) / m_TileSize;
+	int		TilesCountY = (m_Height + m_TileSize-1) / m_TileSize;
+	int		TilesCount = TilesCountX * TilesCountY;
+	int*	pTilesX = new int[TilesCountX];
+	int*	pTilesY = new int[TilesCountY];
+
+	// Count the primitives overlapping each tile
+	int*	pTileStart = new int[TilesCount+1];
+	memset( pTileStart, 0, (TilesCount+1)*sizeof(int) );
+	for ( int PrimitiveIndex=0; PrimitiveIndex < PrimitivesCount; PrimitiveIndex++ )
+	{
+		const BatchPrimitive&	Primitive = m_BatchPrimitives[PrimitiveIndex];
+		int	CountX = BuildTilesList( Primitive.X0, Primitive.X1, m_Width, m_TileSize, TilesCountX, pTilesX );
+		int	CountY = BuildTilesList( Primitive.Y0, Primitive.Y1, m_Height, m_TileSize, TilesCountY, pTilesY );
+		for ( int Y=0; Y < CountY; Y++ )
+			for ( int X=0; X < CountX; X++ )
+				pTileStart[1+pTilesY[Y]*TilesCountX+pTilesX[X]]++;
+	}
+	for ( int TileIndex=0; TileIndex < TilesCount; TileIndex++ )
+		pTileStart[TileIndex+1] += pTileStart[TileIndex];
+
+	// Bin the primitive indices, keeping submission order within each tile
+	int*	pPrimitiveIndices = new int[pTileStart[TilesCount]];
+	int*	pTileEnd = new int[TilesCount];
+	memcpy( pTileEnd, pTileStart, TilesCount*sizeof(int) );
+	for ( int PrimitiveIndex=0; PrimitiveIndex < PrimitivesCount; PrimitiveIndex++ )
+	{
+		const BatchPrimitive&	Primitive = m_BatchPrimitives[PrimitiveIndex];
+		int	CountX = BuildTilesList( Primitive.X0, Primitive.X1, m_Width, m_TileSize, TilesCountX, pTilesX );
+		int	CountY = BuildTilesList( Primitive.Y0, Primitive.Y1, m_Height, m_TileSize, TilesCountY, pTilesY );
+		for ( int Y=0; Y < CountY; Y++ )
+			for ( int X=0; X < CountX; X++ )
+				pPrimitiveIndices[pTileEnd[pTilesY[Y]*TilesCountX+pTilesX[X]]++] = PrimitiveIndex;
+	}
+
+	// Draw the tiles in parallel
+	__DrawTilesStruct	Params;
+	Params.pOwner = this;
+	Params.TilesCountX = TilesCountX;
+	Params.pTileStart = pTileStart;
+	Params.pPrimitiveIndices = pPrimitiveIndices;
+
+	TextureBuilder::ParallelRows( TilesCount, RasterizeTiles, &Params, 1 );
+
+	delete[] pTileEnd;
+	delete[] pPrimitiveIndices;
+	delete[] pTileStart;
+	delete[] pTilesY;
+	delete[] pTilesX;
+
+	m_BatchPrimitives.Clear();
+}
+
+// Draws a range of tiles, each with a private drawing object clipped to the tile
+void	DrawUtils::RasterizeTiles( int _TileIndex0, int _TileIndex1, void* _pData )
+{
+	__DrawTilesStruct&	Params = *((__DrawTilesStruct*) _pData);
+	const DrawUtils&	Owner = *Params.pOwner;
+
+	DrawUtils	Tile;
+	Tile.SetupSurface( Owner.m_Width, Owner.m_Height, Owner.m_pSurface );
+	Tile.m_bClip = true;
+
+	for ( int TileIndex=_TileIndex0; TileIndex < _TileIndex1; TileIndex++ )
+	{
+		int	TileX = TileIndex % Params.TilesCountX;
+		int	TileY = TileIndex / Params.TilesCountX;
+		Tile.m_ClipX0 = TileX * Owner.m_TileSize;
+		Tile.m_ClipY0 = TileY * Owner.m_TileSize;
+		Tile.m_ClipX1 = MIN( Tile.m_ClipX0 + Owner.m_TileSize, Owner.m_Width );
+		Tile.m_ClipY1 = MIN( Tile.m_ClipY0 + Owner.m_TileSize, Owner.m_Height );
+
+		for ( int i=Params.pTileStart[TileIndex]; i < Params.pTileStart[TileIndex+1]; i++ )
+		{
+			const BatchPrimitive&	Primitive = Owner.m_BatchPrimitives[Params.pPrimitiveIndices[i]];
+			Primitive.pRasterize( Tile, Primitive );
+		}
+	}
+}
+
+// Builds the list of tiles overlapped by the [_Min,_Max] pixel range along one axis, accounting for wrapping
+// Returns the amount of tiles, each tile being listed only once
+int		DrawUtils::BuildTilesList( int _Min, int _Max, int _Size, int _TileSize, int _TilesCount, int* _pTiles )
+{
+	int	Count = 0;
+	if ( _Max - _Min + 1 < _Size )
+	{
+		int	Min = _Min % _Size;
+			Min = Min < 0 ? Min + _Size : Min;
+		int	Max = Min + _Max - _Min;
+
+		int	T0 = Min / _TileSize;
+		if ( Max < _Size )
+		{	// Simple range
+			for ( int TileIndex=T0; TileIndex <= Max / _TileSize; TileIndex++ )
+				_pTiles[Count++] = TileIndex;
+			return Count;
+		}
+
+		int	T1 = (Max - _Size) / _TileSize;
+		if ( T1 < T0 )
+		{	// Wrapped range: [T0,TilesCount[ + [0,T1]
+			for ( int TileIndex=T0; TileIndex < _TilesCount; TileIndex++ )
+				_pTiles[Count++] = TileIndex;
+			for ( int TileIndex=0; TileIndex <= T1; TileIndex++ )
+				_pTiles[Count++] = TileIndex;
+			return Count;
+		}
+	}
+
+	// The range overlaps all the tiles
+	for ( int TileIndex=0; TileIndex < _TilesCount; TileIndex++ )
+		_pTiles[Count++] = TileIndex;
+
+	return Count;
+}
+
+// Restores the recorded context and draws the primitive
+template<class ContextType>
+void	DrawUtils::RasterizeBatchPrimitive( DrawUtils& _Owner, const BatchPrimitive& _Primitive )
+{
+	ContextType	Context;
+	memcpy( &Context, _Primitive.pContext, sizeof(ContextType) );
+	Context.pOwner = &_Owner;
+
+	_Owner.m_Infos.pData = _Primitive.pData;
+	_Owner.RasterizeQuad( _Primitive.pVertices, Context );
 }
 
 
 //////////////////////////////////////////////////////////////////////////
+// Rasterization
 void	DrawUtils::Transform( const float4& _SourcePosition, float4& _TransformedPosition ) const
 {
 	_TransformedPosition.x = m_C.x + m_X.x * _SourcePosition.x + m_Y.x * _SourcePosition.y;
@@ -277,117 +521,327 @@ void	DrawUtils::Transform( const float4& _SourcePosition, float4& _TransformedPo
 	_TransformedPosition.w = _SourcePosition.w;
 }
 
-// Here, we're assuming (x,y) couples are CCW and form a convex quadrilateral
-void	DrawUtils::DrawQuad( float4 _pVertices[], DrawContext& _Context ) const
+// Transforms the quad and draws it, or simply records it if we're batching
+template<class ContextType>
+void	DrawUtils::DrawQuad( float4 _pVertices[], ContextType& _Context ) const
 {
-	// Build doubled list of vertices with UVs
-	float4	pVertices[8];
+	float4	pVertices[4];
 	Transform( _pVertices[0], pVertices[0] );
 	Transform( _pVertices[1], pVertices[1] );
 	Transform( _pVertices[2], pVertices[2] );
 	Transform( _pVertices[3], pVertices[3] );
+
+	if ( !m_bBatching )
+	{
+		RasterizeQuad( pVertices, _Context );
+		return;
+	}
+
+	ASSERT( sizeof(ContextType) <= MAX_CONTEXT_SIZE, "Context is too large to be recorded! Increase MAX_CONTEXT_SIZE." );
+
+	BatchPrimitive&	Primitive = m_BatchPrimitives.Append();
+	float2	Min( FLOAT32_MAX, FLOAT32_MAX );
+	float2	Max( -FLOAT32_MAX, -FLOAT32_MAX );
 	for ( int i=0; i < 4; i++ )
-		pVertices[4+i] = pVertices[i];
+	{
+		Primitive.pVertices[i] = pVertices[i];
+		Min.x = MIN( Min.x, pVertices[i].x );	Max.x = MAX( Max.x, pVertices[i].x );
+		Min.y = MIN( Min.y, pVertices[i].y );	Max.y = MAX( Max.y, pVertices[i].y );
+	}
+	Primitive.X0 = floorf( Min.x );
+	Primitive.Y0 = floorf( Min.y );
+	Primitive.X1 = floorf( Max.x );
+	Primitive.Y1 = floorf( Max.y );
+	Primitive.pData = m_Infos.pData;
+	Primitive.pRasterize = RasterizeBatchPrimitive<ContextType>;
+	memcpy( Primitive.pContext, &_Context, sizeof(ContextType) );
+}
 
-	// Find top vertex
+// Here, we're assuming (x,y) couples are CCW and form a convex quadrilateral
+// The quad is rasterized as horizontal spans: only the left & right pixels of a span get a partial coverage, the inner run
+//	is drawn at full coverage by the context's (inlined) DrawPixel() with no per-pixel modulo since we wrap by whole segments.
+template<class ContextType>
+void	DrawUtils::RasterizeQuad( const float4 _pVertices[], ContextType& _Context ) const
+{
+	// Build doubled list of vertices with UVs
+	float4	pVertices[8];
+	for ( int i=0; i < 4; i++ )
+		pVertices[4+i] = pVertices[i] = _pVertices[i];
+
+	// Find top vertex & bounds
 	float	Min = FLOAT32_MAX;
+	float	Max = -FLOAT32_MAX;
+	float	MinX = FLOAT32_MAX;
+	float	MaxX = -FLOAT32_MAX;
 	int		Top = -1;
 	for ( int i=0; i < 4; i++ )
+	{
 		if ( pVertices[i].y < Min )
 		{
 			Min = pVertices[i].y;
 			Top = i;
 		}
-
+		Max = MAX( Max, pVertices[i].y );
+		MinX = MIN( MinX, pVertices[i].x );
+		MaxX = MAX( MaxX, pVertices[i].x );
+	}
 	// Start drawing
+	// Edge positions are evaluated from their start vertex for every scanline rather than accumulated
+	//	so clipped scanlines can be skipped without changing the result of the others
 	_Context.Y = floorf( pVertices[Top].y );
 	int			LDy = 0, RDy = 0;			// Amount of pixels to trace for the left & right segments until the next segment (or end of the quad)
 	int			L = Top, R = 4+Top;			// Left & Right indices: Left will increase, Right will decrease
-	float4	LPos, RPos;					// Left & Right position & UV
-	float4	LSlope, RSlope;				// Left & Right slope
-//	while ( _Context.Y < m_Height )
+	float4	LStart = pVertices[Top];	// Left & Right segment start position & UV
+	float4	RStart = pVertices[Top];
+	float4	LSlope = float4::Zero;		// Left & Right slope
+	float4	RSlope = float4::Zero;
 	while ( true )
 	{
-		while ( LDy <= 0.0f && L <= R )
+		while ( LDy <= 0 && L <= R )
 		{	// Rebuild left slope
 			float4&	Current = pVertices[L];
 			float4&	Next = pVertices[++L];
-			LSlope = Next - Current;
+			if ( Next.y - Current.y < 1e-3f )
+				continue;	// Horizontal (or going up) segment
+
 			int		EndY = floorf( Next.y+0.5f );
 			LDy = EndY - _Context.Y;
-// 			if ( LDy <= 0 )
-// 				continue;	// Too low a slope !
+			if ( LDy <= 0 )
+				continue;	// Too low a slope !
 
+			LStart = Current;
+			LSlope = Next - Current;
 			LSlope = LSlope / LSlope.y;
-			LPos = Current + (_Context.Y+0.5f - Current.y) * LSlope;
 		}
-		while ( RDy <= 0.0f && L <= R )
+		while ( RDy <= 0 && L <= R )
 		{	// Rebuild right slope
 			float4&	Current = pVertices[R];
 			float4&	Next = pVertices[--R];
-			RSlope = Next - Current;
+			if ( Next.y - Current.y < 1e-3f )
+				continue;	// Horizontal (or going up) segment
+
 			int		EndY = floorf( Next.y+0.5f );
 			RDy = EndY - _Context.Y;
-// 			if ( RDy <= 0 )
-// 				continue;	// Too low a slope !
+			if ( RDy <= 0 )
+				continue;	// Too low a slope !
 
+			RStart = Current;
+			RSlope = Next - Current;
 			RSlope = RSlope / RSlope.y;
-			RPos = Current + (_Context.Y+0.5f - Current.y) * RSlope;
 		}
 		if ( L > R )
 			break;	// The quad is over !
 
-		// Draw the scanline
-		// The comments left here are the original lines you need to draw in CLAMP mode
-//		if ( _Context.Y > 0 )
-		{
-			_Context.X = floorf( LPos.x );
-//			bool		bClipLeft = _Context.X < 0;
-			bool		bClipLeft = false;	// Don't ever clip since we wrap !
-//			_Context.X = MAX( 0, _Context.X );
-
-			int			RX = floorf( RPos.x );
-//			bool		bClipRight = RX >= m_Width;
-			bool		bClipRight = false;	// Don't ever clip since we wrap !
-//						RX = MIN( m_Width-1, RX );
-
-			// Compute slope & start position
-			float4	Slope = RPos - LPos;
-			if ( Slope.x != 0.0f )
-				Slope = Slope / Slope.x;
-
-			_Context.P = LPos + (_Context.X+0.5f - LPos.x) * Slope;
-			_Context.NewScanline();
-
-			// Draw left pixel
-			if ( !bClipLeft )
+		if ( m_bClip )
+		{	// Jump toward the next scanline inside the clip rectangle
+			// We never jump past the end of a segment so segments are rebuilt on the exact same scanlines as when not clipping
+			int	WrappedY = _Context.Y % m_Height;
+				WrappedY = WrappedY < 0 ? WrappedY + m_Height : WrappedY;
+			int	SkippedRows = 0;
+			if ( WrappedY < m_ClipY0 )
+				SkippedRows = m_ClipY0 - WrappedY;
+			else if ( WrappedY >= m_ClipY1 )
+				SkippedRows = m_Height - WrappedY + m_ClipY0;
+
+			if ( SkippedRows > 0 )
 			{
-				_Context.Coverage = ceilf( _Context.P.x ) - LPos.x;
-				_Context.DrawPixel();
-				_Context.X++;
-				_Context.P = _Context.P + Slope;
+				SkippedRows = MIN( SkippedRows, MIN( LDy, RDy ) );
+				_Context.Y += SkippedRows;
+				LDy -= SkippedRows;
+				RDy -= SkippedRows;
+				continue;
 			}
+		}
 
-			// Draw full coverage pixels
-			_Context.Coverage = 1.0f;
-			for ( ; _Context.X < RX; _Context.X++ )
-			{
-				_Context.DrawPixel();
-				_Context.P = _Context.P + Slope;
-			}
+		// Draw the scanline (the top scanline is partially covered)
+		float4	LPos = LStart + (_Context.Y+0.5f - LStart.y) * LSlope;
+		float4	RPos = RStart + (_Context.Y+0.5f - RStart.y) * RSlope;
+		float	CoverageY = _Context.bAntiAliasY ? SATURATE( MIN( _Context.Y+1.0f, Max ) - MAX( float(_Context.Y), Min ) ) : 1.0f;
+		DrawScanline( _Context, LPos, RPos, CoverageY, MinX, MaxX );
+
+		// Increment
+		_Context.Y++;
+		LDy--; RDy--;
+	}
+
+	// Scanlines are only drawn if their center is covered so the last partially covered scanline is still missing
+	if ( _Context.bAntiAliasY && Max > _Context.Y )
+	{
+		float4	LPos = LStart + (_Context.Y+0.5f - LStart.y) * LSlope;
+		float4	RPos = RStart + (_Context.Y+0.5f - RStart.y) * RSlope;
+		DrawScanline( _Context, LPos, RPos, Max - _Context.Y, MinX, MaxX );
+	}
+}
+
+// Draws a single scanline between the left & right positions
+// We don't ever clip since we wrap ! (except to the tile's rectangle when drawing batches)
+template<class ContextType>
+void	DrawUtils::DrawScanline( ContextType& _Context, const float4& _LPos, const float4& _RPos, float _CoverageY, float _MinX, float _MaxX ) const
+{
+	// Edges are extrapolated up to half a pixel past their end vertices, which can shoot far away for nearly horizontal edges
+	//	so we clamp them to the quad's bounds
+	float	LeftX = MAX( _LPos.x, _MinX );
+	float	RightX = MIN( _RPos.x, _MaxX );
+	if ( RightX <= LeftX || _CoverageY <= 0.0f )
+		return;	// Empty span
+
+	if ( m_bClip )
+	{
+		int	WrappedY = _Context.Y % m_Height;
+			WrappedY = WrappedY < 0 ? WrappedY + m_Height : WrappedY;
+		if ( WrappedY < m_ClipY0 || WrappedY >= m_ClipY1 )
+			return;
+	}
 
-			// Draw right pixel
-			if ( !bClipRight )
+	int		LX = floorf( LeftX );
+	int		RX = floorf( RightX );
+	float	CoverageL = (LX == RX ? RightX - LeftX : LX+1 - LeftX) * _CoverageY;
+	float	CoverageR = (RightX - RX) * _CoverageY;
+
+	// Compute slope & origin so the position + UV at the center of pixel X is Origin + X * Slope
+	// (we don't accumulate the slope so a pixel gets the exact same values whether it's clipped or not)
+	float4	Slope = _RPos - _LPos;
+			Slope = Slope * (1.0f / Slope.x);
+	float4	Origin = _LPos + (0.5f - _LPos.x) * Slope;
+
+	_Context.NewScanline();
+
+	int		WrappedX = LX % m_Width;
+			WrappedX = WrappedX < 0 ? WrappedX + m_Width : WrappedX;
+
+	if ( m_bClip )
+	{	// Only draw the pixels inside the clip rectangle (a span wider than the surface may cross it several times)
+		int	LastX = RX > LX && CoverageR <= 0.0f ? RX-1 : RX;
+		for ( int BaseX=LX-WrappedX; BaseX <= LastX; BaseX+=m_Width )
+		{
+			int	X0 = MAX( LX, BaseX + m_ClipX0 );
+			int	X1 = MIN( LastX+1, BaseX + m_ClipX1 );
+			for ( _Context.X=X0; _Context.X < X1; _Context.X++ )
 			{
-				_Context.Coverage = RPos.x - floorf( _Context.P.x );
-				_Context.DrawPixel();
+				_Context.Coverage = _Context.X == LX ? CoverageL : (_Context.X == RX ? CoverageR : _CoverageY);
+				_Context.P = Origin + float(_Context.X) * Slope;
+				_Context.DrawPixel( _Context.pScanline[_Context.X - BaseX] );
 			}
 		}
+		return;
+	}
 
-		// Increment
-		_Context.Y++;
-		LDy--; RDy--;
-		LPos = LPos + LSlope;
-		RPos = RPos + RSlope;
+	_Context.X = LX;
+	if ( LX == RX )
+	{	// Both edges lie in the same pixel
+		_Context.Coverage = CoverageL;
+		DrawSpan( _Context, WrappedX, 1, Origin, Slope );
+		return;
+	}
+
+	// Draw left pixel
+	_Context.Coverage = CoverageL;
+	DrawSpan( _Context, WrappedX, 1, Origin, Slope );
+
+	// Draw full coverage pixels
+	_Context.Coverage = _CoverageY;
+	DrawSpan( _Context, WrappedX, RX - LX - 1, Origin, Slope );
+
+	// Draw right pixel
+	_Context.Coverage = CoverageR;
+	if ( _Context.Coverage > 0.0f )
+		DrawSpan( _Context, WrappedX, 1, Origin, Slope );
+}
+
+// Draws a run of pixels with the same coverage, starting at the current context position
+// The run is split into contiguous segments when it wraps around the surface
+template<class ContextType>
+void	DrawUtils::DrawSpan( ContextType& _Context, int& _WrappedX, int _Count, const float4& _Origin, const float4& _Slope ) const
+{
+	while ( _Count > 0 )
+	{
+		int		SegmentCount = MIN( _Count, m_Width - _WrappedX );
+		Pixel*	pPixel = _Context.pScanline + _WrappedX;
+		_Count -= SegmentCount;
+		_WrappedX += SegmentCount;
+		for ( ; SegmentCount > 0; SegmentCount--, pPixel++ )
+		{
+			_Context.P = _Origin + float(_Context.X) * _Slope;
+			_Context.DrawPixel( *pPixel );
+			_Context.X++;
+		}
+		if ( _WrappedX == m_Width )
+			_WrappedX = 0;
+	}
+}
+
+#ifdef _DEBUG
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+// Benchmark
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//
+void	__BenchmarkFillLine( const DrawUtils::DrawInfos& _Infos, Pixel& _Pixel )
+{
+	float	Intensity = MAX( 0.0f, 1.0f - _Infos.Distance );
+	_Pixel.Blend( Pixel( float4( 0, Intensity, 0, 0 ) ), Intensity * _Infos.Coverage );
+}
+
+void	__BenchmarkFillRectangle( const DrawUtils::DrawInfos& _Infos, Pixel& _Pixel )
+{
+	float	Intensity = 1.0f - 2.0f * abs( _Infos.Distance );
+	_Pixel.Blend( Pixel( float4( Intensity, 0, 0, 1 ) ), Intensity < 0.0f ? 0.0f : _Infos.Coverage );
+}
+
+void	DrawUtils::Benchmark( int _LinesCount, int _QuadsCount, BenchmarkResults& _Results )
+{
+	ASSERT( m_pSurface != NULL, "Setup a surface to draw into before running the benchmark!" );
+	ASSERT( !m_bBatching, "The benchmark must measure immediate drawing!" );
+
+	// The lines are thinner than a pixel and cross the surface's borders so they mostly measure the quad setup and the wrapping
+	float2*	pLines = new float2[2*_LinesCount];
+	for ( int LineIndex=0; LineIndex < 2*_LinesCount; LineIndex++ )
+		pLines[LineIndex].Set( _frand( -0.2f, 1.2f ) * m_Width, _frand( -0.2f, 1.2f ) * m_Height );
+
+	// The rectangles are rotated and cover the whole surface several times so they mostly measure the span loops
+	float3*	pQuads = new float3[_QuadsCount];
+	for ( int QuadIndex=0; QuadIndex < _QuadsCount; QuadIndex++ )
+		pQuads[QuadIndex].Set( _frand( 0.0f, float(m_Width) ), _frand( 0.0f, float(m_Height) ), _frand( -180.0f, 180.0f ) );
+
+	float	QuadWidth = 1.75f * m_Width;
+	float	QuadHeight = 1.75f * m_Height;
+
+	TimeProfile	Profile;
+
+	SetupTransform( 0.0f, 0.0f, 0.0f );
+	Profile.Start();
+	for ( int LineIndex=0; LineIndex < _LinesCount; LineIndex++ )
+		DrawLine( pLines[2*LineIndex+0].x, pLines[2*LineIndex+0].y, pLines[2*LineIndex+1].x, pLines[2*LineIndex+1].y, 0.5f, __BenchmarkFillLine, NULL );
+	_Results.ThinLinesTime = Profile.Stop();
+
+	Profile.Start();
+	for ( int QuadIndex=0; QuadIndex < _QuadsCount; QuadIndex++ )
+	{
+		SetupTransform( pQuads[QuadIndex].x, pQuads[QuadIndex].y, pQuads[QuadIndex].z );
+		DrawRectangle( -0.4f * m_Width, -0.4f * m_Height, QuadWidth, QuadHeight, 40.0f, 0.5f, __BenchmarkFillRectangle, NULL );
+	}
+	_Results.LargeQuadsTime = Profile.Stop();
+
+	Pixel	LineColor( float4( 0, 1, 0, 1 ) );
+	SetupTransform( 0.0f, 0.0f, 0.0f );
+	Profile.Start();
+	for ( int LineIndex=0; LineIndex < _LinesCount; LineIndex++ )
+		DrawLine( pLines[2*LineIndex+0].x, pLines[2*LineIndex+0].y, pLines[2*LineIndex+1].x, pLines[2*LineIndex+1].y, 0.5f, LineColor );
+	_Results.SolidThinLinesTime = Profile.Stop();
+
+	Pixel	QuadColor( float4( 1, 0, 0, 0.5f ) );
+	Profile.Start();
+	for ( int QuadIndex=0; QuadIndex < _QuadsCount; QuadIndex++ )
+	{
+		SetupTransform( pQuads[QuadIndex].x, pQuads[QuadIndex].y, pQuads[QuadIndex].z );
+		DrawRectangle( -0.4f * m_Width, -0.4f * m_Height, QuadWidth, QuadHeight, QuadColor );
 	}
+	_Results.SolidLargeQuadsTime = Profile.Stop();
+
+	SetupTransform( 0.0f, 0.0f, 0.0f );
+
+	delete[] pQuads;
+	delete[] pLines;
 }
+#endif
@@ -21,8 +21,21 @@ public:		// NESTED TYPES
 	typedef void	(*FillDelegate)( const DrawInfos& _Infos, Pixel& _Pixel );
 	typedef void	(*ScratchFillDelegate)( const DrawInfos& _Infos, Pixel& _Pixel, float Distance, float U );
 
+#ifdef _DEBUG
+	// Rasterization throughput, in milliseconds
+	struct	BenchmarkResults
+	{
+		double	ThinLinesTime;			// Time to draw the thin lines with a delegate (setup bound)
+		double	LargeQuadsTime;			// Time to draw the large rectangles with a delegate (span bound)
+		double	SolidThinLinesTime;		// Same as above but blending a constant pixel
+		double	SolidLargeQuadsTime;
+	};
+#endif
+
 protected:
 
+	// The quad rasterizer is templated on the context type so the per-pixel DrawPixel() of each context gets inlined into the span loops
+	// Contexts are NOT virtual: each of them simply provides a DrawPixel( Pixel& ) method that is called for every pixel of a span
 	struct	DrawContext
 	{
 		DrawUtils*	pOwner;
@@ -30,7 +43,9 @@ protected:
 		float4	P;				// Current position + UV
 		float		Coverage;		// Pixel coverage
 		Pixel*		pScanline;		// Current scanline
-		virtual void	NewScanline()
+		bool		bAntiAliasY;	// True to attenuate the coverage of the top & bottom scanlines (disabled for primitives made of abutting quads)
+
+		void	NewScanline()
 		{
 			int	WrappedY = Y % pOwner->m_Height;
 				WrappedY = WrappedY < 0 ? WrappedY + pOwner->m_Height : WrappedY;	// Ensure always positive !
@@ -38,12 +53,11 @@ protected:
 			pScanline = pOwner->m_pSurface + pOwner->m_Width * WrappedY;
 			pOwner->m_Infos.y = Y;
 		}
-		virtual void	DrawPixel() = 0;
 	};
 
 	struct	DrawContextRECT : public DrawContext
 	{
-		virtual void	DrawPixel();
+		void			DrawPixel( Pixel& _Pixel );
 
 		float			w, h;			// Rectangle width/height
 		float			x0, y0, x1, y1;	// Borders
@@ -53,7 +67,7 @@ protected:
 
 	struct	DrawContextLINE : public DrawContext
 	{
-		virtual void	DrawPixel();
+		void			DrawPixel( Pixel& _Pixel );
 
 		float			dU;				// Small portion of UV space along U that offsets to the line's start
 		FillDelegate	pFiller;		// Filler delegate
@@ -61,7 +75,7 @@ protected:
 
 	struct	DrawContextELLIPSE : public DrawContext
 	{
-		virtual void	DrawPixel();
+		void			DrawPixel( Pixel& _Pixel );
 
 		float			w, h;			// Rectangle width/height
 		float			x0, y0, x1, y1;	// Borders
@@ -72,7 +86,7 @@ protected:
 
 	struct	DrawContextSCRATCH : public DrawContext
 	{
-		virtual void	DrawPixel();
+		void		DrawPixel( Pixel& _Pixel );
 
 		float		Distance;
 		float		StepDistance;
@@ -82,6 +96,46 @@ protected:
 		ScratchFillDelegate	pFiller;	// Filler delegate
 	};
 
+	// Solid contexts don't call any delegate, they directly blend a constant pixel using the coverage
+	struct	DrawContextSOLIDRECT : public DrawContext
+	{
+		void		DrawPixel( Pixel& _Pixel )	{ _Pixel.Blend( Color, Coverage * Color.RGBA.w ); }
+
+		Pixel		Color;
+	};
+
+	struct	DrawContextSOLIDLINE : public DrawContext
+	{
+		void		DrawPixel( Pixel& _Pixel );
+
+		float		dU;				// Small portion of UV space along U that offsets to the line's start
+		float		Thickness;		// Line thickness in pixels, used to anti-alias the distance to the line
+		Pixel		Color;
+	};
+
+	struct	DrawContextSPLOTCH : public DrawContext
+	{
+		void		DrawPixel( Pixel& _Pixel );
+
+		const Noise*	pNoise;
+		float		Perturbation;	// Amount of noise perturbation of the splotch's radius
+	};
+
+	// A quad recorded while batching, along with a copy of the context it must be drawn with
+	struct	BatchPrimitive;
+	typedef void	(*RasterizeDelegate)( DrawUtils& _Owner, const BatchPrimitive& _Primitive );
+
+	static const int	MAX_CONTEXT_SIZE = 128;
+
+	struct	BatchPrimitive
+	{
+		float4				pVertices[4];		// Already transformed vertices
+		int					X0, Y0, X1, Y1;		// Covered pixels (unwrapped)
+		void*				pData;				// User data
+		RasterizeDelegate	pRasterize;			// Restores the context and draws the quad
+		U8					pContext[MAX_CONTEXT_SIZE];
+	};
+
 protected:	// FIELDS
 
 	int			m_Width;
@@ -100,6 +154,20 @@ protected:	// FIELDS
 
 	mutable DrawContextSCRATCH	m_ContextSCRATCH;
 
+	mutable DrawContextSOLIDRECT	m_ContextSOLIDRECT;
+	mutable DrawContextSOLIDLINE	m_ContextSOLIDLINE;
+	mutable DrawContextSPLOTCH		m_ContextSPLOTCH;
+
+	// Batching
+	bool						m_bBatching;
+	int							m_TileSize;
+	mutable List<BatchPrimitive>	m_BatchPrimitives;
+
+	// Clipping rectangle in WRAPPED surface space (only used by the batch tiles)
+	bool		m_bClip;
+	int			m_ClipX0, m_ClipY0;
+	int			m_ClipX1, m_ClipY1;
+
 public:		// METHODS
 
 	DrawUtils();
@@ -113,6 +181,10 @@ public:		// METHODS
 	//	bias = bias in the border computation [0,1]. 1 shifts the border toward the outside of the rectangle.
 	void	DrawRectangle( float x, float y, float w, float h, float border, float bias, FillDelegate _Filler, void* _pData ) const;
 
+	// Draws an anti-aliased rectangle blended with a constant pixel (the blend factor is the coverage times the alpha of the color)
+	// This is much faster than using a delegate as the blending is inlined in the span loop
+	void	DrawRectangle( float x, float y, float w, float h, const Pixel& _Color ) const;
+
 	// Draws an ellipse
 	//	border = thickness of the border
 	//	bias = bias in the border computation [0,1]. 1 shifts the border toward the outside of the rectangle.
@@ -121,6 +193,9 @@ public:		// METHODS
 	// Draws a line
 	void	DrawLine( float x0, float y0, float x1, float y1, float thickness, FillDelegate _Filler, void* _pData ) const;
 
+	// Draws an anti-aliased line with round caps blended with a constant pixel
+	void	DrawLine( float x0, float y0, float x1, float y1, float thickness, const Pixel& _Color ) const;
+
 
 	// =================== Compound Drawing ===================
 	// Draws a scratch mark
@@ -130,9 +205,40 @@ public:		// METHODS
 	//	_StepSize, size of each subdivision
 	void	DrawScratch( const float2& _Position, const float2& _Direction, float _Length, float _ThicknessStart, float _ThicknessEnd, float _CurveAngle, float _StepSize, ScratchFillDelegate _Filler, void* _pData ) const;
 
+	// Draws a splotch centered on the position
+	//	_Size, size of the splotch
+	//	_Angle, rotation of the splotch in degrees
+	//	_Perturbation, amount of noise perturbation of the splotch's radius
 	void	DrawSplotch( const float2& _Position, const float2& _Size, float _Angle, const Noise& _Noise, float _Perturbation ) const;
 
+
+	// =================== Batched Drawing ===================
+	// Once a batch is started, all the drawing primitives are simply gathered instead of being drawn
+	// EndBatch() then bins the primitives into square tiles of the surface and draws the tiles in parallel.
+	// Primitives are drawn in submission order within each tile so blending yields the same result as immediate drawing.
+	// NOTE: the delegates are then called from several threads at once, they must only read their user data
+	void	BeginBatch( int _TileSize=64 );
+	void	EndBatch();
+
+#ifdef _DEBUG
+	// Measures the rasterizer throughput on many thin lines and a few rectangles covering the whole surface several times
+	// NOTE: This draws into the current surface and resets the transform
+	void	Benchmark( int _LinesCount, int _QuadsCount, BenchmarkResults& _Results );
+#endif
+
 protected:
-	void	DrawQuad( float4 _pVertices[], DrawContext& _Context ) const;
+	template<class ContextType>
+	void	DrawQuad( float4 _pVertices[], ContextType& _Context ) const;
+	template<class ContextType>
+	void	RasterizeQuad( const float4 _pVertices[], ContextType& _Context ) const;
+	template<class ContextType>
+	void	DrawScanline( ContextType& _Context, const float4& _LPos, const float4& _RPos, float _CoverageY, float _MinX, float _MaxX ) const;
+	template<class ContextType>
+	void	DrawSpan( ContextType& _Context, int& _WrappedX, int _Count, const float4& _Origin, const float4& _Slope ) const;
+	template<class ContextType>
+	static void	RasterizeBatchPrimitive( DrawUtils& _Owner, const BatchPrimitive& _Primitive );
+	static void	RasterizeTiles( int _TileIndex0, int _TileIndex1, void* _pData );
+	static int	BuildTilesList( int _Min, int _Max, int _Size, int _TileSize, int _TilesCount, int* _pTiles );
 	void	Transform( const float4& _SourcePosition, float4& _TransformedPosition ) const;
+	bool	BuildLineQuad( float x0, float y0, float x1, float y1, float thickness, float4 _pVertices[], float& _dU ) const;
 };
@@ -246,17 +246,71 @@ void	FillBCG( int _X, int _Y, const float2& _UV, Pixel& _Pixel, void* _pData )
 	_Pixel.RGBA = _Pixel.RGBA * (NewLuma / Luma);
 }
 
+static void	SetupBCG( __BCGStruct& _BCG, float _Brightness, float _Contrast, float _Gamma )
+{
+//	_BCG.B = 0.5f + _Brightness;
+	_BCG.B = _Brightness - 0.5f;
+	_BCG.C = tanf( HALFPI * 0.5f * (1.0f + _Contrast) );
+	_BCG.G = _Gamma;
+}
+
 void	Filters::BrightnessContrastGamma( TextureBuilder& _Builder, float _Brightness, float _Contrast, float _Gamma )
 {
 	__BCGStruct	BCG;
-//	BCG.B = 0.5f + _Brightness;
-	BCG.B = _Brightness - 0.5f;
-	BCG.C = tanf( HALFPI * 0.5f * (1.0f + _Contrast) );
-	BCG.G = _Gamma;
+	SetupBCG( BCG, _Brightness, _Contrast, _Gamma );
 
 	_Builder.Fill( FillBCG, &BCG );
 }
 
+//////////////////////////////////////////////////////////////////////////
+// Remapping
+struct __RemapStruct
+{
+	float	InMin;
+	float	Scale;
+	float	OutMin;
+	float	OutMax;
+	bool	bSaturate;
+};
+void	FillRemap( int _X, int _Y, const float2& _UV, Pixel& _Pixel, void* _pData )
+{
+	__RemapStruct&	Params = *((__RemapStruct*) _pData);
+
+	_Pixel.RGBA.x = Params.OutMin + Params.Scale * (_Pixel.RGBA.x - Params.InMin);
+	_Pixel.RGBA.y = Params.OutMin + Params.Scale * (_Pixel.RGBA.y - Params.InMin);
+	_Pixel.RGBA.z = Params.OutMin + Params.Scale * (_Pixel.RGBA.z - Params.InMin);
+	_Pixel.Height = Params.OutMin + Params.Scale * (_Pixel.Height - Params.InMin);
+	_Pixel.Roughness = Params.OutMin + Params.Scale * (_Pixel.Roughness - Params.InMin);
+	if ( !Params.bSaturate )
+		return;
+
+	float	Min = MIN( Params.OutMin, Params.OutMax );
+	float	Max = MAX( Params.OutMin, Params.OutMax );
+	_Pixel.RGBA.x = CLAMP( _Pixel.RGBA.x, Min, Max );
+	_Pixel.RGBA.y = CLAMP( _Pixel.RGBA.y, Min, Max );
+	_Pixel.RGBA.z = CLAMP( _Pixel.RGBA.z, Min, Max );
+	_Pixel.Height = CLAMP( _Pixel.Height, Min, Max );
+	_Pixel.Roughness = CLAMP( _Pixel.Roughness, Min, Max );
+}
+
+static void	SetupRemap( __RemapStruct& _Params, float _InMin, float _InMax, float _OutMin, float _OutMax, bool _bSaturate )
+{
+	ASSERT( _InMax != _InMin, "Empty input range !" );
+	_Params.InMin = _InMin;
+	_Params.Scale = (_OutMax - _OutMin) / (_InMax - _InMin);
+	_Params.OutMin = _OutMin;
+	_Params.OutMax = _OutMax;
+	_Params.bSaturate = _bSaturate;
+}
+
+void	Filters::Remap( TextureBuilder& _Builder, float _InMin, float _InMax, float _OutMin, float _OutMax, bool _bSaturate )
+{
+	__RemapStruct	Params;
+	SetupRemap( Params, _InMin, _InMax, _OutMin, _OutMax, _bSaturate );
+
+	_Builder.Fill( FillRemap, &Params );
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Filters
 struct __EmbossStruct
@@ -379,3 +433,72 @@ void	Filters::Dilate( TextureBuilder& _Builder, int _KernelSize )
 
 	_Builder.Fill( FillDilate, &Params );
 }
+
+
+//////////////////////////////////////////////////////////////////////////
+// Point-wise filters chain
+void	FilterChain::Append( TextureBuilder::FillDelegate _Filler, void* _pData )
+{
+	ASSERT( m_StagesCount < MAX_STAGES, "Too many stages in the filter chain ! Increase MAX_STAGES..." );
+
+	Stage&	S = m_pStages[m_StagesCount++];
+	S.pFiller = _Filler;
+	S.pData = _pData;
+	S.bOwnParams = false;
+}
+
+FilterChain::Stage&	FilterChain::AppendOwned( TextureBuilder::FillDelegate _Filler )
+{
+	ASSERT( m_StagesCount < MAX_STAGES, "Too many stages in the filter chain ! Increase MAX_STAGES..." );
+
+	Stage&	S = m_pStages[m_StagesCount++];
+	S.pFiller = _Filler;
+	S.pData = NULL;
+	S.bOwnParams = true;
+	return S;
+}
+
+void	FilterChain::BrightnessContrastGamma( float _Brightness, float _Contrast, float _Gamma )
+{
+	ASSERT( sizeof(__BCGStruct) <= MAX_STAGE_PARAMS*sizeof(float), "Stage parameters too small !" );
+
+	Stage&	S = AppendOwned( FillBCG );
+	SetupBCG( *((__BCGStruct*) S.pParams), _Brightness, _Contrast, _Gamma );
+}
+
+void	FilterChain::Remap( float _InMin, float _InMax, float _OutMin, float _OutMax, bool _bSaturate )
+{
+	ASSERT( sizeof(__RemapStruct) <= MAX_STAGE_PARAMS*sizeof(float), "Stage parameters too small !" );
+
+	Stage&	S = AppendOwned( FillRemap );
+	SetupRemap( *((__RemapStruct*) S.pParams), _InMin, _InMax, _OutMin, _OutMax, _bSaturate );
+}
+
+void	FilterChain::FillChain( int _X, int _Y, const float2& _UV, Pixel& _Pixel, void* _pData )
+{
+	FilterChain&	Chain = *((FilterChain*) _pData);
+
+	Stage*	pStage = Chain.m_pStages;
+	for ( int StageIndex=0; StageIndex < Chain.m_StagesCount; StageIndex++, pStage++ )
+		(*pStage->pFiller)( _X, _Y, _UV, _Pixel, pStage->pData );
+}
+
+int	FilterChain::Apply( TextureBuilder& _Builder )
+{
+	m_PassesSaved = 0;
+	if ( m_StagesCount == 0 )
+		return 0;
+
+	// Resolve the stages that use their own parameters (we do it here so the chain can be safely copied around before that)
+	for ( int StageIndex=0; StageIndex < m_StagesCount; StageIndex++ )
+		if ( m_pStages[StageIndex].bOwnParams )
+			m_pStages[StageIndex].pData = m_pStages[StageIndex].pParams;
+
+	if ( m_StagesCount == 1 )
+		_Builder.Fill( m_pStages[0].pFiller, m_pStages[0].pData );	// No need for the indirection
+	else
+		_Builder.Fill( FillChain, this );
+
+	m_PassesSaved = m_StagesCount - 1;
+	return m_PassesSaved;
+}
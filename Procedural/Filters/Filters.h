@@ -14,9 +14,77 @@ public:		// METHODS
 
 	static void	BrightnessContrastGamma( TextureBuilder& _Builder, float _Brightness=0.0f, float _Contrast=0.0f, float _Gamma=1.0f );
 
+	// Linearly remaps the RGB, height & roughness fields from [_InMin,_InMax] into [_OutMin,_OutMax]
+	static void	Remap( TextureBuilder& _Builder, float _InMin=0.0f, float _InMax=1.0f, float _OutMin=0.0f, float _OutMax=1.0f, bool _bSaturate=true );
+
 	static void	Emboss( TextureBuilder& _Builder, const float2& _Direction, float _Amplitude=1.0f );
 
 	static void	Erode( TextureBuilder& _Builder, int _KernelSize=4 );
 
 	static void	Dilate( TextureBuilder& _Builder, int _KernelSize=4 );
 };
+
+
+//////////////////////////////////////////////////////////////////////////
+// Point-wise filters chain
+// Each point-wise filter (i.e. a filter that only reads the pixel it's writing) usually costs a full Fill() pass over the fat pixels.
+// The chain gathers a sequence of such filters and applies them all at once, in order, while the pixel is in cache
+//	so the image only streams through memory once, whatever the length of the chain.
+//
+// Typical use:
+//	FilterChain	Chain;
+//	Chain.BrightnessContrastGamma( 0.1f, 0.7f, 2.0f );
+//	Chain.Remap( 0.2f, 0.8f );
+//	Chain.Append( FillColorize, &MyColorizeParams );	// Any of your own point-wise fillers
+//	Chain.Apply( TB );
+//
+// NOTE: Only append fillers that don't sample neighbor pixels from the texture they write to!
+//
+class	FilterChain
+{
+public:		// CONSTANTS
+
+	static const int	MAX_STAGES = 16;
+	static const int	MAX_STAGE_PARAMS = 8;
+
+protected:	// NESTED TYPES
+
+	struct	Stage
+	{
+		TextureBuilder::FillDelegate	pFiller;
+		void*							pData;
+		bool							bOwnParams;	// True if pData must point to our own parameters below
+		float							pParams[MAX_STAGE_PARAMS];
+	};
+
+protected:	// FIELDS
+
+	Stage	m_pStages[MAX_STAGES];
+	int		m_StagesCount;
+	int		m_PassesSaved;
+
+public:		// PROPERTIES
+
+	int		GetStagesCount() const	{ return m_StagesCount; }
+	int		GetPassesSaved() const	{ return m_PassesSaved; }	// Amount of Fill() passes saved by the last Apply()
+
+public:		// METHODS
+
+	FilterChain() : m_StagesCount( 0 ), m_PassesSaved( 0 )	{}
+
+	void	Clear()	{ m_StagesCount = 0; }
+
+	// Appends any point-wise filler with its user data (the data must stay alive until Apply() is called)
+	void	Append( TextureBuilder::FillDelegate _Filler, void* _pData );
+
+	// Appends the built-in point-wise filters (same parameters as their Filters:: counterpart)
+	void	BrightnessContrastGamma( float _Brightness=0.0f, float _Contrast=0.0f, float _Gamma=1.0f );
+	void	Remap( float _InMin=0.0f, float _InMax=1.0f, float _OutMin=0.0f, float _OutMax=1.0f, bool _bSaturate=true );
+
+	// Applies the whole chain in a single pass and returns the amount of passes saved compared to applying each filter separately
+	int		Apply( TextureBuilder& _Builder );
+
+protected:
+	Stage&	AppendOwned( TextureBuilder::FillDelegate _Filler );
+	static void	FillChain( int _X, int _Y, const float2& _UV, Pixel& _Pixel, void* _pData );
+};
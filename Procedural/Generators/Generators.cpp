@@ -1,4 +1,6 @@
 #include "../../GodComplex.h"
+#include <xmmintrin.h>
+#include <emmintrin.h>
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -44,6 +46,205 @@ void Generators::ComputeNormal( const TextureBuilder& _Source, TextureBuilder& _
 }
 
 
+//////////////////////////////////////////////////////////////////////////
+// Fast Normal Map
+// Heights are extracted once per row into 3 rolling row buffers (top, center, bottom) with a 1 pixel border that is either wrapped or clamped.
+// The stencil then computes 4 normals at once and stores them as separate X, Y, Z rows that are finally written into the target format.
+//
+struct __NormalRowsStruct
+{
+	const Pixel*	pSource;
+	int				W, H;
+	int				W4;			// Width rounded up to a multiple of 4
+	float			HeightFactor;
+	bool			bNormalize;
+	bool			bWrap;
+	bool			bSobel;
+
+	float*			pBuffer;
+	float*			ppRows[3];	// Top, center & bottom heights (W4+2 each, height of pixel X is at index X+1)
+	float*			pNx;		// W4 normals each
+	float*			pNy;
+	float*			pNz;
+};
+
+void	NormalRowsInit( __NormalRowsStruct& _Params, const TextureBuilder& _Source, int _MipLevel, float _HeightFactor, bool _bNormalize, bool _bWrap, bool _bSobel )
+{
+	_Params.pSource = _Source.GetMip( _MipLevel );
+	_Params.W = _Source.GetWidth( _MipLevel );
+	_Params.H = _Source.GetHeight( _MipLevel );
+	_Params.W4 = (_Params.W + 3) & ~3;
+	_Params.HeightFactor = _HeightFactor;
+	_Params.bNormalize = _bNormalize;
+	_Params.bWrap = _bWrap;
+	_Params.bSobel = _bSobel;
+
+	int	RowSize = _Params.W4 + 2;
+	_Params.pBuffer = new float[3*RowSize + 3*_Params.W4];
+	_Params.ppRows[0] = _Params.pBuffer;
+	_Params.ppRows[1] = _Params.ppRows[0] + RowSize;
+	_Params.ppRows[2] = _Params.ppRows[1] + RowSize;
+	_Params.pNx = _Params.ppRows[2] + RowSize;
+	_Params.pNy = _Params.pNx + _Params.W4;
+	_Params.pNz = _Params.pNy + _Params.W4;
+}
+
+void	NormalRowsLoad( __NormalRowsStruct& _Params, int _Y, float* _pRow )
+{
+	int	W = _Params.W;
+	int	H = _Params.H;
+	if ( _Params.bWrap )
+		_Y = _Y < 0 ? _Y + H : (_Y >= H ? _Y - H : _Y);
+	else
+		_Y = CLAMP( _Y, 0, H-1 );
+
+	const Pixel*	pScanline = _Params.pSource + W * _Y;
+	for ( int X=0; X < W; X++ )
+		_pRow[1+X] = pScanline[X].Height;
+
+	_pRow[0] = _Params.bWrap ? _pRow[W] : _pRow[1];
+	_pRow[1+W] = _Params.bWrap ? _pRow[1] : _pRow[W];
+	for ( int X=W+2; X < _Params.W4+2; X++ )
+		_pRow[X] = _pRow[1+W];	// Unused lanes
+}
+
+// Loads the first rows, call this before computing row 0
+void	NormalRowsStart( __NormalRowsStruct& _Params )
+{
+	NormalRowsLoad( _Params, -1, _Params.ppRows[0] );
+	NormalRowsLoad( _Params, 0, _Params.ppRows[1] );
+	NormalRowsLoad( _Params, 1, _Params.ppRows[2] );
+}
+
+// Rolls the row buffers to compute the next row
+void	NormalRowsNext( __NormalRowsStruct& _Params, int _NextY )
+{
+	float*	pTemp = _Params.ppRows[0];
+	_Params.ppRows[0] = _Params.ppRows[1];
+	_Params.ppRows[1] = _Params.ppRows[2];
+	_Params.ppRows[2] = pTemp;
+	NormalRowsLoad( _Params, _NextY+1, _Params.ppRows[2] );
+}
+
+void	NormalRowsCompute( __NormalRowsStruct& _Params )
+{
+	const float*	pT = _Params.ppRows[0];
+	const float*	pC = _Params.ppRows[1];
+	const float*	pB = _Params.ppRows[2];
+
+	// Normal = Dy ^ Dx with Dx = (1, 0, f * dH/dx) and Dy = (0, -1, f * dH/dy) which simplifies into (-f * dH/dx, f * dH/dy, 1)
+	__m128	NegFactor = _mm_set1_ps( -_Params.HeightFactor );
+	__m128	Factor = _mm_set1_ps( _Params.HeightFactor );
+	__m128	SobelFactor = _mm_set1_ps( 0.25f );	// So the Sobel gradient has the same magnitude as the central differences
+	__m128	One = _mm_set1_ps( 1.0f );
+	__m128	Two = _mm_set1_ps( 2.0f );
+
+	for ( int X=0; X < _Params.W4; X+=4 )
+	{
+		__m128	dHdx, dHdy;
+		if ( _Params.bSobel )
+		{
+			__m128	TL = _mm_loadu_ps( pT+X ), T = _mm_loadu_ps( pT+X+1 ), TR = _mm_loadu_ps( pT+X+2 );
+			__m128	L = _mm_loadu_ps( pC+X ), R = _mm_loadu_ps( pC+X+2 );
+			__m128	BL = _mm_loadu_ps( pB+X ), B = _mm_loadu_ps( pB+X+1 ), BR = _mm_loadu_ps( pB+X+2 );
+
+			dHdx = _mm_sub_ps( _mm_add_ps( _mm_add_ps( TR, BR ), _mm_mul_ps( Two, R ) ), _mm_add_ps( _mm_add_ps( TL, BL ), _mm_mul_ps( Two, L ) ) );
+			dHdy = _mm_sub_ps( _mm_add_ps( _mm_add_ps( BL, BR ), _mm_mul_ps( Two, B ) ), _mm_add_ps( _mm_add_ps( TL, TR ), _mm_mul_ps( Two, T ) ) );
+			dHdx = _mm_mul_ps( dHdx, SobelFactor );
+			dHdy = _mm_mul_ps( dHdy, SobelFactor );
+		}
+		else
+		{
+			dHdx = _mm_sub_ps( _mm_loadu_ps( pC+X+2 ), _mm_loadu_ps( pC+X ) );
+			dHdy = _mm_sub_ps( _mm_loadu_ps( pB+X+1 ), _mm_loadu_ps( pT+X+1 ) );
+		}
+
+		__m128	Nx = _mm_mul_ps( NegFactor, dHdx );
+		__m128	Ny = _mm_mul_ps( Factor, dHdy );
+		__m128	Nz = One;
+		if ( _Params.bNormalize )
+		{
+			__m128	InvLength = _mm_div_ps( One, _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( Nx, Nx ), _mm_mul_ps( Ny, Ny ) ), One ) ) );
+			Nx = _mm_mul_ps( Nx, InvLength );
+			Ny = _mm_mul_ps( Ny, InvLength );
+			Nz = InvLength;
+		}
+
+		_mm_storeu_ps( _Params.pNx+X, Nx );
+		_mm_storeu_ps( _Params.pNy+X, Ny );
+		_mm_storeu_ps( _Params.pNz+X, Nz );
+	}
+}
+
+void Generators::ComputeNormalFast( const TextureBuilder& _Source, TextureBuilder& _Target, float _HeightFactor, bool _bNormalize, bool _bWrap, bool _bSobel )
+{
+	ASSERT( _Source.GetWidth() == _Target.GetWidth() && _Source.GetHeight() == _Target.GetHeight(), "Source and target must have the same size!" );
+
+	__NormalRowsStruct	Params;
+	NormalRowsInit( Params, _Source, 0, _HeightFactor, _bNormalize, _bWrap, _bSobel );
+	NormalRowsStart( Params );
+
+	for ( int Y=0; Y < Params.H; Y++ )
+	{
+		if ( Y > 0 )
+			NormalRowsNext( Params, Y );
+		NormalRowsCompute( Params );
+
+		const float*	pHeight = Params.ppRows[1] + 1;
+		Pixel*			pScanline = _Target.GetMips()[0] + Params.W * Y;
+		for ( int X=0; X < Params.W; X++, pScanline++ )
+			pScanline->RGBA.Set( Params.pNx[X], Params.pNy[X], Params.pNz[X], pHeight[X] );
+	}
+
+	_Target.InvalidateMips();
+	delete[] Params.pBuffer;
+}
+
+void Generators::ComputeNormalPacked( const TextureBuilder& _Source, int _MipLevel, const IPixelFormatDescriptor& _Format, void* _pTarget, float _HeightFactor, bool _bNormalize, bool _bWrap, bool _bSobel )
+{
+	__NormalRowsStruct	Params;
+	NormalRowsInit( Params, _Source, _MipLevel, _HeightFactor, _bNormalize, _bWrap, _bSobel );
+	NormalRowsStart( Params );
+
+	bool	bRGBA8 = &_Format == &PixelFormatRGBA8::DESCRIPTOR;
+	int		PixelSize = _Format.Size();
+
+	__m128	Half = _mm_set1_ps( 0.5f );
+	__m128	Scale = _mm_set1_ps( 255.0f );
+	__m128	Zero = _mm_setzero_ps();
+
+	for ( int Y=0; Y < Params.H; Y++ )
+	{
+		if ( Y > 0 )
+			NormalRowsNext( Params, Y );
+		NormalRowsCompute( Params );
+
+		const float*	pHeight = Params.ppRows[1] + 1;
+		U8*				pScanline = ((U8*) _pTarget) + PixelSize * Params.W * Y;
+		int				X = 0;
+		if ( bRGBA8 )
+		{	// Pack 4 pixels at once, truncating like FLOAT2BYTE() does
+			for ( ; X+4 <= Params.W; X+=4, pScanline+=16 )
+			{
+				__m128i	R = _mm_cvttps_epi32( _mm_min_ps( Scale, _mm_max_ps( Zero, _mm_mul_ps( Scale, _mm_add_ps( Half, _mm_mul_ps( Half, _mm_loadu_ps( Params.pNx+X ) ) ) ) ) ) );
+				__m128i	G = _mm_cvttps_epi32( _mm_min_ps( Scale, _mm_max_ps( Zero, _mm_mul_ps( Scale, _mm_add_ps( Half, _mm_mul_ps( Half, _mm_loadu_ps( Params.pNy+X ) ) ) ) ) ) );
+				__m128i	B = _mm_cvttps_epi32( _mm_min_ps( Scale, _mm_max_ps( Zero, _mm_mul_ps( Scale, _mm_add_ps( Half, _mm_mul_ps( Half, _mm_loadu_ps( Params.pNz+X ) ) ) ) ) ) );
+				__m128i	A = _mm_cvttps_epi32( _mm_min_ps( Scale, _mm_max_ps( Zero, _mm_mul_ps( Scale, _mm_loadu_ps( pHeight+X ) ) ) ) );
+
+				__m128i	RGBA = _mm_or_si128( _mm_or_si128( R, _mm_slli_epi32( G, 8 ) ), _mm_or_si128( _mm_slli_epi32( B, 16 ), _mm_slli_epi32( A, 24 ) ) );
+				_mm_storeu_si128( (__m128i*) pScanline, RGBA );
+			}
+		}
+
+		// Generic path (and remaining pixels)
+		for ( ; X < Params.W; X++, pScanline+=PixelSize )
+			_Format.Write( pScanline, float4( 0.5f * (1.0f + Params.pNx[X]), 0.5f * (1.0f + Params.pNy[X]), 0.5f * (1.0f + Params.pNz[X]), pHeight[X] ) );
+	}
+
+	delete[] Params.pBuffer;
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 // AO
 // The algorithm here is to find the "horizon" of the height field for each of the samplings directions
@@ -111,43 +312,440 @@ void Generators::ComputeAO( const TextureBuilder& _Source, TextureBuilder& _Targ
 }
 
 
+//////////////////////////////////////////////////////////////////////////
+// Fast AO
+// Same horizon algorithm as above but:
+//	_ The height field is copied once into a float plane with a wrapped border large enough for the longest march,
+//		so there's no more modulo nor fat pixel to read
+//	_ As the pixels of a scanline only differ by an integer offset, all the pixels share the same bilinear weights
+//		for a given direction & step: we precompute a table of (offset, weights, slope factor) taps and march 4 pixels at once
+//	_ Optional coarse levels continue the march into downsampled height planes to catch long-range occlusion for cheap:
+//		each level marches once per coarse texel & direction and the fine pixels simply fetch the max slope of their coarse texel
+//
+struct __AOTap
+{
+	int		Offset;					// Offset of the top-left texel in the padded plane
+	float	W00, W01, W10, W11;		// Bilinear weights
+	float	SlopeFactor;			// HeightFactor / marched distance
+};
+
+struct __AOCoarseTap
+{
+	float	dX, dY;					// Offset in the coarse plane's texels
+	float	SlopeFactor;
+};
+
+struct __AOCoarsePlane
+{
+	float*	pHeights;
+	float*	pMaxSlopes;				// DirectionsCount max slopes per texel
+	int		W, H;
+	int		Shift;					// Fine pixel => Coarse texel shift
+	__AOCoarseTap*	pTaps;			// DirectionsCount * CoarseSamplesCount taps
+};
+
+struct __AOFastStruct
+{
+	const Pixel*	pSource;
+	Pixel*			pTarget;
+	int				W, H;
+
+	float*			pPlane;			// Padded height plane
+	int				PlaneWidth;
+	int				Pad;
+
+	int				DirectionsCount;
+	int				SamplesCount;
+	__AOTap*		pTaps;			// DirectionsCount * SamplesCount taps
+
+	int				CoarseLevelsCount;
+	int				CoarseSamplesCount;	// Per direction & per level
+	__AOCoarsePlane*pCoarsePlanes;
+	int				CurrentCoarseLevel;
+
+	bool			bWriteOnlyAlpha;
+};
+
+float	SampleHeightWrap( const __AOCoarsePlane& _Plane, float _X, float _Y )
+{
+	int		X0 = floorf( _X );
+	float	x = _X - X0;
+	int		Y0 = floorf( _Y );
+	float	y = _Y - Y0;
+
+	X0 %= _Plane.W;	X0 += X0 < 0 ? _Plane.W : 0;
+	Y0 %= _Plane.H;	Y0 += Y0 < 0 ? _Plane.H : 0;
+	int		X1 = X0+1 < _Plane.W ? X0+1 : 0;
+	int		Y1 = Y0+1 < _Plane.H ? Y0+1 : 0;
+
+	const float*	pRow0 = _Plane.pHeights + _Plane.W * Y0;
+	const float*	pRow1 = _Plane.pHeights + _Plane.W * Y1;
+	float	H0 = pRow0[X0] + x * (pRow0[X1] - pRow0[X0]);
+	float	H1 = pRow1[X0] + x * (pRow1[X1] - pRow1[X0]);
+	return H0 + y * (H1 - H0);
+}
+
+void	ComputeAOCoarseRows( int _Y0, int _Y1, void* _pData )
+{
+	__AOFastStruct&		Params = *((__AOFastStruct*) _pData);
+	__AOCoarsePlane&	Plane = Params.pCoarsePlanes[Params.CurrentCoarseLevel];
+
+	for ( int Y=_Y0; Y < _Y1; Y++ )
+	{
+		float*	pMaxSlope = Plane.pMaxSlopes + Params.DirectionsCount * Plane.W * Y;
+		for ( int X=0; X < Plane.W; X++ )
+		{
+			const __AOCoarseTap*	pTap = Plane.pTaps;
+			for ( int DirectionIndex=0; DirectionIndex < Params.DirectionsCount; DirectionIndex++, pMaxSlope++ )
+			{
+				float	MaxSlope = 0.0f;
+				for ( int SampleIndex=0; SampleIndex < Params.CoarseSamplesCount; SampleIndex++, pTap++ )
+				{
+					float	H = SampleHeightWrap( Plane, X + pTap->dX, Y + pTap->dY );
+					MaxSlope = MAX( MaxSlope, pTap->SlopeFactor * H );
+				}
+				*pMaxSlope = MaxSlope;
+			}
+		}
+	}
+}
+
+void	ComputeAOFastRows( int _Y0, int _Y1, void* _pData )
+{
+	__AOFastStruct&	Params = *((__AOFastStruct*) _pData);
+
+	float	pMaxSlopes[4];
+	float	pSumAO[4];
+	float	Normalizer = 1.0f / (HALFPI * Params.DirectionsCount);
+
+	for ( int Y=_Y0; Y < _Y1; Y++ )
+	{
+		const float*	pRow = Params.pPlane + Params.PlaneWidth * (Params.Pad + Y) + Params.Pad;
+		Pixel*			pScanline = Params.pTarget + Params.W * Y;
+
+		for ( int X=0; X < Params.W; X+=4 )
+		{
+			pSumAO[0] = pSumAO[1] = pSumAO[2] = pSumAO[3] = 0.0f;
+
+			const __AOTap*	pTap = Params.pTaps;
+			for ( int DirectionIndex=0; DirectionIndex < Params.DirectionsCount; DirectionIndex++ )
+			{
+				// March the 4 pixels at once
+				__m128	MaxSlope = _mm_setzero_ps();
+				for ( int SampleIndex=0; SampleIndex < Params.SamplesCount; SampleIndex++, pTap++ )
+				{
+					const float*	p0 = pRow + X + pTap->Offset;
+					const float*	p1 = p0 + Params.PlaneWidth;
+
+					__m128	H = _mm_mul_ps( _mm_loadu_ps( p0 ), _mm_set1_ps( pTap->W00 ) );
+							H = _mm_add_ps( H, _mm_mul_ps( _mm_loadu_ps( p0+1 ), _mm_set1_ps( pTap->W01 ) ) );
+							H = _mm_add_ps( H, _mm_mul_ps( _mm_loadu_ps( p1 ), _mm_set1_ps( pTap->W10 ) ) );
+							H = _mm_add_ps( H, _mm_mul_ps( _mm_loadu_ps( p1+1 ), _mm_set1_ps( pTap->W11 ) ) );
+
+					MaxSlope = _mm_max_ps( MaxSlope, _mm_mul_ps( H, _mm_set1_ps( pTap->SlopeFactor ) ) );
+				}
+				_mm_storeu_ps( pMaxSlopes, MaxSlope );
+
+				// Continue the march into the coarse levels
+				for ( int LevelIndex=0; LevelIndex < Params.CoarseLevelsCount; LevelIndex++ )
+				{
+					const __AOCoarsePlane&	Plane = Params.pCoarsePlanes[LevelIndex];
+					const float*			pCoarseSlopes = Plane.pMaxSlopes + Params.DirectionsCount * Plane.W * MIN( Y >> Plane.Shift, Plane.H-1 ) + DirectionIndex;
+					for ( int i=0; i < 4; i++ )
+						pMaxSlopes[i] = MAX( pMaxSlopes[i], pCoarseSlopes[Params.DirectionsCount * MIN( (X+i) >> Plane.Shift, Plane.W-1 )] );
+				}
+
+				// Accumulate visibility
+				for ( int i=0; i < 4; i++ )
+					pSumAO[i] += HALFPI - atanf( pMaxSlopes[i] );
+			}
+
+			int	Count = MIN( 4, Params.W - X );
+			for ( int i=0; i < Count; i++ )
+			{
+				float	AO = pSumAO[i] * Normalizer;
+				Pixel&	P = pScanline[X+i];
+				if ( Params.bWriteOnlyAlpha )
+					P.RGBA.w = AO;
+				else
+					P.RGBA.Set( AO, AO, AO, AO );
+			}
+		}
+	}
+}
+
+void Generators::ComputeAOFast( const TextureBuilder& _Source, TextureBuilder& _Target, float _HeightFactor, int _DirectionsCount, int _SamplesCount, bool _bWriteOnlyAlpha, int _CoarseLevelsCount )
+{
+	ASSERT( _Source.GetWidth() == _Target.GetWidth() && _Source.GetHeight() == _Target.GetHeight(), "Source and target must have the same size!" );
+
+	__AOFastStruct	Params;
+	Params.pSource = _Source.GetMip( 0 );
+	Params.pTarget = _Target.GetMips()[0];
+	Params.W = _Source.GetWidth();
+	Params.H = _Source.GetHeight();
+	Params.DirectionsCount = _DirectionsCount;
+	Params.SamplesCount = _SamplesCount;
+	Params.bWriteOnlyAlpha = _bWriteOnlyAlpha;
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build the padded height plane
+	int	W = Params.W;
+	int	H = Params.H;
+	int	W4 = (W + 3) & ~3;		// We always march 4 pixels at once
+
+	Params.Pad = _SamplesCount + 2;
+	Params.PlaneWidth = W4 + 2 * Params.Pad;
+	int		PlaneHeight = H + 2 * Params.Pad;
+	Params.pPlane = new float[Params.PlaneWidth * PlaneHeight];
+
+	float*	pPlane = Params.pPlane;
+	for ( int Y=0; Y < PlaneHeight; Y++ )
+	{
+		int				SourceY = (((Y - Params.Pad) % H) + H) % H;
+		const Pixel*	pScanline = Params.pSource + W * SourceY;
+		for ( int X=0; X < Params.PlaneWidth; X++ )
+		{
+			int	SourceX = (((X - Params.Pad) % W) + W) % W;
+			*pPlane++ = pScanline[SourceX].Height;
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build the direction taps
+	Params.pTaps = new __AOTap[_DirectionsCount * _SamplesCount];
+	__AOTap*	pTap = Params.pTaps;
+	for ( int DirectionIndex=0; DirectionIndex < _DirectionsCount; DirectionIndex++ )
+	{
+		float	Angle = TWOPI * DirectionIndex / _DirectionsCount;
+		float2	Direction( cosf( Angle ), sinf( Angle ) );
+
+		for ( int SampleIndex=0; SampleIndex < _SamplesCount; SampleIndex++, pTap++ )
+		{
+			float	Distance = 1.0f + SampleIndex;
+			float	dX = Distance * Direction.x;
+			float	dY = Distance * Direction.y;
+			int		X0 = floorf( dX );
+			int		Y0 = floorf( dY );
+			float	x = dX - X0;
+			float	y = dY - Y0;
+
+			pTap->Offset = Params.PlaneWidth * Y0 + X0;
+			pTap->W00 = (1.0f - x) * (1.0f - y);
+			pTap->W01 = x * (1.0f - y);
+			pTap->W10 = (1.0f - x) * y;
+			pTap->W11 = x * y;
+			pTap->SlopeFactor = _HeightFactor / Distance;
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Build the coarse levels
+	Params.CoarseLevelsCount = _CoarseLevelsCount;
+	Params.CoarseSamplesCount = MAX( 1, _SamplesCount >> 1 );	// Level L marches SamplesCount/2 steps of 2^(L+1) pixels, starting where the previous level stopped
+	Params.pCoarsePlanes = NULL;
+	if ( _CoarseLevelsCount > 0 )
+	{
+		Params.pCoarsePlanes = new __AOCoarsePlane[_CoarseLevelsCount];
+
+		// Downsample the height plane
+		const float*	pSource = NULL;
+		int				SourceW = W, SourceH = H;
+		for ( int LevelIndex=0; LevelIndex < _CoarseLevelsCount; LevelIndex++ )
+		{
+			__AOCoarsePlane&	Plane = Params.pCoarsePlanes[LevelIndex];
+			Plane.W = MAX( 1, SourceW >> 1 );
+			Plane.H = MAX( 1, SourceH >> 1 );
+			Plane.Shift = 1 + LevelIndex;
+			Plane.pHeights = new float[Plane.W * Plane.H];
+			Plane.pMaxSlopes = new float[_DirectionsCount * Plane.W * Plane.H];
+			Plane.pTaps = new __AOCoarseTap[_DirectionsCount * Params.CoarseSamplesCount];
+
+			float*	pTarget = Plane.pHeights;
+			for ( int Y=0; Y < Plane.H; Y++ )
+			{
+				int	Y0 = (2*Y) % SourceH;
+				int	Y1 = (2*Y+1) % SourceH;
+				for ( int X=0; X < Plane.W; X++ )
+				{
+					int	X0 = (2*X) % SourceW;
+					int	X1 = (2*X+1) % SourceW;
+					if ( pSource == NULL )
+					{	// Read from the padded plane
+						const float*	pRow0 = Params.pPlane + Params.PlaneWidth * (Params.Pad + Y0) + Params.Pad;
+						const float*	pRow1 = Params.pPlane + Params.PlaneWidth * (Params.Pad + Y1) + Params.Pad;
+						*pTarget++ = 0.25f * (pRow0[X0] + pRow0[X1] + pRow1[X0] + pRow1[X1]);
+					}
+					else
+						*pTarget++ = 0.25f * (pSource[SourceW*Y0+X0] + pSource[SourceW*Y0+X1] + pSource[SourceW*Y1+X0] + pSource[SourceW*Y1+X1]);
+				}
+			}
+
+			pSource = Plane.pHeights;
+			SourceW = Plane.W;
+			SourceH = Plane.H;
+		}
+
+		// Build the taps & march each level at its own resolution
+		for ( int LevelIndex=0; LevelIndex < _CoarseLevelsCount; LevelIndex++ )
+		{
+			__AOCoarsePlane&	Plane = Params.pCoarsePlanes[LevelIndex];
+			float	Step = float(1 << Plane.Shift);
+			float	InvScale = 1.0f / Step;
+
+			__AOCoarseTap*	pCoarseTap = Plane.pTaps;
+			for ( int DirectionIndex=0; DirectionIndex < _DirectionsCount; DirectionIndex++ )
+			{
+				float	Angle = TWOPI * DirectionIndex / _DirectionsCount;
+				float2	Direction( cosf( Angle ), sinf( Angle ) );
+
+				float	Distance = _SamplesCount * 0.5f * Step;	// Where the previous level stopped
+				for ( int SampleIndex=0; SampleIndex < Params.CoarseSamplesCount; SampleIndex++, pCoarseTap++ )
+				{
+					Distance += Step;
+					pCoarseTap->dX = Distance * Direction.x * InvScale;
+					pCoarseTap->dY = Distance * Direction.y * InvScale;
+					pCoarseTap->SlopeFactor = _HeightFactor / Distance;
+				}
+			}
+
+			Params.CurrentCoarseLevel = LevelIndex;
+			TextureBuilder::ParallelRows( Plane.H, ComputeAOCoarseRows, &Params );
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// March!
+	TextureBuilder::ParallelRows( H, ComputeAOFastRows, &Params );
+	_Target.InvalidateMips();
+
+	for ( int LevelIndex=0; LevelIndex < Params.CoarseLevelsCount; LevelIndex++ )
+	{
+		delete[] Params.pCoarsePlanes[LevelIndex].pTaps;
+		delete[] Params.pCoarsePlanes[LevelIndex].pMaxSlopes;
+		delete[] Params.pCoarsePlanes[LevelIndex].pHeights;
+	}
+	delete[] Params.pCoarsePlanes;
+	delete[] Params.pTaps;
+	delete[] Params.pPlane;
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 // Dirtyness
+// Each pixel only depends on the pixel above it so the generator runs as a wavefront over blocks of columns.
+// To stay byte-identical to the original serial Fill() that was sampling the builder in place, we replicate the exact bilinear
+//	arithmetic of SampleWrap() (whose weights are always 0 or 1) on the exact same values the serial version was reading:
+//	_ Row Y-1 is final, except for row 0 that reads the seed (i.e. the original content of the last row)
+//	_ Row Y is still the original content, except for pixel (0,Y) that was already overwritten when reading it wrapped from (W-1,Y)
+// A block reads its own pixels before overwriting them but the pixels following the block belong to the next block, which may already
+//	be done with the row. So each block grabs their original content while it's processing the previous row (the next block can't start
+//	a row before we're done with the previous one), except for row 0 that is kept aside before the wavefront starts.
+//
 struct __DirtynessStruct
 {
-	TextureBuilder*	pBuilder;
+	Pixel*			pTarget;
+	int				W, H;
+	float4			Seed;				// Content of the last row before the fill, read by row 0
+	float4*			pFirstRow;			// Content of row 0 before the fill
+	float4*			pBlocksNextPixels;	// 2 per block: original content of the 2 (wrapped) pixels that follow the block on the row it's processing
 	const Noise*	pNoise;
 	float			DirtNoiseFrequency;
 	float			DirtAmplitude;
 	float			PullBackForce;
 	float			AverageIntensity;
 };
-void	FillDirtyness( int _X, int _Y, const float2& _UV, Pixel& _Pixel, void* _pData )
+
+// Computes the value of pixel (X,Y) given the 4 values SampleWrap() would have read
+float4	ComputeDirtyness( const __DirtynessStruct& _Params, int _X, int _Y, const float4& _V00, const float4& _V01, const float4& _V10, const float4& _V11 )
 {
-	__DirtynessStruct&	Params = *((__DirtynessStruct*) _pData);
+	// Same as SampleWrap( _X+0.0f, _Y-1.0f )
+	float	fX = _X+0.0f;
+	float	fY = _Y-1.0f;
+	int		X0 = floorf( fX );
+	float	x = fX - X0;
+	float	rx = 1.0f - x;
+	int		Y0 = floorf( fY );
+	float	y = fY - Y0;
+	float	ry = 1.0f - y;
+
+	float4	V0 = rx * _V00 + x * _V01;
+	float4	V1 = rx * _V10 + x * _V11;
 
-	Pixel	P[3];
-	Params.pBuilder->SampleWrap( _X-1.0f, _Y-1.0f, 0, P[0] );
-	Params.pBuilder->SampleWrap( _X+0.0f, _Y-1.0f, 0, P[1] );
-	Params.pBuilder->SampleWrap( _X+1.0f, _Y-1.0f, 0, P[2] );
+	float4	F;
+	F.x = ry * V0.x + y * V1.x;
+	F.y = ry * V0.y + y * V1.y;
+	F.z = ry * V0.z + y * V1.z;
+	F.w = ry * V0.w + y * V1.w;
+
+	// Same as Fill()
+	float2	UV;
+	UV.y = float(_Y) / _Params.H;
+	UV.x = float(_X) / _Params.W;
 
 //	NjFloat4	F = C[0] + C[2] - C[1];	// Some sort of average
 //	NjFloat4	F = 0.333f * (C[0] + C[2] + C[1]);
-	float4	F = P[1].RGBA;
-	float		fOffset = Params.DirtAmplitude * Params.pNoise->Perlin( Params.DirtNoiseFrequency * _UV ) + F.w;
+	float		fOffset = _Params.DirtAmplitude * _Params.pNoise->Perlin( _Params.DirtNoiseFrequency * UV ) + F.w;
 
 	F.x += fOffset;
 	F.y += fOffset;
 	F.z += fOffset;
-	F.w = Params.PullBackForce * (Params.AverageIntensity - (F | LUMINANCE));	// Will yield -1 when F reaches the average intensity so the color is always somewhat brought back to average
+	F.w = _Params.PullBackForce * (_Params.AverageIntensity - (F | LUMINANCE));	// Will yield -1 when F reaches the average intensity so the color is always somewhat brought back to average
 
-	_Pixel.RGBA = F;
+	return F;
+}
+
+void	FillDirtynessRow( int _Y, int _X0, int _X1, int _BlockIndex, void* _pData )
+{
+	__DirtynessStruct&	Params = *((__DirtynessStruct*) _pData);
+
+	int			W = Params.W;
+	Pixel*		pScanline = Params.pTarget + W * _Y;
+	float4*		pNextPixels = Params.pBlocksNextPixels + 2*_BlockIndex;
+	if ( _Y == 0 )
+	{
+		pNextPixels[0] = Params.pFirstRow[_X1 % W];
+		pNextPixels[1] = Params.pFirstRow[(_X1+1) % W];
+	}
+
+	// Previous row is final, except for row 0 that wraps to the seed
+	const Pixel*	pScanlinePrevious = Params.pTarget + W * (_Y-1);
+	#define PREVIOUS( X )	(_Y > 0 ? pScanlinePrevious[X].RGBA : Params.Seed)
+
+	for ( int X=_X0; X < _X1; X++ )
+	{
+		int		X1 = X+1 < W ? X+1 : 0;
+		float4	V10 = pScanline[X].RGBA;	// Not overwritten yet
+		float4	V11;
+		if ( X1 > 0 )
+			V11 = X1 < _X1 ? pScanline[X1].RGBA : pNextPixels[0];
+		else if ( _X0 == 0 )
+			V11 = pScanline[0].RGBA;	// Already computed by ourselves
+		else	// Pixel (0,Y) belongs to another block: recompute it (its inputs are available as our neighbor block finished the previous row)
+			V11 = ComputeDirtyness( Params, 0, _Y, PREVIOUS( 0 ), PREVIOUS( 1 % W ), pNextPixels[0], pNextPixels[1] );
+
+		pScanline[X].RGBA = ComputeDirtyness( Params, X, _Y, PREVIOUS( X ), PREVIOUS( X1 ), V10, V11 );
+	}
+
+	#undef PREVIOUS
+
+	// Grab the pixels following the block on the next row while the next block still can't touch them
+	if ( _Y+1 < Params.H )
+	{
+		const Pixel*	pScanlineNext = pScanline + W;
+		pNextPixels[0] = pScanlineNext[_X1 % W].RGBA;
+		pNextPixels[1] = pScanlineNext[(_X1+1) % W].RGBA;
+	}
 }
 
 void	Generators::Dirtyness( TextureBuilder& _Builder, const Noise& _Noise, float _InitialIntensity, float _AverageIntensity, float _DirtNoiseFrequency, float _DirtAmplitude, float _PullBackForce )
 {
+	int	W = _Builder.GetWidth();
+	int	H = _Builder.GetHeight();
+
 	__DirtynessStruct	Params;
-	Params.pBuilder = &_Builder;
+	Params.pTarget = _Builder.GetMips()[0];
+	Params.W = W;
+	Params.H = H;
 	Params.pNoise = &_Noise;
 	Params.DirtNoiseFrequency = _DirtNoiseFrequency;
 	Params.DirtAmplitude = _DirtAmplitude;
@@ -155,24 +753,117 @@ void	Generators::Dirtyness( TextureBuilder& _Builder, const Noise& _Noise, float
 	Params.AverageIntensity = _AverageIntensity;
 
 	// Setup last line used as initial seed
-	for ( int X=0; X < _Builder.GetWidth(); X++ )
+	for ( int X=0; X < W; X++ )
 	{
-		Pixel&	P = _Builder.GetMips()[0][_Builder.GetWidth() * (_Builder.GetHeight()-1) + X];
+		Pixel&	P = Params.pTarget[W * (H-1) + X];
 //		float	InitialValue = _AverageIntensity + abs( _Noise.Perlin( NjFloat2( _InitNoiseFrequency * float(X) / _Builder.GetWidth(), 0.0f ) ) );
 		float	InitialValue = _InitialIntensity;
 		P.RGBA.Set( InitialValue, InitialValue, InitialValue, 0.0f );
 	}
 
-	_Builder.Fill( FillDirtyness, &Params );
+	Params.Seed.Set( _InitialIntensity, _InitialIntensity, _InitialIntensity, 0.0f );
+
+	// Keep the original content of the first row
+	Params.pFirstRow = new float4[W];
+	for ( int X=0; X < W; X++ )
+		Params.pFirstRow[X] = Params.pTarget[X].RGBA;
+	Params.pBlocksNextPixels = new float4[2*TextureBuilder::ComputeWavefrontBlocksCount( W )];
+
+	TextureBuilder::ParallelWavefront( W, H, FillDirtynessRow, &Params );
+	_Builder.InvalidateMips();
+
+	delete[] Params.pBlocksNextPixels;
+	delete[] Params.pFirstRow;
 }
 
 //////////////////////////////////////////////////////////////////////////
 // Secret marble recipe
+// Each line depends on the previous one (wrapped) so the generator runs as a wavefront over blocks of columns.
+// The random generator is sequential in scanline order but we can jump directly to the value of any pixel using
+//	the LCG skip-ahead trick so the generated values are byte-identical to the original serial version.
+//
 U32	LCGRandom( U32& _LastValue )
 {
 	return _LastValue = U32( (1103515245u * _LastValue + 12345u) );
 }
 
+// Returns the value of the generator after _StepsCount calls to LCGRandom() (in O(log(_StepsCount)))
+U32	LCGSkip( U32 _Seed, U32 _StepsCount )
+{
+	U32	Mul = 1, Add = 0;
+	U32	StepMul = 1103515245u, StepAdd = 12345u;
+	while ( _StepsCount > 0 )
+	{
+		if ( _StepsCount & 1 )
+		{
+			Mul *= StepMul;
+			Add = Add * StepMul + StepAdd;
+		}
+		StepAdd = (StepMul + 1) * StepAdd;
+		StepMul *= StepMul;
+		_StepsCount >>= 1;
+	}
+	return Mul * _Seed + Add;
+}
+
+struct __MarbleBlock
+{
+	float	Min, Max;
+	U32		MinIndex, MaxIndex;	// Scanline index of the last pixel that reached the min/max
+};
+
+struct __MarbleGenerateStruct
+{
+	float*	pBuffer;
+	int		W;
+	float	NoiseAmplitude;
+	float	Weight0, Weight1, Weight2;
+	float	WeightsNormalizer;
+	__MarbleBlock*	pBlocks;
+};
+
+void	GenerateMarbleRow( int _Y, int _X0, int _X1, int _BlockIndex, void* _pData )
+{
+	__MarbleGenerateStruct&	Params = *((__MarbleGenerateStruct*) _pData);
+
+	int		Y = 2 + _Y;	// We skip the first 2 lines
+	int		W = Params.W;
+	U32		RandomSeed = LCGSkip( 1, U32(W * _Y + _X0) );
+
+	__MarbleBlock&	Block = Params.pBlocks[_BlockIndex];
+	float*	pSource = &Params.pBuffer[W*(Y-1)];
+	float*	pTarget = &Params.pBuffer[W*Y+_X0];
+	for ( int X=_X0; X < _X1; X++ )
+	{
+		LCGRandom( RandomSeed );
+		float	RandomColor = RandomSeed / 2147483648.0f - 1.0f;
+
+		float	C0 = pSource[(X+W-1) % W];
+		float	C1 = pSource[X];
+		float	C2 = pSource[(X+1) % W];
+
+		float	C = Params.WeightsNormalizer * (Params.Weight0 * C0 + Params.Weight1 * C1 + Params.Weight2 * C2);
+				C += Params.NoiseAmplitude * RandomColor;
+
+		C = fmodf( C, 1.0f );
+
+		// Same as Min = MIN( Min, C ) & Max = MAX( Max, C ) but keeping track of which pixel won, so blocks can be merged exactly as the serial version would have
+		U32	Index = U32(W * _Y + X);
+		if ( !(Block.Min < C) )
+		{
+			Block.Min = C;
+			Block.MinIndex = Index;
+		}
+		if ( !(Block.Max > C) )
+		{
+			Block.Max = C;
+			Block.MaxIndex = Index;
+		}
+
+		*pTarget++ = C;
+	}
+}
+
 struct __MarbleStruct
 {
 	U32		Width;
@@ -200,31 +891,44 @@ void	Generators::Marble( TextureBuilder& _Builder, float _HeightFactor, int _Boo
 	float*	pBuffer = new float[W*H];
 
 	// Fill up the first N lines
-	U32		RandomSeed = 1;
-	float	Min = FLOAT32_MAX, Max = -FLOAT32_MAX;
-	float*	pTarget = pBuffer + 2*W;
-	for ( int Y=2; Y < H; Y++ )
-	{
-		float*	pSource = &pBuffer[W*(Y-1)];
-		for ( int X=0; X < W; X++ )
-		{
-			LCGRandom( RandomSeed );
-			float	RandomColor = RandomSeed / 2147483648.0f - 1.0f;
-
-			float	C0 = pSource[(X+W-1) % W];
-			float	C1 = pSource[X];
-			float	C2 = pSource[(X+1) % W];
+	__MarbleGenerateStruct	Generate;
+	Generate.pBuffer = pBuffer;
+	Generate.W = W;
+	Generate.NoiseAmplitude = _NoiseAmplitude;
+	Generate.Weight0 = _Weight0;
+	Generate.Weight1 = _Weight1;
+	Generate.Weight2 = _Weight2;
+	Generate.WeightsNormalizer = _WeightsNormalizer;
 
-			float	C = _WeightsNormalizer * (_Weight0 * C0 + _Weight1 * C1 + _Weight2 * C2);
-					C += _NoiseAmplitude * RandomColor;
+	int	BlocksCount = TextureBuilder::ComputeWavefrontBlocksCount( W );
+	Generate.pBlocks = new __MarbleBlock[BlocksCount];
+	for ( int BlockIndex=0; BlockIndex < BlocksCount; BlockIndex++ )
+	{
+		Generate.pBlocks[BlockIndex].Min = FLOAT32_MAX;
+		Generate.pBlocks[BlockIndex].Max = -FLOAT32_MAX;
+		Generate.pBlocks[BlockIndex].MinIndex = Generate.pBlocks[BlockIndex].MaxIndex = 0;
+	}
 
-			C = fmodf( C, 1.0f );
-			Min = MIN( Min, C );
-			Max = MAX( Max, C );
+	TextureBuilder::ParallelWavefront( W, H-2, GenerateMarbleRow, &Generate );
 
-			*pTarget++ = C;
+	// Merge blocks: on equality, the serial version would have kept the last pixel in scanline order
+	float	Min = FLOAT32_MAX, Max = -FLOAT32_MAX;
+	U32		MinIndex = 0, MaxIndex = 0;
+	for ( int BlockIndex=0; BlockIndex < BlocksCount; BlockIndex++ )
+	{
+		__MarbleBlock&	Block = Generate.pBlocks[BlockIndex];
+		if ( Block.Min < Min || (Block.Min == Min && Block.MinIndex > MinIndex) )
+		{
+			Min = Block.Min;
+			MinIndex = Block.MinIndex;
+		}
+		if ( Block.Max > Max || (Block.Max == Max && Block.MaxIndex > MaxIndex) )
+		{
+			Max = Block.Max;
+			MaxIndex = Block.MaxIndex;
 		}
 	}
+	delete[] Generate.pBlocks;
 
 	// Renormalize
 	__MarbleStruct	Params;
@@ -10,9 +10,25 @@ public:		// METHODS
 	// Computes the normal from a source texture's height field
 	static void ComputeNormal( const TextureBuilder& _Source, TextureBuilder& _Target, float _HeightFactor=1.0f, bool _bNormalize=true );
 
+	// Fast version of ComputeNormal() that runs a 3x3 stencil directly over rolling row buffers of heights, 4 pixels at once using SSE
+	//	_bWrap, true to wrap the borders, false to clamp them
+	//	_bSobel, true to use a Sobel stencil instead of the central differences used by ComputeNormal()
+	static void ComputeNormalFast( const TextureBuilder& _Source, TextureBuilder& _Target, float _HeightFactor=1.0f, bool _bNormalize=true, bool _bWrap=true, bool _bSobel=false );
+
+	// Same as ComputeNormalFast() but directly writes the packed normal (i.e. (1+N)/2) in XYZ and the height in W into a buffer of the given pixel format
+	//	_MipLevel, the mip of the source whose heights are used (the height factor should be scaled by the mip's size relative to the mip 0)
+	//	_pTarget must be large enough to hold the pixels of the source mip in the given format
+	static void ComputeNormalPacked( const TextureBuilder& _Source, int _MipLevel, const IPixelFormatDescriptor& _Format, void* _pTarget, float _HeightFactor=1.0f, bool _bNormalize=true, bool _bWrap=true, bool _bSobel=false );
+
 	// Computes the ambient occlusion from a source texture's height field
 	static void ComputeAO( const TextureBuilder& _Source, TextureBuilder& _Target, float _HeightFactor=1.0f, int _DirectionsCount=8, int _SamplesCount=8, bool _bWriteOnlyAlpha=false );
 
+	// Same as ComputeAO() but much faster: directions & bilinear weights are precomputed once, the height plane is read directly,
+	//	4 neighbor pixels are marched at once using SSE and bands of rows are computed in parallel
+	//	_CoarseLevelsCount, if > 0, the march is continued into that many coarser height mips (each level doubles the marching distance for half the samples)
+	// NOTE: Source and target must have the same size
+	static void ComputeAOFast( const TextureBuilder& _Source, TextureBuilder& _Target, float _HeightFactor=1.0f, int _DirectionsCount=8, int _SamplesCount=8, bool _bWriteOnlyAlpha=false, int _CoarseLevelsCount=0 );
+
 	// Fills a texture with dirtyness/moss/mouldiness leaking from the top of the texture
 	//	_InitialIntensity, intensity for initialization
 	//	_AverageIntensity, the average intensity of dirtyness
@@ -1,7 +1,8 @@
 #include "../GodComplex.h"
 
-#define VWRITE( pVertex, P, N, T, B, UV )	AppendVertex( _Writer, pVertex, P, N, T, B, UV, _TweakVertex, _pUserData );	VerticesCount--
-#define IWRITE( pIndex, i )					_Writer.AppendIndex( pIndex, i );	IndicesCount--
+// Vertices are generated a whole band at a time in a local buffer, then mapped, tweaked and sent to the writer in a single call
+#define BWRITE( pVertex, pBand, Count )		WriteBand( _Writer, pVertex, pBand, Count, _TweakVertex, _pUserData );	VerticesCount -= Count
+#define IWRITE( pIndex, i )					*pIndex++ = U32(i);	IndicesCount--
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -16,113 +17,127 @@ void	GeometryBuilder::BuildSphere( int _PhiSubdivisions, int _ThetaSubdivisions,
 
 	// Create the buffers
 	void*	pVerticesArray = NULL;
-	void*	pIndicesArray = NULL;
+	U32*	pIndicesArray = NULL;
 	_Writer.CreateBuffers( VerticesCount, IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, pVerticesArray, pIndicesArray );
 	ASSERT( pVerticesArray != NULL, "Invalid vertex buffer !" );
 	ASSERT( pIndicesArray != NULL, "Invalid index buffer !" );
 
 	void*		pVertex = pVerticesArray;
-	void*		pIndex = pIndicesArray;
+	U32*		pIndex = pIndicesArray;
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build vertices
-	float3	Position, Normal, Tangent, BiTangent;
-	float2	UV;
+	Vertex*	pBand = new Vertex[BandLength+1];
 
 	// Top band
 	{
 		for ( int i=0; i <= BandLength; i++ )
 		{
+			Vertex&	V = pBand[i];
+
 			float	Phi = TWOPI * i / BandLength;
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
+			V.Tangent.x = cosf( Phi );
+			V.Tangent.y = 0.0f;
+			V.Tangent.z = -sinf( Phi );
 
 			// Create a dummy position that is slightly offseted from the top of the sphere so UVs are not all identical
-			Position.y = 1.0f;
-			Position.x = -0.001f * Tangent.z;
-			Position.z = 0.001f * Tangent.x;
-//			Position.Normalize();
-			Normal = Position;	Normal.Normalize();
+			V.Position.y = 1.0f;
+			V.Position.x = -0.001f * V.Tangent.z;
+			V.Position.z = 0.001f * V.Tangent.x;
+			V.Normal = V.Position;	V.Normal.Normalize();
 
-			BiTangent = Normal ^ Tangent;
+			V.BiTangent = V.Normal ^ V.Tangent;
 
-			// Ask for UVs
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == BandLength );
-			else
-				UV.Set( 2.0f * float(i) / BandLength, 0.0f );
+			if ( _pMapper == NULL )
+				V.UV.Set( 2.0f * float(i) / BandLength, 0.0f );
+		}
 
-			Position.x = Position.z = 0.0f;
+		// Ask for UVs
+		if ( _pMapper )
+			_pMapper->MapBand( BandLength+1, pBand, true );
 
-			// Write vertex
-			VWRITE( pVertex, float3::UnitY, float3::UnitY, Tangent, BiTangent, UV );
-		}
+		for ( int i=0; i <= BandLength; i++ )
+			pBand[i].Position = pBand[i].Normal = float3::UnitY;
+
+		// Write vertices
+		BWRITE( pVertex, pBand, BandLength+1 );
 	}
 
 	// Generic bands
 	for ( int j=0; j < _ThetaSubdivisions; j++ )
 	{
 		float	Theta = PI * (1+j) / (1 + _ThetaSubdivisions);
+		float	SinTheta = sinf( Theta );
+		float	CosTheta = cosf( Theta );
 		for ( int i=0; i <= BandLength; i++ )
 		{
-			float	Phi = TWOPI * i / BandLength;
+			Vertex&	V = pBand[i];
 
-			Position.x = sinf( Phi ) * sinf( Theta );
-			Position.y = cosf( Theta );
-			Position.z = cosf( Phi ) * sinf( Theta );
+			float	Phi = TWOPI * i / BandLength;
+			float	SinPhi = sinf( Phi );
+			float	CosPhi = cosf( Phi );
 
-			Normal = Position;
+			V.Position.x = SinPhi * SinTheta;
+			V.Position.y = CosTheta;
+			V.Position.z = CosPhi * SinTheta;
 
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
+			V.Normal = V.Position;
 
-			BiTangent = Normal ^ Tangent;
+			V.Tangent.x = CosPhi;
+			V.Tangent.y = 0.0f;
+			V.Tangent.z = -SinPhi;
 
-			// Ask for UVs
-			if (_pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == BandLength );
-			else
-				UV.Set( 2.0f * float(i) / BandLength, float(j) / _ThetaSubdivisions );
+			V.BiTangent = V.Normal ^ V.Tangent;
 
-			// Write vertex
-			VWRITE( pVertex, Position, Normal, Tangent, BiTangent, UV );
+			if ( _pMapper == NULL )
+				V.UV.Set( 2.0f * float(i) / BandLength, float(j) / _ThetaSubdivisions );
 		}
+
+		// Ask for UVs
+		if ( _pMapper )
+			_pMapper->MapBand( BandLength+1, pBand, true );
+
+		// Write vertices
+		BWRITE( pVertex, pBand, BandLength+1 );
 	}
 
 	// Bottom band
 	{
 		for ( int i=0; i <= BandLength; i++ )
 		{
+			Vertex&	V = pBand[i];
+
 			float	Phi = TWOPI * i / BandLength;
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
+			V.Tangent.x = cosf( Phi );
+			V.Tangent.y = 0.0f;
+			V.Tangent.z = -sinf( Phi );
 
 			// Create a dummy position that is slightly offseted from the bottom of the sphere so UVs are not all identical
-			Position.y = -1.0f;
-			Position.x = -0.001f * Tangent.z;
-			Position.z = 0.001f * Tangent.x;
-//			Position.Normalize();
-			Normal = Position;	Normal.Normalize();
+			V.Position.y = -1.0f;
+			V.Position.x = -0.001f * V.Tangent.z;
+			V.Position.z = 0.001f * V.Tangent.x;
+			V.Normal = V.Position;	V.Normal.Normalize();
 
-			BiTangent = Normal ^ Tangent;
+			V.BiTangent = V.Normal ^ V.Tangent;
 
-			// Ask for UVs
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == BandLength );
-			else
-				UV.Set( 2.0f * float(i) / BandLength, 1.0f );
+			if ( _pMapper == NULL )
+				V.UV.Set( 2.0f * float(i) / BandLength, 1.0f );
+		}
 
-			Position.x = Position.z = 0.0f;
+		// Ask for UVs
+		if ( _pMapper )
+			_pMapper->MapBand( BandLength+1, pBand, true );
 
-			// Write vertex
-			VWRITE( pVertex, -float3::UnitY, -float3::UnitY, Tangent, BiTangent, UV );
-		}
+		for ( int i=0; i <= BandLength; i++ )
+			pBand[i].Position = pBand[i].Normal = -float3::UnitY;
+
+		// Write vertices
+		BWRITE( pVertex, pBand, BandLength+1 );
 	}
 	ASSERT( VerticesCount == 0, "Wrong contruction!" );
 
+	delete[] pBand;
+
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build indices
@@ -164,48 +179,51 @@ void	GeometryBuilder::BuildCylinder( int _RadialSubdivisions, int _VerticalSubdi
 
 	// Create the buffers
 	void*	pVerticesArray = NULL;
-	void*	pIndicesArray = NULL;
+	U32*	pIndicesArray = NULL;
 	_Writer.CreateBuffers( VerticesCount, IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, pVerticesArray, pIndicesArray );
 	ASSERT( pVerticesArray != NULL, "Invalid vertex buffer !" );
 	ASSERT( pIndicesArray != NULL, "Invalid index buffer !" );
 
 	void*		pVertex = pVerticesArray;
-	void*		pIndex = pIndicesArray;
+	U32*		pIndex = pIndicesArray;
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build vertices
-	float3	Position, Normal, Tangent, BiTangent;
-	float2	UV;
+	Vertex*	pBand = new Vertex[BandLength];
 
 	// Top vertices
 	if ( _bIncludeCaps )
 	{
 		for ( int i=0; i <= _RadialSubdivisions; i++ )
 		{
+			Vertex&	V = pBand[i];
+
 			float	Phi = TWOPI * i / _RadialSubdivisions;
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
+			V.Tangent.x = cosf( Phi );
+			V.Tangent.y = 0.0f;
+			V.Tangent.z = -sinf( Phi );
 
 			// Create a dummy position that is slightly offseted from the top of the sphere so UVs are not all identical
-			Position.y = 1.0f;
-			Position.x = -0.001f * Tangent.z;
-			Position.z = 0.001f * Tangent.x;
-			Normal = float3::UnitY;
+			V.Position.y = 1.0f;
+			V.Position.x = -0.001f * V.Tangent.z;
+			V.Position.z = 0.001f * V.Tangent.x;
+			V.Normal = float3::UnitY;
 
-			BiTangent = Normal ^ Tangent;
+			V.BiTangent = V.Normal ^ V.Tangent;
 
-			// Ask for UVs
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == _RadialSubdivisions );
-			else
-				UV.Set( 2.0f * float(i) / _RadialSubdivisions, 0.0f );
+			if ( _pMapper == NULL )
+				V.UV.Set( 2.0f * float(i) / _RadialSubdivisions, 0.0f );
+		}
 
-			Position.x = Position.z = 0.0f;
+		// Ask for UVs
+		if ( _pMapper )
+			_pMapper->MapBand( BandLength, pBand, true );
 
-			// Write vertex
-			VWRITE( pVertex, float3::UnitY, float3::UnitY, Tangent, BiTangent, UV );
-		}
+		for ( int i=0; i <= _RadialSubdivisions; i++ )
+			pBand[i].Position = float3::UnitY;
+
+		// Write vertices
+		BWRITE( pVertex, pBand, BandLength );
 	}
 
 	// Generic bands
@@ -214,31 +232,36 @@ void	GeometryBuilder::BuildCylinder( int _RadialSubdivisions, int _VerticalSubdi
 		float	Y = 1.0f - 2.0f * j / _VerticalSubdivisions;
 		for ( int i=0; i <= _RadialSubdivisions; i++ )
 		{
-			float	Phi = TWOPI * i / _RadialSubdivisions;
+			Vertex&	V = pBand[i];
 
-			Position.x = sinf( Phi );
-			Position.y = Y;
-			Position.z = cosf( Phi );
+			float	Phi = TWOPI * i / _RadialSubdivisions;
+			float	SinPhi = sinf( Phi );
+			float	CosPhi = cosf( Phi );
 
-			Normal.x = sinf( Phi );
-			Normal.y = 0;
-			Normal.z = cosf( Phi );
+			V.Position.x = SinPhi;
+			V.Position.y = Y;
+			V.Position.z = CosPhi;
 
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
+			V.Normal.x = SinPhi;
+			V.Normal.y = 0;
+			V.Normal.z = CosPhi;
 
-			BiTangent = Normal ^ Tangent;
+			V.Tangent.x = CosPhi;
+			V.Tangent.y = 0.0f;
+			V.Tangent.z = -SinPhi;
 
-			// Ask for UVs
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == _RadialSubdivisions );
-			else
-				UV.Set( 2.0f * float(i) / _RadialSubdivisions, float(j) / _VerticalSubdivisions );
+			V.BiTangent = V.Normal ^ V.Tangent;
 
-			// Write vertex
-			VWRITE( pVertex, Position, Normal, Tangent, BiTangent, UV );
+			if ( _pMapper == NULL )
+				V.UV.Set( 2.0f * float(i) / _RadialSubdivisions, float(j) / _VerticalSubdivisions );
 		}
+
+		// Ask for UVs
+		if ( _pMapper )
+			_pMapper->MapBand( BandLength, pBand, true );
+
+		// Write vertices
+		BWRITE( pVertex, pBand, BandLength );
 	}
 
 	// Bottom band
@@ -246,33 +269,39 @@ void	GeometryBuilder::BuildCylinder( int _RadialSubdivisions, int _VerticalSubdi
 	{
 		for ( int i=0; i <= _RadialSubdivisions; i++ )
 		{
+			Vertex&	V = pBand[i];
+
 			float	Phi = TWOPI * i / _RadialSubdivisions;
-			Tangent.x = cosf( Phi );
-			Tangent.y = 0.0f;
-			Tangent.z = -sinf( Phi );
+			V.Tangent.x = cosf( Phi );
+			V.Tangent.y = 0.0f;
+			V.Tangent.z = -sinf( Phi );
 
 			// Create a dummy position that is slightly offseted from the bottom of the sphere so UVs are not all identical
-			Position.y = -1.0f;
-			Position.x = -0.001f * Tangent.z;
-			Position.z = 0.001f * Tangent.x;
-			Normal = -float3::UnitY;
+			V.Position.y = -1.0f;
+			V.Position.x = -0.001f * V.Tangent.z;
+			V.Position.z = 0.001f * V.Tangent.x;
+			V.Normal = -float3::UnitY;
 
-			BiTangent = Normal ^ Tangent;
+			V.BiTangent = V.Normal ^ V.Tangent;
 
-			// Ask for UVs
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == _RadialSubdivisions );
-			else
-				UV.Set( 2.0f * float(i) / _RadialSubdivisions, 1.0f );
+			if ( _pMapper == NULL )
+				V.UV.Set( 2.0f * float(i) / _RadialSubdivisions, 1.0f );
+		}
 
-			Position.x = Position.z = 0.0f;
+		// Ask for UVs
+		if ( _pMapper )
+			_pMapper->MapBand( BandLength, pBand, true );
 
-			// Write vertex
-			VWRITE( pVertex, -float3::UnitY, -float3::UnitY, Tangent, BiTangent, UV );
-		}
+		for ( int i=0; i <= _RadialSubdivisions; i++ )
+			pBand[i].Position = -float3::UnitY;
+
+		// Write vertices
+		BWRITE( pVertex, pBand, BandLength );
 	}
 	ASSERT( VerticesCount == 0, "Wrong contruction!" );
 
+	delete[] pBand;
+
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build indices
@@ -311,19 +340,19 @@ void	GeometryBuilder::BuildTorus( int _PhiSubdivisions, int _ThetaSubdivisions,
 
 	// Create the buffers
 	void*	pVerticesArray = NULL;
-	void*	pIndicesArray = NULL;
+	U32*	pIndicesArray = NULL;
 	_Writer.CreateBuffers( VerticesCount, IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, pVerticesArray, pIndicesArray );
 	ASSERT( pVerticesArray != NULL, "Invalid vertex buffer !" );
 	ASSERT( pIndicesArray != NULL, "Invalid index buffer !" );
 
 	void*		pVertex = pVerticesArray;
-	void*		pIndex = pIndicesArray;
+	U32*		pIndex = pIndicesArray;
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build vertices
-	float3	Position, Normal, Tangent, BiTangent;
-	float2	UV;
+	Vertex*	pBand = new Vertex[BandLength+1];
 
+	float3	Tangent;
 	for ( int j=0; j < BandsCount; j++ )
 	{
 		float		Phi = TWOPI * j / BandsCount;
@@ -337,23 +366,28 @@ void	GeometryBuilder::BuildTorus( int _PhiSubdivisions, int _ThetaSubdivisions,
 
 		for ( int i=0; i <= BandLength; i++ )
 		{
+			Vertex&	V = pBand[i];
+
 			float	Theta = TWOPI * i / BandLength;
 
-			Normal = cosf(Theta) * X + sinf(Theta) * float3::UnitZ;
-			Position = Center + _SmallRadius * Normal;
+			V.Normal = cosf(Theta) * X + sinf(Theta) * float3::UnitZ;
+			V.Position = Center + _SmallRadius * V.Normal;
+			V.Tangent = Tangent;
+			V.BiTangent = V.Normal ^ Tangent;
 
-			BiTangent = Normal ^ Tangent;
+			if ( _pMapper == NULL )
+				V.UV.Set( 4.0f * float(j) / BandsCount, float(j) / BandLength );
+		}
 
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, i == BandLength );
-			else
-				UV.Set( 4.0f * float(j) / BandsCount, float(j) / BandLength );
+		if ( _pMapper )
+			_pMapper->MapBand( BandLength+1, pBand, true );
 
-			VWRITE( pVertex, Position, Normal, Tangent, BiTangent, UV );
-		}
+		BWRITE( pVertex, pBand, BandLength+1 );
 	}
 	ASSERT( VerticesCount == 0, "Wrong contruction!" );
 
+	delete[] pBand;
+
 	//////////////////////////////////////////////////////////////////////////
 	// Build indices
 	for ( int j=0; j < BandsCount; j++ )
@@ -391,13 +425,13 @@ void	GeometryBuilder::BuildPlane( int _SubdivisionsX, int _SubdivisionsY, const
 
 	// Create the buffers
 	void*	pVerticesArray = NULL;
-	void*	pIndicesArray = NULL;
+	U32*	pIndicesArray = NULL;
 	_Writer.CreateBuffers( VerticesCount, IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, pVerticesArray, pIndicesArray );
 	ASSERT( pVerticesArray != NULL, "Invalid vertex buffer !" );
 	ASSERT( pIndicesArray != NULL, "Invalid index buffer !" );
 
 	void*		pVertex = pVerticesArray;
-	void*		pIndex = pIndicesArray;
+	U32*		pIndex = pIndicesArray;
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build vertices
@@ -405,27 +439,44 @@ void	GeometryBuilder::BuildPlane( int _SubdivisionsX, int _SubdivisionsY, const
 	float3	BiTangent = _Y;					BiTangent.Normalize();
 	float3	Normal = Tangent ^ BiTangent;	Normal.Normalize();
 
-	float3	Position;
-	float2	UV;
+	Vertex*	pBand = new Vertex[_SubdivisionsX+1];
+	for ( int i=0; i <= _SubdivisionsX; i++ )
+	{	// Those never change
+		pBand[i].Normal = Normal;
+		pBand[i].Tangent = Tangent;
+		pBand[i].BiTangent = BiTangent;
+	}
 
 	for ( int j=0; j <= _SubdivisionsY; j++ )
 	{
 		float	Y = 1.0f - 2.0f * j / _SubdivisionsY;
 		for ( int i=0; i <= _SubdivisionsX; i++ )
 		{
-			float	X = 2.0f * i / _SubdivisionsX - 1.0f;
+			Vertex&	V = pBand[i];
 
-			Position = X * _X + Y * _Y;
-			if ( _pMapper )
-				_pMapper->Map( Position, Normal, Tangent, UV, false );
-			else
-				UV.Set( float(i) / _SubdivisionsX, float(j) / _SubdivisionsY );
+			float	X = 2.0f * i / _SubdivisionsX - 1.0f;
 
-			VWRITE( pVertex, Position, Normal, Tangent, BiTangent, UV );
+			V.Position = X * _X + Y * _Y;
+			if ( _pMapper == NULL )
+				V.UV.Set( float(i) / _SubdivisionsX, float(j) / _SubdivisionsY );
 		}
+
+		if ( _pMapper )
+			_pMapper->MapBand( _SubdivisionsX+1, pBand, false );
+
+		BWRITE( pVertex, pBand, _SubdivisionsX+1 );
+
+		if ( _TweakVertex != NULL )
+			for ( int i=0; i <= _SubdivisionsX; i++ )
+			{	// Restore what the user may have tweaked
+				pBand[i].Normal = Normal;
+				pBand[i].Tangent = Tangent;
+			}
 	}
 	ASSERT( VerticesCount == 0, "Wrong contruction!" );
 
+	delete[] pBand;
+
 	//////////////////////////////////////////////////////////////////////////
 	// Build indices
 	for ( int j=0; j < _SubdivisionsY; j++ )
@@ -466,13 +517,13 @@ void	GeometryBuilder::BuildCube( int _SubdivisionsX, int _SubdivisionsY, int _Su
 
 	// Create the buffers
 	void*	pVerticesArray = NULL;
-	void*	pIndicesArray = NULL;
+	U32*	pIndicesArray = NULL;
 	_Writer.CreateBuffers( VerticesCount, IndicesCount, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, pVerticesArray, pIndicesArray );
 	ASSERT( pVerticesArray != NULL, "Invalid vertex buffer !" );
 	ASSERT( pIndicesArray != NULL, "Invalid index buffer !" );
 
 	void*	pVertex = pVerticesArray;
-	void*	pIndex = pIndicesArray;
+	U32*	pIndex = pIndicesArray;
 
 	//////////////////////////////////////////////////////////////////////////
 	// Build vertices
@@ -496,9 +547,9 @@ void	GeometryBuilder::BuildCube( int _SubdivisionsX, int _SubdivisionsY, int _Su
 	int			pSizesX[6] = { SizeZ, SizeZ, SizeX, SizeX, SizeX, SizeX };
 	int			pSizesY[6] = { SizeY, SizeY, SizeZ, SizeZ, SizeZ, SizeZ };
 
-	float3	Position, Normal, X, Y;
-	float2	UV;
+	Vertex*	pBand = new Vertex[MAX( SizeX, SizeZ )];
 
+	float3	Normal, X, Y;
 	for ( int FaceIndex=0; FaceIndex < 6; FaceIndex++ )
 	{
 		int		Sx = pSizesX[FaceIndex];
@@ -512,21 +563,29 @@ void	GeometryBuilder::BuildCube( int _SubdivisionsX, int _SubdivisionsY, int _Su
 			float	y = 1.0f - 2.0f * float(j) / (Sy-1);
 			for ( int i=0; i < Sx; i++ )
 			{
-				float	x = 2.0f * float(i) / (Sx-1) - 1.0f;
+				Vertex&	V = pBand[i];
 
-				Position = Normal + x * X + y * Y;
+				float	x = 2.0f * float(i) / (Sx-1) - 1.0f;
 
-				if ( _pMapper )
-					_pMapper->Map( Position, Normal, X, UV, false );
-				else
-					UV.Set( 0.5f * (1.0f + x), 0.5f * (1.0f + y) );
+				V.Position = Normal + x * X + y * Y;
+				V.Normal = Normal;
+				V.Tangent = X;
+				V.BiTangent = Y;
 
-				VWRITE( pVertex, Position, Normal, X, Y, UV );
+				if ( _pMapper == NULL )
+					V.UV.Set( 0.5f * (1.0f + x), 0.5f * (1.0f + y) );
 			}
+
+			if ( _pMapper )
+				_pMapper->MapBand( Sx, pBand, false );
+
+			BWRITE( pVertex, pBand, Sx );
 		}
 	}
 	ASSERT( VerticesCount == 0, "Wrong contruction!" );
 
+	delete[] pBand;
+
 	//////////////////////////////////////////////////////////////////////////
 	// Build indices
 	int		FaceOffset = 0;
@@ -573,22 +632,28 @@ void	GeometryBuilder::BuildCube( int _SubdivisionsX, int _SubdivisionsY, int _Su
 	_Writer.Finalize( pVerticesArray, pIndicesArray );
 }
 
-void	GeometryBuilder::AppendVertex( IGeometryWriter& _Writer, void*& _pVertex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV, TweakVertexDelegate _TweakVertex, void* _pUserData )
+void	GeometryBuilder::WriteBand( IGeometryWriter& _Writer, void*& _pVertex, Vertex* _pBand, int _Count, TweakVertexDelegate _TweakVertex, void* _pUserData )
 {
-	if ( _TweakVertex == NULL )
-	{
-		_Writer.AppendVertex( _pVertex, _Position, _Normal, _Tangent, _BiTangent, _UV );
-		return;
+	if ( _TweakVertex != NULL )
+	{	// Ask the user to tweak the vertices first !
+		for ( int i=0; i < _Count; i++ )
+		{
+			Vertex&	V = _pBand[i];
+			(*_TweakVertex)( V.Position, V.Normal, V.Tangent, V.BiTangent, V.UV, _pUserData );
+		}
 	}
 
-	// Ask the user to tweak the vertices first !
-	float3	P = _Position;
-	float3	N = _Normal;
-	float3	T = _Tangent;
-	float3	B = _BiTangent;
-	float2	UV = _UV;
-	(*_TweakVertex)( P, N, T, B, UV, _pUserData );
-	_Writer.AppendVertex( _pVertex, P, N, T, B, UV );
+	_Writer.AppendVertices( _pVertex, _Count, _pBand );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Base mapper
+//
+void	GeometryBuilder::MapperBase::MapBand( int _Count, Vertex* _pVertices, bool _bLastIsBandEndVertex ) const
+{
+	for ( int i=0; i < _Count; i++ )
+		Map( _pVertices[i].Position, _pVertices[i].Normal, _pVertices[i].Tangent, _pVertices[i].UV, _bLastIsBandEndVertex && i == _Count-1 );
 }
 
 
@@ -624,6 +689,11 @@ void	GeometryBuilder::MapperSpherical::Map( const float3& _Position, const float
 	_UV.x = m_WrapU * INV2PI * Phi;
 	_UV.y = m_WrapV * INVPI * Theta;
 }
+void	GeometryBuilder::MapperSpherical::MapBand( int _Count, Vertex* _pVertices, bool _bLastIsBandEndVertex ) const
+{
+	for ( int i=0; i < _Count; i++ )
+		MapperSpherical::Map( _pVertices[i].Position, _pVertices[i].Normal, _pVertices[i].Tangent, _pVertices[i].UV, _bLastIsBandEndVertex && i == _Count-1 );
+}
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -655,6 +725,11 @@ void	GeometryBuilder::MapperCylindrical::Map( const float3& _Position, const flo
 	_UV.x = m_WrapU * INV2PI * Phi;
 	_UV.y = m_WrapV * Y;
 }
+void	GeometryBuilder::MapperCylindrical::MapBand( int _Count, Vertex* _pVertices, bool _bLastIsBandEndVertex ) const
+{
+	for ( int i=0; i < _Count; i++ )
+		MapperCylindrical::Map( _pVertices[i].Position, _pVertices[i].Normal, _pVertices[i].Tangent, _pVertices[i].UV, _bLastIsBandEndVertex && i == _Count-1 );
+}
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -675,6 +750,11 @@ void	GeometryBuilder::MapperPlanar::Map( const float3& _Position, const float3&
 	_UV.x = m_WrapU * (Delta | m_Tangent);
 	_UV.y = m_WrapV * (Delta | m_BiTangent);
 }
+void	GeometryBuilder::MapperPlanar::MapBand( int _Count, Vertex* _pVertices, bool _bLastIsBandEndVertex ) const
+{
+	for ( int i=0; i < _Count; i++ )
+		MapperPlanar::Map( _pVertices[i].Position, _pVertices[i].Normal, _pVertices[i].Tangent, _pVertices[i].UV, false );
+}
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -750,3 +830,8 @@ void	GeometryBuilder::MapperCube::Map( const float3& _Position, const float3& _N
 	_UV.x *= m_WrapU;
 	_UV.y *= m_WrapV;
 }
+void	GeometryBuilder::MapperCube::MapBand( int _Count, Vertex* _pVertices, bool _bLastIsBandEndVertex ) const
+{
+	for ( int i=0; i < _Count; i++ )
+		MapperCube::Map( _pVertices[i].Position, _pVertices[i].Normal, _pVertices[i].Tangent, _pVertices[i].UV, false );
+}
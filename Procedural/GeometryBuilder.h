@@ -9,10 +9,24 @@ protected:	// CONSTANTS
 
 public:		// NESTED TYPES
 
+	// The vertex generated by the builders (same layout as VertexFormatP3N3G3B3T2)
+	struct	Vertex
+	{
+		float3	Position;
+		float3	Normal;
+		float3	Tangent;
+		float3	BiTangent;
+		float2	UV;
+	};
+
 	class	MapperBase
 	{
 	public:
 		virtual void	Map( const float3& _Position, const float3& _Normal, const float3& _Tangent, float2& _UV, bool _bIsBandEndVertex ) const = 0;
+
+		// Maps a whole band of vertices at once (only the last vertex of the band can be a band end vertex)
+		// The default implementation calls Map() for each vertex
+		virtual void	MapBand( int _Count, Vertex* _pVertices, bool _bLastIsBandEndVertex ) const;
 	};
 
 	// Spherical mapping
@@ -27,6 +41,7 @@ public:		// NESTED TYPES
 	public:
 		MapperSpherical( float _WrapU=2.0f, float _WrapV=1.0f, const float3& _Center=float3::Zero, const float3& _X=float3::UnitX, const float3& _Y=float3::UnitY );
 		virtual void	Map( const float3& _Position, const float3& _Normal, const float3& _Tangent, float2& _UV, bool _bIsBandEndVertex ) const;
+		virtual void	MapBand( int _Count, Vertex* _pVertices, bool _bLastIsBandEndVertex ) const;
 	};
 
 	// Cylindrical mapping
@@ -41,6 +56,7 @@ public:		// NESTED TYPES
 	public:
 		MapperCylindrical( float _WrapU=2.0f, float _WrapV=1.0f, const float3& _Center=float3::Zero, const float3& _X=float3::UnitX, const float3& _Z=float3::UnitZ );
 		virtual void	Map( const float3& _Position, const float3& _Normal, const float3& _Tangent, float2& _UV, bool _bIsBandEndVertex ) const;
+		virtual void	MapBand( int _Count, Vertex* _pVertices, bool _bLastIsBandEndVertex ) const;
 	};
 
 	// Planar mapping
@@ -55,6 +71,7 @@ public:		// NESTED TYPES
 	public:
 		MapperPlanar( float _WrapU=1.0f, float _WrapV=1.0f, const float3& _Center=float3::Zero, const float3& _Tangent=float3::UnitZ, const float3& _BiTangent=float3::UnitX );
 		virtual void	Map( const float3& _Position, const float3& _Normal, const float3& _Tangent, float2& _UV, bool _bIsBandEndVertex ) const;
+		virtual void	MapBand( int _Count, Vertex* _pVertices, bool _bLastIsBandEndVertex ) const;
 	};
 
 	// Cube mapping
@@ -70,15 +87,17 @@ public:		// NESTED TYPES
 	public:
 		MapperCube( float _WrapU=1.0f, float _WrapV=1.0f, const float3& _Center=float3::Zero, const float3& _X=float3::UnitX, const float3& _Y=float3::UnitY, const float3& _Z=float3::UnitZ );
 		virtual void	Map( const float3& _Position, const float3& _Normal, const float3& _Tangent, float2& _UV, bool _bIsBandEndVertex ) const;
+		virtual void	MapBand( int _Count, Vertex* _pVertices, bool _bLastIsBandEndVertex ) const;
 	};
 
+	// The builders reserve the exact amount of vertices & indices they need, then send vertices one band at a time
+	//	and write indices directly into the provided index buffer
 	class	IGeometryWriter
 	{
 	public:
-		virtual void	CreateBuffers( int _VerticesCount, int _IndicesCount, D3D11_PRIMITIVE_TOPOLOGY _Topology, void*& _pVertices, void*& _pIndices ) = 0;
-		virtual void	AppendVertex( void*& _pVertex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV ) = 0;
-		virtual void	AppendIndex( void*& _pIndex, int _Index ) = 0;
-		virtual void	Finalize( void* _pVertices, void* _pIndices ) = 0;
+		virtual void	CreateBuffers( int _VerticesCount, int _IndicesCount, D3D11_PRIMITIVE_TOPOLOGY _Topology, void*& _pVertices, U32*& _pIndices ) = 0;
+		virtual void	AppendVertices( void*& _pVertex, int _Count, const Vertex* _pVertices ) = 0;
+		virtual void	Finalize( void* _pVertices, U32* _pIndices ) = 0;
 	};
 
 	typedef void	(*TweakVertexDelegate)( float3& _Position, float3& _Normal, float3& _Tangent, const float3& _BiTangent, float2& _UV, void* _pUserData );
@@ -102,5 +121,5 @@ public:		// METHODS
 
 private:
 
-	static void		AppendVertex( IGeometryWriter& _Writer, void*& _pVertex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV, TweakVertexDelegate _TweakVertex=NULL, void* _pUserData=NULL );
+	static void		WriteBand( IGeometryWriter& _Writer, void*& _pVertex, Vertex* _pBand, int _Count, TweakVertexDelegate _TweakVertex, void* _pUserData );
 };
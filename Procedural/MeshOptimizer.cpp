@@ -0,0 +1,441 @@
+#include "../GodComplex.h"
+
+// Scoring parameters from Forsyth's article
+static const int	SCORING_CACHE_SIZE = 32;
+static const int	MAX_VALENCE_SCORE = 64;
+static const float	CACHE_DECAY_POWER = 1.5f;
+static const float	LAST_TRIANGLE_SCORE = 0.75f;
+static const float	VALENCE_BOOST_SCALE = 2.0f;
+static const float	VALENCE_BOOST_POWER = 0.5f;
+
+static const int	SORT_BUCKETS_COUNT = 1024;
+
+void	MeshOptimizer::Optimize( U32* _pIndices, int _IndicesCount, void* _pVertices, int _VerticesCount, int _VertexStride, float _OverdrawThreshold, Statistics* _pBefore, Statistics* _pAfter )
+{
+	ASSERT( (_IndicesCount % 3) == 0, "Not a triangle list!" );
+
+	if ( _pBefore != NULL )
+		ComputeStatistics( _pIndices, _IndicesCount, _VerticesCount, *_pBefore );
+
+	OptimizeVertexCache( _pIndices, _IndicesCount, _VerticesCount );
+	if ( _pVertices != NULL )
+	{
+		if ( _OverdrawThreshold > 0.0f )
+			OptimizeOverdraw( _pIndices, _IndicesCount, _pVertices, _VerticesCount, _VertexStride, _OverdrawThreshold );
+		OptimizeVertexFetch( _pIndices, _IndicesCount, _pVertices, _VerticesCount, _VertexStride );
+	}
+
+	if ( _pAfter != NULL )
+		ComputeStatistics( _pIndices, _IndicesCount, _VerticesCount, *_pAfter );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Vertex cache optimization
+//
+namespace
+{
+	float	gs_pCachePositionScores[SCORING_CACHE_SIZE];
+	float	gs_pValenceScores[1+MAX_VALENCE_SCORE];
+	bool	gs_bScoresInitialized = false;
+
+	void	InitScores()
+	{
+		if ( gs_bScoresInitialized )
+			return;
+
+		for ( int CachePosition=0; CachePosition < SCORING_CACHE_SIZE; CachePosition++ )
+		{
+			if ( CachePosition < 3 )
+				gs_pCachePositionScores[CachePosition] = LAST_TRIANGLE_SCORE;	// The vertices of the last triangle get a fixed score so we don't favor the ones we just used too much
+			else
+				gs_pCachePositionScores[CachePosition] = powf( 1.0f - float(CachePosition-3) / (SCORING_CACHE_SIZE-3), CACHE_DECAY_POWER );
+		}
+
+		gs_pValenceScores[0] = 0.0f;
+		for ( int Valence=1; Valence <= MAX_VALENCE_SCORE; Valence++ )
+			gs_pValenceScores[Valence] = VALENCE_BOOST_SCALE * powf( float(Valence), -VALENCE_BOOST_POWER );	// Boost vertices with few triangles left so we don't leave lone triangles behind
+
+		gs_bScoresInitialized = true;
+	}
+
+	float	ComputeVertexScore( int _CachePosition, int _RemainingTrianglesCount )
+	{
+		if ( _RemainingTrianglesCount == 0 )
+			return -1.0f;	// No triangle needs this vertex anymore
+
+		float	Score = _CachePosition >= 0 ? gs_pCachePositionScores[_CachePosition] : 0.0f;
+		Score += gs_pValenceScores[MIN( _RemainingTrianglesCount, MAX_VALENCE_SCORE )];
+		return Score;
+	}
+}
+
+void	MeshOptimizer::OptimizeVertexCache( U32* _pIndices, int _IndicesCount, int _VerticesCount )
+{
+	LinearAllocator&		Scratch = GetThreadScratch();
+	LinearAllocator::Scope	ScratchScope( Scratch );
+
+	int	TrianglesCount = _IndicesCount / 3;
+	if ( TrianglesCount == 0 )
+		return;
+
+	InitScores();
+
+	// Build the vertex => triangles adjacency
+	int*	pRemainingTriangles = Scratch.Allocate<int>( _VerticesCount );
+	int*	pAdjacencyOffsets = Scratch.Allocate<int>( _VerticesCount+1 );
+	int*	pAdjacency = Scratch.Allocate<int>( _IndicesCount );
+	memset( pRemainingTriangles, 0, _VerticesCount*sizeof(int) );
+	for ( int i=0; i < _IndicesCount; i++ )
+	{
+		ASSERT( _pIndices[i] < U32(_VerticesCount), "Index out of range!" );
+		pRemainingTriangles[_pIndices[i]]++;
+	}
+
+	pAdjacencyOffsets[0] = 0;
+	for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+	{
+		pAdjacencyOffsets[VertexIndex+1] = pAdjacencyOffsets[VertexIndex] + pRemainingTriangles[VertexIndex];
+		pRemainingTriangles[VertexIndex] = 0;
+	}
+	for ( int i=0; i < _IndicesCount; i++ )
+	{
+		U32	VertexIndex = _pIndices[i];
+		pAdjacency[pAdjacencyOffsets[VertexIndex] + pRemainingTriangles[VertexIndex]++] = i / 3;
+	}
+
+	// Initialize scores
+	float*	pVertexScores = Scratch.Allocate<float>( _VerticesCount );
+	for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		pVertexScores[VertexIndex] = ComputeVertexScore( -1, pRemainingTriangles[VertexIndex] );
+
+	float*	pTriangleScores = Scratch.Allocate<float>( TrianglesCount );
+	bool*	pTriangleEmitted = Scratch.Allocate<bool>( TrianglesCount );
+	int		BestTriangle = -1;
+	float	BestScore = -1.0f;
+	for ( int TriangleIndex=0; TriangleIndex < TrianglesCount; TriangleIndex++ )
+	{
+		const U32*	pTriangle = &_pIndices[3*TriangleIndex];
+		pTriangleScores[TriangleIndex] = pVertexScores[pTriangle[0]] + pVertexScores[pTriangle[1]] + pVertexScores[pTriangle[2]];
+		pTriangleEmitted[TriangleIndex] = false;
+		if ( pTriangleScores[TriangleIndex] > BestScore )
+		{
+			BestScore = pTriangleScores[TriangleIndex];
+			BestTriangle = TriangleIndex;
+		}
+	}
+
+	// Emit triangles one by one
+	U32*	pResult = Scratch.Allocate<U32>( _IndicesCount );
+	int		pCache[SCORING_CACHE_SIZE+3];
+	int		pNewCache[SCORING_CACHE_SIZE+3];
+	int		CacheSize = 0;
+	int		Cursor = 0;	// Scanning position used when we run out of candidates in the cache
+
+	for ( int EmittedCount=0; EmittedCount < TrianglesCount; EmittedCount++ )
+	{
+		if ( BestTriangle < 0 )
+		{	// No candidate in the cache, pick the next triangle that wasn't emitted
+			while ( pTriangleEmitted[Cursor] )
+				Cursor++;
+			BestTriangle = Cursor;
+		}
+
+		const U32*	pTriangle = &_pIndices[3*BestTriangle];
+		pResult[3*EmittedCount+0] = pTriangle[0];
+		pResult[3*EmittedCount+1] = pTriangle[1];
+		pResult[3*EmittedCount+2] = pTriangle[2];
+		pTriangleEmitted[BestTriangle] = true;
+
+		// Remove the triangle from the adjacency of its vertices
+		for ( int Corner=0; Corner < 3; Corner++ )
+		{
+			U32		VertexIndex = pTriangle[Corner];
+			int*	pVertexTriangles = &pAdjacency[pAdjacencyOffsets[VertexIndex]];
+			int		Count = pRemainingTriangles[VertexIndex];
+			for ( int i=0; i < Count; i++ )
+				if ( pVertexTriangles[i] == BestTriangle )
+				{
+					pVertexTriangles[i] = pVertexTriangles[Count-1];
+					break;
+				}
+			pRemainingTriangles[VertexIndex]--;
+		}
+
+		// Push the triangle's vertices at the front of the LRU cache
+		int	NewCacheSize = 0;
+		for ( int Corner=0; Corner < 3; Corner++ )
+			pNewCache[NewCacheSize++] = pTriangle[Corner];
+		for ( int i=0; i < CacheSize; i++ )
+		{
+			int	VertexIndex = pCache[i];
+			if ( VertexIndex != int(pTriangle[0]) && VertexIndex != int(pTriangle[1]) && VertexIndex != int(pTriangle[2]) )
+				pNewCache[NewCacheSize++] = VertexIndex;
+		}
+
+		// Update the scores of the vertices in the cache and those that were just evicted
+		for ( int i=0; i < NewCacheSize; i++ )
+		{
+			int	VertexIndex = pNewCache[i];
+			int	CachePosition = i < SCORING_CACHE_SIZE ? i : -1;
+
+			float	Score = ComputeVertexScore( CachePosition, pRemainingTriangles[VertexIndex] );
+			float	DeltaScore = Score - pVertexScores[VertexIndex];
+			pVertexScores[VertexIndex] = Score;
+
+			const int*	pVertexTriangles = &pAdjacency[pAdjacencyOffsets[VertexIndex]];
+			int			Count = pRemainingTriangles[VertexIndex];
+			for ( int j=0; j < Count; j++ )
+				pTriangleScores[pVertexTriangles[j]] += DeltaScore;
+		}
+
+		// Only the triangles using a cached vertex are candidates for the next pick
+		BestTriangle = -1;
+		BestScore = -1.0f;
+		for ( int i=0; i < NewCacheSize && i < SCORING_CACHE_SIZE; i++ )
+		{
+			int			VertexIndex = pNewCache[i];
+			const int*	pVertexTriangles = &pAdjacency[pAdjacencyOffsets[VertexIndex]];
+			int			Count = pRemainingTriangles[VertexIndex];
+			for ( int j=0; j < Count; j++ )
+				if ( pTriangleScores[pVertexTriangles[j]] > BestScore )
+				{
+					BestScore = pTriangleScores[pVertexTriangles[j]];
+					BestTriangle = pVertexTriangles[j];
+				}
+		}
+
+		// Swap caches
+		CacheSize = MIN( NewCacheSize, SCORING_CACHE_SIZE );
+		memcpy( pCache, pNewCache, CacheSize*sizeof(int) );
+	}
+
+	memcpy( _pIndices, pResult, _IndicesCount*sizeof(U32) );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Overdraw optimization
+//
+void	MeshOptimizer::OptimizeOverdraw( U32* _pIndices, int _IndicesCount, const void* _pVertices, int _VerticesCount, int _VertexStride, float _Threshold )
+{
+	LinearAllocator&		Scratch = GetThreadScratch();
+	LinearAllocator::Scope	ScratchScope( Scratch );
+
+	int	TrianglesCount = _IndicesCount / 3;
+	if ( TrianglesCount == 0 )
+		return;
+
+	Statistics	MeshStats;
+	ComputeStatistics( _pIndices, _IndicesCount, _VerticesCount, MeshStats );
+	float	TargetACMR = _Threshold * MeshStats.ACMR;
+
+	// Split the triangles into clusters that can be drawn in any order without hurting the cache much:
+	//	_ Hard boundaries are where the cache would naturally get flushed (all 3 vertices miss)
+	//	_ Soft boundaries further split hard clusters once their own ACMR, from an empty cache, is acceptable
+	int*	pClusterStarts = Scratch.Allocate<int>( TrianglesCount+1 );
+	int		ClustersCount = 0;
+
+	U32*	pCacheTimeStamps = Scratch.Allocate<U32>( _VerticesCount );
+	memset( pCacheTimeStamps, 0, _VerticesCount*sizeof(U32) );
+	U32		TimeStamp = DEFAULT_CACHE_SIZE+1;
+
+	int		ClusterMisses = 0;
+	int		ClusterTriangles = 0;
+	for ( int TriangleIndex=0; TriangleIndex < TrianglesCount; TriangleIndex++ )
+	{
+		int	Misses = 0;
+		for ( int Corner=0; Corner < 3; Corner++ )
+		{
+			U32	VertexIndex = _pIndices[3*TriangleIndex+Corner];
+			if ( TimeStamp - pCacheTimeStamps[VertexIndex] > U32(DEFAULT_CACHE_SIZE) )
+			{
+				pCacheTimeStamps[VertexIndex] = TimeStamp++;
+				Misses++;
+			}
+		}
+
+		if ( Misses == 3 || ClusterTriangles == 0 )
+		{	// Hard boundary
+			pClusterStarts[ClustersCount++] = TriangleIndex;
+			ClusterMisses = 0;
+			ClusterTriangles = 0;
+		}
+
+		ClusterMisses += Misses;
+		ClusterTriangles++;
+
+		if ( ClusterMisses <= TargetACMR * ClusterTriangles && TriangleIndex < TrianglesCount-1 )
+		{	// Soft boundary: flush the cache and start a new cluster with the next triangle
+			TimeStamp += DEFAULT_CACHE_SIZE+1;
+			ClusterTriangles = 0;
+		}
+	}
+	pClusterStarts[ClustersCount] = TrianglesCount;
+
+	// Compute the mesh's centroid
+	float3	MeshCentroid = float3::Zero;
+	for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		MeshCentroid = MeshCentroid + *((const float3*) ((const U8*) _pVertices + VertexIndex * _VertexStride));
+	MeshCentroid = MeshCentroid / float(MAX( 1, _VerticesCount ));
+
+	// Compute each cluster's sort key: clusters whose centroid is far away along their normal are more likely to occlude the others
+	float*	pSortKeys = Scratch.Allocate<float>( ClustersCount );
+	float	MinKey = FLOAT32_MAX;
+	float	MaxKey = -FLOAT32_MAX;
+	for ( int ClusterIndex=0; ClusterIndex < ClustersCount; ClusterIndex++ )
+	{
+		float3	Centroid = float3::Zero;
+		float3	Normal = float3::Zero;
+		float	TotalArea = 0.0f;
+		for ( int TriangleIndex=pClusterStarts[ClusterIndex]; TriangleIndex < pClusterStarts[ClusterIndex+1]; TriangleIndex++ )
+		{
+			const float3&	P0 = *((const float3*) ((const U8*) _pVertices + _pIndices[3*TriangleIndex+0] * _VertexStride));
+			const float3&	P1 = *((const float3*) ((const U8*) _pVertices + _pIndices[3*TriangleIndex+1] * _VertexStride));
+			const float3&	P2 = *((const float3*) ((const U8*) _pVertices + _pIndices[3*TriangleIndex+2] * _VertexStride));
+
+			float3	FaceNormal = (P1 - P0) ^ (P2 - P0);
+			float	Area = FaceNormal.Length();
+
+			Centroid = Centroid + (Area / 3.0f) * (P0 + P1 + P2);
+			Normal = Normal + FaceNormal;
+			TotalArea += Area;
+		}
+
+		if ( TotalArea > 0.0f )
+			Centroid = Centroid / TotalArea;
+		float	NormalLength = Normal.Length();
+		if ( NormalLength > 0.0f )
+			Normal = Normal / NormalLength;
+
+		pSortKeys[ClusterIndex] = (Centroid - MeshCentroid) | Normal;
+		MinKey = MIN( MinKey, pSortKeys[ClusterIndex] );
+		MaxKey = MAX( MaxKey, pSortKeys[ClusterIndex] );
+	}
+
+	// Counting sort by decreasing key
+	int*	pBucketOffsets = Scratch.Allocate<int>( SORT_BUCKETS_COUNT+1 );
+	int*	pClusterBuckets = Scratch.Allocate<int>( ClustersCount );
+	memset( pBucketOffsets, 0, (SORT_BUCKETS_COUNT+1)*sizeof(int) );
+
+	float	KeyScale = MaxKey > MinKey ? (SORT_BUCKETS_COUNT-1) / (MaxKey - MinKey) : 0.0f;
+	for ( int ClusterIndex=0; ClusterIndex < ClustersCount; ClusterIndex++ )
+	{
+		int	Bucket = SORT_BUCKETS_COUNT-1 - CLAMP( int((pSortKeys[ClusterIndex] - MinKey) * KeyScale), 0, SORT_BUCKETS_COUNT-1 );
+		pClusterBuckets[ClusterIndex] = Bucket;
+		pBucketOffsets[Bucket+1]++;
+	}
+	for ( int Bucket=0; Bucket < SORT_BUCKETS_COUNT; Bucket++ )
+		pBucketOffsets[Bucket+1] += pBucketOffsets[Bucket];
+
+	// Rewrite the triangles in cluster order
+	int*	pTriangleOffsets = Scratch.Allocate<int>( ClustersCount );
+	for ( int ClusterIndex=0; ClusterIndex < ClustersCount; ClusterIndex++ )
+		pTriangleOffsets[ClusterIndex] = pBucketOffsets[pClusterBuckets[ClusterIndex]]++;	// Temporarily holds the cluster's sorted position
+
+	int*	pSortedClusters = Scratch.Allocate<int>( ClustersCount );
+	for ( int ClusterIndex=0; ClusterIndex < ClustersCount; ClusterIndex++ )
+		pSortedClusters[pTriangleOffsets[ClusterIndex]] = ClusterIndex;
+
+	U32*	pResult = Scratch.Allocate<U32>( _IndicesCount );
+	U32*	pTarget = pResult;
+	for ( int i=0; i < ClustersCount; i++ )
+	{
+		int	ClusterIndex = pSortedClusters[i];
+		int	Start = pClusterStarts[ClusterIndex];
+		int	Count = pClusterStarts[ClusterIndex+1] - Start;
+		memcpy( pTarget, &_pIndices[3*Start], 3*Count*sizeof(U32) );
+		pTarget += 3*Count;
+	}
+	memcpy( _pIndices, pResult, _IndicesCount*sizeof(U32) );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Vertex fetch optimization
+//
+void	MeshOptimizer::OptimizeVertexFetch( U32* _pIndices, int _IndicesCount, void* _pVertices, int _VerticesCount, int _VertexStride )
+{
+	LinearAllocator&		Scratch = GetThreadScratch();
+	LinearAllocator::Scope	ScratchScope( Scratch );
+
+	// Assign new indices in order of first reference
+	U32*	pRemap = Scratch.Allocate<U32>( _VerticesCount );
+	memset( pRemap, 0xFF, _VerticesCount*sizeof(U32) );
+
+	U32	NewVerticesCount = 0;
+	for ( int i=0; i < _IndicesCount; i++ )
+	{
+		U32&	NewIndex = pRemap[_pIndices[i]];
+		if ( NewIndex == ~0U )
+			NewIndex = NewVerticesCount++;
+		_pIndices[i] = NewIndex;
+	}
+	for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		if ( pRemap[VertexIndex] == ~0U )
+			pRemap[VertexIndex] = NewVerticesCount++;	// Unreferenced vertices go last
+
+	// Move the vertices
+	U8*	pOldVertices = Scratch.Allocate<U8>( _VerticesCount * _VertexStride );
+	memcpy( pOldVertices, _pVertices, _VerticesCount * _VertexStride );
+	for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		memcpy( (U8*) _pVertices + pRemap[VertexIndex] * _VertexStride, pOldVertices + VertexIndex * _VertexStride, _VertexStride );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Helpers
+//
+void	MeshOptimizer::ComputeStatistics( const U32* _pIndices, int _IndicesCount, int _VerticesCount, Statistics& _Statistics, int _CacheSize )
+{
+	LinearAllocator&		Scratch = GetThreadScratch();
+	LinearAllocator::Scope	ScratchScope( Scratch );
+
+	U32*	pCacheTimeStamps = Scratch.Allocate<U32>( _VerticesCount );
+	memset( pCacheTimeStamps, 0, _VerticesCount*sizeof(U32) );
+	U32		TimeStamp = _CacheSize+1;
+
+	bool*	pReferenced = Scratch.Allocate<bool>( _VerticesCount );
+	memset( pReferenced, 0, _VerticesCount*sizeof(bool) );
+
+	int	ReferencedCount = 0;
+	int	MissesCount = 0;
+	for ( int i=0; i < _IndicesCount; i++ )
+	{
+		U32	VertexIndex = _pIndices[i];
+		if ( TimeStamp - pCacheTimeStamps[VertexIndex] > U32(_CacheSize) )
+		{	// Cache miss: the vertex gets transformed and pushed into the FIFO
+			pCacheTimeStamps[VertexIndex] = TimeStamp++;
+			MissesCount++;
+		}
+		if ( !pReferenced[VertexIndex] )
+		{
+			pReferenced[VertexIndex] = true;
+			ReferencedCount++;
+		}
+	}
+
+	_Statistics.ACMR = _IndicesCount > 0 ? 3.0f * MissesCount / _IndicesCount : 0.0f;
+	_Statistics.ATVR = ReferencedCount > 0 ? float(MissesCount) / ReferencedCount : 0.0f;
+}
+
+int		MeshOptimizer::ConvertStripToList( const U32* _pStrip, int _StripIndicesCount, U32* _pList )
+{
+	U32*	pTarget = _pList;
+	for ( int i=0; i < _StripIndicesCount-2; i++ )
+	{
+		U32	I0 = _pStrip[i+0];
+		U32	I1 = _pStrip[i+1];
+		U32	I2 = _pStrip[i+2];
+		if ( I0 == I1 || I1 == I2 || I2 == I0 )
+			continue;	// Degenerate
+
+		if ( i & 1 )
+		{	// Odd triangles have their winding reversed
+			U32	Temp = I0;
+			I0 = I1;
+			I1 = Temp;
+		}
+		*pTarget++ = I0;
+		*pTarget++ = I1;
+		*pTarget++ = I2;
+	}
+
+	return int(pTarget - _pList);
+}
@@ -0,0 +1,46 @@
+//////////////////////////////////////////////////////////////////////////
+// Reorders triangle lists for the post-transform vertex cache (Forsyth's "Linear-Speed Vertex Cache Optimisation"),
+//	clusters them to reduce overdraw (Sander et al. "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+//	and remaps vertices in order of first use for fetch locality
+//
+#pragma once
+
+class	MeshOptimizer
+{
+public:		// CONSTANTS
+
+	static const int	DEFAULT_CACHE_SIZE = 16;	// Size of the FIFO cache used to measure statistics
+
+public:		// NESTED TYPES
+
+	struct	Statistics
+	{
+		float	ACMR;	// Average Cache Miss Ratio = transformed vertices / triangles (0.5 is the ideal for large regular meshes, 3 is the worst)
+		float	ATVR;	// Average Transformed Vertex Ratio = transformed vertices / referenced vertices (1 is the ideal)
+	};
+
+public:		// METHODS
+
+	// Runs all the optimizations on an indexed triangle list
+	//	_pVertices, the vertices to remap for fetch locality (the position must be the first field of the vertex). Can be NULL, in which case only the triangles are reordered
+	//	_OverdrawThreshold, a value <= 0 disables the overdraw clustering, otherwise it's the amount of ACMR degradation we accept to get larger clusters (e.g. 1.05)
+	//	_pBefore, _pAfter, optional statistics measured before and after optimization
+	static void		Optimize( U32* _pIndices, int _IndicesCount, void* _pVertices, int _VerticesCount, int _VertexStride, float _OverdrawThreshold=1.05f, Statistics* _pBefore=NULL, Statistics* _pAfter=NULL );
+
+	// Reorders triangles for the post-transform vertex cache
+	static void		OptimizeVertexCache( U32* _pIndices, int _IndicesCount, int _VerticesCount );
+
+	// Sorts clusters of triangles so the ones facing outward are drawn first (must be called after OptimizeVertexCache())
+	static void		OptimizeOverdraw( U32* _pIndices, int _IndicesCount, const void* _pVertices, int _VerticesCount, int _VertexStride, float _Threshold=1.05f );
+
+	// Renumbers vertices in the order they're first referenced by the triangles (unreferenced vertices are moved at the end)
+	static void		OptimizeVertexFetch( U32* _pIndices, int _IndicesCount, void* _pVertices, int _VerticesCount, int _VertexStride );
+
+	// Simulates a FIFO cache of the given size to measure the efficiency of a triangle list
+	static void		ComputeStatistics( const U32* _pIndices, int _IndicesCount, int _VerticesCount, Statistics& _Statistics, int _CacheSize=DEFAULT_CACHE_SIZE );
+
+	// Converts a triangle strip into a triangle list, skipping degenerate triangles
+	//	_pList must be able to contain 3*(_StripIndicesCount-2) indices
+	//	Returns the amount of indices written to the list
+	static int		ConvertStripToList( const U32* _pStrip, int _StripIndicesCount, U32* _pList );
+};
@@ -0,0 +1,693 @@
+#include "../GodComplex.h"
+
+static const int	QUADRIC_SIZE = 3+3+2;	// Position, Normal, UV
+static const int	QUADRIC_MATRIX_SIZE = QUADRIC_SIZE*(QUADRIC_SIZE+1)/2;
+
+static const float	NORMAL_WEIGHT = 0.5f;	// Importance of normals relative to positions (positions are normalized by the mesh's extent)
+static const float	UV_WEIGHT = 0.1f;		// Importance of UVs relative to positions
+static const float	BORDER_WEIGHT = 10.0f;	// Importance of the planes that keep open borders and seams in place
+static const float	FLIP_THRESHOLD = 0.25f;	// Cosine between the normals of a triangle before and after a collapse below which we consider the triangle flipped
+
+static const int	SORT_BUCKETS_COUNT = 2048;
+
+namespace
+{
+	enum	VERTEX_KIND
+	{
+		KIND_INTERIOR,	// Can collapse onto any neighbor
+		KIND_BORDER,	// On an open border, can only collapse along the border
+		KIND_SEAM,		// On an attribute seam (i.e. shares its position with a twin vertex), collapses along the seam together with its twin
+		KIND_LOCKED,	// Non-manifold or complex seam, never collapses
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// Quadric in the combined attributes space
+	//	Q(x) = x.A.x + 2.b.x + c, with A stored as its upper triangle, row by row
+	//
+	struct	Quadric
+	{
+		float	A[QUADRIC_MATRIX_SIZE];
+		float	b[QUADRIC_SIZE];
+		float	c;
+		float	Weight;
+
+		void	Add( const Quadric& _Q )
+		{
+			for ( int i=0; i < QUADRIC_MATRIX_SIZE; i++ )
+				A[i] += _Q.A[i];
+			for ( int i=0; i < QUADRIC_SIZE; i++ )
+				b[i] += _Q.b[i];
+			c += _Q.c;
+			Weight += _Q.Weight;
+		}
+
+		// Adds the squared distance to the plane of a triangle of the attributes space
+		void	AddTriangle( const float* _p0, const float* _p1, const float* _p2, float _Weight )
+		{
+			// Build an orthonormal basis of the triangle's plane
+			float	e0[QUADRIC_SIZE], e1[QUADRIC_SIZE];
+			float	L0 = 0.0f;
+			for ( int i=0; i < QUADRIC_SIZE; i++ )
+			{
+				e0[i] = _p1[i] - _p0[i];
+				L0 += e0[i] * e0[i];
+			}
+			if ( L0 < 1e-20f )
+				return;
+			L0 = 1.0f / sqrtf( L0 );
+
+			float	Dot = 0.0f;
+			for ( int i=0; i < QUADRIC_SIZE; i++ )
+			{
+				e0[i] *= L0;
+				e1[i] = _p2[i] - _p0[i];
+				Dot += e1[i] * e0[i];
+			}
+			float	L1 = 0.0f;
+			for ( int i=0; i < QUADRIC_SIZE; i++ )
+			{
+				e1[i] -= Dot * e0[i];
+				L1 += e1[i] * e1[i];
+			}
+			if ( L1 < 1e-20f )
+				return;
+			L1 = 1.0f / sqrtf( L1 );
+
+			float	pe0 = 0.0f, pe1 = 0.0f, pp = 0.0f;
+			for ( int i=0; i < QUADRIC_SIZE; i++ )
+			{
+				e1[i] *= L1;
+				pe0 += _p0[i] * e0[i];
+				pe1 += _p0[i] * e1[i];
+				pp += _p0[i] * _p0[i];
+			}
+
+			// A = I - e0.e0' - e1.e1'
+			// b = (p.e0) e0 + (p.e1) e1 - p
+			// c = p.p - (p.e0)^2 - (p.e1)^2
+			int	k = 0;
+			for ( int i=0; i < QUADRIC_SIZE; i++ )
+			{
+				for ( int j=i; j < QUADRIC_SIZE; j++ )
+					A[k++] += _Weight * ((i == j ? 1.0f : 0.0f) - e0[i]*e0[j] - e1[i]*e1[j]);
+				b[i] += _Weight * (pe0 * e0[i] + pe1 * e1[i] - _p0[i]);
+			}
+			c += _Weight * (pp - pe0*pe0 - pe1*pe1);
+			Weight += _Weight;
+		}
+
+		// Adds the squared distance to a plane of the position space
+		void	AddPlane( const float3& _Normal, float _Distance, float _Weight )
+		{
+			const float*	n = &_Normal.x;
+			int	k = 0;
+			for ( int i=0; i < 3; i++ )
+			{
+				for ( int j=i; j < 3; j++ )
+					A[k++] += _Weight * n[i] * n[j];
+				k += QUADRIC_SIZE - 3;	// Skip attribute columns
+				b[i] += _Weight * _Distance * n[i];
+			}
+			c += _Weight * _Distance * _Distance;
+			Weight += _Weight;
+		}
+
+		// Returns the average squared distance of a point to the accumulated planes
+		float	Evaluate( const float* _x ) const
+		{
+			float	Result = c;
+			int		k = 0;
+			for ( int i=0; i < QUADRIC_SIZE; i++ )
+			{
+				float	xi = _x[i];
+				Result += (A[k++] * xi + 2.0f * b[i]) * xi;
+				for ( int j=i+1; j < QUADRIC_SIZE; j++ )
+					Result += 2.0f * A[k++] * xi * _x[j];
+			}
+			return Weight > 0.0f ? MAX( 0.0f, Result ) / Weight : 0.0f;
+		}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// Counts half-edges
+	//
+	class	EdgeTable
+	{
+		U32*	m_pKeys;	// Start and end vertex indices of each slot, ~0 for empty slots
+		int*	m_pCounts;
+		U32		m_Mask;
+
+	public:
+		EdgeTable( int _MaxEdgesCount )
+		{
+			U32	Size = 1;
+			while ( Size < U32(2*_MaxEdgesCount) )
+				Size <<= 1;
+			m_Mask = Size-1;
+			m_pKeys = new U32[2*Size];
+			m_pCounts = new int[Size];
+		}
+		~EdgeTable()
+		{
+			delete[] m_pKeys;
+			delete[] m_pCounts;
+		}
+
+		void	Clear()
+		{
+			memset( m_pKeys, 0xFF, 2*(m_Mask+1)*sizeof(U32) );
+		}
+
+		void	Add( U32 _V0, U32 _V1 )
+		{
+			U32	Slot = Find( _V0, _V1 );
+			if ( m_pKeys[2*Slot] == ~0U )
+			{
+				m_pKeys[2*Slot+0] = _V0;
+				m_pKeys[2*Slot+1] = _V1;
+				m_pCounts[Slot] = 0;
+			}
+			m_pCounts[Slot]++;
+		}
+
+		int		Count( U32 _V0, U32 _V1 ) const
+		{
+			U32	Slot = Find( _V0, _V1 );
+			return m_pKeys[2*Slot] != ~0U ? m_pCounts[Slot] : 0;
+		}
+
+	private:
+		U32		Find( U32 _V0, U32 _V1 ) const
+		{
+			U32	Slot = ((_V0 * 73856093) ^ (_V1 * 19349663)) & m_Mask;
+			while ( m_pKeys[2*Slot] != ~0U && (m_pKeys[2*Slot+0] != _V0 || m_pKeys[2*Slot+1] != _V1) )
+				Slot = (Slot+1) & m_Mask;
+			return Slot;
+		}
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	// Finds the vertices that share their position with another vertex
+	//	_pTwins receives -1 for unique vertices, the index of the twin for vertices shared by 2, -2 for vertices shared by more
+	//
+	void	FindTwins( const GeometryBuilder::Vertex* _pVertices, int _VerticesCount, int* _pTwins )
+	{
+		U32	Size = 1;
+		while ( Size < U32(2*_VerticesCount) )
+			Size <<= 1;
+		U32	Mask = Size-1;
+
+		int*	pTable = new int[Size];
+		int*	pFirst = new int[_VerticesCount];
+		int*	pGroupCount = new int[_VerticesCount];
+		memset( pTable, 0xFF, Size*sizeof(int) );
+
+		for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		{
+			const float3&	P = _pVertices[VertexIndex].Position;
+			const U32*		pBits = (const U32*) &P.x;
+			U32				Slot = ((pBits[0] * 73856093) ^ (pBits[1] * 19349663) ^ (pBits[2] * 83492791)) & Mask;
+			while ( pTable[Slot] != -1 )
+			{
+				const float3&	Other = _pVertices[pTable[Slot]].Position;
+				if ( Other.x == P.x && Other.y == P.y && Other.z == P.z )
+					break;
+				Slot = (Slot+1) & Mask;
+			}
+
+			if ( pTable[Slot] == -1 )
+			{	// First vertex at that position
+				pTable[Slot] = VertexIndex;
+				pFirst[VertexIndex] = VertexIndex;
+				pGroupCount[VertexIndex] = 1;
+				_pTwins[VertexIndex] = -1;
+			}
+			else
+			{
+				int	First = pTable[Slot];
+				pFirst[VertexIndex] = First;
+				pGroupCount[First]++;
+				if ( pGroupCount[First] == 2 )
+					_pTwins[First] = VertexIndex;	// Remember the second vertex in the first vertex's slot
+			}
+		}
+
+		for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		{
+			int	First = pFirst[VertexIndex];
+			int	GroupCount = pGroupCount[First];
+			if ( GroupCount > 2 )
+				_pTwins[VertexIndex] = -2;
+			else if ( GroupCount == 2 && VertexIndex != First )
+				_pTwins[VertexIndex] = First;
+		}
+
+		delete[] pGroupCount;
+		delete[] pFirst;
+		delete[] pTable;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Classifies vertices given the current triangles
+	//	_pOpenNext, _pOpenPrev receive the next and previous vertices along open edges (i.e. half-edges without an opposite half-edge)
+	//
+	void	ClassifyVertices( const U32* _pIndices, int _IndicesCount, const int* _pTwins, int _VerticesCount, EdgeTable& _Edges, int* _pOpenNext, int* _pOpenPrev, U8* _pKinds )
+	{
+		_Edges.Clear();
+		for ( int i=0; i < _IndicesCount; i+=3 )
+		{
+			_Edges.Add( _pIndices[i+0], _pIndices[i+1] );
+			_Edges.Add( _pIndices[i+1], _pIndices[i+2] );
+			_Edges.Add( _pIndices[i+2], _pIndices[i+0] );
+		}
+
+		for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		{
+			_pOpenNext[VertexIndex] = _pOpenPrev[VertexIndex] = -1;
+			_pKinds[VertexIndex] = _pTwins[VertexIndex] == -2 ? KIND_LOCKED : KIND_INTERIOR;
+		}
+
+		for ( int i=0; i < _IndicesCount; i++ )
+		{
+			U32	V0 = _pIndices[i];
+			U32	V1 = _pIndices[i - (i%3) + (i+1)%3];
+			if ( _Edges.Count( V0, V1 ) > 1 )
+			{	// Non-manifold edge
+				_pKinds[V0] = _pKinds[V1] = KIND_LOCKED;
+				continue;
+			}
+			if ( _Edges.Count( V1, V0 ) != 0 )
+				continue;	// Edge is shared by 2 triangles
+
+			// Open edge
+			if ( _pOpenNext[V0] != -1 )
+				_pKinds[V0] = KIND_LOCKED;	// Several borders meet at that vertex
+			_pOpenNext[V0] = V1;
+			if ( _pOpenPrev[V1] != -1 )
+				_pKinds[V1] = KIND_LOCKED;
+			_pOpenPrev[V1] = V0;
+		}
+
+		for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		{
+			if ( _pKinds[VertexIndex] == KIND_LOCKED )
+				continue;
+
+			bool	bOpenNext = _pOpenNext[VertexIndex] != -1;
+			bool	bOpenPrev = _pOpenPrev[VertexIndex] != -1;
+			if ( bOpenNext != bOpenPrev )
+				_pKinds[VertexIndex] = KIND_LOCKED;	// Broken border
+			else if ( _pTwins[VertexIndex] >= 0 )
+				_pKinds[VertexIndex] = bOpenNext ? KIND_SEAM : KIND_LOCKED;
+			else
+				_pKinds[VertexIndex] = bOpenNext ? KIND_BORDER : KIND_INTERIOR;
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Checks none of the triangles of a vertex would flip if it were collapsed onto a target vertex
+	//	_pRemap, the collapses already performed during the current pass
+	//	_TrianglesRemovedCount is increased by the amount of triangles the collapse would remove
+	//
+	bool	CheckCollapse( const U32* _pIndices, const int* _pAdjacencyOffsets, const int* _pAdjacency, const U32* _pRemap, const GeometryBuilder::Vertex* _pVertices, U32 _Vertex, U32 _Target, int& _TrianglesRemovedCount )
+	{
+		const float3&	Target = _pVertices[_Target].Position;
+		int		TrianglesRemovedCount = 0;
+		for ( int AdjacencyIndex=_pAdjacencyOffsets[_Vertex]; AdjacencyIndex < _pAdjacencyOffsets[_Vertex+1]; AdjacencyIndex++ )
+		{
+			const U32*	pTriangle = &_pIndices[3*_pAdjacency[AdjacencyIndex]];
+			U32		V0 = _pRemap[pTriangle[0]];
+			U32		V1 = _pRemap[pTriangle[1]];
+			U32		V2 = _pRemap[pTriangle[2]];
+			if ( V0 == V1 || V1 == V2 || V2 == V0 )
+				continue;	// Already removed by a previous collapse
+			if ( V0 == _Target || V1 == _Target || V2 == _Target )
+			{	// That triangle will collapse
+				TrianglesRemovedCount++;
+				continue;
+			}
+
+			const float3&	P0 = _pVertices[V0].Position;
+			const float3&	P1 = _pVertices[V1].Position;
+			const float3&	P2 = _pVertices[V2].Position;
+			float3	OldNormal = (P1 - P0) ^ (P2 - P0);
+			float3	NewNormal = V0 == _Vertex ? (P1 - Target) ^ (P2 - Target)
+							  : V1 == _Vertex ? (Target - P0) ^ (P2 - P0)
+							  : (P1 - P0) ^ (Target - P0);
+
+			float	Dot = OldNormal | NewNormal;
+			if ( Dot <= FLIP_THRESHOLD * sqrtf( (OldNormal | OldNormal) * (NewNormal | NewNormal) ) )
+				return false;
+		}
+
+		_TrianglesRemovedCount += TrianglesRemovedCount;
+		return true;
+	}
+}
+
+int		MeshSimplifier::Simplify( const U32* _pIndices, int _IndicesCount, const GeometryBuilder::Vertex* _pVertices, int _VerticesCount, int _TargetIndicesCount, float _MaxError, U32* _pResult, float* _pError )
+{
+	ASSERT( (_IndicesCount % 3) == 0, "Not a triangle list!" );
+
+	if ( _pResult != _pIndices )
+		memcpy( _pResult, _pIndices, _IndicesCount*sizeof(U32) );
+	if ( _pError != NULL )
+		*_pError = 0.0f;
+
+	int		IndicesCount = _IndicesCount;
+	if ( IndicesCount <= _TargetIndicesCount || _VerticesCount == 0 )
+		return IndicesCount;
+
+	// Compute the attributes of each vertex, positions are normalized so errors are relative to the mesh's extent
+	float3	BBoxMin = float3::MaxFlt;
+	float3	BBoxMax = -float3::MaxFlt;
+	for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+	{
+		BBoxMin = BBoxMin.Min( _pVertices[VertexIndex].Position );
+		BBoxMax = BBoxMax.Max( _pVertices[VertexIndex].Position );
+	}
+	float3	Size = BBoxMax - BBoxMin;
+	float	Extent = MAX( MAX( Size.x, Size.y ), Size.z );
+	float	Scale = Extent > 0.0f ? 1.0f / Extent : 1.0f;
+
+	float*	pAttributes = new float[QUADRIC_SIZE*_VerticesCount];
+	for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+	{
+		const GeometryBuilder::Vertex&	V = _pVertices[VertexIndex];
+		float*	x = &pAttributes[QUADRIC_SIZE*VertexIndex];
+		x[0] = (V.Position.x - BBoxMin.x) * Scale;
+		x[1] = (V.Position.y - BBoxMin.y) * Scale;
+		x[2] = (V.Position.z - BBoxMin.z) * Scale;
+		x[3] = NORMAL_WEIGHT * V.Normal.x;
+		x[4] = NORMAL_WEIGHT * V.Normal.y;
+		x[5] = NORMAL_WEIGHT * V.Normal.z;
+		x[6] = UV_WEIGHT * V.UV.x;
+		x[7] = UV_WEIGHT * V.UV.y;
+	}
+
+	// Classify vertices
+	int*		pTwins = new int[_VerticesCount];
+	int*		pOpenNext = new int[_VerticesCount];
+	int*		pOpenPrev = new int[_VerticesCount];
+	U8*			pKinds = new U8[_VerticesCount];
+	EdgeTable	Edges( _IndicesCount );
+
+	FindTwins( _pVertices, _VerticesCount, pTwins );
+	ClassifyVertices( _pResult, IndicesCount, pTwins, _VerticesCount, Edges, pOpenNext, pOpenPrev, pKinds );
+
+	// Accumulate the quadrics of the triangles, and of the planes orthogonal to open edges that keep borders and seams in place
+	Quadric*	pQuadrics = new Quadric[_VerticesCount];
+	memset( pQuadrics, 0, _VerticesCount*sizeof(Quadric) );
+	for ( int i=0; i < IndicesCount; i+=3 )
+	{
+		U32		V0 = _pResult[i+0];
+		U32		V1 = _pResult[i+1];
+		U32		V2 = _pResult[i+2];
+		const float*	p0 = &pAttributes[QUADRIC_SIZE*V0];
+		const float*	p1 = &pAttributes[QUADRIC_SIZE*V1];
+		const float*	p2 = &pAttributes[QUADRIC_SIZE*V2];
+
+		float3	Normal = (float3( p1[0], p1[1], p1[2] ) - float3( p0[0], p0[1], p0[2] )) ^ (float3( p2[0], p2[1], p2[2] ) - float3( p0[0], p0[1], p0[2] ));
+		float	Area = 0.5f * Normal.Length();
+
+		Quadric	Q;
+		memset( &Q, 0, sizeof(Quadric) );
+		Q.AddTriangle( p0, p1, p2, Area );
+
+		for ( int Edge=0; Edge < 3; Edge++ )
+		{
+			U32		E0 = _pResult[i+Edge];
+			U32		E1 = _pResult[i+(Edge+1)%3];
+			if ( Edges.Count( E1, E0 ) != 0 )
+				continue;
+
+			const float*	pE0 = &pAttributes[QUADRIC_SIZE*E0];
+			const float*	pE1 = &pAttributes[QUADRIC_SIZE*E1];
+			float3	Start( pE0[0], pE0[1], pE0[2] );
+			float3	EdgeVector = float3( pE1[0], pE1[1], pE1[2] ) - Start;
+			float3	PlaneNormal = EdgeVector ^ Normal;
+			float	Length = PlaneNormal.Length();
+			if ( Length < 1e-20f )
+				continue;
+			PlaneNormal = PlaneNormal / Length;
+
+			float	Weight = BORDER_WEIGHT * (EdgeVector | EdgeVector);
+			float	Distance = -(PlaneNormal | Start);
+			pQuadrics[E0].AddPlane( PlaneNormal, Distance, Weight );
+			pQuadrics[E1].AddPlane( PlaneNormal, Distance, Weight );
+		}
+
+		pQuadrics[V0].Add( Q );
+		pQuadrics[V1].Add( Q );
+		pQuadrics[V2].Add( Q );
+	}
+
+	// Collapse edges in passes until we reach the target
+	int*	pAdjacencyOffsets = new int[_VerticesCount+1];
+	int*	pAdjacency = new int[_IndicesCount];
+	int*	pTargets = new int[_VerticesCount];
+	float*	pCosts = new float[_VerticesCount];
+	int*	pCandidates = new int[_VerticesCount];
+	int*	pSortedCandidates = new int[_VerticesCount];
+	int*	pBucketOffsets = new int[SORT_BUCKETS_COUNT];
+	U32*	pRemap = new U32[_VerticesCount];
+	bool*	pTouched = new bool[_VerticesCount];
+	bool*	pDirty = new bool[_VerticesCount];
+	memset( pDirty, 1, _VerticesCount*sizeof(bool) );
+
+	float	MaxCost = _MaxError * _MaxError;
+	float	ReachedCost = 0.0f;
+	bool	bFirstPass = true;
+	while ( IndicesCount > _TargetIndicesCount )
+	{
+		if ( !bFirstPass )
+			ClassifyVertices( _pResult, IndicesCount, pTwins, _VerticesCount, Edges, pOpenNext, pOpenPrev, pKinds );
+		bFirstPass = false;
+
+		// Build the vertex => triangles adjacency
+		memset( pAdjacencyOffsets, 0, (_VerticesCount+1)*sizeof(int) );
+		for ( int i=0; i < IndicesCount; i++ )
+			pAdjacencyOffsets[_pResult[i]+1]++;
+		for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+			pAdjacencyOffsets[VertexIndex+1] += pAdjacencyOffsets[VertexIndex];
+		for ( int i=0; i < IndicesCount; i++ )
+			pAdjacency[pAdjacencyOffsets[_pResult[i]]++] = i / 3;
+		for ( int VertexIndex=_VerticesCount; VertexIndex > 0; VertexIndex-- )
+			pAdjacencyOffsets[VertexIndex] = pAdjacencyOffsets[VertexIndex-1];
+		pAdjacencyOffsets[0] = 0;
+
+		// Find the cheapest collapse of each vertex
+		// NOTE: Only the vertices touched by the previous pass need an update since the neighborhood and quadric of the others didn't change
+		int		CandidatesCount = 0;
+		for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		{
+			if ( !pDirty[VertexIndex] )
+			{
+				if ( pTargets[VertexIndex] != -1 && pCosts[VertexIndex] <= MaxCost )
+					pCandidates[CandidatesCount++] = VertexIndex;
+				continue;
+			}
+
+			pTargets[VertexIndex] = -1;
+			pCosts[VertexIndex] = FLOAT32_MAX;
+
+			const Quadric&	Q = pQuadrics[VertexIndex];
+			switch ( pKinds[VertexIndex] )
+			{
+			case KIND_INTERIOR:
+				for ( int AdjacencyIndex=pAdjacencyOffsets[VertexIndex]; AdjacencyIndex < pAdjacencyOffsets[VertexIndex+1]; AdjacencyIndex++ )
+				{
+					const U32*	pTriangle = &_pResult[3*pAdjacency[AdjacencyIndex]];
+					for ( int Corner=0; Corner < 3; Corner++ )
+					{
+						int	Target = pTriangle[Corner];
+						if ( Target == VertexIndex )
+							continue;
+						float	Cost = Q.Evaluate( &pAttributes[QUADRIC_SIZE*Target] );
+						if ( Cost < pCosts[VertexIndex] )
+						{
+							pCosts[VertexIndex] = Cost;
+							pTargets[VertexIndex] = Target;
+						}
+					}
+				}
+				break;
+
+			case KIND_BORDER:
+			case KIND_SEAM:
+				for ( int Side=0; Side < 2; Side++ )
+				{
+					int	Target = Side == 0 ? pOpenNext[VertexIndex] : pOpenPrev[VertexIndex];
+					float	Cost = Q.Evaluate( &pAttributes[QUADRIC_SIZE*Target] );
+					if ( pKinds[VertexIndex] == KIND_SEAM )
+					{	// The twin must be able to collapse onto the target's twin along the other side of the seam
+						int	Twin = pTwins[VertexIndex];
+						int	TargetTwin = pTwins[Target];
+						if ( TargetTwin < 0 || pKinds[Twin] != KIND_SEAM || (pOpenNext[Twin] != TargetTwin && pOpenPrev[Twin] != TargetTwin) )
+							continue;
+						Cost += pQuadrics[Twin].Evaluate( &pAttributes[QUADRIC_SIZE*TargetTwin] );
+					}
+					if ( Cost < pCosts[VertexIndex] )
+					{
+						pCosts[VertexIndex] = Cost;
+						pTargets[VertexIndex] = Target;
+					}
+				}
+				break;
+			}
+
+			if ( pTargets[VertexIndex] != -1 && pCosts[VertexIndex] <= MaxCost )
+				pCandidates[CandidatesCount++] = VertexIndex;
+		}
+
+		// Sort candidates by cost (the top bits of positive floats sort like integers)
+		memset( pBucketOffsets, 0, SORT_BUCKETS_COUNT*sizeof(int) );
+		for ( int CandidateIndex=0; CandidateIndex < CandidatesCount; CandidateIndex++ )
+			pBucketOffsets[(*((U32*) &pCosts[pCandidates[CandidateIndex]]) >> 20) & (SORT_BUCKETS_COUNT-1)]++;
+		int		Offset = 0;
+		for ( int BucketIndex=0; BucketIndex < SORT_BUCKETS_COUNT; BucketIndex++ )
+		{
+			int	Count = pBucketOffsets[BucketIndex];
+			pBucketOffsets[BucketIndex] = Offset;
+			Offset += Count;
+		}
+		for ( int CandidateIndex=0; CandidateIndex < CandidatesCount; CandidateIndex++ )
+		{
+			int	VertexIndex = pCandidates[CandidateIndex];
+			pSortedCandidates[pBucketOffsets[(*((U32*) &pCosts[VertexIndex]) >> 20) & (SORT_BUCKETS_COUNT-1)]++] = VertexIndex;
+		}
+
+		// Collapse the cheapest edges first, leaving the vertices involved in a collapse alone until the next pass
+		for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		{
+			pRemap[VertexIndex] = VertexIndex;
+			pTouched[VertexIndex] = false;
+		}
+
+		int		TrianglesGoal = (IndicesCount - _TargetIndicesCount + 2) / 3;
+		int		TrianglesRemovedCount = 0;
+		int		CollapsesCount = 0;
+		for ( int CandidateIndex=0; CandidateIndex < CandidatesCount && TrianglesRemovedCount < TrianglesGoal; CandidateIndex++ )
+		{
+			U32	Vertex = pSortedCandidates[CandidateIndex];
+			U32	Target = pTargets[Vertex];
+			if ( pTouched[Vertex] || pTouched[Target] )
+				continue;
+
+			bool	bSeam = pKinds[Vertex] == KIND_SEAM;
+			U32		Twin = bSeam ? pTwins[Vertex] : 0;
+			U32		TargetTwin = bSeam ? pTwins[Target] : 0;
+			if ( bSeam && (Twin == Target || pTouched[Twin] || pTouched[TargetTwin]) )
+				continue;
+			if ( bSeam && (pKinds[Twin] != KIND_SEAM || (pOpenNext[Twin] != int(TargetTwin) && pOpenPrev[Twin] != int(TargetTwin))) )
+				continue;	// The other side of the seam changed since we computed that collapse
+
+			int		RemovedCount = 0;
+			if ( !CheckCollapse( _pResult, pAdjacencyOffsets, pAdjacency, pRemap, _pVertices, Vertex, Target, RemovedCount ) )
+				continue;
+			if ( bSeam && !CheckCollapse( _pResult, pAdjacencyOffsets, pAdjacency, pRemap, _pVertices, Twin, TargetTwin, RemovedCount ) )
+				continue;
+
+			// Collapse!
+			pRemap[Vertex] = Target;
+			pQuadrics[Target].Add( pQuadrics[Vertex] );
+			pTouched[Vertex] = pTouched[Target] = true;
+			if ( bSeam )
+			{
+				pRemap[Twin] = TargetTwin;
+				pQuadrics[TargetTwin].Add( pQuadrics[Twin] );
+				pTouched[Twin] = pTouched[TargetTwin] = true;
+			}
+
+			ReachedCost = MAX( ReachedCost, pCosts[Vertex] );
+			TrianglesRemovedCount += RemovedCount;
+			CollapsesCount++;
+		}
+
+		if ( CollapsesCount == 0 )
+			break;	// Can't simplify any further within the error bound
+
+		// Remap indices and remove collapsed triangles
+		// The vertices of the modified triangles (and their twins) will need to update their collapse during the next pass
+		memset( pDirty, 0, _VerticesCount*sizeof(bool) );
+		int		NewIndicesCount = 0;
+		for ( int i=0; i < IndicesCount; i+=3 )
+		{
+			U32	V0 = pRemap[_pResult[i+0]];
+			U32	V1 = pRemap[_pResult[i+1]];
+			U32	V2 = pRemap[_pResult[i+2]];
+			if ( V0 != _pResult[i+0] || V1 != _pResult[i+1] || V2 != _pResult[i+2] )
+				pDirty[V0] = pDirty[V1] = pDirty[V2] = pDirty[_pResult[i+0]] = pDirty[_pResult[i+1]] = pDirty[_pResult[i+2]] = true;
+			if ( V0 == V1 || V1 == V2 || V2 == V0 )
+				continue;
+
+			_pResult[NewIndicesCount++] = V0;
+			_pResult[NewIndicesCount++] = V1;
+			_pResult[NewIndicesCount++] = V2;
+		}
+		IndicesCount = NewIndicesCount;
+
+		for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+			if ( pDirty[VertexIndex] && pTwins[VertexIndex] >= 0 )
+				pDirty[pTwins[VertexIndex]] = true;
+	}
+
+	delete[] pDirty;
+	delete[] pTouched;
+	delete[] pRemap;
+	delete[] pBucketOffsets;
+	delete[] pSortedCandidates;
+	delete[] pCandidates;
+	delete[] pCosts;
+	delete[] pTargets;
+	delete[] pAdjacency;
+	delete[] pAdjacencyOffsets;
+	delete[] pQuadrics;
+	delete[] pKinds;
+	delete[] pOpenPrev;
+	delete[] pOpenNext;
+	delete[] pTwins;
+	delete[] pAttributes;
+
+	if ( _pError != NULL )
+		*_pError = sqrtf( ReachedCost );
+
+	return IndicesCount;
+}
+
+int		MeshSimplifier::BuildLODChain( const U32* _pIndices, int _IndicesCount, const GeometryBuilder::Vertex* _pVertices, int _VerticesCount, int _LODsCount, float _Ratio, float _MaxError, U32* _pLODIndices, int* _pLODIndicesCount, float* _pLODErrors )
+{
+	ASSERT( _LODsCount > 0 && _LODsCount <= MAX_LODS, "Invalid amount of LODs!" );
+	ASSERT( _Ratio > 0.0f && _Ratio < 1.0f, "Invalid LOD ratio!" );
+
+	memcpy( _pLODIndices, _pIndices, _IndicesCount*sizeof(U32) );
+	_pLODIndicesCount[0] = _IndicesCount;
+	if ( _pLODErrors != NULL )
+		_pLODErrors[0] = 0.0f;
+
+	// Each LOD is simplified from the previous one, which is much faster than starting from the original mesh every time
+	const U32*	pPrevious = _pLODIndices;
+	int			PreviousIndicesCount = _IndicesCount;
+	float		Error = 0.0f;
+	int			LODIndex = 1;
+	for ( ; LODIndex < _LODsCount && Error < _MaxError; LODIndex++ )
+	{
+		int		TargetIndicesCount = 3 * int( _Ratio * (PreviousIndicesCount / 3) );
+		U32*	pLOD = _pLODIndices + (pPrevious - _pLODIndices) + PreviousIndicesCount;
+
+		float	LODError;
+		int		IndicesCount = Simplify( pPrevious, PreviousIndicesCount, _pVertices, _VerticesCount, TargetIndicesCount, _MaxError - Error, pLOD, &LODError );
+		if ( IndicesCount == 0 || IndicesCount > 0.95f * PreviousIndicesCount )
+			break;	// Not worth another LOD
+
+		Error += LODError;	// Errors of successive simplifications add up in the worst case
+		_pLODIndicesCount[LODIndex] = IndicesCount;
+		if ( _pLODErrors != NULL )
+			_pLODErrors[LODIndex] = Error;
+
+		pPrevious = pLOD;
+		PreviousIndicesCount = IndicesCount;
+	}
+
+	return LODIndex;
+}
@@ -0,0 +1,30 @@
+//////////////////////////////////////////////////////////////////////////
+// Simplifies triangle lists using quadric error metrics (Garland & Heckbert "Simplifying Surfaces with Color and Texture using Quadric Error Metrics")
+// Quadrics are computed in the combined position + normal + UV space of the P3N3G3B3T2 vertices, and edges are collapsed onto existing vertices
+//	so the simplified index buffers all reference the original vertex buffer
+//
+#pragma once
+
+class	MeshSimplifier
+{
+public:		// CONSTANTS
+
+	static const int	MAX_LODS = 8;
+
+public:		// METHODS
+
+	// Simplifies an indexed triangle list
+	//	_TargetIndicesCount, the amount of indices we'd like to reach
+	//	_MaxError, the maximum error we accept, relative to the mesh's extent (e.g. 0.01 for 1%)
+	//	_pResult, receives the simplified indices (can be the same as _pIndices)
+	//	_pError, optional, receives the error that was reached, relative to the mesh's extent
+	//	Returns the amount of indices written to _pResult
+	static int		Simplify( const U32* _pIndices, int _IndicesCount, const GeometryBuilder::Vertex* _pVertices, int _VerticesCount, int _TargetIndicesCount, float _MaxError, U32* _pResult, float* _pError=NULL );
+
+	// Builds a chain of LODs, each one having about _Ratio times the triangles of the previous one
+	//	_pLODIndices, receives the indices of all the LODs one after the other, LOD 0 being a copy of the original indices (must be able to hold _LODsCount * _IndicesCount indices)
+	//	_pLODIndicesCount, receives the amount of indices of each LOD
+	//	_pLODErrors, optional, receives the error of each LOD relative to the mesh's extent
+	//	Returns the amount of LODs actually built (we stop early once a LOD can't be simplified any further)
+	static int		BuildLODChain( const U32* _pIndices, int _IndicesCount, const GeometryBuilder::Vertex* _pVertices, int _VerticesCount, int _LODsCount, float _Ratio, float _MaxError, U32* _pLODIndices, int* _pLODIndicesCount, float* _pLODErrors=NULL );
+};
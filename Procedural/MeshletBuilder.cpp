@@ -0,0 +1,277 @@
+#include "../GodComplex.h"
+
+int		MeshletBuilder::ComputeMaxMeshletsCount( int _IndicesCount, int _MaxVertices, int _MaxTriangles )
+{
+	// A meshlet is only closed when the next triangle doesn't fit, so it holds at least _MaxVertices/3 triangles
+	int	MinTrianglesPerMeshlet = MAX( 1, MIN( _MaxTriangles, _MaxVertices / 3 ) );
+	int	TrianglesCount = _IndicesCount / 3;
+	return (TrianglesCount + MinTrianglesPerMeshlet-1) / MinTrianglesPerMeshlet;
+}
+
+namespace
+{
+	const float3&	GetPosition( const void* _pVertices, int _VertexStride, U32 _VertexIndex )
+	{
+		return *((const float3*) ((const U8*) _pVertices + _VertexIndex * _VertexStride));
+	}
+
+	// Computes the bounding sphere and normal cone of a meshlet
+	void	ComputeBounds( MeshletBuilder::Meshlet& _Meshlet, const U32* _pIndices, const void* _pVertices, int _VertexStride )
+	{
+		const U32*	pFaces = _pIndices + 3*_Meshlet.StartFace;
+		int			IndicesCount = 3*_Meshlet.FacesCount;
+
+		// Bounding sphere centered on the bounding box
+		float3	BBoxMin = float3::MaxFlt;
+		float3	BBoxMax = -float3::MaxFlt;
+		for ( int i=0; i < IndicesCount; i++ )
+		{
+			const float3&	P = GetPosition( _pVertices, _VertexStride, pFaces[i] );
+			BBoxMin = BBoxMin.Min( P );
+			BBoxMax = BBoxMax.Max( P );
+		}
+		_Meshlet.Center = 0.5f * (BBoxMin + BBoxMax);
+
+		float	SqRadius = 0.0f;
+		for ( int i=0; i < IndicesCount; i++ )
+		{
+			float3	Delta = GetPosition( _pVertices, _VertexStride, pFaces[i] ) - _Meshlet.Center;
+			SqRadius = MAX( SqRadius, Delta | Delta );
+		}
+		_Meshlet.Radius = sqrtf( SqRadius );
+
+		// Normal cone from the face normals
+		float3	Axis = float3::Zero;
+		for ( int i=0; i < IndicesCount; i+=3 )
+		{
+			const float3&	P0 = GetPosition( _pVertices, _VertexStride, pFaces[i+0] );
+			const float3&	P1 = GetPosition( _pVertices, _VertexStride, pFaces[i+1] );
+			const float3&	P2 = GetPosition( _pVertices, _VertexStride, pFaces[i+2] );
+			float3	Normal = (P1 - P0) ^ (P2 - P0);
+			float	Length = Normal.Length();
+			if ( Length > 0.0f )
+				Axis = Axis + Normal / Length;
+		}
+
+		_Meshlet.ConeAxis = float3::UnitZ;
+		_Meshlet.ConeCutoff = 2.0f;	// Can't cull
+		float	AxisLength = Axis.Length();
+		if ( AxisLength < 1e-6f )
+			return;
+		Axis = Axis / AxisLength;
+
+		float	MinDot = 1.0f;
+		for ( int i=0; i < IndicesCount; i+=3 )
+		{
+			const float3&	P0 = GetPosition( _pVertices, _VertexStride, pFaces[i+0] );
+			const float3&	P1 = GetPosition( _pVertices, _VertexStride, pFaces[i+1] );
+			const float3&	P2 = GetPosition( _pVertices, _VertexStride, pFaces[i+2] );
+			float3	Normal = (P1 - P0) ^ (P2 - P0);
+			float	Length = Normal.Length();
+			if ( Length > 0.0f )
+				MinDot = MIN( MinDot, (Normal | Axis) / Length );
+		}
+
+		_Meshlet.ConeAxis = Axis;
+		if ( MinDot > 0.0f )
+			_Meshlet.ConeCutoff = sqrtf( 1.0f - MinDot * MinDot );	// Sine of the cone's half angle
+	}
+}
+
+int		MeshletBuilder::Build( U32* _pIndices, int _IndicesCount, const void* _pVertices, int _VerticesCount, int _VertexStride, Meshlet* _pMeshlets, int _MaxVertices, int _MaxTriangles )
+{
+	ASSERT( (_IndicesCount % 3) == 0, "Not a triangle list!" );
+	ASSERT( _MaxVertices >= 3 && _MaxTriangles >= 1, "Invalid meshlet limits!" );
+
+	int	TrianglesCount = _IndicesCount / 3;
+	if ( TrianglesCount == 0 )
+		return 0;
+
+	// Build the vertex => triangles adjacency
+	int*	pAdjacencyOffsets = new int[_VerticesCount+1];
+	int*	pAdjacency = new int[_IndicesCount];
+	memset( pAdjacencyOffsets, 0, (_VerticesCount+1)*sizeof(int) );
+	for ( int i=0; i < _IndicesCount; i++ )
+	{
+		ASSERT( _pIndices[i] < U32(_VerticesCount), "Index out of range!" );
+		pAdjacencyOffsets[_pIndices[i]+1]++;
+	}
+	for ( int VertexIndex=0; VertexIndex < _VerticesCount; VertexIndex++ )
+		pAdjacencyOffsets[VertexIndex+1] += pAdjacencyOffsets[VertexIndex];
+	for ( int i=0; i < _IndicesCount; i++ )
+		pAdjacency[pAdjacencyOffsets[_pIndices[i]]++] = i / 3;
+	for ( int VertexIndex=_VerticesCount; VertexIndex > 0; VertexIndex-- )
+		pAdjacencyOffsets[VertexIndex] = pAdjacencyOffsets[VertexIndex-1];
+	pAdjacencyOffsets[0] = 0;
+
+	bool*	pEmitted = new bool[TrianglesCount];
+	memset( pEmitted, 0, TrianglesCount*sizeof(bool) );
+	int*	pVertexMeshlet = new int[_VerticesCount];	// Index of the last meshlet that used each vertex
+	memset( pVertexMeshlet, 0xFF, _VerticesCount*sizeof(int) );
+	U32*	pMeshletVertices = new U32[_MaxVertices];
+	U32*	pResult = new U32[_IndicesCount];
+
+	int		MeshletsCount = 0;
+	int		EmittedCount = 0;
+	int		NextUnemitted = 0;
+	while ( EmittedCount < TrianglesCount )
+	{
+		Meshlet&	M = _pMeshlets[MeshletsCount];
+		M.StartFace = EmittedCount;
+		M.FacesCount = 0;
+		M.VerticesCount = 0;
+
+		float3	Sum = float3::Zero;
+		while ( int(M.FacesCount) < _MaxTriangles )
+		{
+			// Find the adjacent triangle that adds the fewest new vertices, and is the closest to the meshlet's center
+			int		BestTriangle = -1;
+			int		BestNewVertices = 4;
+			float	BestSqDistance = FLOAT32_MAX;
+			float3	Center = M.VerticesCount > 0 ? Sum / float(M.VerticesCount) : float3::Zero;
+			for ( U32 MeshletVertexIndex=0; MeshletVertexIndex < M.VerticesCount; MeshletVertexIndex++ )
+			{
+				U32	VertexIndex = pMeshletVertices[MeshletVertexIndex];
+				for ( int AdjacencyIndex=pAdjacencyOffsets[VertexIndex]; AdjacencyIndex < pAdjacencyOffsets[VertexIndex+1]; AdjacencyIndex++ )
+				{
+					int	TriangleIndex = pAdjacency[AdjacencyIndex];
+					if ( pEmitted[TriangleIndex] )
+						continue;
+
+					const U32*	pTriangle = &_pIndices[3*TriangleIndex];
+					int		NewVertices = (pVertexMeshlet[pTriangle[0]] != MeshletsCount) + (pVertexMeshlet[pTriangle[1]] != MeshletsCount) + (pVertexMeshlet[pTriangle[2]] != MeshletsCount);
+					if ( NewVertices > BestNewVertices )
+						continue;
+
+					float3	Centroid = (GetPosition( _pVertices, _VertexStride, pTriangle[0] ) + GetPosition( _pVertices, _VertexStride, pTriangle[1] ) + GetPosition( _pVertices, _VertexStride, pTriangle[2] )) / 3.0f;
+					float3	Delta = Centroid - Center;
+					float	SqDistance = Delta | Delta;
+					if ( NewVertices < BestNewVertices || SqDistance < BestSqDistance )
+					{
+						BestTriangle = TriangleIndex;
+						BestNewVertices = NewVertices;
+						BestSqDistance = SqDistance;
+					}
+				}
+			}
+
+			if ( BestTriangle == -1 )
+			{	// No more adjacent triangle, continue with the next triangle in the original order
+				while ( pEmitted[NextUnemitted] )
+					NextUnemitted++;
+				BestTriangle = NextUnemitted;
+				const U32*	pTriangle = &_pIndices[3*BestTriangle];
+				BestNewVertices = (pVertexMeshlet[pTriangle[0]] != MeshletsCount) + (pVertexMeshlet[pTriangle[1]] != MeshletsCount) + (pVertexMeshlet[pTriangle[2]] != MeshletsCount);
+			}
+
+			if ( int(M.VerticesCount) + BestNewVertices > _MaxVertices )
+				break;	// Meshlet is full
+
+			// Add the triangle to the meshlet
+			const U32*	pTriangle = &_pIndices[3*BestTriangle];
+			for ( int Corner=0; Corner < 3; Corner++ )
+			{
+				U32	VertexIndex = pTriangle[Corner];
+				pResult[3*EmittedCount+Corner] = VertexIndex;
+				if ( pVertexMeshlet[VertexIndex] == MeshletsCount )
+					continue;
+
+				pVertexMeshlet[VertexIndex] = MeshletsCount;
+				pMeshletVertices[M.VerticesCount++] = VertexIndex;
+				Sum = Sum + GetPosition( _pVertices, _VertexStride, VertexIndex );
+			}
+			pEmitted[BestTriangle] = true;
+			EmittedCount++;
+			M.FacesCount++;
+
+			if ( EmittedCount == TrianglesCount )
+				break;
+		}
+
+		MeshletsCount++;
+	}
+
+	memcpy( _pIndices, pResult, _IndicesCount*sizeof(U32) );
+
+	for ( int MeshletIndex=0; MeshletIndex < MeshletsCount; MeshletIndex++ )
+		ComputeBounds( _pMeshlets[MeshletIndex], _pIndices, _pVertices, _VertexStride );
+
+	delete[] pResult;
+	delete[] pMeshletVertices;
+	delete[] pVertexMeshlet;
+	delete[] pEmitted;
+	delete[] pAdjacency;
+	delete[] pAdjacencyOffsets;
+
+	return MeshletsCount;
+}
+
+void	MeshletBuilder::ExtractFrustumPlanes( const float4x4& _Local2Proj, float4 _pPlanes[6] )
+{
+	// We use row vectors so the clip coordinates are the dot products of the position with the columns of the matrix
+	const float*	m = _Local2Proj.m;
+	float4	Column0( m[4*0+0], m[4*1+0], m[4*2+0], m[4*3+0] );
+	float4	Column1( m[4*0+1], m[4*1+1], m[4*2+1], m[4*3+1] );
+	float4	Column2( m[4*0+2], m[4*1+2], m[4*2+2], m[4*3+2] );
+	float4	Column3( m[4*0+3], m[4*1+3], m[4*2+3], m[4*3+3] );
+
+	_pPlanes[0] = Column3 + Column0;	// Left		-W <= X
+	_pPlanes[1] = Column3 - Column0;	// Right	X <= W
+	_pPlanes[2] = Column3 + Column1;	// Bottom	-W <= Y
+	_pPlanes[3] = Column3 - Column1;	// Top		Y <= W
+	_pPlanes[4] = Column2;				// Near		0 <= Z
+	_pPlanes[5] = Column3 - Column2;	// Far		Z <= W
+
+	for ( int PlaneIndex=0; PlaneIndex < 6; PlaneIndex++ )
+	{
+		float4&	Plane = _pPlanes[PlaneIndex];
+		float	Length = sqrtf( Plane.x*Plane.x + Plane.y*Plane.y + Plane.z*Plane.z );
+		if ( Length > 0.0f )
+			Plane = Plane * (1.0f / Length);
+	}
+}
+
+int		MeshletBuilder::Cull( const Meshlet* _pMeshlets, int _MeshletsCount, const float4x4& _Local2Proj, const float3& _LocalCameraPosition, DrawRange* _pRanges, int* _pVisibleMeshletsCount )
+{
+	float4	pPlanes[6];
+	ExtractFrustumPlanes( _Local2Proj, pPlanes );
+
+	int		RangesCount = 0;
+	int		VisibleMeshletsCount = 0;
+	for ( int MeshletIndex=0; MeshletIndex < _MeshletsCount; MeshletIndex++ )
+	{
+		const Meshlet&	M = _pMeshlets[MeshletIndex];
+
+		// Frustum test
+		float4	Center( M.Center, 1.0f );
+		int		PlaneIndex = 0;
+		for ( ; PlaneIndex < 6; PlaneIndex++ )
+			if ( (pPlanes[PlaneIndex] | Center) < -M.Radius )
+				break;
+		if ( PlaneIndex < 6 )
+			continue;	// Outside of the frustum
+
+		// Back-face cone test
+		float3	ToCenter = M.Center - _LocalCameraPosition;
+		if ( (ToCenter | M.ConeAxis) >= M.ConeCutoff * ToCenter.Length() + M.Radius )
+			continue;	// All the triangles face away from the camera
+
+		VisibleMeshletsCount++;
+
+		// Merge with the previous range if contiguous
+		if ( RangesCount > 0 && _pRanges[RangesCount-1].StartFace + _pRanges[RangesCount-1].FacesCount == M.StartFace )
+		{
+			_pRanges[RangesCount-1].FacesCount += M.FacesCount;
+			continue;
+		}
+
+		DrawRange&	Range = _pRanges[RangesCount++];
+		Range.StartFace = M.StartFace;
+		Range.FacesCount = M.FacesCount;
+	}
+
+	if ( _pVisibleMeshletsCount != NULL )
+		*_pVisibleMeshletsCount = VisibleMeshletsCount;
+
+	return RangesCount;
+}
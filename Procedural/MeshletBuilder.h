@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////
+// Splits triangle lists into small clusters of triangles ("meshlets") carrying a bounding sphere and a normal cone
+//	so they can be culled on the CPU and drawn as contiguous ranges of the original index buffer
+// Since we don't have mesh shaders, triangles are reordered so each meshlet is a contiguous range of faces
+//
+#pragma once
+
+class	MeshletBuilder
+{
+public:		// CONSTANTS
+
+	static const int	MAX_VERTICES = 64;		// Default maximum amount of unique vertices per meshlet
+	static const int	MAX_TRIANGLES = 124;	// Default maximum amount of triangles per meshlet
+
+public:		// NESTED TYPES
+
+	struct	Meshlet
+	{
+		U32		StartFace;
+		U32		FacesCount;
+		U32		VerticesCount;		// Amount of unique vertices referenced by the meshlet
+
+		float3	Center;				// Bounding sphere
+		float	Radius;
+
+		float3	ConeAxis;			// Normal cone: the meshlet is back-facing for any camera position P where dot( Center - P, ConeAxis ) >= ConeCutoff * |Center - P| + Radius
+		float	ConeCutoff;			// > 1 when the cone is too wide to ever cull the meshlet
+	};
+
+	struct	DrawRange
+	{
+		U32		StartFace;			// Use Primitive::Render( Material, 0, VerticesCount, 3*StartFace, 3*FacesCount, 0 ) to draw the range
+		U32		FacesCount;
+	};
+
+public:		// METHODS
+
+	// Returns the maximum amount of meshlets Build() can produce
+	static int		ComputeMaxMeshletsCount( int _IndicesCount, int _MaxVertices=MAX_VERTICES, int _MaxTriangles=MAX_TRIANGLES );
+
+	// Reorders the triangles of an indexed triangle list into meshlets
+	//	_pVertices, the vertices of the mesh (the position must be the first field of the vertex)
+	//	_pMeshlets, receives the meshlets (must be able to hold ComputeMaxMeshletsCount() meshlets)
+	//	Returns the amount of meshlets
+	static int		Build( U32* _pIndices, int _IndicesCount, const void* _pVertices, int _VerticesCount, int _VertexStride, Meshlet* _pMeshlets, int _MaxVertices=MAX_VERTICES, int _MaxTriangles=MAX_TRIANGLES );
+
+	// Culls meshlets outside of the view frustum or facing away from the camera, and merges the remaining ones into draw ranges
+	//	_Local2Proj, the LOCAL => PROJECTION transform
+	//	_LocalCameraPosition, the camera position in LOCAL space
+	//	_pRanges, receives the draw ranges (must be able to hold _MeshletsCount ranges)
+	//	_pVisibleMeshletsCount, optional, receives the amount of meshlets that passed the tests
+	//	Returns the amount of draw ranges
+	static int		Cull( const Meshlet* _pMeshlets, int _MeshletsCount, const float4x4& _Local2Proj, const float3& _LocalCameraPosition, DrawRange* _pRanges, int* _pVisibleMeshletsCount=NULL );
+
+	// Extracts the 6 planes of the view frustum from a LOCAL => PROJECTION transform (planes point inside the frustum and are normalized)
+	static void		ExtractFrustumPlanes( const float4x4& _Local2Proj, float4 _pPlanes[6] );
+};
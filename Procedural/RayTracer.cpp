@@ -1,23 +1,60 @@
 #include "../GodComplex.h"
+#include <xmmintrin.h>
+#include <emmintrin.h>
 
-RayTracer::RayTracer() : m_pQuads( NULL )
+RayTracer::RayTracer()
+	: m_QuadsCount( 0 )
+	, m_pQuads( NULL )
+	, m_MeshesCount( 0 )
+	, m_MeshesCapacity( 0 )
+	, m_ppMeshes( NULL )
+	, m_InstancesCount( 0 )
+	, m_InstancesCapacity( 0 )
+	, m_pInstances( NULL )
 {
+	memset( &m_UpdateStats, 0, sizeof(UpdateStats) );
+	memset( &m_LastUpdateStats, 0, sizeof(UpdateStats) );
 }
 RayTracer::~RayTracer()
 {
 	ExitGeometry();
+	ExitMeshes();
 }
 
 void	RayTracer::InitGeometry( int _QuadsCount, const Quad* _pQuads )
 {
 	ExitGeometry();
 
+	// Build the hierarchy from the bounding boxes of the quads
+	float3*	pBBoxMin = new float3[_QuadsCount];
+	float3*	pBBoxMax = new float3[_QuadsCount];
+	for ( int QuadIndex=0; QuadIndex < _QuadsCount; QuadIndex++ )
+	{
+		const Quad&	Source = _pQuads[QuadIndex];
+		float3	Normal = Source.Normal;
+		float3	Tangent = Source.Tangent;
+		Normal.Normalize();
+		Tangent.Normalize();
+		float3	BiTangent = Normal ^ Tangent;
+
+		float3	HalfExtent = 0.5f * Source.Size.x * float3( abs(Tangent.x), abs(Tangent.y), abs(Tangent.z) )
+						   + 0.5f * Source.Size.y * float3( abs(BiTangent.x), abs(BiTangent.y), abs(BiTangent.z) );
+		pBBoxMin[QuadIndex] = Source.Center - HalfExtent;
+		pBBoxMax[QuadIndex] = Source.Center + HalfExtent;
+	}
+
+	m_BVH.Build( _QuadsCount, pBBoxMin, pBBoxMax );
+
+	delete[] pBBoxMax;
+	delete[] pBBoxMin;
+
+	// Store the quads in the order of the leaves
 	m_QuadsCount = _QuadsCount;
 	m_pQuads = new Quad_Internal[_QuadsCount];
 
 	for ( int QuadIndex=0; QuadIndex < m_QuadsCount; QuadIndex++ )
 	{
-		const Quad&		Source = _pQuads[QuadIndex];
+		const Quad&		Source = _pQuads[m_BVH.m_pPrimitiveIndices[QuadIndex]];
 		Quad_Internal&	Target = m_pQuads[QuadIndex];
 		memcpy( &Target, &Source, sizeof(Quad) );
 
@@ -28,37 +65,597 @@ void	RayTracer::InitGeometry( int _QuadsCount, const Quad* _pQuads )
 	}
 }
 
-bool	RayTracer::Trace( Ray& _Ray )
+namespace
 {
-	_Ray.pHitQuad = NULL;
-	_Ray.HitDistance = FLOAT32_MAX;	// Infinity...
-
-	Quad_Internal*	pQuad = m_pQuads;
-	for ( int QuadIndex=0; QuadIndex < m_QuadsCount; QuadIndex++, pQuad++ )
+	// Intersects a ray with a quad, updates the ray and returns true if the quad is hit closer than the ray's current hit
+	bool	IntersectQuad( RayTracer::Ray& _Ray, RayTracer::Quad_Internal* _pQuad )
 	{
-		float3	ToCenter = pQuad->Center - _Ray.Position;
-		float		HeightFromQuad = ToCenter | pQuad->Normal;		// Negative if above quad
-		float		SlopeToQuad = _Ray.Direction | pQuad->Normal;	// Rate at which we get closer to the quad
+		float3	ToCenter = _pQuad->Center - _Ray.Position;
+		float		HeightFromQuad = ToCenter | _pQuad->Normal;		// Negative if above quad
+		float		SlopeToQuad = _Ray.Direction | _pQuad->Normal;	// Rate at which we get closer to the quad
 		float		HitDistance = HeightFromQuad / SlopeToQuad;		// Distance at which we'll hit the quad's plane
 		if ( HitDistance <= 0.0f || HitDistance > _Ray.HitDistance )
-			continue;	// No hit, or we hit too far away from best hit...
+			return false;	// No hit, or we hit too far away from best hit...
 
 		// Compute hit position and check we're within the quad
 		float3	HitPosition = _Ray.Position + HitDistance * _Ray.Direction;	// Position within quad's plane
-		float3	FromCenter = HitPosition - pQuad->Center;
-		float		DistanceX = FromCenter | pQuad->Tangent;
-		float		DistanceY = FromCenter | pQuad->BiTangent;
-		if ( abs(DistanceX) > pQuad->SizeAndInvSize.x || abs(DistanceY) > pQuad->SizeAndInvSize.y )
-			continue;	// We hit outside the quad...
+		float3	FromCenter = HitPosition - _pQuad->Center;
+		float		DistanceX = FromCenter | _pQuad->Tangent;
+		float		DistanceY = FromCenter | _pQuad->BiTangent;
+		if ( abs(DistanceX) > _pQuad->SizeAndInvSize.x || abs(DistanceY) > _pQuad->SizeAndInvSize.y )
+			return false;	// We hit outside the quad...
 
 		// We have a hit !
 		// Now, all we need to do is to find the UVs where it happened
 		_Ray.HitDistance = HitDistance;
-		_Ray.pHitQuad = pQuad;
-		_Ray.HitUV.Set( 0.5f + DistanceX * pQuad->SizeAndInvSize.z, 0.5f + DistanceY * pQuad->SizeAndInvSize.w );
+		_Ray.pHitQuad = _pQuad;
+		_Ray.HitUV.Set( 0.5f + DistanceX * _pQuad->SizeAndInvSize.z, 0.5f + DistanceY * _pQuad->SizeAndInvSize.w );
+
+		return true;
+	}
+
+	// A ray in the LOCAL space of an instance, prepared for the watertight triangle test
+	struct	WatertightRay
+	{
+		float3	Position;
+		float3	Direction;		// Not normalized so hit distances are the same in LOCAL and WORLD space
+		float3	InvDirection;
+		int		kx, ky, kz;		// Permutation of the axes so that Z is the largest component of the direction
+		float	Sx, Sy, Sz;		// Shear that aligns the direction with Z
+	};
+
+	void	PrepareWatertightRay( WatertightRay& _LocalRay, const RayTracer::Instance& _Instance, const RayTracer::Ray& _Ray )
+	{
+		float4	LocalPosition = float4( _Ray.Position, 1.0f ) * _Instance.World2Local;
+		float4	LocalDirection = float4( _Ray.Direction, 0.0f ) * _Instance.World2Local;
+		_LocalRay.Position.Set( LocalPosition.x, LocalPosition.y, LocalPosition.z );
+		_LocalRay.Direction.Set( LocalDirection.x, LocalDirection.y, LocalDirection.z );
+		_LocalRay.InvDirection = BVH::ComputeInvDirection( _LocalRay.Direction );
+
+		const float*	D = &_LocalRay.Direction.x;
+		_LocalRay.kz = abs(D[0]) > abs(D[1]) ? (abs(D[0]) > abs(D[2]) ? 0 : 2) : (abs(D[1]) > abs(D[2]) ? 1 : 2);
+		_LocalRay.kx = (_LocalRay.kz + 1) % 3;
+		_LocalRay.ky = (_LocalRay.kx + 1) % 3;
+		if ( D[_LocalRay.kz] < 0.0f )
+		{	// Swap to preserve the winding
+			int	Temp = _LocalRay.kx;
+			_LocalRay.kx = _LocalRay.ky;
+			_LocalRay.ky = Temp;
+		}
+
+		_LocalRay.Sz = 1.0f / D[_LocalRay.kz];
+		_LocalRay.Sx = D[_LocalRay.kx] * _LocalRay.Sz;
+		_LocalRay.Sy = D[_LocalRay.ky] * _LocalRay.Sz;
+	}
+
+	// Watertight ray/triangle test, updates the hit distance and barycentrics if the triangle is hit closer than _HitDistance
+	bool	IntersectTriangle( const WatertightRay& _Ray, const RayTracer::Triangle& _Triangle, float& _HitDistance, float2& _HitUV )
+	{
+		float3	A = _Triangle.P0 - _Ray.Position;
+		float3	B = _Triangle.P1 - _Ray.Position;
+		float3	C = _Triangle.P2 - _Ray.Position;
+		const float*	pA = &A.x;
+		const float*	pB = &B.x;
+		const float*	pC = &C.x;
+
+		// Shear and scale the vertices so the ray goes along +Z
+		float	Ax = pA[_Ray.kx] - _Ray.Sx * pA[_Ray.kz];
+		float	Ay = pA[_Ray.ky] - _Ray.Sy * pA[_Ray.kz];
+		float	Bx = pB[_Ray.kx] - _Ray.Sx * pB[_Ray.kz];
+		float	By = pB[_Ray.ky] - _Ray.Sy * pB[_Ray.kz];
+		float	Cx = pC[_Ray.kx] - _Ray.Sx * pC[_Ray.kz];
+		float	Cy = pC[_Ray.ky] - _Ray.Sy * pC[_Ray.kz];
+
+		// Scaled barycentrics as 2D edge functions
+		float	U = Cx * By - Cy * Bx;
+		float	V = Ax * Cy - Ay * Cx;
+		float	W = Bx * Ay - By * Ax;
+		if ( U == 0.0f || V == 0.0f || W == 0.0f )
+		{	// Fall back to double precision on the edges so a ray going exactly through an edge hits one of the 2 triangles
+			U = float( double(Cx) * double(By) - double(Cy) * double(Bx) );
+			V = float( double(Ax) * double(Cy) - double(Ay) * double(Cx) );
+			W = float( double(Bx) * double(Ay) - double(By) * double(Ax) );
+		}
+
+		if ( (U < 0.0f || V < 0.0f || W < 0.0f) && (U > 0.0f || V > 0.0f || W > 0.0f) )
+			return false;	// Outside the triangle
+
+		float	Det = U + V + W;
+		if ( Det == 0.0f )
+			return false;	// Ray parallel to the triangle
+
+		// Compute the scaled hit distance
+		float	Az = _Ray.Sz * pA[_Ray.kz];
+		float	Bz = _Ray.Sz * pB[_Ray.kz];
+		float	Cz = _Ray.Sz * pC[_Ray.kz];
+		float	T = U * Az + V * Bz + W * Cz;
+		if ( Det < 0.0f )
+		{	// Back face, flip the signs so we can compare without dividing
+			U = -U;	V = -V;	W = -W;
+			T = -T;
+			Det = -Det;
+		}
+		if ( T <= 0.0f || T > _HitDistance * Det )
+			return false;	// Behind the ray, or too far away from best hit...
+
+		float	InvDet = 1.0f / Det;
+		_HitDistance = T * InvDet;
+		_HitUV.Set( V * InvDet, W * InvDet );
+
+		return true;
+	}
+}
+
+bool	RayTracer::Trace( Ray& _Ray )
+{
+	_Ray.pHitQuad = NULL;
+	_Ray.pHitTriangle = NULL;
+	_Ray.HitInstanceIndex = -1;
+	_Ray.HitTriangleIndex = -1;
+	_Ray.HitDistance = FLOAT32_MAX;	// Infinity...
+
+	TraceQuads( _Ray, false );
+	TraceInstances( _Ray, false );
+
+	return _Ray.pHitQuad != NULL || _Ray.pHitTriangle != NULL;
+}
+
+bool	RayTracer::TraceAny( Ray& _Ray )
+{
+	_Ray.pHitQuad = NULL;
+	_Ray.pHitTriangle = NULL;
+	_Ray.HitInstanceIndex = -1;
+	_Ray.HitTriangleIndex = -1;
+
+	return TraceQuads( _Ray, true ) || TraceInstances( _Ray, true );
+}
+
+bool	RayTracer::TraceQuads( Ray& _Ray, bool _bAnyHit )
+{
+	if ( m_BVH.m_NodesCount == 0 )
+		return false;
+
+	float3	InvDirection = BVH::ComputeInvDirection( _Ray.Direction );
+	bool	pDirectionIsNegative[3] = { _Ray.Direction.x < 0.0f, _Ray.Direction.y < 0.0f, _Ray.Direction.z < 0.0f };
+
+	bool	bHit = false;
+	int		pStack[BVH::MAX_DEPTH];
+	int		StackSize = 0;
+	int		NodeIndex = 0;
+	while ( true )
+	{
+		const BVH::Node&	N = m_BVH.m_pNodes[NodeIndex];
+		if ( BVH::IntersectBox( N, _Ray.Position, InvDirection, _Ray.HitDistance ) )
+		{
+			if ( N.IsLeaf() )
+			{
+				Quad_Internal*	pQuad = &m_pQuads[N.Offset];
+				for ( int QuadIndex=0; QuadIndex < N.PrimitivesCount; QuadIndex++, pQuad++ )
+					if ( IntersectQuad( _Ray, pQuad ) )
+					{
+						bHit = true;
+						if ( _bAnyHit )
+							return true;	// Any hit will do
+					}
+			}
+			else
+			{	// Visit the nearest child first, hoping to shorten the ray before we visit the other one
+				ASSERT( StackSize < BVH::MAX_DEPTH, "BVH is too deep!" );
+				if ( pDirectionIsNegative[N.Axis] )
+				{
+					pStack[StackSize++] = NodeIndex+1;
+					NodeIndex = N.Offset;
+				}
+				else
+				{
+					pStack[StackSize++] = N.Offset;
+					NodeIndex++;
+				}
+				continue;
+			}
+		}
+
+		if ( StackSize == 0 )
+			break;
+		NodeIndex = pStack[--StackSize];
+	}
+
+	return bHit;
+}
+
+bool	RayTracer::TraceBruteForce( Ray& _Ray )
+{
+	_Ray.pHitQuad = NULL;
+	_Ray.pHitTriangle = NULL;
+	_Ray.HitInstanceIndex = -1;
+	_Ray.HitTriangleIndex = -1;
+	_Ray.HitDistance = FLOAT32_MAX;	// Infinity...
+
+	Quad_Internal*	pQuad = m_pQuads;
+	for ( int QuadIndex=0; QuadIndex < m_QuadsCount; QuadIndex++, pQuad++ )
+		IntersectQuad( _Ray, pQuad );
+
+	for ( int InstanceIndex=0; InstanceIndex < m_InstancesCount; InstanceIndex++ )
+	{
+		const Instance&	I = m_pInstances[InstanceIndex];
+		const Mesh&		M = *m_ppMeshes[I.MeshIndex];
+
+		WatertightRay	LocalRay;
+		PrepareWatertightRay( LocalRay, I, _Ray );
+		for ( int TriangleIndex=0; TriangleIndex < M.TrianglesCount; TriangleIndex++ )
+			if ( IntersectTriangle( LocalRay, M.pTriangles[TriangleIndex], _Ray.HitDistance, _Ray.HitUV ) )
+			{
+				_Ray.pHitQuad = NULL;
+				_Ray.pHitTriangle = &M.pTriangles[TriangleIndex];
+				_Ray.HitInstanceIndex = InstanceIndex;
+				_Ray.HitTriangleIndex = M.Hierarchy.m_pPrimitiveIndices[TriangleIndex];
+			}
+	}
+
+	return _Ray.pHitQuad != NULL || _Ray.pHitTriangle != NULL;
+}
+
+namespace
+{
+	// 4 rays of a packet in SoA layout
+	struct	RayGroup
+	{
+		__m128	Ox, Oy, Oz;
+		__m128	Dx, Dy, Dz;
+		__m128	InvDx, InvDy, InvDz;
+		__m128	HitDistance;
+		__m128	HitU, HitV;
+		__m128i	HitQuadIndex;
+	};
+
+	void	LoadRayGroup( RayGroup& _Group, const RayTracer::Ray* _pRays, int _RaysCount )
+	{
+		float	pO[3][4], pD[3][4], pInvD[3][4], pHitDistance[4];
+		for ( int i=0; i < 4; i++ )
+		{
+			const RayTracer::Ray&	R = _pRays[MIN( i, _RaysCount-1 )];
+			float3	InvDirection = BVH::ComputeInvDirection( R.Direction );
+			pO[0][i] = R.Position.x;	pO[1][i] = R.Position.y;	pO[2][i] = R.Position.z;
+			pD[0][i] = R.Direction.x;	pD[1][i] = R.Direction.y;	pD[2][i] = R.Direction.z;
+			pInvD[0][i] = InvDirection.x;	pInvD[1][i] = InvDirection.y;	pInvD[2][i] = InvDirection.z;
+			pHitDistance[i] = i < _RaysCount ? FLOAT32_MAX : -1.0f;	// Unused lanes can't hit anything
+		}
+
+		_Group.Ox = _mm_loadu_ps( pO[0] );	_Group.Oy = _mm_loadu_ps( pO[1] );	_Group.Oz = _mm_loadu_ps( pO[2] );
+		_Group.Dx = _mm_loadu_ps( pD[0] );	_Group.Dy = _mm_loadu_ps( pD[1] );	_Group.Dz = _mm_loadu_ps( pD[2] );
+		_Group.InvDx = _mm_loadu_ps( pInvD[0] );	_Group.InvDy = _mm_loadu_ps( pInvD[1] );	_Group.InvDz = _mm_loadu_ps( pInvD[2] );
+		_Group.HitDistance = _mm_loadu_ps( pHitDistance );
+		_Group.HitU = _Group.HitV = _mm_setzero_ps();
+		_Group.HitQuadIndex = _mm_set1_epi32( -1 );
+	}
+
+	// Returns the mask of the rays hitting the node's bounding box closer than their current hit
+	int		IntersectBox( const BVH::Node& _Node, const RayGroup& _Group )
+	{
+		__m128	t0x = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( _Node.BBoxMin.x ), _Group.Ox ), _Group.InvDx );
+		__m128	t1x = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( _Node.BBoxMax.x ), _Group.Ox ), _Group.InvDx );
+		__m128	t0y = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( _Node.BBoxMin.y ), _Group.Oy ), _Group.InvDy );
+		__m128	t1y = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( _Node.BBoxMax.y ), _Group.Oy ), _Group.InvDy );
+		__m128	t0z = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( _Node.BBoxMin.z ), _Group.Oz ), _Group.InvDz );
+		__m128	t1z = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( _Node.BBoxMax.z ), _Group.Oz ), _Group.InvDz );
+		__m128	tMin = _mm_max_ps( _mm_max_ps( _mm_min_ps( t0x, t1x ), _mm_min_ps( t0y, t1y ) ), _mm_max_ps( _mm_min_ps( t0z, t1z ), _mm_setzero_ps() ) );
+		__m128	tMax = _mm_min_ps( _mm_min_ps( _mm_max_ps( t0x, t1x ), _mm_max_ps( t0y, t1y ) ), _mm_min_ps( _mm_max_ps( t0z, t1z ), _Group.HitDistance ) );
+		return _mm_movemask_ps( _mm_cmple_ps( tMin, _mm_mul_ps( tMax, _mm_set1_ps( BVH::BOX_EXIT_SCALE ) ) ) );
+	}
+
+	// Same as the single ray IntersectQuad() for 4 rays at once
+	void	IntersectQuad( RayGroup& _Group, const RayTracer::Quad_Internal& _Quad, int _QuadIndex )
+	{
+		__m128	Nx = _mm_set1_ps( _Quad.Normal.x ), Ny = _mm_set1_ps( _Quad.Normal.y ), Nz = _mm_set1_ps( _Quad.Normal.z );
+		__m128	Cx = _mm_set1_ps( _Quad.Center.x ), Cy = _mm_set1_ps( _Quad.Center.y ), Cz = _mm_set1_ps( _Quad.Center.z );
+
+		__m128	HeightFromQuad = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_sub_ps( Cx, _Group.Ox ), Nx ), _mm_mul_ps( _mm_sub_ps( Cy, _Group.Oy ), Ny ) ), _mm_mul_ps( _mm_sub_ps( Cz, _Group.Oz ), Nz ) );
+		__m128	SlopeToQuad = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _Group.Dx, Nx ), _mm_mul_ps( _Group.Dy, Ny ) ), _mm_mul_ps( _Group.Dz, Nz ) );
+		__m128	HitDistance = _mm_div_ps( HeightFromQuad, SlopeToQuad );
+		__m128	HitMask = _mm_and_ps( _mm_cmpgt_ps( HitDistance, _mm_setzero_ps() ), _mm_cmple_ps( HitDistance, _Group.HitDistance ) );
+		if ( _mm_movemask_ps( HitMask ) == 0 )
+			return;
+
+		// Compute hit positions and check we're within the quad
+		__m128	FromCenterX = _mm_sub_ps( _mm_add_ps( _Group.Ox, _mm_mul_ps( HitDistance, _Group.Dx ) ), Cx );
+		__m128	FromCenterY = _mm_sub_ps( _mm_add_ps( _Group.Oy, _mm_mul_ps( HitDistance, _Group.Dy ) ), Cy );
+		__m128	FromCenterZ = _mm_sub_ps( _mm_add_ps( _Group.Oz, _mm_mul_ps( HitDistance, _Group.Dz ) ), Cz );
+		__m128	DistanceX = _mm_add_ps( _mm_add_ps( _mm_mul_ps( FromCenterX, _mm_set1_ps( _Quad.Tangent.x ) ), _mm_mul_ps( FromCenterY, _mm_set1_ps( _Quad.Tangent.y ) ) ), _mm_mul_ps( FromCenterZ, _mm_set1_ps( _Quad.Tangent.z ) ) );
+		__m128	DistanceY = _mm_add_ps( _mm_add_ps( _mm_mul_ps( FromCenterX, _mm_set1_ps( _Quad.BiTangent.x ) ), _mm_mul_ps( FromCenterY, _mm_set1_ps( _Quad.BiTangent.y ) ) ), _mm_mul_ps( FromCenterZ, _mm_set1_ps( _Quad.BiTangent.z ) ) );
+
+		__m128	AbsMask = _mm_castsi128_ps( _mm_set1_epi32( 0x7FFFFFFF ) );
+		HitMask = _mm_and_ps( HitMask, _mm_cmple_ps( _mm_and_ps( DistanceX, AbsMask ), _mm_set1_ps( _Quad.SizeAndInvSize.x ) ) );
+		HitMask = _mm_and_ps( HitMask, _mm_cmple_ps( _mm_and_ps( DistanceY, AbsMask ), _mm_set1_ps( _Quad.SizeAndInvSize.y ) ) );
+		if ( _mm_movemask_ps( HitMask ) == 0 )
+			return;
+
+		// Keep the new hits
+		__m128	Half = _mm_set1_ps( 0.5f );
+		__m128	HitU = _mm_add_ps( Half, _mm_mul_ps( DistanceX, _mm_set1_ps( _Quad.SizeAndInvSize.z ) ) );
+		__m128	HitV = _mm_add_ps( Half, _mm_mul_ps( DistanceY, _mm_set1_ps( _Quad.SizeAndInvSize.w ) ) );
+		__m128i	HitMaskInt = _mm_castps_si128( HitMask );
+
+		_Group.HitDistance = _mm_or_ps( _mm_and_ps( HitMask, HitDistance ), _mm_andnot_ps( HitMask, _Group.HitDistance ) );
+		_Group.HitU = _mm_or_ps( _mm_and_ps( HitMask, HitU ), _mm_andnot_ps( HitMask, _Group.HitU ) );
+		_Group.HitV = _mm_or_ps( _mm_and_ps( HitMask, HitV ), _mm_andnot_ps( HitMask, _Group.HitV ) );
+		_Group.HitQuadIndex = _mm_or_si128( _mm_and_si128( HitMaskInt, _mm_set1_epi32( _QuadIndex ) ), _mm_andnot_si128( HitMaskInt, _Group.HitQuadIndex ) );
+	}
+}
+
+U32		RayTracer::TracePacket( Ray* _pRays, int _RaysCount )
+{
+	ASSERT( _RaysCount > 0 && _RaysCount <= PACKET_SIZE, "Invalid amount of rays in the packet!" );
+
+	int			GroupsCount = (_RaysCount + 3) >> 2;
+	RayGroup	pGroups[PACKET_SIZE/4];
+	for ( int GroupIndex=0; GroupIndex < GroupsCount; GroupIndex++ )
+		LoadRayGroup( pGroups[GroupIndex], _pRays + 4*GroupIndex, _RaysCount - 4*GroupIndex );
+
+	if ( m_BVH.m_NodesCount > 0 )
+	{
+		// The order of the children is given by the first ray, assuming the other rays go roughly the same way
+		bool	pDirectionIsNegative[3] = { _pRays[0].Direction.x < 0.0f, _pRays[0].Direction.y < 0.0f, _pRays[0].Direction.z < 0.0f };
+
+		int		pStack[BVH::MAX_DEPTH];
+		int		StackSize = 0;
+		int		NodeIndex = 0;
+		while ( true )
+		{
+			const BVH::Node&	N = m_BVH.m_pNodes[NodeIndex];
+
+			int	ActiveMask = 0;
+			for ( int GroupIndex=0; GroupIndex < GroupsCount; GroupIndex++ )
+				ActiveMask |= IntersectBox( N, pGroups[GroupIndex] ) << (4*GroupIndex);
+
+			if ( ActiveMask != 0 )
+			{
+				if ( N.IsLeaf() )
+				{
+					for ( int GroupIndex=0; GroupIndex < GroupsCount; GroupIndex++ )
+					{
+						if ( ((ActiveMask >> (4*GroupIndex)) & 0xF) == 0 )
+							continue;	// No ray of that group hit the leaf
+
+						for ( int QuadIndex=N.Offset; QuadIndex < int(N.Offset + N.PrimitivesCount); QuadIndex++ )
+							IntersectQuad( pGroups[GroupIndex], m_pQuads[QuadIndex], QuadIndex );
+					}
+				}
+				else
+				{
+					ASSERT( StackSize < BVH::MAX_DEPTH, "BVH is too deep!" );
+					if ( pDirectionIsNegative[N.Axis] )
+					{
+						pStack[StackSize++] = NodeIndex+1;
+						NodeIndex = N.Offset;
+					}
+					else
+					{
+						pStack[StackSize++] = N.Offset;
+						NodeIndex++;
+					}
+					continue;
+				}
+			}
+
+			if ( StackSize == 0 )
+				break;
+			NodeIndex = pStack[--StackSize];
+		}
+	}
+
+	// Write back the hits
+	U32	HitMask = 0;
+	for ( int GroupIndex=0; GroupIndex < GroupsCount; GroupIndex++ )
+	{
+		const RayGroup&	G = pGroups[GroupIndex];
+		float	pHitDistance[4], pHitU[4], pHitV[4];
+		int		pHitQuadIndex[4];
+		_mm_storeu_ps( pHitDistance, G.HitDistance );
+		_mm_storeu_ps( pHitU, G.HitU );
+		_mm_storeu_ps( pHitV, G.HitV );
+		_mm_storeu_si128( (__m128i*) pHitQuadIndex, G.HitQuadIndex );
+
+		int	LanesCount = MIN( 4, _RaysCount - 4*GroupIndex );
+		for ( int LaneIndex=0; LaneIndex < LanesCount; LaneIndex++ )
+		{
+			Ray&	R = _pRays[4*GroupIndex+LaneIndex];
+			R.HitDistance = pHitDistance[LaneIndex];
+			R.pHitQuad = NULL;
+			R.pHitTriangle = NULL;
+			R.HitInstanceIndex = -1;
+			R.HitTriangleIndex = -1;
+			if ( pHitQuadIndex[LaneIndex] < 0 )
+				continue;
+
+			R.pHitQuad = &m_pQuads[pHitQuadIndex[LaneIndex]];
+			R.HitUV.Set( pHitU[LaneIndex], pHitV[LaneIndex] );
+			HitMask |= 1 << (4*GroupIndex+LaneIndex);
+		}
+	}
+
+	// Trace triangles individually
+	if ( m_InstancesCount > 0 )
+		for ( int RayIndex=0; RayIndex < _RaysCount; RayIndex++ )
+			if ( TraceInstances( _pRays[RayIndex], false ) )
+				HitMask |= 1 << RayIndex;
+
+	return HitMask;
+}
+
+namespace
+{
+	// Processes a chunk of rays and returns the amount of rays that hit something
+	typedef int	(*ChunkDelegate)( int _ChunkIndex, int _ThreadIndex, void* _pData );
+
+	struct __DispatchChunksStruct
+	{
+		ChunkDelegate	pDelegate;
+		void*			pData;
+		volatile LONG	HitsCount;
+	};
+
+	void	DispatchChunksRange( int _Start, int _End, void* _pData )
+	{
+		__DispatchChunksStruct&	Params = *((__DispatchChunksStruct*) _pData);
+		int		ThreadIndex = JobSystem::GetThreadIndex();
+
+		int		HitsCount = 0;
+		for ( int Chunk=_Start; Chunk < _End; Chunk++ )
+			HitsCount += (*Params.pDelegate)( Chunk, ThreadIndex, Params.pData );
+
+		InterlockedExchangeAdd( &Params.HitsCount, HitsCount );
+	}
+
+	// Dispatches chunks of rays on the job system and returns the total amount of hits
+	// The chunks are split in contiguous ranges so each thread keeps tracing coherent rays, and idle threads steal the largest ranges left
+	int		DispatchChunks( int _ChunksCount, ChunkDelegate _Delegate, void* _pData )
+	{
+		ASSERT( JobSystem::MAX_THREADS <= RayTracer::MAX_THREADS, "Per-thread data are indexed by the job system's thread index!" );
+
+		__DispatchChunksStruct	Params;
+		Params.pDelegate = _Delegate;
+		Params.pData = _pData;
+		Params.HitsCount = 0;
+
+		JobSystem::ParallelFor( _ChunksCount, DispatchChunksRange, &Params, 1 );
+
+		return Params.HitsCount;
+	}
+
+	// Very large arrays of rays use larger chunks so we don't submit too many jobs
+	int		ComputeChunkSize( int _RaysCount )
+	{
+		int		PacketsCount = (_RaysCount + RayTracer::PACKET_SIZE - 1) / RayTracer::PACKET_SIZE;
+		return RayTracer::PACKET_SIZE * MAX( RayTracer::STREAM_CHUNK_SIZE / RayTracer::PACKET_SIZE, (PacketsCount + 0xFFFE) / 0xFFFF );
+	}
+
+	struct __TraceStreamStruct
+	{
+		RayTracer*		pTracer;
+		RayTracer::Ray*	pRays;
+		int				RaysCount;
+		int				ChunkSize;
+	};
+
+	int		TraceStreamChunk( int _ChunkIndex, int _ThreadIndex, void* _pData )
+	{
+		__TraceStreamStruct&	Params = *((__TraceStreamStruct*) _pData);
+
+		int		HitsCount = 0;
+		int		RayIndex = _ChunkIndex * Params.ChunkSize;
+		int		RaysCount = MIN( Params.ChunkSize, Params.RaysCount - RayIndex );
+		for ( ; RaysCount > 0; RayIndex+=RayTracer::PACKET_SIZE, RaysCount-=RayTracer::PACKET_SIZE )
+		{
+			U32	HitMask = Params.pTracer->TracePacket( Params.pRays + RayIndex, MIN( RaysCount, RayTracer::PACKET_SIZE ) );
+			for ( ; HitMask != 0; HitMask &= HitMask-1 )
+				HitsCount++;
+		}
+
+		return HitsCount;
+	}
+}
+
+int		RayTracer::TraceStream( Ray* _pRays, int _RaysCount )
+{
+	if ( _RaysCount <= 0 )
+		return 0;
+
+	__TraceStreamStruct	Params;
+	Params.pTracer = this;
+	Params.pRays = _pRays;
+	Params.RaysCount = _RaysCount;
+	Params.ChunkSize = ComputeChunkSize( _RaysCount );
+
+	return DispatchChunks( (_RaysCount + Params.ChunkSize - 1) / Params.ChunkSize, TraceStreamChunk, &Params );
+}
+
+bool	RayTracer::Occluded( const OcclusionRay& _Ray, OcclusionCache* _pCache )
+{
+	Ray		R;
+	R.Position = _Ray.Position;
+	R.Direction = _Ray.Direction;
+	R.HitDistance = _Ray.MaxDistance;
+	R.pHitQuad = NULL;
+	R.pHitTriangle = NULL;
+	R.HitInstanceIndex = -1;
+
+	// Test the last occluder first, coherent rays are likely to be blocked by the same thing
+	// The cache is emptied as soon as it misses so runs of unoccluded rays don't pay for testing it
+	if ( _pCache != NULL )
+	{
+		if ( _pCache->pQuad != NULL && IntersectQuad( R, _pCache->pQuad ) )
+			return true;
+
+		if ( _pCache->pTriangle != NULL )
+		{
+			WatertightRay	LocalRay;
+			PrepareWatertightRay( LocalRay, m_pInstances[_pCache->InstanceIndex], R );
+			if ( IntersectTriangle( LocalRay, *_pCache->pTriangle, R.HitDistance, R.HitUV ) )
+				return true;
+		}
+
+		_pCache->pQuad = NULL;
+		_pCache->pTriangle = NULL;
+		_pCache->InstanceIndex = -1;
+	}
+
+	if ( !TraceQuads( R, true ) && !TraceInstances( R, true ) )
+		return false;
+
+	if ( _pCache != NULL )
+	{
+		_pCache->pQuad = (Quad_Internal*) R.pHitQuad;
+		_pCache->pTriangle = R.pHitTriangle;
+		_pCache->InstanceIndex = R.HitInstanceIndex;
+	}
+
+	return true;
+}
+
+namespace
+{
+	struct __OccludedStreamStruct
+	{
+		RayTracer*						pTracer;
+		const RayTracer::OcclusionRay*	pRays;
+		U8*								pOccluded;
+		int								RaysCount;
+		int								ChunkSize;
+		RayTracer::OcclusionCache		pCaches[RayTracer::MAX_THREADS];
+	};
+
+	int		OccludedStreamChunk( int _ChunkIndex, int _ThreadIndex, void* _pData )
+	{
+		__OccludedStreamStruct&		Params = *((__OccludedStreamStruct*) _pData);
+		RayTracer::OcclusionCache&	Cache = Params.pCaches[_ThreadIndex];
+
+		int		OccludedCount = 0;
+		int		RayIndex = _ChunkIndex * Params.ChunkSize;
+		int		RayIndexEnd = MIN( RayIndex + Params.ChunkSize, Params.RaysCount );
+		for ( ; RayIndex < RayIndexEnd; RayIndex++ )
+		{
+			bool	bOccluded = Params.pTracer->Occluded( Params.pRays[RayIndex], &Cache );
+			Params.pOccluded[RayIndex] = bOccluded ? 1 : 0;
+			OccludedCount += bOccluded ? 1 : 0;
+		}
+
+		return OccludedCount;
 	}
+}
+
+int		RayTracer::OccludedStream( const OcclusionRay* _pRays, int _RaysCount, U8* _pOccluded )
+{
+	if ( _RaysCount <= 0 )
+		return 0;
+
+	__OccludedStreamStruct	Params;
+	Params.pTracer = this;
+	Params.pRays = _pRays;
+	Params.pOccluded = _pOccluded;
+	Params.RaysCount = _RaysCount;
+	Params.ChunkSize = ComputeChunkSize( _RaysCount );
 
-	return _Ray.pHitQuad != NULL;
+	return DispatchChunks( (_RaysCount + Params.ChunkSize - 1) / Params.ChunkSize, OccludedStreamChunk, &Params );
 }
 
 void	RayTracer::ExitGeometry()
@@ -66,5 +663,608 @@ void	RayTracer::ExitGeometry()
 	if ( m_pQuads != NULL )
 		delete[] m_pQuads;
 	m_pQuads = NULL;
+	m_QuadsCount = 0;
+
+	m_BVH.Exit();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Triangle meshes
+namespace
+{
+	U32		HashTriangles( int _TrianglesCount, const RayTracer::Triangle* _pTriangles )
+	{	// FNV-1a
+		U32			Hash = 2166136261U;
+		const U8*	pBytes = (const U8*) _pTriangles;
+		for ( int ByteIndex=0; ByteIndex < _TrianglesCount * int(sizeof(RayTracer::Triangle)); ByteIndex++ )
+			Hash = (Hash ^ pBytes[ByteIndex]) * 16777619U;
+		return Hash;
+	}
+
+	// Traces a ray in LOCAL space through a mesh and returns the index of the hit triangle (in leaf order), or -1 if no triangle was hit closer than _HitDistance
+	int		TraceMesh( const RayTracer::Mesh& _Mesh, const WatertightRay& _Ray, float& _HitDistance, float2& _HitUV, bool _bAnyHit )
+	{
+		const BVH&	Hierarchy = _Mesh.Hierarchy;
+		bool	pDirectionIsNegative[3] = { _Ray.Direction.x < 0.0f, _Ray.Direction.y < 0.0f, _Ray.Direction.z < 0.0f };
+
+		int		HitTriangleIndex = -1;
+		int		pStack[BVH::MAX_DEPTH];
+		int		StackSize = 0;
+		int		NodeIndex = 0;
+		while ( true )
+		{
+			const BVH::Node&	N = Hierarchy.m_pNodes[NodeIndex];
+			if ( BVH::IntersectBox( N, _Ray.Position, _Ray.InvDirection, _HitDistance ) )
+			{
+				if ( N.IsLeaf() )
+				{
+					for ( int TriangleIndex=N.Offset; TriangleIndex < int(N.Offset + N.PrimitivesCount); TriangleIndex++ )
+						if ( IntersectTriangle( _Ray, _Mesh.pTriangles[TriangleIndex], _HitDistance, _HitUV ) )
+						{
+							HitTriangleIndex = TriangleIndex;
+							if ( _bAnyHit )
+								return HitTriangleIndex;
+						}
+				}
+				else
+				{
+					ASSERT( StackSize < BVH::MAX_DEPTH, "BVH is too deep!" );
+					if ( pDirectionIsNegative[N.Axis] )
+					{
+						pStack[StackSize++] = NodeIndex+1;
+						NodeIndex = N.Offset;
+					}
+					else
+					{
+						pStack[StackSize++] = N.Offset;
+						NodeIndex++;
+					}
+					continue;
+				}
+			}
+
+			if ( StackSize == 0 )
+				break;
+			NodeIndex = pStack[--StackSize];
+		}
+
+		return HitTriangleIndex;
+	}
+}
+
+bool	RayTracer::TraceInstances( Ray& _Ray, bool _bAnyHit )
+{
+	if ( m_InstancesBVH.m_NodesCount == 0 )
+		return false;
+
+	float3	InvDirection = BVH::ComputeInvDirection( _Ray.Direction );
+	bool	pDirectionIsNegative[3] = { _Ray.Direction.x < 0.0f, _Ray.Direction.y < 0.0f, _Ray.Direction.z < 0.0f };
+
+	bool	bHit = false;
+	int		pStack[BVH::MAX_DEPTH];
+	int		StackSize = 0;
+	int		NodeIndex = 0;
+	while ( true )
+	{
+		const BVH::Node&	N = m_InstancesBVH.m_pNodes[NodeIndex];
+		if ( BVH::IntersectBox( N, _Ray.Position, InvDirection, _Ray.HitDistance ) )
+		{
+			if ( N.IsLeaf() )
+			{
+				for ( U32 LeafIndex=N.Offset; LeafIndex < N.Offset + N.PrimitivesCount; LeafIndex++ )
+				{
+					int				InstanceIndex = m_InstancesBVH.m_pPrimitiveIndices[LeafIndex];
+					const Instance&	I = m_pInstances[InstanceIndex];
+					if ( N.PrimitivesCount > 1 && !BVH::IntersectBox( I.BBoxMin, I.BBoxMax, _Ray.Position, InvDirection, _Ray.HitDistance ) )
+						continue;
+
+					WatertightRay	LocalRay;
+					PrepareWatertightRay( LocalRay, I, _Ray );
+
+					const Mesh&	M = *m_ppMeshes[I.MeshIndex];
+					int		TriangleIndex = TraceMesh( M, LocalRay, _Ray.HitDistance, _Ray.HitUV, _bAnyHit );
+					if ( TriangleIndex < 0 )
+						continue;
+
+					_Ray.pHitQuad = NULL;
+					_Ray.pHitTriangle = &M.pTriangles[TriangleIndex];
+					_Ray.HitInstanceIndex = InstanceIndex;
+					_Ray.HitTriangleIndex = M.Hierarchy.m_pPrimitiveIndices[TriangleIndex];
+					bHit = true;
+					if ( _bAnyHit )
+						return true;
+				}
+			}
+			else
+			{
+				ASSERT( StackSize < BVH::MAX_DEPTH, "BVH is too deep!" );
+				if ( pDirectionIsNegative[N.Axis] )
+				{
+					pStack[StackSize++] = NodeIndex+1;
+					NodeIndex = N.Offset;
+				}
+				else
+				{
+					pStack[StackSize++] = N.Offset;
+					NodeIndex++;
+				}
+				continue;
+			}
+		}
+
+		if ( StackSize == 0 )
+			break;
+		NodeIndex = pStack[--StackSize];
+	}
+
+	return bHit;
+}
+
+namespace
+{
+	void	ComputeTrianglesBBoxes( int _TrianglesCount, const RayTracer::Triangle* _pTriangles, float3* _pBBoxMin, float3* _pBBoxMax )
+	{
+		for ( int TriangleIndex=0; TriangleIndex < _TrianglesCount; TriangleIndex++ )
+		{
+			const RayTracer::Triangle&	T = _pTriangles[TriangleIndex];
+			_pBBoxMin[TriangleIndex] = T.P0.Min( T.P1 ).Min( T.P2 );
+			_pBBoxMax[TriangleIndex] = T.P0.Max( T.P1 ).Max( T.P2 );
+		}
+	}
+
+	// Transforms the corners of the mesh's bounding box to get the WORLD space bounding box of the instance
+	void	ComputeInstanceBBox( RayTracer::Instance& _Instance, const RayTracer::Mesh& _Mesh )
+	{
+		const BVH::Node&	Root = _Mesh.Hierarchy.m_pNodes[0];
+		_Instance.BBoxMin = float3::MaxFlt;
+		_Instance.BBoxMax = -float3::MaxFlt;
+		for ( int CornerIndex=0; CornerIndex < 8; CornerIndex++ )
+		{
+			float4	Corner( (CornerIndex & 1) ? Root.BBoxMax.x : Root.BBoxMin.x, (CornerIndex & 2) ? Root.BBoxMax.y : Root.BBoxMin.y, (CornerIndex & 4) ? Root.BBoxMax.z : Root.BBoxMin.z, 1.0f );
+			Corner = Corner * _Instance.Local2World;
+			float3	WorldCorner( Corner.x, Corner.y, Corner.z );
+			_Instance.BBoxMin = _Instance.BBoxMin.Min( WorldCorner );
+			_Instance.BBoxMax = _Instance.BBoxMax.Max( WorldCorner );
+		}
+	}
+}
+
+int		RayTracer::AddMesh( int _TrianglesCount, const Triangle* _pTriangles )
+{
+	ASSERT( _TrianglesCount > 0, "Can't create an empty mesh!" );
+
+	// Build the hierarchy
+	float3*	pBBoxMin = new float3[_TrianglesCount];
+	float3*	pBBoxMax = new float3[_TrianglesCount];
+	ComputeTrianglesBBoxes( _TrianglesCount, _pTriangles, pBBoxMin, pBBoxMax );
+
+	Mesh*	pMesh = new Mesh();
+	pMesh->Hierarchy.Build( _TrianglesCount, pBBoxMin, pBBoxMax );
+	pMesh->Hash = HashTriangles( _TrianglesCount, _pTriangles );
+
+	delete[] pBBoxMax;
+	delete[] pBBoxMin;
+
+	// Store the triangles in the order of the leaves
+	pMesh->TrianglesCount = _TrianglesCount;
+	pMesh->pTriangles = new Triangle[_TrianglesCount];
+	for ( int TriangleIndex=0; TriangleIndex < _TrianglesCount; TriangleIndex++ )
+		pMesh->pTriangles[TriangleIndex] = _pTriangles[pMesh->Hierarchy.m_pPrimitiveIndices[TriangleIndex]];
+
+	// Append the mesh
+	if ( m_MeshesCount == m_MeshesCapacity )
+	{
+		m_MeshesCapacity = MAX( 16, 2*m_MeshesCapacity );
+		Mesh**	ppMeshes = new Mesh*[m_MeshesCapacity];
+		if ( m_MeshesCount > 0 )
+			memcpy( ppMeshes, m_ppMeshes, m_MeshesCount*sizeof(Mesh*) );
+		delete[] m_ppMeshes;
+		m_ppMeshes = ppMeshes;
+	}
+	m_ppMeshes[m_MeshesCount] = pMesh;
+
+	return m_MeshesCount++;
+}
+
+int		RayTracer::AddMesh( int _FacesCount, const U32* _pFaces, const void* _pVertices, int _VertexStride, int _MaterialID )
+{
+	Triangle*	pTriangles = new Triangle[_FacesCount];
+	for ( int FaceIndex=0; FaceIndex < _FacesCount; FaceIndex++ )
+	{
+		Triangle&	T = pTriangles[FaceIndex];
+		T.P0 = *((const float3*) ((const U8*) _pVertices + _VertexStride * _pFaces[3*FaceIndex+0]));
+		T.P1 = *((const float3*) ((const U8*) _pVertices + _VertexStride * _pFaces[3*FaceIndex+1]));
+		T.P2 = *((const float3*) ((const U8*) _pVertices + _VertexStride * _pFaces[3*FaceIndex+2]));
+		T.MaterialID = _MaterialID;
+	}
+
+	int	MeshIndex = AddMesh( _FacesCount, pTriangles );
+
+	delete[] pTriangles;
+
+	return MeshIndex;
+}
+
+int		RayTracer::FindMesh( int _TrianglesCount, const Triangle* _pTriangles ) const
+{
+	U32	Hash = HashTriangles( _TrianglesCount, _pTriangles );
+	for ( int MeshIndex=0; MeshIndex < m_MeshesCount; MeshIndex++ )
+	{
+		const Mesh&	M = *m_ppMeshes[MeshIndex];
+		if ( M.TrianglesCount != _TrianglesCount || M.Hash != Hash )
+			continue;
+
+		// Compare the triangles for real (ours are in leaf order)
+		int	TriangleIndex = 0;
+		for ( ; TriangleIndex < _TrianglesCount; TriangleIndex++ )
+			if ( memcmp( &M.pTriangles[TriangleIndex], &_pTriangles[M.Hierarchy.m_pPrimitiveIndices[TriangleIndex]], sizeof(Triangle) ) )
+				break;
+		if ( TriangleIndex == _TrianglesCount )
+			return MeshIndex;
+	}
+
+	return -1;
+}
+
+int		RayTracer::AddInstance( int _MeshIndex, const float4x4& _Local2World, void* _pUserData )
+{
+	ASSERT( _MeshIndex >= 0 && _MeshIndex < m_MeshesCount, "Invalid mesh index!" );
+
+	if ( m_InstancesCount == m_InstancesCapacity )
+	{
+		m_InstancesCapacity = MAX( 16, 2*m_InstancesCapacity );
+		Instance*	pInstances = new Instance[m_InstancesCapacity];
+		if ( m_InstancesCount > 0 )
+			memcpy( pInstances, m_pInstances, m_InstancesCount*sizeof(Instance) );
+		delete[] m_pInstances;
+		m_pInstances = pInstances;
+	}
+
+	Instance&	I = m_pInstances[m_InstancesCount];
+	I.MeshIndex = _MeshIndex;
+	I.Local2World = _Local2World;
+	I.World2Local = _Local2World.Inverse();
+	I.pUserData = _pUserData;
+	ComputeInstanceBBox( I, *m_ppMeshes[_MeshIndex] );
+
+	return m_InstancesCount++;
+}
+
+void	RayTracer::BuildInstances()
+{
+	float3*	pBBoxMin = new float3[m_InstancesCount];
+	float3*	pBBoxMax = new float3[m_InstancesCount];
+	for ( int InstanceIndex=0; InstanceIndex < m_InstancesCount; InstanceIndex++ )
+	{
+		pBBoxMin[InstanceIndex] = m_pInstances[InstanceIndex].BBoxMin;
+		pBBoxMax[InstanceIndex] = m_pInstances[InstanceIndex].BBoxMax;
+	}
+
+	m_InstancesBVH.Build( m_InstancesCount, pBBoxMin, pBBoxMax );
+
+	delete[] pBBoxMax;
+	delete[] pBBoxMin;
+}
+
+void	RayTracer::SetInstanceTransform( int _InstanceIndex, const float4x4& _Local2World )
+{
+	ASSERT( _InstanceIndex >= 0 && _InstanceIndex < m_InstancesCount, "Invalid instance index!" );
+
+	Instance&	I = m_pInstances[_InstanceIndex];
+	I.Local2World = _Local2World;
+	I.World2Local = _Local2World.Inverse();
+	ComputeInstanceBBox( I, *m_ppMeshes[I.MeshIndex] );
 }
 
+void	RayTracer::UpdateMesh( int _MeshIndex, const Triangle* _pTriangles )
+{
+	ASSERT( _MeshIndex >= 0 && _MeshIndex < m_MeshesCount, "Invalid mesh index!" );
+
+	double	UpdateTime = 0.0;
+	{
+#ifdef _DEBUG
+		TimeProfile	Profile( UpdateTime );
+#endif
+
+		Mesh&	M = *m_ppMeshes[_MeshIndex];
+
+		float3*	pBBoxMin = new float3[M.TrianglesCount];
+		float3*	pBBoxMax = new float3[M.TrianglesCount];
+		ComputeTrianglesBBoxes( M.TrianglesCount, _pTriangles, pBBoxMin, pBBoxMax );
+
+		int	RebuiltTrianglesCount = 0;
+		m_UpdateStats.RebuiltSubtreesCount += M.Hierarchy.Update( pBBoxMin, pBBoxMax, &RebuiltTrianglesCount );
+		m_UpdateStats.RebuiltPrimitivesCount += RebuiltTrianglesCount;
+
+		delete[] pBBoxMax;
+		delete[] pBBoxMin;
+
+		// Gather the triangles again as rebuilt subtrees may have reordered them
+		for ( int TriangleIndex=0; TriangleIndex < M.TrianglesCount; TriangleIndex++ )
+			M.pTriangles[TriangleIndex] = _pTriangles[M.Hierarchy.m_pPrimitiveIndices[TriangleIndex]];
+		M.Hash = HashTriangles( M.TrianglesCount, _pTriangles );
+
+		for ( int InstanceIndex=0; InstanceIndex < m_InstancesCount; InstanceIndex++ )
+			if ( m_pInstances[InstanceIndex].MeshIndex == _MeshIndex )
+				ComputeInstanceBBox( m_pInstances[InstanceIndex], M );
+	}
+	m_UpdateStats.UpdateTime += UpdateTime;
+}
+
+void	RayTracer::UpdateInstances()
+{
+	double	UpdateTime = 0.0;
+	{
+#ifdef _DEBUG
+		TimeProfile	Profile( UpdateTime );
+#endif
+
+		float3*	pBBoxMin = new float3[MAX( 1, m_InstancesCount )];
+		float3*	pBBoxMax = new float3[MAX( 1, m_InstancesCount )];
+		for ( int InstanceIndex=0; InstanceIndex < m_InstancesCount; InstanceIndex++ )
+		{
+			pBBoxMin[InstanceIndex] = m_pInstances[InstanceIndex].BBoxMin;
+			pBBoxMax[InstanceIndex] = m_pInstances[InstanceIndex].BBoxMax;
+		}
+
+		if ( m_InstancesBVH.m_PrimitivesCount != m_InstancesCount )
+			m_InstancesBVH.Build( m_InstancesCount, pBBoxMin, pBBoxMax );	// Instances were added since the last build
+		else
+		{
+			int	RebuiltInstancesCount = 0;
+			m_UpdateStats.RebuiltSubtreesCount += m_InstancesBVH.Update( pBBoxMin, pBBoxMax, &RebuiltInstancesCount );
+			m_UpdateStats.RebuiltPrimitivesCount += RebuiltInstancesCount;
+		}
+
+		delete[] pBBoxMax;
+		delete[] pBBoxMin;
+	}
+	m_UpdateStats.UpdateTime += UpdateTime;
+	m_UpdateStats.InstancesSAHCost = m_InstancesBVH.ComputeSAHCost();
+
+	m_LastUpdateStats = m_UpdateStats;
+	memset( &m_UpdateStats, 0, sizeof(UpdateStats) );
+}
+
+namespace
+{
+	class	SceneMeshesCollector : public Scene::IVisitor
+	{
+	public:
+		RayTracer&	m_Tracer;
+
+		SceneMeshesCollector( RayTracer& _Tracer ) : m_Tracer( _Tracer )	{}
+
+		virtual void	HandleNode( Scene::Node& _Node ) override
+		{
+			if ( _Node.m_Type != Scene::Node::MESH )
+				return;
+
+			Scene::Mesh&	M = (Scene::Mesh&) _Node;
+			for ( int PrimitiveIndex=0; PrimitiveIndex < M.m_PrimitivesCount; PrimitiveIndex++ )
+			{
+				Scene::Mesh::Primitive&	P = M.m_pPrimitives[PrimitiveIndex];
+				if ( P.m_FacesCount == 0 )
+					continue;
+
+				int		VertexSize = 0;
+				switch ( P.m_VertexFormat )
+				{
+				case Scene::Mesh::Primitive::P3N3G3B3T2: VertexSize = (3+3+3+3+2) * sizeof(float); break;
+				}
+				ASSERT( VertexSize != 0, "Unsupported vertex format!" );
+				if ( VertexSize == 0 )
+					continue;	// Unsupported primitive!
+
+				int		MaterialID = P.m_pMaterial != NULL ? int(P.m_pMaterial->m_ID) : -1;
+				RayTracer::Triangle*	pTriangles = new RayTracer::Triangle[P.m_FacesCount];
+				for ( U32 FaceIndex=0; FaceIndex < P.m_FacesCount; FaceIndex++ )
+				{
+					RayTracer::Triangle&	T = pTriangles[FaceIndex];
+					T.P0 = *((const float3*) ((const U8*) P.m_pVertices + VertexSize * P.m_pFaces[3*FaceIndex+0]));
+					T.P1 = *((const float3*) ((const U8*) P.m_pVertices + VertexSize * P.m_pFaces[3*FaceIndex+1]));
+					T.P2 = *((const float3*) ((const U8*) P.m_pVertices + VertexSize * P.m_pFaces[3*FaceIndex+2]));
+					T.MaterialID = MaterialID;
+				}
+
+				// Repeated primitives share the same mesh
+				int		MeshIndex = m_Tracer.FindMesh( P.m_FacesCount, pTriangles );
+				if ( MeshIndex < 0 )
+					MeshIndex = m_Tracer.AddMesh( P.m_FacesCount, pTriangles );
+
+				delete[] pTriangles;
+
+				m_Tracer.AddInstance( MeshIndex, M.m_Local2World, &P );
+			}
+		}
+	};
+}
+
+void	RayTracer::InitScene( Scene& _Scene )
+{
+	SceneMeshesCollector	Collector( *this );
+	_Scene.ForEach( Collector );
+
+	BuildInstances();
+
+	print( "RayTracer scene: %d instances of %d meshes\n", m_InstancesCount, m_MeshesCount );
+}
+
+void	RayTracer::ExitMeshes()
+{
+	for ( int MeshIndex=0; MeshIndex < m_MeshesCount; MeshIndex++ )
+	{
+		delete[] m_ppMeshes[MeshIndex]->pTriangles;
+		delete m_ppMeshes[MeshIndex];
+	}
+	delete[] m_ppMeshes;
+	m_ppMeshes = NULL;
+	m_MeshesCount = m_MeshesCapacity = 0;
+
+	delete[] m_pInstances;
+	m_pInstances = NULL;
+	m_InstancesCount = m_InstancesCapacity = 0;
+
+	m_InstancesBVH.Exit();
+}
+
+#ifdef _DEBUG
+void	RayTracer::Benchmark( int _RaysCount, BenchmarkResults& _Results )
+{
+	float3	BBoxMin = float3::MaxFlt, BBoxMax = -float3::MaxFlt;
+	if ( m_BVH.m_NodesCount > 0 )
+	{
+		BBoxMin = BBoxMin.Min( m_BVH.m_pNodes[0].BBoxMin );
+		BBoxMax = BBoxMax.Max( m_BVH.m_pNodes[0].BBoxMax );
+	}
+	if ( m_InstancesBVH.m_NodesCount > 0 )
+	{
+		BBoxMin = BBoxMin.Min( m_InstancesBVH.m_pNodes[0].BBoxMin );
+		BBoxMax = BBoxMax.Max( m_InstancesBVH.m_pNodes[0].BBoxMax );
+	}
+	if ( BBoxMin.x > BBoxMax.x )
+		return;	// Nothing to trace
+
+	float3	Center = 0.5f * (BBoxMin + BBoxMax);
+	float3	Extent = BBoxMax - BBoxMin;
+	float	Radius = 0.5f * Extent.Length();
+
+	// Coherent rays: a 60 degrees camera looking at the geometry from outside, with rays ordered in tiles of 4x2 pixels so each packet covers a tile
+	int		TilesCountX = MAX( 1, int( sqrtf( float(_RaysCount) / 8 ) ) );
+	int		TilesCountY = MAX( 1, _RaysCount / (8 * TilesCountX) );
+	int		Width = 4 * TilesCountX, Height = 2 * TilesCountY;
+	_RaysCount = Width * Height;
+
+	Ray*	ppRays[2];
+	ppRays[0] = new Ray[_RaysCount];
+	ppRays[1] = new Ray[_RaysCount];
+
+	float3	CameraPosition = Center - 2.0f * Radius * float3::UnitZ;
+	float	TanHalfFOV = tanf( 0.5f * 60.0f * PI / 180.0f );
+	Ray*	pRay = ppRays[0];
+	for ( int TileY=0; TileY < TilesCountY; TileY++ )
+		for ( int TileX=0; TileX < TilesCountX; TileX++ )
+			for ( int Y=2*TileY; Y < 2*TileY+2; Y++ )
+				for ( int X=4*TileX; X < 4*TileX+4; X++, pRay++ )
+				{
+					pRay->Position = CameraPosition;
+					pRay->Direction.Set( TanHalfFOV * (2.0f * (X+0.5f) / Width - 1.0f) * Width / Height, TanHalfFOV * (1.0f - 2.0f * (Y+0.5f) / Height), 1.0f );
+					pRay->Direction.Normalize();
+				}
+
+	// Incoherent rays: random origins within the geometry and random directions
+	pRay = ppRays[1];
+	for ( int RayIndex=0; RayIndex < _RaysCount; RayIndex++, pRay++ )
+	{
+		pRay->Position = BBoxMin + float3( _frand() * Extent.x, _frand() * Extent.y, _frand() * Extent.z );
+		do
+		{
+			pRay->Direction.Set( _frand( -1.0f, 1.0f ), _frand( -1.0f, 1.0f ), _frand( -1.0f, 1.0f ) );
+		} while ( pRay->Direction.LengthSq() > 1.0f || pRay->Direction.LengthSq() < 1e-6f );
+		pRay->Direction.Normalize();
+	}
+
+	OcclusionRay*	pOcclusionRays = new OcclusionRay[_RaysCount];
+	U8*				pOccluded = new U8[_RaysCount];
+
+	TimeProfile	Profile;
+	double		MRays = 1e-3 * _RaysCount;	// Millions of rays per millisecond
+	_Results.ErrorsCount = 0;
+	for ( int SetIndex=0; SetIndex < 2; SetIndex++ )
+	{
+		Ray*	pRays = ppRays[SetIndex];
+
+		Profile.Start();
+		for ( int RayIndex=0; RayIndex < _RaysCount; RayIndex++ )
+			Trace( pRays[RayIndex] );
+		_Results.pSingle[SetIndex] = MRays / Profile.Stop();
+
+		Profile.Start();
+		for ( int RayIndex=0; RayIndex < _RaysCount; RayIndex+=4 )
+			TracePacket( pRays + RayIndex, 4 );
+		_Results.pPacket4[SetIndex] = MRays / Profile.Stop();
+
+		Profile.Start();
+		for ( int RayIndex=0; RayIndex < _RaysCount; RayIndex+=8 )
+			TracePacket( pRays + RayIndex, 8 );
+		_Results.pPacket8[SetIndex] = MRays / Profile.Stop();
+
+		Profile.Start();
+		TraceStream( pRays, _RaysCount );
+		_Results.pStream[SetIndex] = MRays / Profile.Stop();
+
+		// Same rays as occlusion queries
+		for ( int RayIndex=0; RayIndex < _RaysCount; RayIndex++ )
+		{
+			pOcclusionRays[RayIndex].Position = pRays[RayIndex].Position;
+			pOcclusionRays[RayIndex].Direction = pRays[RayIndex].Direction;
+			pOcclusionRays[RayIndex].MaxDistance = FLOAT32_MAX;
+		}
+
+		Profile.Start();
+		for ( int RayIndex=0; RayIndex < _RaysCount; RayIndex++ )
+			Occluded( pOcclusionRays[RayIndex] );
+		_Results.pOcclusionNoCache[SetIndex] = MRays / Profile.Stop();
+
+		Profile.Start();
+		OcclusionCache	Cache;
+		for ( int RayIndex=0; RayIndex < _RaysCount; RayIndex++ )
+			Occluded( pOcclusionRays[RayIndex], &Cache );
+		_Results.pOcclusion[SetIndex] = MRays / Profile.Stop();
+
+		Profile.Start();
+		OccludedStream( pOcclusionRays, _RaysCount, pOccluded );
+		_Results.pOcclusionStream[SetIndex] = MRays / Profile.Stop();
+
+		// Check the hierarchies against the brute-force loop on a subset of the rays (it's really slow!)
+		_Results.ErrorsCount += Validate( MIN( _RaysCount, 1024 ), pRays );
+
+		print( "RayTracer %s rays: %.2f MRays/s single, %.2f MRays/s packets of 4, %.2f MRays/s packets of 8, %.2f MRays/s stream\n", SetIndex == 0 ? "coherent" : "incoherent", _Results.pSingle[SetIndex], _Results.pPacket4[SetIndex], _Results.pPacket8[SetIndex], _Results.pStream[SetIndex] );
+		print( "RayTracer %s occlusion rays: %.2f MRays/s single (%.2f MRays/s without cache), %.2f MRays/s stream\n", SetIndex == 0 ? "coherent" : "incoherent", _Results.pOcclusion[SetIndex], _Results.pOcclusionNoCache[SetIndex], _Results.pOcclusionStream[SetIndex] );
+	}
+
+	delete[] pOccluded;
+	delete[] pOcclusionRays;
+	delete[] ppRays[1];
+	delete[] ppRays[0];
+
+	ASSERT( _Results.ErrorsCount == 0, "The BVH traversal disagrees with the brute-force tracing!" );
+}
+
+int		RayTracer::Validate( int _RaysCount, const Ray* _pRays )
+{
+	int	ErrorsCount = 0;
+	for ( int RayIndex=0; RayIndex < _RaysCount; RayIndex++ )
+	{
+		Ray	Reference = _pRays[RayIndex];
+		bool	bReferenceHit = TraceBruteForce( Reference );
+
+		Ray	Closest = _pRays[RayIndex];
+		bool	bHit = Trace( Closest );
+		if ( bHit != bReferenceHit || (bHit && Closest.HitDistance != Reference.HitDistance) )
+		{
+			ErrorsCount++;
+			continue;
+		}
+
+		// Any hit must be found beyond the closest hit, and none before it
+		Ray	Any = _pRays[RayIndex];
+		Any.HitDistance = bReferenceHit ? 1.001f * Reference.HitDistance : FLOAT32_MAX;
+		bHit = TraceAny( Any );
+		if ( bHit != bReferenceHit )
+		{
+			ErrorsCount++;
+			continue;
+		}
+		if ( !bReferenceHit )
+			continue;
+
+		Any = _pRays[RayIndex];
+		Any.HitDistance = 0.999f * Reference.HitDistance;
+		if ( TraceAny( Any ) )
+			ErrorsCount++;
+	}
+
+	return ErrorsCount;
+}
+#endif
@@ -1,12 +1,24 @@
 //////////////////////////////////////////////////////////////////////////
 // Helps to ray trace a bunch of rays
-// We only raytrace for quads at the moment
+// We raytrace quads and instanced triangle meshes
+// Quads are stored in the order of the leaves of a BVH so we only test the quads whose bounding boxes are hit by the rays
+// Triangle meshes have their own BVH in LOCAL space and are placed in the world by instances, themselves stored in a top-level BVH
+//	Triangles use the watertight intersection test from Woop et al. "Watertight Ray/Triangle Intersection" so rays can't leak between adjacent triangles
+// Coherent rays can be traced as SSE packets of 4 or 8 rays, and large arrays of rays as streams of packets dispatched on all the cores
+// Shadow and visibility rays (e.g. when baking AO, probes or lightmaps) should use the occlusion queries that stop at the first occluder
+// Instances can move and meshes can deform every frame: hierarchies are refitted and only their degraded subtrees are rebuilt
 //
 #pragma once
 
+class	Scene;
+
 class	RayTracer
 {
-protected:	// CONSTANTS
+public:		// CONSTANTS
+
+	static const int	PACKET_SIZE = 8;		// Maximum amount of rays in a packet (i.e. 2 SSE groups of 4 rays)
+	static const int	STREAM_CHUNK_SIZE = 64;	// Amount of rays a thread takes (or steals) at once when tracing a stream
+	static const int	MAX_THREADS = 32;		// Max amount of threads used to trace a stream
 
 public:		// NESTED TYPES
 
@@ -26,13 +38,23 @@ public:		// NESTED TYPES
 		int			MaterialID;		// Material ID associated to the quad
 	};
 
+	// The geometric triangle structure, in the LOCAL space of its mesh
+	struct	Triangle
+	{
+		float3	P0, P1, P2;
+		int			MaterialID;		// Material ID associated to the triangle
+	};
+
 	struct	Ray
 	{
 		float3	Position;		// Ray position
 		float3	Direction;		// Ray direction
 		float		HitDistance;	// Distance to the hit
-		float2	HitUV;			// UV of the hit within the hit quad
+		float2	HitUV;			// UV of the hit within the hit quad, or barycentric coordinates of P1 and P2 within the hit triangle
 		Quad*		pHitQuad;		// Pointer to the quad that was hit
+		const Triangle*	pHitTriangle;	// Pointer to the triangle that was hit
+		int			HitInstanceIndex;	// Index of the instance whose triangle was hit
+		int			HitTriangleIndex;	// Index of the hit triangle within the mesh, in the order it was given to AddMesh()
 	};
 
 	struct	Quad_Internal : public Quad
@@ -41,11 +63,73 @@ public:		// NESTED TYPES
 		float4	SizeAndInvSize;	// XY=0.5*Size ZW=1/(0.5*Size)
 	};
 
+	// A triangle mesh with its own hierarchy
+	struct	Mesh
+	{
+		int			TrianglesCount;
+		Triangle*	pTriangles;		// Triangles in the order of the BVH leaves
+		BVH			Hierarchy;		// Hierarchy in LOCAL space (Hierarchy.m_pPrimitiveIndices gives the original index of the triangles)
+		U32			Hash;			// Hash of the triangles to quickly find identical meshes
+	};
+
+	// A shadow or visibility ray that only needs to know if something lies in its way
+	struct	OcclusionRay
+	{
+		float3	Position;
+		float3	Direction;
+		float		MaxDistance;	// Occluders beyond that distance are ignored (e.g. the distance to the light or the AO radius)
+	};
+
+	// Remembers the last occluder found so the next (coherent) occlusion query tests it before anything else
+	// Keep one cache per thread and per baking task (e.g. all the AO rays of a texel)
+	struct	OcclusionCache
+	{
+		Quad_Internal*	pQuad;
+		const Triangle*	pTriangle;
+		int				InstanceIndex;
+
+		OcclusionCache() : pQuad( NULL ), pTriangle( NULL ), InstanceIndex( -1 )	{}
+	};
+
+	// An instance of a mesh in the world
+	struct	Instance
+	{
+		int			MeshIndex;
+		float4x4	Local2World;
+		float4x4	World2Local;
+		float3		BBoxMin;		// WORLD space bounding box
+		float3		BBoxMax;
+		void*		pUserData;		// Custom user data (e.g. the scene primitive the instance was created from)
+	};
+
+	// The cost of the last frame's updates of meshes and instances
+	struct	UpdateStats
+	{
+		double		UpdateTime;				// Duration of the updates in milliseconds (only measured in DEBUG)
+		int			RebuiltSubtreesCount;	// Amount of subtrees rebuilt because refitting degraded them too much
+		int			RebuiltPrimitivesCount;	// Amount of triangles and instances in these subtrees
+		float		InstancesSAHCost;		// SAH cost of the top-level hierarchy after the update
+	};
+
 
 protected:	// FIELDS
 
 	int				m_QuadsCount;
-	Quad_Internal*	m_pQuads;
+	Quad_Internal*	m_pQuads;		// Quads in the order of the BVH leaves
+
+	BVH				m_BVH;
+
+	int				m_MeshesCount;
+	int				m_MeshesCapacity;
+	Mesh**			m_ppMeshes;
+
+	int				m_InstancesCount;
+	int				m_InstancesCapacity;
+	Instance*		m_pInstances;
+	BVH				m_InstancesBVH;	// Top-level hierarchy (m_InstancesBVH.m_pPrimitiveIndices gives the index of the instances referenced by the leaves)
+
+	UpdateStats		m_UpdateStats;		// Stats accumulated since the last UpdateInstances()
+	UpdateStats		m_LastUpdateStats;
 
 
 public:		// METHODS
@@ -55,8 +139,110 @@ public:		// METHODS
 
 	void	InitGeometry( int _QuadsCount, const Quad* _pQuads );
 
-	// Traces a ray in the geometry
+	// Traces a ray in the geometry and returns the closest hit
 	bool	Trace( Ray& _Ray );
 
+	// Traces a ray in the geometry and stops at the first hit found
+	//	_Ray.HitDistance must contain the maximum distance we're interested in (e.g. the distance to a light)
+	bool	TraceAny( Ray& _Ray );
+
+	// Tests the ray against all the quads and triangles without using the BVHs (for validation purpose)
+	bool	TraceBruteForce( Ray& _Ray );
+
+	// Traces a packet of up to PACKET_SIZE rays in the geometry and returns their closest hits
+	// The packet traverses the quads' BVH as a whole so the rays should be coherent (i.e. close origins and directions, like neighbor camera rays)
+	// Triangle meshes are then traced one ray at a time
+	// Returns a mask where bit N is set if ray N hit something
+	U32		TracePacket( Ray* _pRays, int _RaysCount=PACKET_SIZE );
+
+	// Traces an array of rays as packets of PACKET_SIZE consecutive rays dispatched on all the cores
+	// Rays are grouped in chunks of at least STREAM_CHUNK_SIZE rays that are processed with JobSystem::ParallelFor(), so idle threads steal the largest ranges of chunks left
+	// Returns the amount of rays that hit something
+	int		TraceStream( Ray* _pRays, int _RaysCount );
+
+	// Tells if anything lies along a ray within its max distance
+	// This is cheaper than Trace() as it stops at the first occluder found and doesn't compute any hit information
+	//	_pCache, an optional cache of the last occluder, tested first
+	bool	Occluded( const OcclusionRay& _Ray, OcclusionCache* _pCache=NULL );
+
+	// Tests an array of occlusion rays dispatched on all the cores, like TraceStream(), and writes 1 in _pOccluded for each occluded ray (0 otherwise)
+	// Each thread keeps its own occluder cache so consecutive rays should be coherent (e.g. all the AO rays of a texel, or the shadow rays of neighbor texels)
+	// Returns the amount of occluded rays
+	int		OccludedStream( const OcclusionRay* _pRays, int _RaysCount, U8* _pOccluded );
+
+	// Gets the duration of the last BVH build, in milliseconds (only measured in DEBUG)
+	double	GetBuildTime() const	{ return m_BVH.m_BuildTime; }
+
 	void	ExitGeometry();
+
+	// Creates a triangle mesh from triangles in LOCAL space and returns its index
+	int		AddMesh( int _TrianglesCount, const Triangle* _pTriangles );
+
+	// Creates a triangle mesh from an indexed triangle list in LOCAL space (the position must be the first field of the vertex) and returns its index
+	int		AddMesh( int _FacesCount, const U32* _pFaces, const void* _pVertices, int _VertexStride, int _MaterialID );
+
+	// Returns the index of an existing mesh made of the exact same triangles, or -1 if there is none
+	int		FindMesh( int _TrianglesCount, const Triangle* _pTriangles ) const;
+
+	// Places a mesh in the world and returns the instance index
+	int		AddInstance( int _MeshIndex, const float4x4& _Local2World, void* _pUserData=NULL );
+
+	// Builds the top-level hierarchy of the instances (must be called once all instances are added, before tracing)
+	void	BuildInstances();
+
+	// Moves an instance (the top-level hierarchy is only updated by UpdateInstances())
+	void	SetInstanceTransform( int _InstanceIndex, const float4x4& _Local2World );
+
+	// Deforms a mesh, given the same amount of triangles in the same order as for AddMesh()
+	// The mesh's hierarchy is refitted and partially rebuilt, and the bounding boxes of all the instances of the mesh are updated
+	//	(the top-level hierarchy is only updated by UpdateInstances())
+	void	UpdateMesh( int _MeshIndex, const Triangle* _pTriangles );
+
+	// Refits the top-level hierarchy to the moved instances and rebuilds its degraded subtrees
+	// Call this once per frame after moving instances and deforming meshes, and before tracing
+	void	UpdateInstances();
+
+	// Gets the cost of the updates of the last frame (i.e. the UpdateMesh() calls and the UpdateInstances() call that ended it)
+	const UpdateStats&	GetUpdateStats() const	{ return m_LastUpdateStats; }
+
+	// Creates meshes and instances for the LOD 0 of all the primitives of a scene, in WORLD space
+	// Primitives with the same triangles and material share the same mesh
+	// The instances' user data point to the scene primitives and triangle indices are the primitives' face indices
+	void	InitScene( Scene& _Scene );
+
+	int				GetMeshesCount() const						{ return m_MeshesCount; }
+	const Mesh&		GetMesh( int _MeshIndex ) const				{ return *m_ppMeshes[_MeshIndex]; }
+	int				GetInstancesCount() const					{ return m_InstancesCount; }
+	const Instance&	GetInstance( int _InstanceIndex ) const		{ return m_pInstances[_InstanceIndex]; }
+
+	void	ExitMeshes();
+
+#ifdef _DEBUG
+	struct	BenchmarkResults
+	{
+		// Throughputs in millions of rays per second, [0] for coherent rays and [1] for incoherent rays
+		double	pSingle[2];
+		double	pPacket4[2];
+		double	pPacket8[2];
+		double	pStream[2];
+		double	pOcclusion[2];			// Single rays through Occluded() with an infinite max distance
+		double	pOcclusionNoCache[2];	// Same without the occluder cache
+		double	pOcclusionStream[2];
+		int		ErrorsCount;			// Amount of rays whose Trace() or TraceAny() hits disagree with TraceBruteForce() (should be 0!)
+	};
+
+	// Measures the throughput of the tracing methods on coherent rays (i.e. camera rays looking at the geometry) and incoherent rays (i.e. random rays within the geometry)
+	void	Benchmark( int _RaysCount, BenchmarkResults& _Results );
+
+	// Compares the hits of Trace() and TraceAny() with TraceBruteForce() for each ray and returns the amount of rays that disagree
+	// TraceAny() is tested with a max distance slightly shorter and slightly longer than the closest hit
+	int		Validate( int _RaysCount, const Ray* _pRays );
+#endif
+
+protected:
+
+	// Traces a ray through the quads or the instances, only accepting hits closer than _Ray.HitDistance
+	//	_bAnyHit, true to stop at the first hit found
+	bool	TraceQuads( Ray& _Ray, bool _bAnyHit );
+	bool	TraceInstances( Ray& _Ray, bool _bAnyHit );
 };
@@ -6,6 +6,8 @@ TextureBuilder::TextureBuilder( int _Width, int _Height )
 	, m_Height( _Height )
 	, m_bMipLevelsBuilt( false )
 {
+	MemoryTagScope	Tag( MEMORY_TAG_FAT_PIXELS );
+
 	m_MipLevelsCount = Texture2D::ComputeMipLevelsCount( _Width, _Height, 0 );
 	m_ppBufferGeneric = new Pixel*[m_MipLevelsCount];
 	m_pMipSizes = new int[2*m_MipLevelsCount];
@@ -119,6 +121,97 @@ void	TextureBuilder::Fill( FillDelegate _Filler, void* _pData )
 	m_bMipLevelsBuilt = false;
 }
 
+void	TextureBuilder::ParallelRows( int _RowsCount, RowsDelegate _Delegate, void* _pData, int _BandSize )
+{
+	JobSystem::ParallelFor( _RowsCount, _Delegate, _pData, MAX( 1, _BandSize ) );
+}
+
+namespace Fillers
+{
+	struct __WavefrontStruct;
+
+	// A row of a block, only submitted once the blocks it depends on are done with the previous row
+	struct __WavefrontCell
+	{
+		__WavefrontStruct*	pOwner;
+		int					Y;
+		int					BlockIndex;
+		volatile LONG		PendingDependencies;
+	};
+
+	struct __WavefrontStruct
+	{
+		TextureBuilder::WavefrontDelegate	pDelegate;
+		void*								pData;
+		int									Width, Height;
+		int									BlocksCount;
+		int									DependenciesCount;	// Amount of distinct blocks a row depends on (i.e. itself and its 2 wrapped neighbors)
+		__WavefrontCell*					pCells;				// Height rows of BlocksCount cells
+		JobSystem::Counter					Done;
+	};
+
+	void	WavefrontCellJob( void* _pData )
+	{
+		__WavefrontCell&	Cell = *((__WavefrontCell*) _pData);
+		__WavefrontStruct&	Params = *Cell.pOwner;
+
+		int		X0 = Params.Width * Cell.BlockIndex / Params.BlocksCount;
+		int		X1 = Params.Width * (Cell.BlockIndex+1) / Params.BlocksCount;
+		(*Params.pDelegate)( Cell.Y, X0, X1, Cell.BlockIndex, Params.pData );
+
+		if ( Cell.Y+1 == Params.Height )
+			return;
+
+		// Release the cells of the next row that depend on us (i.e. ourselves and our wrapped neighbors)
+		__WavefrontCell*	pNextRow = Params.pCells + (Cell.Y+1) * Params.BlocksCount;
+		int		FirstBlockIndex = Cell.BlockIndex + Params.BlocksCount - (Params.DependenciesCount == 3 ? 1 : 0);
+		for ( int DependentIndex=0; DependentIndex < Params.DependenciesCount; DependentIndex++ )
+		{
+			__WavefrontCell&	NextCell = pNextRow[(FirstBlockIndex + DependentIndex) % Params.BlocksCount];
+			if ( InterlockedDecrement( &NextCell.PendingDependencies ) == 0 )
+				JobSystem::Run( WavefrontCellJob, &NextCell, &Params.Done );
+		}
+	}
+}
+
+int		TextureBuilder::ComputeWavefrontBlocksCount( int _Width, int _MinBlockWidth )
+{
+	return CLAMP( MIN( JobSystem::GetThreadsCount(), _Width / MAX( 2, _MinBlockWidth ) ), 1, MAX_THREADS );
+}
+
+int		TextureBuilder::ParallelWavefront( int _Width, int _Height, WavefrontDelegate _Delegate, void* _pData, int _MinBlockWidth )
+{
+	Fillers::__WavefrontStruct	Params;
+	Params.pDelegate = _Delegate;
+	Params.pData = _pData;
+	Params.Width = _Width;
+	Params.Height = _Height;
+	Params.BlocksCount = ComputeWavefrontBlocksCount( _Width, _MinBlockWidth );
+	Params.DependenciesCount = MIN( Params.BlocksCount, 3 );
+	if ( _Height <= 0 )
+		return Params.BlocksCount;
+
+	Params.pCells = new Fillers::__WavefrontCell[_Height*Params.BlocksCount];
+	for ( int Y=0; Y < _Height; Y++ )
+		for ( int BlockIndex=0; BlockIndex < Params.BlocksCount; BlockIndex++ )
+		{
+			Fillers::__WavefrontCell&	Cell = Params.pCells[Y*Params.BlocksCount+BlockIndex];
+			Cell.pOwner = &Params;
+			Cell.Y = Y;
+			Cell.BlockIndex = BlockIndex;
+			Cell.PendingDependencies = Params.DependenciesCount;
+		}
+
+	// The first row has no dependency, the other rows are submitted by the cells they depend on
+	for ( int BlockIndex=0; BlockIndex < Params.BlocksCount; BlockIndex++ )
+		JobSystem::Run( Fillers::WavefrontCellJob, &Params.pCells[BlockIndex], &Params.Done );
+
+	JobSystem::Wait( Params.Done );
+	delete[] Params.pCells;
+
+	return Params.BlocksCount;
+}
+
 void	TextureBuilder::Get( int _X, int _Y, int _MipLevel, Pixel& _Color ) const
 {
 	ASSERT( _MipLevel == 0 || m_bMipLevelsBuilt, "You must call GenerateMips() prior getting a pixel from a mip level different than 0!" );
@@ -372,6 +465,46 @@ TextureBuilder::ConversionParams	TextureBuilder::CONV_NxNyNzH =
 	-1,		// int		PosAO;
 };
 
+namespace
+{
+	// Tells if the conversion only writes the packed normal in XYZ and the height in W (e.g. CONV_NxNyNzH)
+	bool	IsPackedNormalHeight( const TextureBuilder::ConversionParams& _Params )
+	{
+		return _Params.PosR == -1 && _Params.PosG == -1 && _Params.PosB == -1 && _Params.PosA == -1
+			&& _Params.PosNormalX == 0 && _Params.PosNormalY == 1 && _Params.PosNormalZ == 2 && _Params.bPackNormal
+			&& _Params.PosHeight == 3 && _Params.PosRoughness == -1 && _Params.PosMatID == -1 && _Params.PosAO == -1;
+	}
+
+#ifdef _DEBUG
+	bool	gs_bPackedNormalsChecked = false;
+
+	// Checks once per session that the packed normals of the mip 0 match ComputeNormal()
+	void	CheckPackedNormals( const TextureBuilder& _Source, const IPixelFormatDescriptor& _Format, const U8* _pPacked, float _HeightFactor, bool _bNormalize )
+	{
+		if ( gs_bPackedNormalsChecked )
+			return;
+		gs_bPackedNormalsChecked = true;
+
+		TextureBuilder	Reference( _Source.GetWidth(), _Source.GetHeight() );
+		Generators::ComputeNormal( _Source, Reference, _HeightFactor, _bNormalize );
+
+		const Pixel*	pSource = _Source.GetMip( 0 );
+		const Pixel*	pReference = Reference.GetMip( 0 );
+		int		PixelSize = _Format.Size();
+		U8		pExpected[16];
+		float	MaxError = 0.0f;
+		for ( int PixelIndex=0; PixelIndex < _Source.GetWidth() * _Source.GetHeight(); PixelIndex++ )
+		{
+			const float4&	N = pReference[PixelIndex].RGBA;
+			_Format.Write( pExpected, float4( 0.5f * (1.0f + N.x), 0.5f * (1.0f + N.y), 0.5f * (1.0f + N.z), pSource[PixelIndex].Height ) );
+			float4	Delta = _Format.Read( _pPacked + PixelSize * PixelIndex ) - _Format.Read( pExpected );
+			MaxError = MAX( MaxError, MAX( MAX( fabs( Delta.x ), fabs( Delta.y ) ), MAX( fabs( Delta.z ), fabs( Delta.w ) ) ) );
+		}
+		ASSERT( MaxError <= 1.5f / 255.0f, "Packed normals don't match ComputeNormal()!" );
+	}
+#endif
+}
+
 void**	TextureBuilder::Convert( const IPixelFormatDescriptor& _Format, const ConversionParams& _Params, int& _ArraySize, float _NormalFactor, bool _bNormalizeNormals, float _AOFactor ) const
 {
 	if ( !m_bMipLevelsBuilt )
@@ -379,6 +512,31 @@ void**	TextureBuilder::Convert( const IPixelFormatDescriptor& _Format, const Con
 
 	ReleaseSpecificBuffer();
 
+	//////////////////////////////////////////////////////////////////////////
+	// Packed normal + height only: each mip is written straight into the target format from the heights of the same mip
+	//	(the height factor is scaled by the mip's size so the slopes stay the same)
+	if ( IsPackedNormalHeight( _Params ) )
+	{
+		MemoryTagScope	Tag( MEMORY_TAG_FAT_PIXELS );
+		_ArraySize = 1;
+		m_ppBufferSpecific = new void*[m_MipLevelsCount];
+
+		for ( int MipLevelIndex=0; MipLevelIndex < m_MipLevelsCount; MipLevelIndex++ )
+		{
+			int		Width = GetWidth( MipLevelIndex );
+			U8*		pDest = new U8[Width*GetHeight( MipLevelIndex )*_Format.Size()];
+			m_ppBufferSpecific[MipLevelIndex] = (void*) pDest;
+
+			Generators::ComputeNormalPacked( *this, MipLevelIndex, _Format, pDest, _NormalFactor * Width / m_Width, _bNormalizeNormals );
+		}
+
+#ifdef _DEBUG
+		CheckPackedNormals( *this, _Format, (const U8*) m_ppBufferSpecific[0], _NormalFactor, _bNormalizeNormals );
+#endif
+
+		return m_ppBufferSpecific;
+	}
+
 	//////////////////////////////////////////////////////////////////////////
 	// Generate normal
 	TextureBuilder	TBNormal( m_Width, m_Height );
@@ -386,7 +544,7 @@ void**	TextureBuilder::Convert( const IPixelFormatDescriptor& _Format, const Con
 	{
 		ASSERT( _Params.PosNormalY != -1, "You must specify a position for the Y component of the normal if PosNormalX is not -1!" );
 		bool	bNormalize = _bNormalizeNormals || _Params.PosNormalZ == -1;
-		Generators::ComputeNormal( *this, TBNormal, _NormalFactor, bNormalize );
+		Generators::ComputeNormalFast( *this, TBNormal, _NormalFactor, bNormalize );
 		TBNormal.GenerateMips( true, true );
 	}
 
@@ -395,7 +553,7 @@ void**	TextureBuilder::Convert( const IPixelFormatDescriptor& _Format, const Con
 	TextureBuilder	TBAO( m_Width, m_Height );
 	if ( _Params.PosAO != -1 )
 	{
-		Generators::ComputeAO( *this, TBNormal, _AOFactor );
+		Generators::ComputeAOFast( *this, TBAO, _AOFactor );
 		TBAO.GenerateMips();
 	}
 
@@ -418,6 +576,7 @@ void**	TextureBuilder::Convert( const IPixelFormatDescriptor& _Format, const Con
 
 	//////////////////////////////////////////////////////////////////////////
 	// Allocate buffers
+	MemoryTagScope	Tag( MEMORY_TAG_FAT_PIXELS );
 	m_ppBufferSpecific = new void*[m_MipLevelsCount*_ArraySize];
 
 	int	PixelSize = _Format.Size();
@@ -10,9 +10,13 @@ class	TextureBuilder
 {
 protected:	// CONSTANTS
 
+	static const int	MAX_THREADS = 32;	// Max amount of blocks used by ParallelWavefront()
+
 public:		// NESTED TYPES
 
 	typedef void	(*FillDelegate)( int _X, int _Y, const float2& _UV, Pixel& _Pixel, void* _pData );
+	typedef void	(*RowsDelegate)( int _Y0, int _Y1, void* _pData );	// Processes rows in [_Y0,_Y1[
+	typedef void	(*WavefrontDelegate)( int _Y, int _X0, int _X1, int _BlockIndex, void* _pData );	// Processes columns [_X0,_X1[ of row _Y
 
 	// The complex structure that is guiding the texture conversion
 	// Use -1 in field positions to avoid storing the field
@@ -78,6 +82,8 @@ public:		// PROPERTIES
 	int				GetHeight( int _MipLevel ) const	{ return m_pMipSizes[(_MipLevel<<1)+1]; }
 
 	Pixel**			GetMips()							{ return m_ppBufferGeneric; }
+	const Pixel*	GetMip( int _MipLevel ) const		{ return m_ppBufferGeneric[_MipLevel]; }
+	void			InvalidateMips()					{ m_bMipLevelsBuilt = false; }	// Call this if you wrote into GetMips()[0] yourself
 	const void**	GetLastConvertedMips() const;
 
 
@@ -106,6 +112,18 @@ public:		// METHODS
 	// NOTE: All arrays must have the same pixel format, width, height and mip levels count!
 	Texture2D*		Concat( int _SourcesCount, void** _pppArrays[], int _ArraySizes[], const IPixelFormatDescriptor& _Format, bool _bStaging=false, bool _bWriteable=false ) const;
 
+	// Splits the rows [0,_RowsCount[ into bands of _BandSize rows and dispatches them on the job system
+	// The delegate must only write to its own rows!
+	static void		ParallelRows( int _RowsCount, RowsDelegate _Delegate, void* _pData, int _BandSize=16 );
+
+	// Executes a scan-dependent generator where row Y depends on row Y-1 in the immediate neighborhood (i.e. columns [X-1,X+1], wrapped)
+	// The columns are split into one block per core and the blocks are pipelined in a wavefront: the row of a block is submitted as a job
+	//	as soon as the block and its 2 (wrapped) neighbor blocks are done with the previous row. Rows of a block are always processed in order
+	//	(though not necessarily by the same thread).
+	// Returns the amount of blocks used (at most one per thread, each at least _MinBlockWidth columns wide, cf. ComputeWavefrontBlocksCount()) so callers can prepare per-block data
+	static int		ParallelWavefront( int _Width, int _Height, WavefrontDelegate _Delegate, void* _pData, int _MinBlockWidth=32 );
+	static int		ComputeWavefrontBlocksCount( int _Width, int _MinBlockWidth=32 );
+
 	// Small helper to convert from sRGB to linear space & reverse
 	// From http://wiki.nuaj.net/index.php?title=Color_Transforms#RGB_.E2.86.92_XYZ
 	static float	sRGB2Linear( float _sRGB );
@@ -1,6 +1,6 @@
 #include "Primitive.h"
 
-Primitive::Primitive( Device& _Device, int _VerticesCount, const void* _pVertices, int _IndicesCount, const U32* _pIndices, D3D11_PRIMITIVE_TOPOLOGY _Topology, const IVertexFormatDescriptor& _Format ) : Component( _Device )
+Primitive::Primitive( Device& _Device, int _VerticesCount, const void* _pVertices, int _IndicesCount, const U32* _pIndices, D3D11_PRIMITIVE_TOPOLOGY _Topology, const IVertexFormatDescriptor& _Format, bool _bOptimize ) : Component( _Device )
 	, m_VerticesCount( _VerticesCount )
 	, m_IndicesCount( _IndicesCount )
 	, m_Format( _Format )
@@ -8,12 +8,13 @@ Primitive::Primitive( Device& _Device, int _VerticesCount, const void* _pVertice
 	, m_pVB( NULL )
 	, m_pIB( NULL )
 	, m_BoundVertexStreamsCount( 0 )
+	, m_bOptimize( _bOptimize )
 {
 	m_Stride = _Format.Size();
 	Build( _pVertices, _pIndices, false );
 }
 
-Primitive::Primitive( Device& _Device, const IVertexFormatDescriptor& _Format ) : Component( _Device )
+Primitive::Primitive( Device& _Device, const IVertexFormatDescriptor& _Format, bool _bOptimize ) : Component( _Device )
 	, m_Format( _Format )
 	, m_VerticesCount( 0 )
 	, m_IndicesCount( 0 )
@@ -21,6 +22,7 @@ Primitive::Primitive( Device& _Device, const IVertexFormatDescriptor& _Format )
 	, m_pVB( NULL )
 	, m_pIB( NULL )
 	, m_BoundVertexStreamsCount( 0 )
+	, m_bOptimize( _bOptimize )
 {
 	m_Stride = _Format.Size();
 	// Deferred construction...
@@ -34,6 +36,7 @@ Primitive::Primitive( Device& _Device, int _VerticesCount, int _IndicesCount, D3
 	, m_pVB( NULL )
 	, m_pIB( NULL )
 	, m_BoundVertexStreamsCount( 0 )
+	, m_bOptimize( false )
 {
 	m_Stride = _Format.Size();
 	Build( NULL, NULL, true );
@@ -123,6 +126,35 @@ void	Primitive::Build( const void* _pVertices, const U32* _pIndices, bool _bDyna
 {
 //	ASSERT( m_VerticesCount <= 65536, "Time to upgrade to U32 indices!" );
 
+#ifdef SUPPORT_GEO_BUILDERS
+	memset( m_pOptimizationStatistics, 0, sizeof(m_pOptimizationStatistics) );
+
+	U8*		pOptimizedVertices = NULL;
+	U32*	pOptimizedIndices = NULL;
+	if ( m_bOptimize && !_bDynamic && _pVertices != NULL && _pIndices != NULL && (m_Topology == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST || m_Topology == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP) )
+	{	// Optimize copies of the provided buffers
+		pOptimizedVertices = new U8[m_VerticesCount * m_Stride];
+		memcpy( pOptimizedVertices, _pVertices, m_VerticesCount * m_Stride );
+
+		if ( m_Topology == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP )
+		{
+			pOptimizedIndices = new U32[3*MAX( 0, m_IndicesCount-2 )];
+			m_IndicesCount = MeshOptimizer::ConvertStripToList( _pIndices, m_IndicesCount, pOptimizedIndices );
+			m_Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		}
+		else
+		{
+			pOptimizedIndices = new U32[m_IndicesCount];
+			memcpy( pOptimizedIndices, _pIndices, m_IndicesCount*sizeof(U32) );
+		}
+
+		MeshOptimizer::Optimize( pOptimizedIndices, m_IndicesCount, pOptimizedVertices, m_VerticesCount, m_Stride, 1.05f, &m_pOptimizationStatistics[0], &m_pOptimizationStatistics[1] );
+
+		_pVertices = pOptimizedVertices;
+		_pIndices = pOptimizedIndices;
+	}
+#endif
+
 	{   // Create the vertex buffer
 		D3D11_BUFFER_DESC   Desc;
 		Desc.ByteWidth = m_VerticesCount * m_Stride;
@@ -206,6 +238,11 @@ void	Primitive::Build( const void* _pVertices, const U32* _pIndices, bool _bDyna
 		else
 			ASSERT( FALSE, "Unsupported primitive type !" );
 	}
+
+#ifdef SUPPORT_GEO_BUILDERS
+	delete[] pOptimizedVertices;
+	delete[] pOptimizedIndices;
+#endif
 }
 
 void	Primitive::UpdateDynamic( void* _pVertices, U16* _pIndices, int _VerticesCount, int _IndicesCount )
@@ -248,7 +285,7 @@ void	Primitive::BindVertexStream( U32 _StreamIndex, Primitive& _BoundPrimitive,
 #ifdef SUPPORT_GEO_BUILDERS
 
 // IGeometryWriter Implementation
-void	Primitive::CreateBuffers( int _VerticesCount, int _IndicesCount, D3D11_PRIMITIVE_TOPOLOGY _Topology, void*& _pVertices, void*& _pIndices )
+void	Primitive::CreateBuffers( int _VerticesCount, int _IndicesCount, D3D11_PRIMITIVE_TOPOLOGY _Topology, void*& _pVertices, U32*& _pIndices )
 {
 	ASSERT( _VerticesCount <= 65536, "Too many vertices !" );	// Time to start accounting for large meshes d00d !
 
@@ -260,22 +297,58 @@ void	Primitive::CreateBuffers( int _VerticesCount, int _IndicesCount, D3D11_PRIM
 	_pIndices = new U32[m_IndicesCount];
 }
 
-void	Primitive::AppendVertex( void*& _pVertex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV )
+void	Primitive::AppendVertices( void*& _pVertex, int _Count, const GeometryBuilder::Vertex* _pVertices )
 {
-	m_Format.Write( _pVertex, _Position, _Normal, _Tangent, _BiTangent, _UV );
-	_pVertex = (void*) ((U8*) _pVertex + m_Format.Size());
-}
+	// Write the typed formats used by the builders directly, only fall back to the descriptor for the other ones
+	if ( &m_Format == &VertexFormatP3N3G3B3T2::DESCRIPTOR )
+	{	// Same layout as the builder's vertices
+		ASSERT( sizeof(VertexFormatP3N3G3B3T2) == sizeof(GeometryBuilder::Vertex), "Vertex layouts mismatch!" );
+		memcpy( _pVertex, _pVertices, _Count * sizeof(GeometryBuilder::Vertex) );
+	}
+	else if ( &m_Format == &VertexFormatP3N3G3T2::DESCRIPTOR )
+	{
+		VertexFormatP3N3G3T2*	pTarget = (VertexFormatP3N3G3T2*) _pVertex;
+		for ( int i=0; i < _Count; i++, pTarget++, _pVertices++ )
+		{
+			pTarget->Position = _pVertices->Position;
+			pTarget->Normal = _pVertices->Normal;
+			pTarget->Tangent = _pVertices->Tangent;
+			pTarget->UV = _pVertices->UV;
+		}
+	}
+	else if ( &m_Format == &VertexFormatP3T2::DESCRIPTOR )
+	{
+		VertexFormatP3T2*	pTarget = (VertexFormatP3T2*) _pVertex;
+		for ( int i=0; i < _Count; i++, pTarget++, _pVertices++ )
+		{
+			pTarget->P = _pVertices->Position;
+			pTarget->UV = _pVertices->UV;
+		}
+	}
+	else if ( &m_Format == &VertexFormatP3::DESCRIPTOR )
+	{
+		VertexFormatP3*	pTarget = (VertexFormatP3*) _pVertex;
+		for ( int i=0; i < _Count; i++, pTarget++, _pVertices++ )
+			pTarget->P = _pVertices->Position;
+	}
+	else
+	{
+		U8*	pTarget = (U8*) _pVertex;
+		for ( int i=0; i < _Count; i++, pTarget+=m_Stride, _pVertices++ )
+			m_Format.Write( pTarget, _pVertices->Position, _pVertices->Normal, _pVertices->Tangent, _pVertices->BiTangent, _pVertices->UV );
+	}
 
-void	Primitive::AppendIndex( void*& _pIndex, int _Index )
-{
-	ASSERT( _Index < m_VerticesCount, "Index out of range !" );
-	*((U32*) _pIndex) = _Index;
-	_pIndex = (void*) ((U8*) _pIndex + sizeof(U32));
+	_pVertex = (void*) ((U8*) _pVertex + _Count * m_Stride);
 }
 
-void	Primitive::Finalize( void* _pVertices, void* _pIndices )
+void	Primitive::Finalize( void* _pVertices, U32* _pIndices )
 {
-	Build( _pVertices, (U32*) _pIndices, false );
+#ifdef _DEBUG
+	for ( int i=0; i < m_IndicesCount; i++ )
+		ASSERT( _pIndices[i] < U32(m_VerticesCount), "Index out of range !" );
+#endif
+
+	Build( _pVertices, _pIndices, false );
 
 	delete[] _pVertices;
 	delete[] _pIndices;
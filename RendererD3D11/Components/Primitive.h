@@ -10,6 +10,7 @@
 
 #ifdef SUPPORT_GEO_BUILDERS
 #include "../../Procedural/GeometryBuilder.h"
+#include "../../Procedural/MeshOptimizer.h"
 class Primitive : public Component, public GeometryBuilder::IGeometryWriter
 #else
 class Primitive : public Component
@@ -30,6 +31,7 @@ private:	// FIELDS
 	int								m_IndicesCount;
 	int								m_FacesCount;
 	U32								m_Stride;
+	bool							m_bOptimize;		// True to optimize triangles & vertices order before creating the buffers
 
 	// Render parameters
 	U32								m_BoundVertexStreamsCount;
@@ -40,6 +42,9 @@ private:	// FIELDS
 #ifdef _DEBUG
 	Primitive*						m_ppBoundPrimitives[MAX_BOUND_VERTEX_STREAMS];	// The primitive that contains the vertex stream to bind to our primitive
 #endif
+#ifdef SUPPORT_GEO_BUILDERS
+	MeshOptimizer::Statistics		m_pOptimizationStatistics[2];	// Cache statistics before and after optimization
+#endif
 
 
 public:	 // PROPERTIES
@@ -47,12 +52,17 @@ public:	 // PROPERTIES
 	int				GetVerticesCount() const	{ return m_VerticesCount; }
 	int				GetIndicesCount() const		{ return m_IndicesCount; }
 	int				GetFacesCount() const		{ return m_FacesCount; }
+#ifdef SUPPORT_GEO_BUILDERS
+	const MeshOptimizer::Statistics&	GetStatisticsBeforeOptimization() const	{ return m_pOptimizationStatistics[0]; }
+	const MeshOptimizer::Statistics&	GetStatisticsAfterOptimization() const	{ return m_pOptimizationStatistics[1]; }
+#endif
 
 
 public:	 // METHODS
 
-	Primitive( Device& _Device, int _VerticesCount, const void* _pVertices, int _IndicesCount, const U32* _pIndices, D3D11_PRIMITIVE_TOPOLOGY _Topology, const IVertexFormatDescriptor& _Format );
-	Primitive( Device& _Device, const IVertexFormatDescriptor& _Format );	// Used by geometry builders
+	// _bOptimize, true to reorder the triangles for the vertex cache and the vertices for fetch locality before creating the buffers (triangle strips get converted into lists)
+	Primitive( Device& _Device, int _VerticesCount, const void* _pVertices, int _IndicesCount, const U32* _pIndices, D3D11_PRIMITIVE_TOPOLOGY _Topology, const IVertexFormatDescriptor& _Format, bool _bOptimize=false );
+	Primitive( Device& _Device, const IVertexFormatDescriptor& _Format, bool _bOptimize=false );	// Used by geometry builders
 	Primitive( Device& _Device, int _VerticesCount, int _IndicesCount, D3D11_PRIMITIVE_TOPOLOGY _Topology, const IVertexFormatDescriptor& _Format );	// Used to build dynamic buffers
 	~Primitive();
 
@@ -80,10 +90,9 @@ public:	 // METHODS
 
 #ifdef SUPPORT_GEO_BUILDERS
 	// IGeometryWriter implementation
-	virtual void	CreateBuffers( int _VerticesCount, int _IndicesCount, D3D11_PRIMITIVE_TOPOLOGY _Topology, void*& _pVertices, void*& _pIndices );
-	virtual void	AppendVertex( void*& _pVertex, const float3& _Position, const float3& _Normal, const float3& _Tangent, const float3& _BiTangent, const float2& _UV );
-	virtual void	AppendIndex( void*& _pIndex, int _Index );
-	virtual void	Finalize( void* _pVertices, void* _pIndices );
+	virtual void	CreateBuffers( int _VerticesCount, int _IndicesCount, D3D11_PRIMITIVE_TOPOLOGY _Topology, void*& _pVertices, U32*& _pIndices );
+	virtual void	AppendVertices( void*& _pVertex, int _Count, const GeometryBuilder::Vertex* _pVertices );
+	virtual void	Finalize( void* _pVertices, U32* _pIndices );
 #endif
 
 private:
@@ -1,5 +1,9 @@
 #include "Texture2D.h"
 
+#ifdef GODCOMPLEX
+#include "../../Utility/Memory.h"	// Video memory is accounted for in the MEMORY_TAG_TEXTURES tag
+#endif
+
 Texture2D::Texture2D( Device& _Device, ID3D11Texture2D& _Texture, const IPixelFormatDescriptor& _Format )
 	: Component( _Device )
 	, m_Format( _Format )
@@ -19,6 +23,7 @@ Texture2D::Texture2D( Device& _Device, ID3D11Texture2D& _Texture, const IPixelFo
 	m_LastAssignedSlotsUAV = -1;
 
 	m_pTexture = &_Texture;
+	m_VideoMemorySize = 0;	// We don't own that texture
 }
 
 Texture2D::Texture2D( Device& _Device, int _Width, int _Height, int _ArraySize, const IPixelFormatDescriptor& _Format, int _MipLevelsCount, const void* const* _ppContent, bool _bStaging, bool _bUnOrderedAccess )
@@ -75,6 +80,11 @@ Texture2D::Texture2D( Device& _Device, int _Width, int _Height, const IDepthSten
 	Desc.MiscFlags = D3D11_RESOURCE_MISC_FLAG( 0 );
 
 	Check( m_Device.DXDevice().CreateTexture2D( &Desc, NULL, &m_pTexture ) );
+
+	m_VideoMemorySize = m_Width * m_Height * m_ArraySize * _Format.Size();
+#ifdef GODCOMPLEX
+	TrackExternalMemory( MEMORY_TAG_TEXTURES, m_VideoMemorySize );
+#endif
 }
 
 static void		ReleaseDirectXObject( int _EntryIndex, void*& _pValue, void* _pUserData )
@@ -94,6 +104,10 @@ Texture2D::~Texture2D()
 
 	m_pTexture->Release();
 	m_pTexture = NULL;
+
+#ifdef GODCOMPLEX
+	TrackExternalMemory( MEMORY_TAG_TEXTURES, -m_VideoMemorySize );
+#endif
 }
 
 void	Texture2D::Init( const void* const* _ppContent, bool _bStaging, bool _bUnOrderedAccess, TextureFilePOM::MipDescriptor* _pMipDescriptors )
@@ -157,6 +171,20 @@ void	Texture2D::Init( const void* const* _ppContent, bool _bStaging, bool _bUnOr
 	}
 	else
 		Check( m_Device.DXDevice().CreateTexture2D( &Desc, NULL, &m_pTexture ) );
+
+	// Account for the video memory of all the mips
+	int	Width = m_Width;
+	int	Height = m_Height;
+	m_VideoMemorySize = 0;
+	for ( int MipLevelIndex=0; MipLevelIndex < m_MipLevelsCount; MipLevelIndex++ )
+	{
+		m_VideoMemorySize += Width * Height;
+		NextMipSize( Width, Height );
+	}
+	m_VideoMemorySize *= m_ArraySize * m_Format.Size();
+#ifdef GODCOMPLEX
+	TrackExternalMemory( MEMORY_TAG_TEXTURES, m_VideoMemorySize );
+#endif
 }
 
 ID3D11ShaderResourceView*	Texture2D::GetSRV( int _MipLevelStart, int _MipLevelsCount, int _ArrayStart, int _ArraySize, bool _AsArray ) const
@@ -26,6 +26,7 @@ private:	// FIELDS
 	bool							m_bIsCubeMap;
 
 	ID3D11Texture2D*				m_pTexture;
+	int								m_VideoMemorySize;	// Accounted for in the MEMORY_TAG_TEXTURES tag
 
 	// Cached resource views
 	mutable DictionaryU32			m_CachedSRVs;
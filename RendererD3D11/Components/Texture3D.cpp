@@ -1,5 +1,9 @@
 #include "Texture3D.h"
 
+#ifdef GODCOMPLEX
+#include "../../Utility/Memory.h"	// Video memory is accounted for in the MEMORY_TAG_TEXTURES tag
+#endif
+
 Texture3D::Texture3D( Device& _Device, int _Width, int _Height, int _Depth, const IPixelFormatDescriptor& _Format, int _MipLevelsCount, const void* const* _ppContent, bool _bStaging, bool _bUnOrderedAccess )
 	: Component( _Device )
 	, m_Width( _Width )
@@ -27,6 +31,10 @@ Texture3D::~Texture3D()
 
 	m_pTexture->Release();
 	m_pTexture = NULL;
+
+#ifdef GODCOMPLEX
+	TrackExternalMemory( MEMORY_TAG_TEXTURES, -m_VideoMemorySize );
+#endif
 }
 
 void	Texture3D::Init( const void* const* _ppContent, bool _bStaging, bool _bUnOrderedAccess, TextureFilePOM::MipDescriptor* _pMipDescriptors )
@@ -83,6 +91,21 @@ void	Texture3D::Init( const void* const* _ppContent, bool _bStaging, bool _bUnOr
 	}
 	else
 		Check( m_Device.DXDevice().CreateTexture3D( &Desc, NULL, &m_pTexture ) );
+
+	// Account for the video memory of all the mips
+	int	Width = m_Width;
+	int	Height = m_Height;
+	int	Depth = m_Depth;
+	m_VideoMemorySize = 0;
+	for ( int MipLevelIndex=0; MipLevelIndex < m_MipLevelsCount; MipLevelIndex++ )
+	{
+		m_VideoMemorySize += Width * Height * Depth;
+		NextMipSize( Width, Height, Depth );
+	}
+	m_VideoMemorySize *= m_Format.Size();
+#ifdef GODCOMPLEX
+	TrackExternalMemory( MEMORY_TAG_TEXTURES, m_VideoMemorySize );
+#endif
 }
 
 ID3D11ShaderResourceView*	Texture3D::GetSRV( int _MipLevelStart, int _MipLevelsCount, int _FirstWSlice, int _WSize, bool _AsArray ) const
@@ -20,6 +20,7 @@ private:	// FIELDS
 	const IPixelFormatDescriptor&  m_Format;
 
 	ID3D11Texture3D*	m_pTexture;
+	int					m_VideoMemorySize;	// Accounted for in the MEMORY_TAG_TEXTURES tag
 
 	// Cached resource views
 	mutable DictionaryU32			m_CachedSRVs;
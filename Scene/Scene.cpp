@@ -1,11 +1,17 @@
 #include "../GodComplex.h"
 #include "Scene.h"
 
+static const float	LOD_RATIO = 0.5f;		// Each LOD has about half the faces of the previous one
+static const float	LOD_MAX_ERROR = 0.05f;	// We don't simplify primitives beyond 5% of their extent
+
 
 Scene::Scene()
 	: m_pROOT( NULL )
 	, m_MaterialsCount( 0 )
 	, m_ppMaterials( NULL )
+	, m_bOptimizePrimitives( false )
+	, m_LODsCount( 1 )
+	, m_bBuildMeshlets( false )
 {
 }
 Scene::~Scene()
@@ -19,8 +25,15 @@ Scene::~Scene()
 	m_MaterialsCount = 0;
 }
 
-void	Scene::Load( U16 _SceneResourceID, ISceneTagger& _SceneTagger )
+void	Scene::Load( U16 _SceneResourceID, ISceneTagger& _SceneTagger, bool _bOptimizePrimitives, int _LODsCount, bool _bBuildMeshlets )
 {
+	ASSERT( _LODsCount > 0 && _LODsCount <= MeshSimplifier::MAX_LODS, "Invalid amount of LODs!" );
+	MemoryTagScope	Tag( MEMORY_TAG_SCENE );
+
+	m_bOptimizePrimitives = _bOptimizePrimitives;
+	m_LODsCount = _LODsCount;
+	m_bBuildMeshlets = _bBuildMeshlets;
+
 	U32			SceneSize = 0;
 	const U8*	pData = LoadResourceBinary( _SceneResourceID, "SCENE", &SceneSize );
 
@@ -62,7 +75,11 @@ void	Scene::Render( const Node* _pNode, ISceneRenderer& _SceneRenderer, bool _Se
 	ASSERT( _pNode != NULL, "Invalid node!" );
 
 	if ( _pNode->m_Type == Node::MESH )
-		_SceneRenderer.RenderMesh( (const Mesh&) *_pNode, NULL, _SetMaterial );
+	{
+		const Mesh&	M = (const Mesh&) *_pNode;
+		M.m_LODIndex = _SceneRenderer.SelectLOD( M );
+		_SceneRenderer.RenderMesh( M, NULL, _SetMaterial );
+	}
 
 	// Render children
 	for ( int ChildIndex=0; ChildIndex < _pNode->m_ChildrenCount; ChildIndex++ )
@@ -328,6 +345,8 @@ Scene::Mesh::Mesh( Scene& _Owner, Node* _pParent )
 	: Node( _Owner, _pParent )
 	, m_PrimitivesCount( 0 )
 	, m_pPrimitives( NULL )
+	, m_LODsCount( 1 )
+	, m_LODIndex( 0 )
 {
 }
 Scene::Mesh::~Mesh()
@@ -356,6 +375,7 @@ void	Scene::Mesh::InitSpecific( const U8*& _pData, ISceneTagger& _SceneTagger )
 		m_LocalBBoxMax = m_LocalBBoxMax.Max( P.m_LocalBBoxMax );
 		m_GlobalBBoxMin = m_GlobalBBoxMin.Min( P.m_GlobalBBoxMin );
 		m_GlobalBBoxMax = m_GlobalBBoxMax.Max( P.m_GlobalBBoxMax );
+		m_LODsCount = MAX( m_LODsCount, P.m_LODsCount );
 
 		// Tag the primitive
 		P.m_pTag = _SceneTagger.TagPrimitive( m_Owner, *this, P );
@@ -368,16 +388,43 @@ void	Scene::Mesh::ExitSpecific( ISceneTagger& _SceneTagClearer )
 		m_pPrimitives[PrimitiveIndex].m_pTag = _SceneTagClearer.TagPrimitive( m_Owner, *this, m_pPrimitives[PrimitiveIndex] );
 }
 
+int		Scene::Mesh::ComputeLOD( const float3& _CameraPosition, float _PixelsPerUnit, float _MaxPixelError ) const
+{
+	// Distance from the camera to the bounding box
+	float3	Delta = (m_GlobalBBoxMin - _CameraPosition).Max( _CameraPosition - m_GlobalBBoxMax ).Max( float3::Zero );
+	float	Distance = Delta.Length();
+
+	// Local space errors are scaled by the largest scale of the transform
+	float	Scale = MAX( MAX( m_Local2World.GetRow( 0 ).Length(), m_Local2World.GetRow( 1 ).Length() ), m_Local2World.GetRow( 2 ).Length() );
+	float	MaxError = _MaxPixelError * Distance / (Scale * _PixelsPerUnit);
+
+	for ( int LODIndex=m_LODsCount-1; LODIndex > 0; LODIndex-- )
+	{
+		float	Error = 0.0f;
+		for ( int PrimitiveIndex=0; PrimitiveIndex < m_PrimitivesCount; PrimitiveIndex++ )
+			Error = MAX( Error, m_pPrimitives[PrimitiveIndex].GetLOD( LODIndex ).Error );
+		if ( Error <= MaxError )
+			return LODIndex;
+	}
+
+	return 0;
+}
+
 Scene::Mesh::Primitive::Primitive()
 	: m_pMaterial( NULL )
 	, m_FacesCount( 0 )
 	, m_pFaces( NULL )
+	, m_TotalFacesCount( 0 )
+	, m_LODsCount( 0 )
+	, m_MeshletsCount( 0 )
+	, m_pMeshlets( NULL )
 	, m_VerticesCount( 0 )
 	, m_pVertices( NULL )
 {
 }
 Scene::Mesh::Primitive::~Primitive()
 {
+	delete[] m_pMeshlets;
 	delete[] m_pFaces;
 	delete[] m_pVertices;
 }
@@ -430,6 +477,81 @@ void	Scene::Mesh::Primitive::Init( Mesh& _Owner, const U8*& _pData )
 	memcpy( m_pVertices, _pData, VertexBufferSize );
 	_pData += VertexBufferSize;
 
+	// Optimize for the vertex cache
+	// NOTE: Only the triangles are reordered, vertices must keep the exported order as some effects bind additional per-vertex streams computed offline (e.g. probe IDs)
+	if ( _Owner.m_Owner.m_bOptimizePrimitives )
+	{
+		MeshOptimizer::Statistics	Before, After;
+		MeshOptimizer::ComputeStatistics( m_pFaces, 3*m_FacesCount, m_VerticesCount, Before );
+		MeshOptimizer::OptimizeVertexCache( m_pFaces, 3*m_FacesCount, m_VerticesCount );
+		MeshOptimizer::OptimizeOverdraw( m_pFaces, 3*m_FacesCount, m_pVertices, m_VerticesCount, VertexSize );
+		MeshOptimizer::ComputeStatistics( m_pFaces, 3*m_FacesCount, m_VerticesCount, After );
+		print( "Scene primitive optimized: %d faces, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", m_FacesCount, Before.ACMR, After.ACMR, Before.ATVR, After.ATVR );
+	}
+
+	// Build the LODs
+	// NOTE: Simplified faces reference the same vertices and are appended after the exported faces so LOD 0 keeps its face indices
+	m_TotalFacesCount = m_FacesCount;
+	m_LODsCount = 1;
+	m_pLODs[0].StartFace = 0;
+	m_pLODs[0].FacesCount = m_FacesCount;
+	m_pLODs[0].Error = 0.0f;
+	if ( _Owner.m_Owner.m_LODsCount > 1 && m_VertexFormat == P3N3G3B3T2 )
+	{
+		LinearAllocator&		Scratch = GetThreadScratch();
+		LinearAllocator::Scope	ScratchScope( Scratch );
+
+		// Very large meshes don't fit in the scratch so their LOD chain is built on the heap
+		int		LODsCount = _Owner.m_Owner.m_LODsCount;
+		U32		LODIndicesCount = LODsCount*3*m_FacesCount;
+		bool	bUseScratch = LODIndicesCount*sizeof(U32) + 16 <= Scratch.GetCapacity() - Scratch.GetSize();
+		U32*	pLODIndices = bUseScratch ? Scratch.Allocate<U32>( LODIndicesCount ) : new U32[LODIndicesCount];
+		int		pLODIndicesCount[MeshSimplifier::MAX_LODS];
+		float	pLODErrors[MeshSimplifier::MAX_LODS];
+		m_LODsCount = MeshSimplifier::BuildLODChain( m_pFaces, 3*m_FacesCount, (const GeometryBuilder::Vertex*) m_pVertices, m_VerticesCount, LODsCount, LOD_RATIO, LOD_MAX_ERROR, pLODIndices, pLODIndicesCount, pLODErrors );
+
+		float3	Size = m_LocalBBoxMax - m_LocalBBoxMin;
+		float	Extent = MAX( MAX( Size.x, Size.y ), Size.z );
+		for ( int LODIndex=1; LODIndex < m_LODsCount; LODIndex++ )
+		{
+			m_pLODs[LODIndex].StartFace = m_TotalFacesCount;
+			m_pLODs[LODIndex].FacesCount = pLODIndicesCount[LODIndex] / 3;
+			m_pLODs[LODIndex].Error = pLODErrors[LODIndex] * Extent;
+			m_TotalFacesCount += m_pLODs[LODIndex].FacesCount;
+		}
+
+		U32*	pFaces = new U32[3*m_TotalFacesCount];
+		memcpy( pFaces, pLODIndices, 3*m_TotalFacesCount*sizeof(U32) );
+		delete[] m_pFaces;
+		m_pFaces = pFaces;
+		if ( !bUseScratch )
+			delete[] pLODIndices;
+
+		if ( _Owner.m_Owner.m_bOptimizePrimitives )
+			for ( int LODIndex=1; LODIndex < m_LODsCount; LODIndex++ )
+				MeshOptimizer::OptimizeVertexCache( m_pFaces + 3*m_pLODs[LODIndex].StartFace, 3*m_pLODs[LODIndex].FacesCount, m_VerticesCount );
+
+		print( "Scene primitive simplified: %d LODs, %d faces -> %d faces\n", m_LODsCount, m_FacesCount, m_pLODs[m_LODsCount-1].FacesCount );
+	}
+
+	// Split LOD 0 into meshlets
+	// NOTE: Meshlets reorder the triangles so they're built from a copy of the exported faces appended after the LODs, LOD 0 keeps its face indices
+	if ( _Owner.m_Owner.m_bBuildMeshlets )
+	{
+		U32*	pFaces = new U32[3*(m_TotalFacesCount + m_FacesCount)];
+		memcpy( pFaces, m_pFaces, 3*m_TotalFacesCount*sizeof(U32) );
+		memcpy( pFaces + 3*m_TotalFacesCount, m_pFaces, 3*m_FacesCount*sizeof(U32) );
+		delete[] m_pFaces;
+		m_pFaces = pFaces;
+
+		m_pMeshlets = new MeshletBuilder::Meshlet[MeshletBuilder::ComputeMaxMeshletsCount( 3*m_FacesCount )];
+		m_MeshletsCount = MeshletBuilder::Build( m_pFaces + 3*m_TotalFacesCount, 3*m_FacesCount, m_pVertices, m_VerticesCount, VertexSize, m_pMeshlets );
+		for ( int MeshletIndex=0; MeshletIndex < m_MeshletsCount; MeshletIndex++ )
+			m_pMeshlets[MeshletIndex].StartFace += m_TotalFacesCount;	// So the culled ranges directly index m_pFaces
+
+		m_TotalFacesCount += m_FacesCount;
+	}
+
 	// Compute global bounding box
 	m_GlobalBBoxMin = float3::MaxFlt;
 	m_GlobalBBoxMax = -float3::MaxFlt;
@@ -106,8 +106,21 @@ public:		// NESTED TYPES
 			float3				m_GlobalBBoxMin;
 			float3				m_GlobalBBoxMax;
 
-			U32					m_FacesCount;
-			U32*				m_pFaces;
+			U32					m_FacesCount;		// Amount of faces of the full resolution primitive (i.e. LOD 0)
+			U32*				m_pFaces;			// Faces of all the LODs one after the other, LOD 0 coming first with the exported faces, then the faces of the meshlets
+			U32					m_TotalFacesCount;	// Amount of faces of all the LODs and meshlets
+
+			struct	LOD
+			{
+				U32				StartFace;
+				U32				FacesCount;
+				float			Error;				// Simplification error in LOCAL space
+			};
+			int					m_LODsCount;
+			LOD					m_pLODs[MeshSimplifier::MAX_LODS];
+
+			int					m_MeshletsCount;	// Meshlets of LOD 0 (0 if meshlets were not built), their faces are a reordered copy of LOD 0's stored after the last LOD
+			MeshletBuilder::Meshlet*	m_pMeshlets;
 
 			enum	VERTEX_FORMAT
 			{
@@ -119,6 +132,10 @@ public:		// NESTED TYPES
 
 			void*				m_pTag;	// Custom user tag filled with anything the user needs to render the node
 
+		public:
+			// Gets one of the LODs, clamped to the coarsest LOD we have
+			const LOD&	GetLOD( int _LODIndex ) const	{ return m_pLODs[MIN( _LODIndex, m_LODsCount-1 )]; }
+
 		private:
 			Primitive();
 			~Primitive();
@@ -138,6 +155,17 @@ public:		// NESTED TYPES
 		float3				m_GlobalBBoxMin;
 		float3				m_GlobalBBoxMax;
 
+		int					m_LODsCount;	// Largest amount of LODs among our primitives
+		mutable int			m_LODIndex;		// LOD selected by the scene renderer for the current frame (0 for full resolution)
+
+	public:	// METHODS
+
+		// Selects the coarsest LOD whose projected error stays below a given amount of pixels
+		//	_CameraPosition, the camera position in WORLD space
+		//	_PixelsPerUnit, the size in pixels of a unit object at a unit distance (i.e. ScreenHeight / (2*tan(FOV/2)))
+		//	_MaxPixelError, the maximum error we accept in pixels
+		int				ComputeLOD( const float3& _CameraPosition, float _PixelsPerUnit, float _MaxPixelError ) const;
+
 	private:
 
 		Mesh( Scene& _Owner, Node* _pParent );
@@ -225,6 +253,10 @@ public:		// NESTED TYPES
 		//	_pMaterialOverride, an optional material used to override the mesh's default material
 		//	_SetMaterial, true to setup the mesh's material (usually, set to false when rendering shadow maps that don't need materials) (except alpha-tested materials)
 		virtual void	RenderMesh( const Scene::Mesh& _Mesh, ::Material* _pMaterialOverride, bool _SetMaterial=true ) abstract;
+
+		// Selects the LOD of a mesh before it gets rendered, the result is stored into Mesh::m_LODIndex for RenderMesh() to use
+		//	(the default implementation always renders the full resolution meshes, see Mesh::ComputeLOD() for a simple screen-space error selection)
+		virtual int		SelectLOD( const Scene::Mesh& _Mesh )	{ return 0; }
 	};
 
 	// Use a visitor class to browse the scene nodes
@@ -243,6 +275,10 @@ public:		// FIELDS
 
 	const ISceneTagger*	m_pSceneTagger;
 
+	bool				m_bOptimizePrimitives;	// True to reorder the primitives' triangles for the vertex cache at load time
+	int					m_LODsCount;			// Amount of LODs to build for each primitive at load time
+	bool				m_bBuildMeshlets;		// True to split the primitives into meshlets at load time
+
 
 public:		// METHODS
 
@@ -250,7 +286,13 @@ public:		// METHODS
 	~Scene();	// WARNING: Call "ClearTags" to dispose of your tags prior destruction!
 
 
-	void			Load( U16 _SceneResourceID, ISceneTagger& _SceneTagger );
+	// _bOptimizePrimitives, true to reorder the triangles of the primitives for the post-transform vertex cache (vertices keep their order)
+	//	WARNING: Don't use it if you rely on the exported face indices (e.g. face IDs rendered into probe cube maps for offline encoding)
+	// _LODsCount, the amount of LODs to build for each primitive (1 for no simplification). Simplified faces are appended after the exported faces
+	//	so LOD 0 keeps its face indices, but the tagger must upload m_TotalFacesCount faces to be able to render the other LODs
+	// _bBuildMeshlets, true to split LOD 0 into meshlets that can be culled with MeshletBuilder::Cull(). The meshlets use a reordered copy of the faces
+	//	of LOD 0 appended after the LODs so the exported face indices are kept, the tagger must also upload m_TotalFacesCount faces
+	void			Load( U16 _SceneResourceID, ISceneTagger& _SceneTagger, bool _bOptimizePrimitives=false, int _LODsCount=1, bool _bBuildMeshlets=false );
 	void			Render( ISceneRenderer& _SceneRenderer, bool _SetMaterial=true ) const;
 	void			ClearTags( ISceneTagger& _SceneTagClearer );
 
@@ -0,0 +1,423 @@
+#include "../GodComplex.h"
+
+namespace
+{
+	// The pending jobs of a thread, in [Top,Bottom[ (indices wrap around the array)
+	// A spin lock is enough as the owner and the thieves rarely compete for the same deque
+	struct	Deque
+	{
+		volatile LONG	Lock;
+		volatile LONG	Top;
+		volatile LONG	Bottom;
+		JobSystem::Job	pJobs[JobSystem::DEQUE_SIZE];
+
+		void	Acquire()
+		{
+			while ( InterlockedCompareExchange( &Lock, 1, 0 ) != 0 )
+				YieldProcessor();
+		}
+		void	Release()	{ InterlockedExchange( &Lock, 0 ); }
+
+		bool	IsEmpty() const	{ return Top == Bottom; }
+		void	Rewind()		{ if ( Top == Bottom ) Top = Bottom = 0; }	// So the indices never overflow
+
+		bool	Push( const JobSystem::Job& _Job )
+		{
+			Acquire();
+			if ( Bottom - Top >= JobSystem::DEQUE_SIZE )
+			{	// Full
+				Release();
+				return false;
+			}
+			pJobs[Bottom % JobSystem::DEQUE_SIZE] = _Job;
+			Bottom++;
+			Release();
+			return true;
+		}
+
+		// The owner takes the most recent job...
+		bool	Pop( JobSystem::Job& _Job )
+		{
+			if ( IsEmpty() )
+				return false;
+
+			Acquire();
+			bool	bFound = !IsEmpty();
+			if ( bFound )
+				_Job = pJobs[--Bottom % JobSystem::DEQUE_SIZE];
+			Rewind();
+			Release();
+			return bFound;
+		}
+
+		// ...while thieves take the oldest one
+		bool	Steal( JobSystem::Job& _Job )
+		{
+			if ( IsEmpty() )
+				return false;
+
+			Acquire();
+			bool	bFound = !IsEmpty();
+			if ( bFound )
+				_Job = pJobs[Top++ % JobSystem::DEQUE_SIZE];
+			Rewind();
+			Release();
+			return bFound;
+		}
+	};
+
+	int				gs_ThreadsCount = 0;
+	DWORD			gs_TlsIndex = 0;		// Stores the thread index + 1 (so threads outside the pool read 0)
+	HANDLE			gs_phThreads[JobSystem::MAX_THREADS];
+	HANDLE			gs_hWakeUp = NULL;		// Semaphore released for the sleeping workers when jobs are pushed
+	volatile LONG	gs_SleepingCount = 0;
+	volatile bool	gs_bExit = false;
+
+	// One deque per thread of the pool + a last one shared by the threads outside the pool
+	Deque*			gs_pDeques = NULL;
+
+	// Looks for a job in our own deque first then tries to steal one from the other threads
+	bool	FindJob( int _ThreadIndex, JobSystem::Job& _Job )
+	{
+		if ( gs_pDeques[_ThreadIndex].Pop( _Job ) )
+			return true;
+
+		int	DequesCount = gs_ThreadsCount + 1;
+		for ( int VictimIndex=1; VictimIndex < DequesCount; VictimIndex++ )
+			if ( gs_pDeques[(_ThreadIndex + VictimIndex) % DequesCount].Steal( _Job ) )
+				return true;
+
+		return false;
+	}
+
+	bool	HasPendingJobs()
+	{
+		for ( int DequeIndex=0; DequeIndex <= gs_ThreadsCount; DequeIndex++ )
+			if ( !gs_pDeques[DequeIndex].IsEmpty() )
+				return true;
+
+		return false;
+	}
+
+	// Pushes a job (whose counter was already incremented) to the deque of the calling thread
+	bool	Push( const JobSystem::Job& _Job )
+	{
+		int		ThreadIndex = JobSystem::GetThreadIndex();
+		if ( !gs_pDeques[ThreadIndex >= 0 ? ThreadIndex : gs_ThreadsCount].Push( _Job ) )
+			return false;
+
+		// Wake a sleeping worker up
+		// (workers increment the sleeping count before checking the deques one last time so they can't miss that job)
+		if ( gs_SleepingCount > 0 )
+			ReleaseSemaphore( gs_hWakeUp, 1, NULL );
+
+		return true;
+	}
+
+	void	Execute( JobSystem::Job& _Job )
+	{
+		if ( _Job.pRangeDelegate != NULL )
+		{	// Push the upper half of the range for the thieves until we're left with a single grain
+			while ( _Job.End - _Job.Start > _Job.Grain )
+			{
+				int		GrainsCount = (_Job.End - _Job.Start + _Job.Grain - 1) / _Job.Grain;
+
+				JobSystem::Job	UpperHalf = _Job;
+				UpperHalf.Start = _Job.Start + (GrainsCount >> 1) * _Job.Grain;
+				_Job.End = UpperHalf.Start;
+
+				_Job.pCounter->Increment();
+				if ( !Push( UpperHalf ) )
+				{	// Deque is full, do it ourselves
+					Execute( UpperHalf );
+				}
+			}
+
+			(*_Job.pRangeDelegate)( _Job.Start, _Job.End, _Job.pData );
+		}
+		else
+			(*_Job.pDelegate)( _Job.pData );
+
+		if ( _Job.pCounter != NULL )
+			_Job.pCounter->Decrement();
+	}
+
+	DWORD WINAPI	WorkerThread( void* _pData )
+	{
+		int		ThreadIndex = int( size_t( _pData ) );
+		TlsSetValue( gs_TlsIndex, (void*) size_t( ThreadIndex+1 ) );
+
+		int		IdleCount = 0;
+		while ( true )
+		{
+			JobSystem::Job	Job;
+			if ( FindJob( ThreadIndex, Job ) )
+			{
+				Execute( Job );
+				IdleCount = 0;
+				continue;
+			}
+			if ( gs_bExit )
+				break;
+
+			if ( ++IdleCount < JobSystem::IDLE_SPINS_COUNT )
+			{	// Spin a little as new jobs usually come in bursts
+				YieldProcessor();
+				continue;
+			}
+
+			// Go to sleep until some jobs are pushed
+			InterlockedIncrement( &gs_SleepingCount );
+			if ( !HasPendingJobs() && !gs_bExit )
+				WaitForSingleObject( gs_hWakeUp, INFINITE );
+			InterlockedDecrement( &gs_SleepingCount );
+			IdleCount = 0;
+		}
+
+		FlushThreadMemoryCache();
+		return 0;
+	}
+
+#ifdef _DEBUG
+	void	EmptyJob( void* _pData )						{}
+	void	EmptyRange( int _Start, int _End, void* _pData )	{}
+#endif
+}
+
+void	JobSystem::Init()
+{
+	ASSERT( gs_ThreadsCount == 0, "Job system already initialized!" );
+
+	SYSTEM_INFO	SysInfo;
+	GetSystemInfo( &SysInfo );
+	gs_ThreadsCount = CLAMP( int(SysInfo.dwNumberOfProcessors), 2, MAX_THREADS );	// Always have a worker so jobs submitted from outside the pool progress while the main thread is busy
+
+	gs_pDeques = new Deque[gs_ThreadsCount+1];
+	for ( int DequeIndex=0; DequeIndex <= gs_ThreadsCount; DequeIndex++ )
+	{
+		gs_pDeques[DequeIndex].Lock = 0;
+		gs_pDeques[DequeIndex].Top = gs_pDeques[DequeIndex].Bottom = 0;
+	}
+
+	gs_bExit = false;
+	gs_SleepingCount = 0;
+	gs_hWakeUp = CreateSemaphore( NULL, 0, MAX_THREADS, NULL );
+
+	// The calling thread is the thread #0
+	gs_TlsIndex = TlsAlloc();
+	TlsSetValue( gs_TlsIndex, (void*) size_t( 1 ) );
+
+	for ( int ThreadIndex=1; ThreadIndex < gs_ThreadsCount; ThreadIndex++ )
+		gs_phThreads[ThreadIndex] = CreateThread( NULL, 0, WorkerThread, (void*) size_t( ThreadIndex ), 0, NULL );
+}
+
+void	JobSystem::Exit()
+{
+	if ( gs_ThreadsCount == 0 )
+		return;
+
+	gs_bExit = true;
+	if ( gs_ThreadsCount > 1 )
+	{
+		ReleaseSemaphore( gs_hWakeUp, gs_ThreadsCount-1, NULL );
+		WaitForMultipleObjects( gs_ThreadsCount-1, gs_phThreads+1, TRUE, INFINITE );
+		for ( int ThreadIndex=1; ThreadIndex < gs_ThreadsCount; ThreadIndex++ )
+			CloseHandle( gs_phThreads[ThreadIndex] );
+	}
+
+	CloseHandle( gs_hWakeUp );
+	TlsFree( gs_TlsIndex );
+	delete[] gs_pDeques;
+	gs_pDeques = NULL;
+	gs_ThreadsCount = 0;
+}
+
+int		JobSystem::GetThreadsCount()
+{
+	return gs_ThreadsCount;
+}
+
+int		JobSystem::GetThreadIndex()
+{
+	return int( size_t( TlsGetValue( gs_TlsIndex ) ) ) - 1;
+}
+
+void	JobSystem::Run( JobDelegate _Delegate, void* _pData, Counter* _pCounter )
+{
+	Job	NewJob;
+	NewJob.pDelegate = _Delegate;
+	NewJob.pRangeDelegate = NULL;
+	NewJob.pData = _pData;
+	NewJob.Start = NewJob.End = NewJob.Grain = 0;
+	NewJob.pCounter = _pCounter;
+
+	if ( _pCounter != NULL )
+		_pCounter->Increment();
+	Submit( NewJob );
+}
+
+void	JobSystem::RunAfter( Counter& _Dependency, JobDelegate _Delegate, void* _pData, Counter* _pCounter )
+{
+	Job	NewJob;
+	NewJob.pDelegate = _Delegate;
+	NewJob.pRangeDelegate = NULL;
+	NewJob.pData = _pData;
+	NewJob.Start = NewJob.End = NewJob.Grain = 0;
+	NewJob.pCounter = _pCounter;
+
+	if ( _pCounter != NULL )
+		_pCounter->Increment();
+	_Dependency.RunAfter( NewJob );
+}
+
+void	JobSystem::ParallelFor( int _Count, RangeDelegate _Delegate, void* _pData, int _Grain )
+{
+	if ( _Count <= 0 )
+		return;
+	if ( _Count <= _Grain && GetThreadIndex() >= 0 )
+	{	// A single range, don't bother with the other threads
+		(*_Delegate)( 0, _Count, _pData );
+		return;
+	}
+
+	Counter	Done;
+	ParallelForAsync( _Count, _Delegate, _pData, Done, _Grain );
+	Wait( Done );
+}
+
+void	JobSystem::ParallelForAsync( int _Count, RangeDelegate _Delegate, void* _pData, Counter& _Counter, int _Grain )
+{
+	if ( _Count <= 0 )
+		return;
+
+	Job	NewJob;
+	NewJob.pDelegate = NULL;
+	NewJob.pRangeDelegate = _Delegate;
+	NewJob.pData = _pData;
+	NewJob.Start = 0;
+	NewJob.End = _Count;
+	NewJob.Grain = _Grain > 0 ? _Grain : MAX( 1, _Count / (8 * gs_ThreadsCount) );
+	NewJob.pCounter = &_Counter;
+
+	_Counter.Increment();
+	Submit( NewJob );
+}
+
+void	JobSystem::Wait( Counter& _Counter )
+{
+	int		ThreadIndex = GetThreadIndex();
+	int		IdleCount = 0;
+	while ( !_Counter.IsDone() )
+	{
+		Job	PendingJob;
+		if ( ThreadIndex >= 0 && FindJob( ThreadIndex, PendingJob ) )
+		{	// Make ourselves useful while we wait
+			Execute( PendingJob );
+			IdleCount = 0;
+		}
+		else if ( ++IdleCount < IDLE_SPINS_COUNT )
+			YieldProcessor();
+		else
+			SwitchToThread();
+	}
+}
+
+void	JobSystem::Submit( const Job& _Job )
+{
+	ASSERT( gs_ThreadsCount > 0, "JobSystem::Init() must be called first!" );
+	if ( Push( _Job ) )
+		return;
+
+	if ( GetThreadIndex() >= 0 )
+	{	// Our deque is full, run the job immediately
+		Job	FullJob = _Job;
+		Execute( FullJob );
+		return;
+	}
+
+	// Threads outside the pool can't run jobs so they wait for the shared deque to make room
+	while ( !Push( _Job ) )
+		SwitchToThread();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Counter
+void	JobSystem::Counter::Decrement()
+{
+	// We're busy until we're done with the list of dependent jobs so waiting threads don't destroy the counter under our feet
+	InterlockedIncrement( &m_BusyCount );
+
+	InlineList<Job,2>	Continuations;
+	LONG	Count = InterlockedDecrement( &m_Count );
+	ASSERT( Count >= 0, "Counter decremented more times than incremented!" );
+	if ( Count == 0 )
+	{	// We completed the last job so we start the dependent jobs
+		Lock();
+		Continuations = static_cast<InlineList<Job,2>&&>( m_Continuations );
+		Unlock();
+	}
+
+	InterlockedDecrement( &m_BusyCount );	// WARNING: The counter may be destroyed from now on!
+
+	for ( int JobIndex=0; JobIndex < Continuations.GetCount(); JobIndex++ )
+		JobSystem::Submit( Continuations[JobIndex] );
+}
+
+void	JobSystem::Counter::RunAfter( const Job& _Job )
+{
+	Lock();
+	if ( m_Count > 0 )
+	{	// Still pending
+		m_Continuations.Append( _Job );
+		Unlock();
+		return;
+	}
+	Unlock();
+
+	JobSystem::Submit( _Job );
+}
+
+void	JobSystem::Counter::Lock()
+{
+	while ( InterlockedCompareExchange( &m_Lock, 1, 0 ) != 0 )
+		YieldProcessor();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Micro-benchmarks
+#ifdef _DEBUG
+void	JobSystem::Benchmark( int _JobsCount, BenchmarkResults& _Results )
+{
+	ASSERT( GetThreadIndex() == 0, "Benchmark must be run from the main thread!" );
+	_Results.ThreadsCount = gs_ThreadsCount;
+
+	double		Scale = 1000.0 / _JobsCount;	// Milliseconds for all the jobs => Microseconds per job
+	TimeProfile	Profile;
+
+	// Independent jobs
+	Counter	Done;
+	Profile.Start();
+	for ( int JobIndex=0; JobIndex < _JobsCount; JobIndex++ )
+		Run( EmptyJob, NULL, &Done );
+	Wait( Done );
+	_Results.RunTime = Scale * Profile.Stop();
+
+	// Parallel-for over single items
+	Profile.Start();
+	ParallelFor( _JobsCount, EmptyRange, NULL, 1 );
+	_Results.ParallelForTime = Scale * Profile.Stop();
+
+	// Chain of dependent jobs
+	Counter*	pChain = new Counter[_JobsCount];
+	Profile.Start();
+	Run( EmptyJob, NULL, &pChain[0] );
+	for ( int JobIndex=1; JobIndex < _JobsCount; JobIndex++ )
+		RunAfter( pChain[JobIndex-1], EmptyJob, NULL, &pChain[JobIndex] );
+	Wait( pChain[_JobsCount-1] );
+	_Results.DependencyTime = Scale * Profile.Stop();
+
+	for ( int JobIndex=0; JobIndex < _JobsCount-1; JobIndex++ )
+		Wait( pChain[JobIndex] );	// The last jobs of the other counters may still be releasing them
+	delete[] pChain;
+}
+#endif
@@ -0,0 +1,117 @@
+//////////////////////////////////////////////////////////////////////////
+// Job system shared by the CPU-heavy tasks: procedural texture generation (TextureBuilder), ray tracing (RayTracer) and batched octree queries
+// (probes precomputation in EffectGlobalIllum2 and scene loading still run on the main thread)
+// A pool of worker threads is created once at startup: one thread per core, the main thread being the thread #0 of the pool
+// Each thread owns a deque of pending jobs: it pushes and pops its own jobs at the bottom (the most recent ones, whose data is still in the cache)
+//	while idle threads steal the oldest jobs at the top (for parallel-for jobs, these are the largest ranges left)
+// Jobs decrement a Counter once they're complete. A counter can be waited for or can start other jobs once it reaches 0 (i.e. dependencies)
+// Waiting for a counter never blocks a thread of the pool: it runs pending jobs until the counter reaches 0
+//
+// Threads that don't belong to the pool (e.g. the shader compilation threads) can also submit jobs and wait for them but they never run any
+//
+#pragma once
+
+#include "../NuajAPI/API/List.h"
+
+class	JobSystem
+{
+public:		// CONSTANTS
+
+	static const int	MAX_THREADS = 32;			// Max amount of threads in the pool (including the main thread)
+	static const int	DEQUE_SIZE = 1024;			// Max amount of pending jobs per thread (jobs pushed to a full deque are run immediately)
+	static const int	IDLE_SPINS_COUNT = 256;		// Attempts to find a job before an idle worker goes to sleep
+
+public:		// NESTED TYPES
+
+	typedef void	(*JobDelegate)( void* _pData );
+	typedef void	(*RangeDelegate)( int _Start, int _End, void* _pData );	// Processes items in [_Start,_End[
+
+	class	Counter;
+
+	struct	Job
+	{
+		JobDelegate		pDelegate;
+		RangeDelegate	pRangeDelegate;	// Range jobs are split in halves until they're not larger than the grain size
+		void*			pData;
+		int				Start, End;
+		int				Grain;
+		Counter*		pCounter;		// Decremented once the job is complete (optional)
+	};
+
+	// Counts the pending jobs that signal it, and starts the jobs depending on it once it reaches 0
+	// WARNING: Always wait for a counter before destroying it (its last job may still be busy releasing it even if the jobs depending on it are complete)
+	class	Counter
+	{
+	protected:	// FIELDS
+
+		volatile LONG		m_Count;			// Amount of pending jobs
+		volatile LONG		m_BusyCount;		// Amount of threads still decrementing the counter (so waiting threads don't destroy it under their feet)
+		volatile LONG		m_Lock;				// Protects the dependent jobs
+		InlineList<Job,2>	m_Continuations;	// Jobs to start once the count reaches 0
+
+	public:		// PROPERTIES
+
+		bool		IsDone() const		{ return m_Count == 0 && m_BusyCount == 0; }
+
+	public:		// METHODS
+
+		Counter() : m_Count( 0 ), m_BusyCount( 0 ), m_Lock( 0 )	{}
+		~Counter()	{ ASSERT( IsDone(), "Destroying a counter that still has pending jobs!" ); }
+
+		// WARNING: The dependent jobs are started as soon as the count reaches 0 so increment the counter before registering dependent jobs
+		void		Increment()			{ InterlockedIncrement( &m_Count ); }
+		void		Decrement();	// Starts the dependent jobs when reaching 0
+
+	private:
+		friend class	JobSystem;
+
+		Counter( const Counter& );
+		Counter&	operator=( const Counter& );
+
+		void		RunAfter( const Job& _Job );	// Starts the job once the count reaches 0 (or immediately if it's already 0)
+		void		Lock();
+		void		Unlock()			{ InterlockedExchange( &m_Lock, 0 ); }
+	};
+
+#ifdef _DEBUG
+	// Scheduling overhead, in microseconds
+	struct	BenchmarkResults
+	{
+		int		ThreadsCount;
+		double	RunTime;			// Average time to run an empty job submitted by the main thread
+		double	ParallelForTime;	// Average time per item of a parallel-for over empty items with a grain of 1
+		double	DependencyTime;		// Average time per job of a chain of empty jobs, each one depending on the previous one
+	};
+#endif
+
+public:		// METHODS
+
+	static void	Init();		// Creates the worker threads (must be called by the main thread before submitting any job)
+	static void	Exit();		// Waits for the worker threads to finish their jobs and destroys them
+
+	static int	GetThreadsCount();
+	static int	GetThreadIndex();	// Index of the calling thread in [0,GetThreadsCount()[ (0 is the main thread) or -1 if it's not part of the pool
+
+	// Submits a job that will decrement the optional counter once complete
+	static void	Run( JobDelegate _Delegate, void* _pData, Counter* _pCounter=NULL );
+
+	// Submits a job that will only start once the dependency counter reaches 0
+	// NOTE: The optional counter is incremented immediately so waiting for it also waits for the dependency
+	static void	RunAfter( Counter& _Dependency, JobDelegate _Delegate, void* _pData, Counter* _pCounter=NULL );
+
+	// Processes the items in [0,_Count[ by ranges of at most _Grain items (0 chooses a grain to make about 8 ranges per thread)
+	// Ranges start on a multiple of the grain size
+	static void	ParallelFor( int _Count, RangeDelegate _Delegate, void* _pData, int _Grain=0 );
+	static void	ParallelForAsync( int _Count, RangeDelegate _Delegate, void* _pData, Counter& _Counter, int _Grain=0 );
+
+	// Runs pending jobs until the counter reaches 0
+	static void	Wait( Counter& _Counter );
+
+#ifdef _DEBUG
+	// Measures the scheduling overhead with micro-benchmarks of empty jobs
+	static void	Benchmark( int _JobsCount, BenchmarkResults& _Results );
+#endif
+
+private:
+	static void	Submit( const Job& _Job );
+};
@@ -0,0 +1,100 @@
+#include "../GodComplex.h"
+
+namespace
+{
+	const U32	COMMIT_SIZE = 64*1024;		// Pages are committed by chunks of that size
+
+	// Allocated by InitFrameArenas() since the intro has no CRT to run the constructors and destructors of globals
+	LinearAllocator*	gs_ppFrameArenas[2] = { NULL, NULL };
+	int					gs_FrameArenaIndex = 0;
+}
+
+void	LinearAllocator::Init( U32 _Capacity )
+{
+	ASSERT( !IsInitialized(), "Linear allocator already initialized!" );
+
+	m_Capacity = (_Capacity + COMMIT_SIZE-1) & ~(COMMIT_SIZE-1);
+	m_pBase = (U8*) VirtualAlloc( NULL, m_Capacity, MEM_RESERVE, PAGE_READWRITE );
+	ASSERT( m_pBase != NULL, "Failed to reserve the address range of a linear allocator!" );
+	m_pCurrent = m_pCommitted = m_pBase;
+	m_PeakSize = 0;
+}
+
+void	LinearAllocator::Exit()
+{
+	if ( !IsInitialized() )
+		return;
+
+	ASSERT( GetSize() == 0, "Destroying a linear allocator that still holds allocations!" );
+	VirtualFree( m_pBase, 0, MEM_RELEASE );
+	m_pBase = m_pCurrent = m_pCommitted = NULL;
+	m_Capacity = 0;
+}
+
+void*	LinearAllocator::AllocateSlow( U8* _pResult, U8* _pEnd )
+{
+	ASSERT( IsInitialized(), "Allocating from an uninitialized linear allocator!" );
+	ASSERT( _pEnd <= m_pBase + m_Capacity, "Linear allocator overflow! Increase its capacity or allocate from the heap." );
+	if ( _pEnd > m_pBase + m_Capacity )
+		return NULL;
+
+	U8*	pNewCommitted = m_pBase + ((U32(_pEnd - m_pBase) + COMMIT_SIZE-1) & ~(COMMIT_SIZE-1));
+	void*	pPages = VirtualAlloc( m_pCommitted, pNewCommitted - m_pCommitted, MEM_COMMIT, PAGE_READWRITE );
+	ASSERT( pPages != NULL, "Failed to commit the pages of a linear allocator!" );
+	m_pCommitted = pNewCommitted;
+
+	m_pCurrent = _pEnd;
+	return _pResult;
+}
+
+void	LinearAllocator::Rewind( Marker _Marker )
+{
+	U32	Size = GetSize();
+	ASSERT( _Marker <= Size, "Rewinding to a marker taken after allocations that were already rewound!" );
+	m_PeakSize = MAX( m_PeakSize, Size );
+	m_pCurrent = m_pBase + _Marker;
+
+#ifdef _DEBUG
+	memset( m_pCurrent, 0xCD, Size - _Marker );	// So reading rewound memory shows up
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Frame arenas
+void	InitFrameArenas( U32 _Capacity )
+{
+	ASSERT( gs_ppFrameArenas[0] == NULL, "Frame arenas already initialized!" );
+	gs_ppFrameArenas[0] = new LinearAllocator();
+	gs_ppFrameArenas[1] = new LinearAllocator();
+	gs_ppFrameArenas[0]->Init( _Capacity );
+	gs_ppFrameArenas[1]->Init( _Capacity );
+	gs_FrameArenaIndex = 0;
+}
+
+void	ExitFrameArenas()
+{
+	if ( gs_ppFrameArenas[0] == NULL )
+		return;
+
+	gs_ppFrameArenas[0]->Reset();
+	gs_ppFrameArenas[1]->Reset();
+	delete gs_ppFrameArenas[0];
+	delete gs_ppFrameArenas[1];
+	gs_ppFrameArenas[0] = gs_ppFrameArenas[1] = NULL;
+}
+
+void	BeginFrameArenas()
+{
+#ifdef _DEBUG
+	ASSERT( GetThreadScratch().GetSize() == 0, "Scratch memory allocated during the last frame was never rewound!" );
+#endif
+
+	gs_FrameArenaIndex ^= 1;
+	gs_ppFrameArenas[gs_FrameArenaIndex]->Reset();	// The allocations of the previous frame stay valid in the other arena
+}
+
+LinearAllocator&	GetFrameArena()
+{
+	ASSERT( gs_ppFrameArenas[0] != NULL, "Frame arenas are not initialized!" );
+	return *gs_ppFrameArenas[gs_FrameArenaIndex];
+}
@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////////////////
+// Linear allocator for temporary data
+// Allocating only moves a pointer forward and memory is given back all at once by rewinding to a marker taken earlier:
+//
+//	LinearAllocator&		Scratch = GetThreadScratch();
+//	LinearAllocator::Scope	ScratchScope( Scratch );	// Rewinds the allocator when leaving the scope
+//	U32*	pTemp = Scratch.Allocate<U32>( Count );
+//
+// The address range is reserved once and pages are committed as the allocator grows (they're never decommitted)
+// NOTE: Unlike new, the returned memory is NOT zeroed
+//
+// Each thread has its own scratch allocator (cf. GetThreadScratch() in Memory.h) and the main thread alternates between 2 frame arenas:
+//	memory allocated from the frame arena stays valid until the end of the next frame
+//
+#pragma once
+
+#define SCRATCH_CAPACITY		(32*1024*1024)	// Address range reserved by the scratch allocator of each thread
+#define FRAME_ARENA_CAPACITY	(4*1024*1024)	// Address range reserved by each frame arena
+
+class	LinearAllocator
+{
+public:		// NESTED TYPES
+
+	typedef U32	Marker;
+
+	// Rewinds the allocator to its position at construction time when leaving the scope
+	class	Scope
+	{
+		LinearAllocator&	m_Owner;
+		Marker				m_Marker;
+
+	public:
+		Scope( LinearAllocator& _Owner ) : m_Owner( _Owner ), m_Marker( _Owner.GetMarker() )	{}
+		~Scope()	{ m_Owner.Rewind( m_Marker ); }
+
+	private:
+		Scope&	operator=( const Scope& );
+	};
+
+protected:	// FIELDS
+
+	// NOTE: A zeroed allocator is a valid uninitialized allocator (the thread caches of Memory.cpp rely on that)
+	U8*		m_pBase;
+	U8*		m_pCurrent;
+	U8*		m_pCommitted;	// End of the committed pages
+	U32		m_Capacity;		// Size of the reserved address range
+	U32		m_PeakSize;		// Only updated when rewinding
+
+public:		// PROPERTIES
+
+	bool	IsInitialized() const	{ return m_pBase != NULL; }
+	U32		GetSize() const			{ return U32(m_pCurrent - m_pBase); }
+	U32		GetPeakSize() const		{ return MAX( m_PeakSize, GetSize() ); }
+	U32		GetCapacity() const		{ return m_Capacity; }
+	Marker	GetMarker() const		{ return GetSize(); }
+
+public:		// METHODS
+
+	LinearAllocator() : m_pBase( NULL ), m_pCurrent( NULL ), m_pCommitted( NULL ), m_Capacity( 0 ), m_PeakSize( 0 )	{}
+	~LinearAllocator()	{ Exit(); }
+
+	void	Init( U32 _Capacity );
+	void	Exit();
+
+	// _Alignment must be a power of 2
+	void*	Allocate( U32 _Size, U32 _Alignment=16 )
+	{
+		U8*	pResult = (U8*) ((size_t(m_pCurrent) + _Alignment-1) & ~size_t(_Alignment-1));
+		U8*	pEnd = pResult + _Size;
+		if ( pEnd > m_pCommitted )
+			return AllocateSlow( pResult, pEnd );
+
+		m_pCurrent = pEnd;
+		return pResult;
+	}
+	template<typename T> T*	Allocate( U32 _Count )	{ return (T*) Allocate( _Count * sizeof(T) ); }
+
+	// Frees everything allocated since the marker was taken
+	void	Rewind( Marker _Marker );
+	void	Reset()		{ Rewind( 0 ); }
+
+private:
+	LinearAllocator( const LinearAllocator& );
+	LinearAllocator&	operator=( const LinearAllocator& );
+
+	void*	AllocateSlow( U8* _pResult, U8* _pEnd );	// Commits more pages
+};
+
+// Double-buffered frame arenas (main thread only)
+void				InitFrameArenas( U32 _Capacity=FRAME_ARENA_CAPACITY );
+void				ExitFrameArenas();
+void				BeginFrameArenas();		// Call at the start of each frame: switches to the other arena and empties it
+LinearAllocator&	GetFrameArena();		// Memory allocated there stays valid until the end of the next frame
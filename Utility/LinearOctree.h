@@ -0,0 +1,179 @@
+//////////////////////////////////////////////////////////////////////////
+// Linear octree helper
+// A pointerless variant of the Octree for values that don't move, built in bulk once all the values are appended:
+//	_ Each value is stored only once, in the cell containing its center at the level where the Octree would have stopped
+//	_ Values are sorted by the Morton code of their cell so the values of a node are a contiguous range
+//	_ Nodes are stored depth-first in a single array and the children of a node are contiguous
+// Nodes keep the bounds of the spheres and of the centers of their whole subtree, which are used to prune the queries
+//
+#pragma once
+
+#include "../NuajAPI/API/List.h"
+
+template<typename T> class	LinearOctree
+{
+public:		// CONSTANTS
+
+	static const U32	MAX_LEVEL = 9;		// Deepest level of the tree (3 bits per level for the Morton codes + 4 bits for the level must fit in 32 bits)
+
+private:	// NESTED TYPES
+
+	struct	Content
+	{
+		float3	Position;
+		float	Radius;
+		T		Value;
+	};
+
+	// Flattened node (64 bytes)
+	struct	Node
+	{
+		float3	BBoxMin;			// Bounds of the spheres of the values in the subtree
+		U32		FirstContent;		// Index of the first value of the node in m_pContents
+		float3	BBoxMax;
+		U32		ContentsCount;		// Amount of values in the node itself
+		float3	CentersMin;			// Bounds of the centers of the values in the subtree
+		U32		FirstChild;			// Index of the first child in m_pNodes
+		float3	CentersMax;
+		U16		ChildrenCount;
+		U8		Octant;				// Octant of the node within its parent (X | Y<<1 | Z<<2)
+		U8		Level;
+	};
+
+	// A max-heap of the candidates of a nearest neighbors query, so the farthest one can be quickly replaced by a closer one
+	struct	CandidateHeap
+	{
+		struct	Candidate
+		{
+			float	SqDistance;
+			U32		ContentIndex;
+		};
+
+		Candidate*	pCandidates;
+		int			Count;
+		int			Capacity;
+		Candidate	pLocalCandidates[32];
+
+		CandidateHeap() : pCandidates( pLocalCandidates ), Count( 0 ), Capacity( 32 )	{}
+		~CandidateHeap()	{ if ( pCandidates != pLocalCandidates ) delete[] pCandidates; }
+
+		const Candidate&	Top() const	{ return pCandidates[0]; }
+		void	Push( float _SqDistance, U32 _ContentIndex );
+		void	Pop();
+	};
+
+	// A min-heap of the nodes to visit, sorted by the distance of their centers' bounds to the query position
+	struct	NodeQueue
+	{
+		struct	Entry
+		{
+			float	SqDistance;
+			U32		NodeIndex;
+		};
+
+		Entry*	pEntries;
+		int		Count;
+		int		Capacity;
+		Entry	pLocalEntries[64];
+
+		NodeQueue() : pEntries( pLocalEntries ), Count( 0 ), Capacity( 64 )	{}
+		~NodeQueue()	{ if ( pEntries != pLocalEntries ) delete[] pEntries; }
+
+		void	Push( float _SqDistance, U32 _NodeIndex );
+		void	Pop();
+	};
+
+private:	// FIELDS
+
+	float3			m_Min;
+	float3			m_Max;
+	float			m_Size;
+	float			m_MinCellSize;
+	U32				m_MaxLevel;			// Deepest level allowed by the min cell size
+
+	int				m_ContentsCount;
+	int				m_ContentsCapacity;
+	Content*		m_pContents;		// Values in the order of their nodes once built
+
+	int				m_NodesCount;
+	int				m_NodesCapacity;
+	Node*			m_pNodes;
+
+public:
+
+	double			m_BuildTime;		// Duration of the last build in milliseconds (only measured in DEBUG)
+
+
+public:		// METHODS
+
+	LinearOctree();
+	~LinearOctree();
+
+	// Initialize the octree with global scene dimensions
+	//	_MinCellSize, the minimum authorized cell size in the octree
+	//	_MaxElementsInOctree, if known, initializes the pool of values to the specified maximum. Leave to default if to be dynamically resized.
+	void		Init( const float3& _BoundMin, float _Size, float _MinCellSize, U32 _MaxElementsInOctree=0 );
+
+	// Appends a value to the octree (the octree must be built again before querying it)
+	//	_Position, the position of the sphere containing the value
+	//	_Radius, the radius of the sphere containing the value
+	//	_Value, the value to append
+	// Returns the amount of nodes the value was added to (always 1)
+	int			Append( const float3& _Position, float _Radius, T _Value );
+
+	// Builds the nodes once all the values are appended
+	void		Build();
+
+	// Fetches the values overlapping the provided position
+	//	_Position, the position to find overlapping values for
+	//	_Result, the list that will be populated with values overlapping the provided position
+	void		Fetch( const float3& _Position, List<T>& _Result ) const;
+
+	// Fetches the value closest to the provided position
+	//	_Distance, the distance to the retrieved value
+	const T*	FetchNearest( const float3& _Position, float& _Distance ) const;
+
+	// Fetches the _K values closest to the provided position, sorted by increasing distance
+	//	_ppValues, an array of _K pointers that will receive the values
+	//	_pDistances, an optional array of _K distances that will receive the distances to the values
+	// Returns the amount of retrieved values (less than _K if the octree doesn't contain enough values)
+	int			FetchNearest( const float3& _Position, int _K, const T** _ppValues, float* _pDistances=NULL ) const;
+
+	// Fetches the values within the provided radius of the position, sorted by increasing distance
+	//	_pDistances, an optional list that will be populated with the distances to the values
+	// Returns the amount of retrieved values
+	int			FetchRadius( const float3& _Position, float _Radius, List<T>& _Result, List<float>* _pDistances=NULL ) const;
+
+	// Fetches the value closest to the provided position by only descending into the cell containing the position
+	// This is cheaper than FetchNearest() but the result can be far off near the cells' boundaries
+	const T*	FetchNearestApproximate( const float3& _Position, float& _Distance ) const;
+
+#ifdef _DEBUG
+	struct	BenchmarkResults
+	{
+		double	ExactTime;				// Durations of the queries in milliseconds
+		double	ApproximateTime;
+		int		ApproximateErrorsCount;	// Amount of queries where the approximate search didn't find the nearest value
+		float	ApproximateMaxError;	// Max extra distance of the values found by the approximate search (ignoring the queries where it found nothing)
+	};
+
+	// Compares FetchNearest() with FetchNearestApproximate() on random positions within the octree
+	void		BenchmarkNearest( int _QueriesCount, BenchmarkResults& _Results ) const;
+#endif
+
+private:
+
+	void		BuildNode( U32 _NodeIndex, U32 _Start, U32 _End, const U32* _pKeys );
+	U32			AllocateNodes( U32 _Count );
+
+	// Visits the nodes best-first and keeps the _K closest candidates within sqrt(_MaxSqDistance) of the position
+	void		FetchCandidates( const float3& _Position, int _K, float _MaxSqDistance, CandidateHeap& _Candidates ) const;
+
+	static float	SqDistanceToBox( const float3& _Position, const float3& _BBoxMin, const float3& _BBoxMax )
+	{
+		float3	Delta = (_BBoxMin - _Position).Max( _Position - _BBoxMax ).Max( float3::Zero );
+		return Delta.LengthSq();
+	}
+};
+
+#include "LinearOctree.inl"
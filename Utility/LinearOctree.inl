@@ -0,0 +1,573 @@
+template<typename T> LinearOctree<T>::LinearOctree()
+	: m_ContentsCount( 0 )
+	, m_ContentsCapacity( 0 )
+	, m_pContents( NULL )
+	, m_NodesCount( 0 )
+	, m_NodesCapacity( 0 )
+	, m_pNodes( NULL )
+	, m_BuildTime( 0.0 )
+{
+}
+
+template<typename T> LinearOctree<T>::~LinearOctree()
+{
+	delete[] m_pContents;
+	delete[] m_pNodes;
+}
+
+template<typename T> void	LinearOctree<T>::Init( const float3& _BoundMin, float _Size, float _MinCellSize, U32 _MaxElementsInOctree )
+{
+	m_Min = _BoundMin;
+	m_Size = _Size;
+	m_Max = _BoundMin + _Size * float3::One;
+	m_MinCellSize = _MinCellSize;
+
+	// Find the level where the Octree would stop subdividing
+	m_MaxLevel = 0;
+	float	HalfSize = 0.5f * _Size;
+	while ( m_MaxLevel < MAX_LEVEL && HalfSize > _MinCellSize )
+	{
+		m_MaxLevel++;
+		HalfSize *= 0.5f;
+	}
+
+	delete[] m_pContents;
+	m_ContentsCount = 0;
+	m_ContentsCapacity = _MaxElementsInOctree;
+	m_pContents = _MaxElementsInOctree > 0 ? new Content[_MaxElementsInOctree] : NULL;
+
+	m_NodesCount = 0;
+}
+
+template<typename T> int	LinearOctree<T>::Append( const float3& _Position, float _Radius, T _Value )
+{
+	if ( m_ContentsCount == m_ContentsCapacity )
+	{
+		m_ContentsCapacity = MAX( 16, 2*m_ContentsCapacity );
+		Content*	pContents = new Content[m_ContentsCapacity];
+		if ( m_ContentsCount > 0 )
+			memcpy( pContents, m_pContents, m_ContentsCount*sizeof(Content) );
+		delete[] m_pContents;
+		m_pContents = pContents;
+	}
+
+	Content&	NewContent = m_pContents[m_ContentsCount++];
+	NewContent.Position = _Position;
+	NewContent.Radius = _Radius;
+	NewContent.Value = _Value;
+
+	m_NodesCount = 0;	// Needs to be built again
+
+	return 1;
+}
+
+template<typename T> void	LinearOctree<T>::Build()
+{
+#ifdef _DEBUG
+	TimeProfile	Profile( m_BuildTime );
+#endif
+
+	m_NodesCount = 0;
+	if ( m_ContentsCount == 0 )
+		return;
+
+	// Compute the key of each value: the Morton code of the cell containing its center, padded to the deepest level, followed by the cell's level
+	// Sorting the keys gives the values in depth-first order, the values of a node coming before the values of its children
+	U32*	pKeys = new U32[2*m_ContentsCount];
+	U32*	pIndices = new U32[2*m_ContentsCount];
+	for ( int ContentIndex=0; ContentIndex < m_ContentsCount; ContentIndex++ )
+	{
+		const Content&	C = m_pContents[ContentIndex];
+
+		U32		Level = 0;
+		float	HalfSize = 0.5f * m_Size;
+		while ( Level < m_MaxLevel && C.Radius < HalfSize )
+		{	// The value is small enough for the next level
+			Level++;
+			HalfSize *= 0.5f;
+		}
+
+		int		CellsCount = 1 << Level;
+		float	CellsPerUnit = CellsCount / m_Size;
+		int		X = CLAMP( int( (C.Position.x - m_Min.x) * CellsPerUnit ), 0, CellsCount-1 );
+		int		Y = CLAMP( int( (C.Position.y - m_Min.y) * CellsPerUnit ), 0, CellsCount-1 );
+		int		Z = CLAMP( int( (C.Position.z - m_Min.z) * CellsPerUnit ), 0, CellsCount-1 );
+
+		U32		Code = 0;
+		for ( U32 Bit=0; Bit < Level; Bit++ )
+			Code |= (((X >> Bit) & 1) | (((Y >> Bit) & 1) << 1) | (((Z >> Bit) & 1) << 2)) << (3*Bit);
+
+		pKeys[ContentIndex] = (Code << (3*(m_MaxLevel - Level) + 4)) | Level;
+		pIndices[ContentIndex] = ContentIndex;
+	}
+
+	// Radix sort the keys, 8 bits at a time
+	U32*	pSourceKeys = pKeys;
+	U32*	pSourceIndices = pIndices;
+	U32*	pTargetKeys = pKeys + m_ContentsCount;
+	U32*	pTargetIndices = pIndices + m_ContentsCount;
+	for ( U32 Shift=0; Shift < 32; Shift+=8 )
+	{
+		U32	pOffsets[256];
+		memset( pOffsets, 0, 256*sizeof(U32) );
+		for ( int ContentIndex=0; ContentIndex < m_ContentsCount; ContentIndex++ )
+			pOffsets[(pSourceKeys[ContentIndex] >> Shift) & 0xFF]++;
+
+		U32	Offset = 0;
+		for ( int BucketIndex=0; BucketIndex < 256; BucketIndex++ )
+		{
+			U32	Count = pOffsets[BucketIndex];
+			pOffsets[BucketIndex] = Offset;
+			Offset += Count;
+		}
+
+		for ( int ContentIndex=0; ContentIndex < m_ContentsCount; ContentIndex++ )
+		{
+			U32	TargetIndex = pOffsets[(pSourceKeys[ContentIndex] >> Shift) & 0xFF]++;
+			pTargetKeys[TargetIndex] = pSourceKeys[ContentIndex];
+			pTargetIndices[TargetIndex] = pSourceIndices[ContentIndex];
+		}
+
+		U32*	pTemp = pSourceKeys; pSourceKeys = pTargetKeys; pTargetKeys = pTemp;
+				pTemp = pSourceIndices; pSourceIndices = pTargetIndices; pTargetIndices = pTemp;
+	}
+
+	// Store the values in the order of the nodes
+	Content*	pContents = new Content[m_ContentsCapacity];
+	for ( int ContentIndex=0; ContentIndex < m_ContentsCount; ContentIndex++ )
+		pContents[ContentIndex] = m_pContents[pSourceIndices[ContentIndex]];
+	delete[] m_pContents;
+	m_pContents = pContents;
+
+	// Build the nodes
+	if ( m_NodesCapacity < m_ContentsCount )
+	{
+		delete[] m_pNodes;
+		m_NodesCapacity = m_ContentsCount;
+		m_pNodes = new Node[m_NodesCapacity];
+	}
+
+	U32	RootIndex = AllocateNodes( 1 );
+	m_pNodes[RootIndex].Octant = 0;
+	m_pNodes[RootIndex].Level = 0;
+	BuildNode( RootIndex, 0, m_ContentsCount, pSourceKeys );
+
+	delete[] pIndices;
+	delete[] pKeys;
+}
+
+template<typename T> U32	LinearOctree<T>::AllocateNodes( U32 _Count )
+{
+	if ( U32(m_NodesCount) + _Count > U32(m_NodesCapacity) )
+	{
+		m_NodesCapacity = MAX( m_NodesCount + int(_Count), 2*m_NodesCapacity );
+		Node*	pNodes = new Node[m_NodesCapacity];
+		if ( m_NodesCount > 0 )
+			memcpy( pNodes, m_pNodes, m_NodesCount*sizeof(Node) );
+		delete[] m_pNodes;
+		m_pNodes = pNodes;
+	}
+
+	U32	FirstNodeIndex = m_NodesCount;
+	m_NodesCount += _Count;
+	return FirstNodeIndex;
+}
+
+template<typename T> void	LinearOctree<T>::BuildNode( U32 _NodeIndex, U32 _Start, U32 _End, const U32* _pKeys )
+{
+	U32		Level = m_pNodes[_NodeIndex].Level;
+
+	// The node's own values come first
+	float3	BBoxMin = float3::MaxFlt, BBoxMax = -float3::MaxFlt;
+	float3	CentersMin = float3::MaxFlt, CentersMax = -float3::MaxFlt;
+	U32		OwnEnd = _Start;
+	for ( ; OwnEnd < _End && (_pKeys[OwnEnd] & 0xF) == Level; OwnEnd++ )
+	{
+		const Content&	C = m_pContents[OwnEnd];
+		BBoxMin = BBoxMin.Min( C.Position - C.Radius * float3::One );
+		BBoxMax = BBoxMax.Max( C.Position + C.Radius * float3::One );
+		CentersMin = CentersMin.Min( C.Position );
+		CentersMax = CentersMax.Max( C.Position );
+	}
+
+	// The values of each child are contiguous
+	U32		ChildrenCount = 0;
+	U32		FirstChild = 0;
+	if ( OwnEnd < _End )
+	{
+		ASSERT( Level < m_MaxLevel, "Values deeper than the deepest level!" );
+		U32	Shift = 3*(m_MaxLevel - Level - 1) + 4;
+		for ( U32 i=OwnEnd; i < _End; i++ )
+			if ( i == OwnEnd || ((_pKeys[i] ^ _pKeys[i-1]) >> Shift) & 7 )
+				ChildrenCount++;
+
+		FirstChild = AllocateNodes( ChildrenCount );
+
+		U32	ChildIndex = FirstChild;
+		U32	ChildStart = OwnEnd;
+		while ( ChildStart < _End )
+		{
+			U32	Octant = (_pKeys[ChildStart] >> Shift) & 7;
+			U32	ChildEnd = ChildStart+1;
+			while ( ChildEnd < _End && ((_pKeys[ChildEnd] >> Shift) & 7) == Octant )
+				ChildEnd++;
+
+			m_pNodes[ChildIndex].Octant = U8(Octant);
+			m_pNodes[ChildIndex].Level = U8(Level+1);
+			BuildNode( ChildIndex, ChildStart, ChildEnd, _pKeys );
+
+			const Node&	Child = m_pNodes[ChildIndex];
+			BBoxMin = BBoxMin.Min( Child.BBoxMin );
+			BBoxMax = BBoxMax.Max( Child.BBoxMax );
+			CentersMin = CentersMin.Min( Child.CentersMin );
+			CentersMax = CentersMax.Max( Child.CentersMax );
+
+			ChildIndex++;
+			ChildStart = ChildEnd;
+		}
+	}
+
+	Node&	N = m_pNodes[_NodeIndex];	// Allocating the children may have moved the nodes
+	N.BBoxMin = BBoxMin;
+	N.BBoxMax = BBoxMax;
+	N.CentersMin = CentersMin;
+	N.CentersMax = CentersMax;
+	N.FirstContent = _Start;
+	N.ContentsCount = OwnEnd - _Start;
+	N.FirstChild = FirstChild;
+	N.ChildrenCount = U16(ChildrenCount);
+}
+
+template<typename T> void	LinearOctree<T>::Fetch( const float3& _Position, List<T>& _Result ) const
+{
+	if ( m_NodesCount == 0 )
+		return;
+
+	U32	pStack[8*(MAX_LEVEL+1)];
+	int	StackSize = 0;
+	pStack[StackSize++] = 0;
+	while ( StackSize > 0 )
+	{
+		const Node&	N = m_pNodes[pStack[--StackSize]];
+		if (	_Position.x < N.BBoxMin.x || _Position.y < N.BBoxMin.y || _Position.z < N.BBoxMin.z
+			||	_Position.x > N.BBoxMax.x || _Position.y > N.BBoxMax.y || _Position.z > N.BBoxMax.z )
+			continue;	// No value of that subtree can overlap the position
+
+		for ( U32 ContentIndex=N.FirstContent; ContentIndex < N.FirstContent+N.ContentsCount; ContentIndex++ )
+		{
+			const Content&	C = m_pContents[ContentIndex];
+			if ( (C.Position - _Position).LengthSq() <= C.Radius*C.Radius )
+				_Result.Append( C.Value );
+		}
+
+		for ( U32 ChildIndex=N.FirstChild; ChildIndex < U32(N.FirstChild+N.ChildrenCount); ChildIndex++ )
+			pStack[StackSize++] = ChildIndex;
+	}
+}
+
+template<typename T> const T*	LinearOctree<T>::FetchNearest( const float3& _Position, float& _Distance ) const
+{
+	const T*	pResult = NULL;
+	if ( FetchNearest( _Position, 1, &pResult, &_Distance ) == 0 )
+		return NULL;
+
+	return pResult;
+}
+
+template<typename T> int	LinearOctree<T>::FetchNearest( const float3& _Position, int _K, const T** _ppValues, float* _pDistances ) const
+{
+	if ( _K <= 0 )
+		return 0;
+
+	CandidateHeap	Candidates;
+	FetchCandidates( _Position, _K, MAX_FLOAT, Candidates );
+
+	// Pop the farthest candidates first
+	int	Count = Candidates.Count;
+	for ( int ValueIndex=Count-1; ValueIndex >= 0; ValueIndex-- )
+	{
+		_ppValues[ValueIndex] = &m_pContents[Candidates.Top().ContentIndex].Value;
+		if ( _pDistances != NULL )
+			_pDistances[ValueIndex] = sqrtf( Candidates.Top().SqDistance );
+		Candidates.Pop();
+	}
+
+	return Count;
+}
+
+template<typename T> int	LinearOctree<T>::FetchRadius( const float3& _Position, float _Radius, List<T>& _Result, List<float>* _pDistances ) const
+{
+	CandidateHeap	Candidates;
+	FetchCandidates( _Position, 0x7FFFFFFF, _Radius*_Radius, Candidates );
+
+	// Pop the farthest candidates first
+	int	Count = Candidates.Count;
+	typename CandidateHeap::Candidate*	pSorted = new typename CandidateHeap::Candidate[MAX( 1, Count )];
+	for ( int CandidateIndex=Count-1; CandidateIndex >= 0; CandidateIndex-- )
+	{
+		pSorted[CandidateIndex] = Candidates.Top();
+		Candidates.Pop();
+	}
+
+	for ( int CandidateIndex=0; CandidateIndex < Count; CandidateIndex++ )
+	{
+		_Result.Append( m_pContents[pSorted[CandidateIndex].ContentIndex].Value );
+		if ( _pDistances != NULL )
+			_pDistances->Append( sqrtf( pSorted[CandidateIndex].SqDistance ) );
+	}
+
+	delete[] pSorted;
+
+	return Count;
+}
+
+template<typename T> const T*	LinearOctree<T>::FetchNearestApproximate( const float3& _Position, float& _Distance ) const
+{
+	if ( m_NodesCount == 0 )
+		return NULL;
+
+	const T*	pResult = NULL;
+	float		SqDistance = MAX_FLOAT;
+	float3		CellMin = m_Min;
+	float		CellSize = m_Size;
+	U32			NodeIndex = 0;
+	while ( true )
+	{
+		// Search this node's values
+		const Node&	N = m_pNodes[NodeIndex];
+		for ( U32 ContentIndex=N.FirstContent; ContentIndex < N.FirstContent+N.ContentsCount; ContentIndex++ )
+		{
+			const Content&	C = m_pContents[ContentIndex];
+			float	ContentSqDistance = (C.Position - _Position).LengthSq();
+			if ( ContentSqDistance < SqDistance )
+			{
+				SqDistance = ContentSqDistance;
+				pResult = &C.Value;
+			}
+		}
+
+		// Descend into the child containing the position
+		CellSize *= 0.5f;
+		float3	CellCenter = CellMin + CellSize * float3::One;
+		U32		Octant = 0;
+		if ( _Position.x >= CellCenter.x )
+		{
+			Octant = 1;
+			CellMin.x = CellCenter.x;
+		}
+		if ( _Position.y >= CellCenter.y )
+		{
+			Octant |= 2;
+			CellMin.y = CellCenter.y;
+		}
+		if ( _Position.z >= CellCenter.z )
+		{
+			Octant |= 4;
+			CellMin.z = CellCenter.z;
+		}
+
+		U32	ChildIndex = N.FirstChild;
+		for ( ; ChildIndex < U32(N.FirstChild+N.ChildrenCount); ChildIndex++ )
+			if ( m_pNodes[ChildIndex].Octant == Octant )
+				break;
+		if ( ChildIndex == U32(N.FirstChild+N.ChildrenCount) )
+			break;
+
+		NodeIndex = ChildIndex;
+	}
+
+	if ( pResult == NULL )
+		return NULL;
+
+	_Distance = sqrtf( SqDistance );
+	return pResult;
+}
+
+template<typename T> void	LinearOctree<T>::FetchCandidates( const float3& _Position, int _K, float _MaxSqDistance, CandidateHeap& _Candidates ) const
+{
+	if ( m_NodesCount == 0 )
+		return;
+
+	NodeQueue	Queue;
+	Queue.Push( SqDistanceToBox( _Position, m_pNodes[0].CentersMin, m_pNodes[0].CentersMax ), 0 );
+	while ( Queue.Count > 0 )
+	{
+		typename NodeQueue::Entry	E = Queue.pEntries[0];
+		Queue.Pop();
+
+		float	MaxSqDistance = _Candidates.Count == _K ? _Candidates.Top().SqDistance : _MaxSqDistance;
+		if ( E.SqDistance > MaxSqDistance )
+			break;	// All the remaining nodes are farther than our farthest candidate
+
+		// Test this node's values
+		const Node&	N = m_pNodes[E.NodeIndex];
+		for ( U32 ContentIndex=N.FirstContent; ContentIndex < N.FirstContent+N.ContentsCount; ContentIndex++ )
+		{
+			float	SqDistance = (m_pContents[ContentIndex].Position - _Position).LengthSq();
+			if ( SqDistance > _MaxSqDistance )
+				continue;
+			if ( _Candidates.Count == _K )
+			{
+				if ( SqDistance >= _Candidates.Top().SqDistance )
+					continue;
+				_Candidates.Pop();
+			}
+			_Candidates.Push( SqDistance, ContentIndex );
+		}
+
+		// Queue the children that may contain closer values
+		MaxSqDistance = _Candidates.Count == _K ? _Candidates.Top().SqDistance : _MaxSqDistance;
+		for ( U32 ChildIndex=N.FirstChild; ChildIndex < U32(N.FirstChild+N.ChildrenCount); ChildIndex++ )
+		{
+			const Node&	Child = m_pNodes[ChildIndex];
+			float		SqDistance = SqDistanceToBox( _Position, Child.CentersMin, Child.CentersMax );
+			if ( SqDistance <= MaxSqDistance )
+				Queue.Push( SqDistance, ChildIndex );
+		}
+	}
+}
+
+#ifdef _DEBUG
+template<typename T> void	LinearOctree<T>::BenchmarkNearest( int _QueriesCount, BenchmarkResults& _Results ) const
+{
+	float3*	pPositions = new float3[_QueriesCount];
+	for ( int QueryIndex=0; QueryIndex < _QueriesCount; QueryIndex++ )
+		pPositions[QueryIndex].Set( _frand( m_Min.x, m_Max.x ), _frand( m_Min.y, m_Max.y ), _frand( m_Min.z, m_Max.z ) );
+
+	float*	pExactDistances = new float[_QueriesCount];
+	float*	pApproximateDistances = new float[_QueriesCount];
+	const T*	pResult;
+
+	TimeProfile	Profile;
+	Profile.Start();
+	for ( int QueryIndex=0; QueryIndex < _QueriesCount; QueryIndex++ )
+	{
+		pResult = FetchNearest( pPositions[QueryIndex], pExactDistances[QueryIndex] );
+		if ( pResult == NULL )
+			pExactDistances[QueryIndex] = MAX_FLOAT;
+	}
+	_Results.ExactTime = Profile.Stop();
+
+	Profile.Start();
+	for ( int QueryIndex=0; QueryIndex < _QueriesCount; QueryIndex++ )
+	{
+		pResult = FetchNearestApproximate( pPositions[QueryIndex], pApproximateDistances[QueryIndex] );
+		if ( pResult == NULL )
+			pApproximateDistances[QueryIndex] = MAX_FLOAT;
+	}
+	_Results.ApproximateTime = Profile.Stop();
+
+	_Results.ApproximateErrorsCount = 0;
+	_Results.ApproximateMaxError = 0.0f;
+	for ( int QueryIndex=0; QueryIndex < _QueriesCount; QueryIndex++ )
+	{
+		ASSERT( pExactDistances[QueryIndex] <= pApproximateDistances[QueryIndex], "The exact search should always find the nearest value!" );
+		if ( pApproximateDistances[QueryIndex] == pExactDistances[QueryIndex] )
+			continue;
+
+		_Results.ApproximateErrorsCount++;
+		if ( pApproximateDistances[QueryIndex] < MAX_FLOAT )
+			_Results.ApproximateMaxError = MAX( _Results.ApproximateMaxError, pApproximateDistances[QueryIndex] - pExactDistances[QueryIndex] );
+	}
+
+	delete[] pApproximateDistances;
+	delete[] pExactDistances;
+	delete[] pPositions;
+}
+#endif
+
+template<typename T> void	LinearOctree<T>::CandidateHeap::Push( float _SqDistance, U32 _ContentIndex )
+{
+	if ( Count == Capacity )
+	{
+		Capacity *= 2;
+		Candidate*	pNewCandidates = new Candidate[Capacity];
+		memcpy( pNewCandidates, pCandidates, Count*sizeof(Candidate) );
+		if ( pCandidates != pLocalCandidates )
+			delete[] pCandidates;
+		pCandidates = pNewCandidates;
+	}
+
+	// Sift up
+	int	Index = Count++;
+	while ( Index > 0 )
+	{
+		int	ParentIndex = (Index-1) >> 1;
+		if ( pCandidates[ParentIndex].SqDistance >= _SqDistance )
+			break;
+		pCandidates[Index] = pCandidates[ParentIndex];
+		Index = ParentIndex;
+	}
+	pCandidates[Index].SqDistance = _SqDistance;
+	pCandidates[Index].ContentIndex = _ContentIndex;
+}
+
+template<typename T> void	LinearOctree<T>::CandidateHeap::Pop()
+{
+	ASSERT( Count > 0, "Heap is empty!" );
+	Candidate	Last = pCandidates[--Count];
+
+	// Sift down
+	int	Index = 0;
+	while ( true )
+	{
+		int	ChildIndex = 2*Index+1;
+		if ( ChildIndex >= Count )
+			break;
+		if ( ChildIndex+1 < Count && pCandidates[ChildIndex+1].SqDistance > pCandidates[ChildIndex].SqDistance )
+			ChildIndex++;
+		if ( pCandidates[ChildIndex].SqDistance <= Last.SqDistance )
+			break;
+		pCandidates[Index] = pCandidates[ChildIndex];
+		Index = ChildIndex;
+	}
+	pCandidates[Index] = Last;
+}
+
+template<typename T> void	LinearOctree<T>::NodeQueue::Push( float _SqDistance, U32 _NodeIndex )
+{
+	if ( Count == Capacity )
+	{
+		Capacity *= 2;
+		Entry*	pNewEntries = new Entry[Capacity];
+		memcpy( pNewEntries, pEntries, Count*sizeof(Entry) );
+		if ( pEntries != pLocalEntries )
+			delete[] pEntries;
+		pEntries = pNewEntries;
+	}
+
+	// Sift up
+	int	Index = Count++;
+	while ( Index > 0 )
+	{
+		int	ParentIndex = (Index-1) >> 1;
+		if ( pEntries[ParentIndex].SqDistance <= _SqDistance )
+			break;
+		pEntries[Index] = pEntries[ParentIndex];
+		Index = ParentIndex;
+	}
+	pEntries[Index].SqDistance = _SqDistance;
+	pEntries[Index].NodeIndex = _NodeIndex;
+}
+
+template<typename T> void	LinearOctree<T>::NodeQueue::Pop()
+{
+	ASSERT( Count > 0, "Queue is empty!" );
+	Entry	Last = pEntries[--Count];
+
+	// Sift down
+	int	Index = 0;
+	while ( true )
+	{
+		int	ChildIndex = 2*Index+1;
+		if ( ChildIndex >= Count )
+			break;
+		if ( ChildIndex+1 < Count && pEntries[ChildIndex+1].SqDistance < pEntries[ChildIndex].SqDistance )
+			ChildIndex++;
+		if ( pEntries[ChildIndex].SqDistance >= Last.SqDistance )
+			break;
+		pEntries[Index] = pEntries[ChildIndex];
+		Index = ChildIndex;
+	}
+	pEntries[Index] = Last;
+}
@@ -1,29 +1,617 @@
 #include "../GodComplex.h"
 
-static U8*		gs_pMemoryBuffer = NULL;
-static U8*		gs_pMemoryBufferAligned = NULL;
-static size_t	gs_MemoryOffset = 0;
+namespace
+{
+	const U32	LARGE_ALLOCATION = ~0U;		// Size class of the large allocations
+	const U32	HEADER_SIZE = 64;			// Size of the header at the start of each slab or large allocation (so blocks are aligned on cache lines)
+	const U32	BATCH_SIZE = 8192;			// Amount of bytes moved at once between a shared pool and a thread cache
+	const U32	MAX_BATCH_COUNT = 64;
+
+	const char*	gs_ppTagNames[MEMORY_TAGS_COUNT] = { "Default", "Textures", "Fat pixels", "Probes", "Scene" };
+
+	// The header at the start of each slab or large allocation
+	struct	Header
+	{
+		U32		SizeClass;		// LARGE_ALLOCATION for large allocations
+		U32		Tag;
+		U32		Size;			// Size of a large allocation, including the header
+	};
+
+	struct	FreeBlock
+	{
+		FreeBlock*	pNext;
+	};
+
+	// The shared pool of blocks of a size class and tag
+	struct	Pool
+	{
+		volatile LONG	Lock;
+		U32				BlockSize;
+		U32				BatchCount;			// Amount of blocks moved at once between the pool and the thread caches
+		FreeBlock*		pFreeBlocks;		// Blocks given back by the thread caches
+		U8*				pFresh;				// Never used blocks of the last slab [pFresh,pFreshEnd[ (still zeroed)
+		U8*				pFreshEnd;
+
+		void	Acquire()
+		{
+			while ( InterlockedCompareExchange( &Lock, 1, 0 ) != 0 )
+				YieldProcessor();
+		}
+		void	Release()	{ InterlockedExchange( &Lock, 0 ); }
+	};
+
+	// The blocks of a size class cached by a thread
+	struct	CachedClass
+	{
+		FreeBlock*	pFreeBlocks;		// Recycled blocks (cleared when they're allocated)
+		U32			FreeBlocksCount;
+		U8*			pFresh;				// Never used blocks [pFresh,pFreshEnd[ (already zeroed)
+		U8*			pFreshEnd;
+		U32			AllocationsCount;	// Statistics, only written by the thread owning the cache
+		U32			FreesCount;
+	};
+
+	// The statistics of a tag gathered by a thread and not published yet
+	struct	PendingTagStats
+	{
+		int		Bytes;
+		int		AllocationsCount;
+		U32		TotalAllocationsCount;
+	};
+
+	struct	ThreadCache
+	{
+		ThreadCache*	pNext;			// Caches are never destroyed, the ones of exited threads are reused by new threads
+		volatile LONG	bInUse;
+		MEMORY_TAG		Tag;			// Tag of the allocations of the thread
+		CachedClass		ppClasses[MEMORY_TAGS_COUNT][MEMORY_SIZE_CLASSES_COUNT];
+		PendingTagStats	pPendingStats[MEMORY_TAGS_COUNT];
+		LinearAllocator	Scratch;		// Initialized on first use (the cache is created zeroed so the allocator is valid)
+	};
+
+	// The published statistics of a tag
+	struct	TagStats
+	{
+		volatile LONG	CurrentBytes;
+		volatile LONG	PeakBytes;
+		volatile LONG	AllocationsCount;
+		volatile LONG	TotalAllocationsCount;
+		volatile LONG	BudgetBytes;
+		volatile LONG	bOverBudget;
+	};
+
+	volatile LONG	gs_InitState = 0;	// 0 = not initialized, 1 = initializing, 2 = ready
+	DWORD			gs_TlsIndex = 0;
+	U8				gs_pSizeClasses[MEMORY_MAX_MEDIUM_SIZE/16+1];	// Size class of each multiple of 16 bytes
+	U32				gs_pBlockSizes[MEMORY_SIZE_CLASSES_COUNT];
+	Pool			gs_ppPools[MEMORY_TAGS_COUNT][MEMORY_SIZE_CLASSES_COUNT];
+	ThreadCache*	gs_pCaches = NULL;
+	TagStats		gs_pTagStats[MEMORY_TAGS_COUNT];
+	bool			gs_bSnapshotFileCreated = false;
+
+	volatile LONG	gs_SlabsCount = 0;
+	volatile LONG	gs_LargeAllocationsCount = 0;
+	volatile LONG	gs_LargeAllocationsTotal = 0;
+	volatile LONG	gs_LargeFreesTotal = 0;
+	volatile LONG	gs_LargeBytes = 0;
+	volatile LONG	gs_ReservedBytes = 0;
+	volatile LONG	gs_PeakReservedBytes = 0;
+
+	void	InitMemory()
+	{
+		if ( InterlockedCompareExchange( &gs_InitState, 1, 0 ) != 0 )
+		{	// Another thread is initializing
+			while ( gs_InitState != 2 )
+				YieldProcessor();
+			return;
+		}
+
+		// Build the size classes
+		U32	BlockSize = 16;
+		for ( int SizeClass=0; SizeClass < MEMORY_SIZE_CLASSES_COUNT; SizeClass++ )
+		{
+			gs_pBlockSizes[SizeClass] = BlockSize;
+			for ( int Tag=0; Tag < MEMORY_TAGS_COUNT; Tag++ )
+			{
+				Pool&	P = gs_ppPools[Tag][SizeClass];
+				P.Lock = 0;
+				P.BlockSize = BlockSize;
+				P.BatchCount = CLAMP( BATCH_SIZE / BlockSize, 1U, MAX_BATCH_COUNT );
+				P.pFreeBlocks = NULL;
+				P.pFresh = P.pFreshEnd = NULL;
+			}
+
+			if ( BlockSize < MEMORY_MAX_SMALL_SIZE )
+			{
+				U32	Step = 16;
+				while ( 8*Step <= BlockSize )
+					Step *= 2;	// 4 classes per power of 2 above 128
+				BlockSize += Step;
+			}
+			else
+			{	// Medium classes: the largest multiple of 64 bytes that fits one less time in a slab
+				U32	BlocksPerSlab = MAX( 1U, (MEMORY_SLAB_SIZE - HEADER_SIZE) / (BlockSize + 64) );
+				BlockSize = ((MEMORY_SLAB_SIZE - HEADER_SIZE) / BlocksPerSlab) & ~63U;
+			}
+		}
+		ASSERT( gs_pBlockSizes[MEMORY_SIZE_CLASSES_COUNT-8] == MEMORY_MAX_SMALL_SIZE, "Size classes don't match the max small size!" );
+		ASSERT( gs_pBlockSizes[MEMORY_SIZE_CLASSES_COUNT-1] == MEMORY_MAX_MEDIUM_SIZE && MEMORY_MAX_MEDIUM_SIZE == MEMORY_SLAB_SIZE - HEADER_SIZE, "Size classes don't match the max medium size!" );
+
+		int	SizeClass = 0;
+		for ( int Index=0; Index <= MEMORY_MAX_MEDIUM_SIZE/16; Index++ )
+		{
+			while ( gs_pBlockSizes[SizeClass] < U32(16*Index) )
+				SizeClass++;
+			gs_pSizeClasses[Index] = U8( SizeClass );
+		}
+
+		gs_TlsIndex = TlsAlloc();
+
+		InterlockedExchange( &gs_InitState, 2 );
+	}
+
+	void	UpdatePeak( volatile LONG& _Peak, LONG _Value )
+	{
+		LONG	Peak;
+		while ( (Peak = _Peak) < _Value )
+			if ( InterlockedCompareExchange( &_Peak, _Value, Peak ) == Peak )
+				break;
+	}
+
+	U8*		ReserveSystemMemory( U32 _Size )
+	{
+		U8*	pMemory = (U8*) VirtualAlloc( NULL, _Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+		ASSERT( pMemory != NULL, "Out of memory!" );
+		ASSERT( (size_t(pMemory) & (MEMORY_SLAB_SIZE-1)) == 0, "VirtualAlloc() doesn't return memory aligned on MEMORY_SLAB_SIZE!" );
+
+		LONG	ReservedBytes = InterlockedExchangeAdd( &gs_ReservedBytes, LONG(_Size) ) + LONG(_Size);
+		UpdatePeak( gs_PeakReservedBytes, ReservedBytes );
+
+		return pMemory;
+	}
+
+	void	ReleaseSystemMemory( U8* _pMemory, U32 _Size )
+	{
+		InterlockedExchangeAdd( &gs_ReservedBytes, -LONG(_Size) );
+		VirtualFree( _pMemory, 0, MEM_RELEASE );
+	}
+
+	ThreadCache&	GetThreadCache()
+	{
+		ThreadCache*	pCache = (ThreadCache*) TlsGetValue( gs_TlsIndex );
+		if ( pCache != NULL )
+			return *pCache;
+
+		// Reuse the cache of an exited thread
+		for ( pCache=gs_pCaches; pCache != NULL; pCache=pCache->pNext )
+			if ( !pCache->bInUse && InterlockedCompareExchange( &pCache->bInUse, 1, 0 ) == 0 )
+				break;
+
+		if ( pCache == NULL )
+		{	// Create a new one
+			pCache = (ThreadCache*) ReserveSystemMemory( sizeof(ThreadCache) );
+			pCache->bInUse = 1;
+			do
+			{
+				pCache->pNext = gs_pCaches;
+			} while ( InterlockedCompareExchangePointer( (void* volatile*) &gs_pCaches, pCache, pCache->pNext ) != pCache->pNext );
+		}
+
+		TlsSetValue( gs_TlsIndex, pCache );
+		return *pCache;
+	}
+
+	// Grabs a batch of recycled blocks from the shared pool, or a batch of fresh blocks if there are none
+	void	RefillCache( U32 _Tag, U32 _SizeClass, CachedClass& _Cache )
+	{
+		Pool&	P = gs_ppPools[_Tag][_SizeClass];
+		P.Acquire();
+
+		if ( P.pFreeBlocks != NULL )
+		{
+			FreeBlock*	pLast = P.pFreeBlocks;
+			U32			Count = 1;
+			for ( ; Count < P.BatchCount && pLast->pNext != NULL; Count++ )
+				pLast = pLast->pNext;
+
+			_Cache.pFreeBlocks = P.pFreeBlocks;
+			_Cache.FreeBlocksCount = Count;
+			P.pFreeBlocks = pLast->pNext;
+			pLast->pNext = NULL;
+		}
+		else
+		{
+			if ( P.pFresh == P.pFreshEnd )
+			{	// Create a new slab
+				U8*		pSlab = ReserveSystemMemory( MEMORY_SLAB_SIZE );
+				Header&	H = *((Header*) pSlab);
+				H.SizeClass = _SizeClass;
+				H.Tag = _Tag;
+				H.Size = MEMORY_SLAB_SIZE;
+				InterlockedIncrement( &gs_SlabsCount );
+
+				P.pFresh = pSlab + HEADER_SIZE;
+				P.pFreshEnd = P.pFresh + P.BlockSize * ((MEMORY_SLAB_SIZE - HEADER_SIZE) / P.BlockSize);
+			}
+
+			U32	Count = MIN( P.BatchCount, U32(P.pFreshEnd - P.pFresh) / P.BlockSize );
+			_Cache.pFresh = P.pFresh;
+			_Cache.pFreshEnd = P.pFresh + Count * P.BlockSize;
+			P.pFresh = _Cache.pFreshEnd;
+		}
+
+		P.Release();
+	}
+
+	// Gives all the recycled blocks of the cache but the first _KeptCount back to the shared pool
+	void	FlushCache( U32 _Tag, U32 _SizeClass, CachedClass& _Cache, U32 _KeptCount )
+	{
+		if ( _Cache.FreeBlocksCount <= _KeptCount )
+			return;
+
+		FreeBlock*	pFirst = _Cache.pFreeBlocks;
+		FreeBlock*	pLastKept = NULL;
+		for ( U32 Index=0; Index < _KeptCount; Index++ )
+		{
+			pLastKept = pFirst;
+			pFirst = pFirst->pNext;
+		}
+
+		FreeBlock*	pLast = pFirst;
+		while ( pLast->pNext != NULL )
+			pLast = pLast->pNext;
+
+		if ( pLastKept != NULL )
+			pLastKept->pNext = NULL;
+		else
+			_Cache.pFreeBlocks = NULL;
+		_Cache.FreeBlocksCount = _KeptCount;
+
+		Pool&	P = gs_ppPools[_Tag][_SizeClass];
+		P.Acquire();
+		pLast->pNext = P.pFreeBlocks;
+		P.pFreeBlocks = pFirst;
+		P.Release();
+	}
+
+	// Adds statistics to a tag and warns if that makes it go over budget
+	void	PublishTagStats( U32 _Tag, int _Bytes, int _AllocationsCount, U32 _TotalAllocationsCount )
+	{
+		TagStats&	S = gs_pTagStats[_Tag];
+		LONG		CurrentBytes = InterlockedExchangeAdd( &S.CurrentBytes, _Bytes ) + _Bytes;
+		InterlockedExchangeAdd( &S.AllocationsCount, _AllocationsCount );
+		InterlockedExchangeAdd( &S.TotalAllocationsCount, LONG(_TotalAllocationsCount) );
+		UpdatePeak( S.PeakBytes, CurrentBytes );
+
+		LONG	BudgetBytes = S.BudgetBytes;
+		LONG	bOverBudget = BudgetBytes > 0 && CurrentBytes > BudgetBytes;
+		if ( bOverBudget == S.bOverBudget || InterlockedExchange( &S.bOverBudget, bOverBudget ) == bOverBudget || !bOverBudget )
+			return;	// Only warn once each time the budget is exceeded
+
+		char	pMessage[256];	// No CRT in the intro so we use wsprintf() and integer sizes
+		wsprintfA( pMessage, "WARNING: Memory tag \"%s\" is over budget! %d KB / %d KB\n", gs_ppTagNames[_Tag], CurrentBytes >> 10, BudgetBytes >> 10 );
+		OutputDebugString( pMessage );
+	}
+
+	void	PublishPendingStats( PendingTagStats& _Pending, U32 _Tag )
+	{
+		PublishTagStats( _Tag, _Pending.Bytes, _Pending.AllocationsCount, _Pending.TotalAllocationsCount );
+		_Pending.Bytes = 0;
+		_Pending.AllocationsCount = 0;
+		_Pending.TotalAllocationsCount = 0;
+	}
+
+	void*	AllocateLarge( size_t _Size, U32 _Tag )
+	{
+		U32		Size = U32( HEADER_SIZE + _Size );
+		U8*		pMemory = ReserveSystemMemory( Size );
+		Header&	H = *((Header*) pMemory);
+		H.SizeClass = LARGE_ALLOCATION;
+		H.Tag = _Tag;
+		H.Size = Size;
+
+		InterlockedIncrement( &gs_LargeAllocationsCount );
+		InterlockedIncrement( &gs_LargeAllocationsTotal );
+		InterlockedExchangeAdd( &gs_LargeBytes, LONG(Size) );
+		PublishTagStats( _Tag, Size, 1, 1 );
+
+		return pMemory + HEADER_SIZE;
+	}
+
+	void	FreeLarge( Header& _Header )
+	{
+		InterlockedDecrement( &gs_LargeAllocationsCount );
+		InterlockedIncrement( &gs_LargeFreesTotal );
+		InterlockedExchangeAdd( &gs_LargeBytes, -LONG(_Header.Size) );
+		PublishTagStats( _Header.Tag, -int(_Header.Size), -1, 0 );
+
+		ReleaseSystemMemory( (U8*) &_Header, _Header.Size );
+	}
+}
+
+void*	MemoryAlloc( size_t _Size )
+{
+	if ( gs_InitState != 2 )
+		InitMemory();
+
+	ThreadCache&	Thread = GetThreadCache();
+	U32				Tag = Thread.Tag;
+	if ( _Size > MEMORY_MAX_MEDIUM_SIZE )
+		return AllocateLarge( _Size, Tag );
+
+	U32				SizeClass = gs_pSizeClasses[(_Size+15) >> 4];
+	U32				BlockSize = gs_pBlockSizes[SizeClass];
+	CachedClass&	Cache = Thread.ppClasses[Tag][SizeClass];
+	Cache.AllocationsCount++;
 
-void	AllocateMemoryPool()
+	PendingTagStats&	Pending = Thread.pPendingStats[Tag];
+	Pending.Bytes += BlockSize;
+	Pending.AllocationsCount++;
+	Pending.TotalAllocationsCount++;
+	if ( Pending.Bytes >= MEMORY_TAG_PUBLISH_SIZE )
+		PublishPendingStats( Pending, Tag );
+
+	if ( Cache.pFreeBlocks == NULL && Cache.pFresh == Cache.pFreshEnd )
+		RefillCache( Tag, SizeClass, Cache );
+
+	if ( Cache.pFreeBlocks != NULL )
+	{	// Recycle the most recently freed block (it's probably still in the cache)
+		FreeBlock*	pBlock = Cache.pFreeBlocks;
+		Cache.pFreeBlocks = pBlock->pNext;
+		Cache.FreeBlocksCount--;
+
+		memset( pBlock, 0, _Size );	// The rest of the block is never read, which matters for the medium blocks
+		return pBlock;
+	}
+
+	void*	pBlock = Cache.pFresh;
+	Cache.pFresh += BlockSize;
+	return pBlock;
+}
+
+void	MemoryFree( void* _pMemory )
+{
+	if ( _pMemory == NULL )
+		return;
+
+	Header&	H = *((Header*) (size_t(_pMemory) & ~size_t(MEMORY_SLAB_SIZE-1)));
+	if ( H.SizeClass == LARGE_ALLOCATION )
+	{
+		FreeLarge( H );
+		return;
+	}
+
+	ASSERT( H.SizeClass < MEMORY_SIZE_CLASSES_COUNT && H.Tag < MEMORY_TAGS_COUNT, "Freeing memory that wasn't allocated by MemoryAlloc()!" );
+	ThreadCache&	Thread = GetThreadCache();
+	CachedClass&	Cache = Thread.ppClasses[H.Tag][H.SizeClass];
+	Cache.FreesCount++;
+
+	PendingTagStats&	Pending = Thread.pPendingStats[H.Tag];
+	Pending.Bytes -= gs_pBlockSizes[H.SizeClass];
+	Pending.AllocationsCount--;
+	if ( Pending.Bytes <= -MEMORY_TAG_PUBLISH_SIZE )
+		PublishPendingStats( Pending, H.Tag );
+
+	FreeBlock*	pBlock = (FreeBlock*) _pMemory;
+	pBlock->pNext = Cache.pFreeBlocks;
+	Cache.pFreeBlocks = pBlock;
+	Cache.FreeBlocksCount++;
+
+	U32	BatchCount = gs_ppPools[H.Tag][H.SizeClass].BatchCount;
+	if ( Cache.FreeBlocksCount > 2*BatchCount )
+		FlushCache( H.Tag, H.SizeClass, Cache, BatchCount );	// Keep the most recently freed blocks
+}
+
+void	FlushThreadMemoryCache()
+{
+	if ( gs_InitState != 2 )
+		return;
+
+	ThreadCache*	pCache = (ThreadCache*) TlsGetValue( gs_TlsIndex );
+	if ( pCache == NULL )
+		return;
+
+	for ( U32 Tag=0; Tag < MEMORY_TAGS_COUNT; Tag++ )
+	{
+		for ( U32 SizeClass=0; SizeClass < MEMORY_SIZE_CLASSES_COUNT; SizeClass++ )
+		{
+			CachedClass&	Cache = pCache->ppClasses[Tag][SizeClass];
+
+			// Fresh blocks are given back as recycled blocks
+			U32		BlockSize = gs_pBlockSizes[SizeClass];
+			for ( ; Cache.pFresh < Cache.pFreshEnd; Cache.pFresh += BlockSize )
+			{
+				FreeBlock*	pBlock = (FreeBlock*) Cache.pFresh;
+				pBlock->pNext = Cache.pFreeBlocks;
+				Cache.pFreeBlocks = pBlock;
+				Cache.FreeBlocksCount++;
+			}
+			Cache.pFresh = Cache.pFreshEnd = NULL;
+
+			FlushCache( Tag, SizeClass, Cache, 0 );
+		}
+
+		PublishPendingStats( pCache->pPendingStats[Tag], Tag );
+	}
+	pCache->Tag = MEMORY_TAG_DEFAULT;
+
+	// The scratch allocator keeps its pages for the next thread
+	ASSERT( pCache->Scratch.GetSize() == 0, "Thread exits with scratch memory that was never rewound!" );
+	pCache->Scratch.Reset();
+
+	// Let another thread use the cache (it keeps its statistics)
+	TlsSetValue( gs_TlsIndex, NULL );
+	InterlockedExchange( &pCache->bInUse, 0 );
+}
+
+LinearAllocator&	GetThreadScratch()
+{
+	if ( gs_InitState != 2 )
+		InitMemory();
+
+	LinearAllocator&	Scratch = GetThreadCache().Scratch;
+	if ( !Scratch.IsInitialized() )
+		Scratch.Init( SCRATCH_CAPACITY );
+
+	return Scratch;
+}
+
+void	GetMemoryStats( MemoryStats& _Stats )
+{
+	_Stats.AllocationsCount = gs_LargeAllocationsTotal;
+	_Stats.FreesCount = gs_LargeFreesTotal;
+	for ( U32 SizeClass=0; SizeClass < MEMORY_SIZE_CLASSES_COUNT; SizeClass++ )
+	{
+		_Stats.pBlockSizes[SizeClass] = gs_pBlockSizes[SizeClass];
+		_Stats.pBlocksCount[SizeClass] = 0;
+	}
+
+	// Statistics of the threads are gathered without locking anything so they're only approximate while other threads allocate
+	for ( const ThreadCache* pCache=gs_pCaches; pCache != NULL; pCache=pCache->pNext )
+		for ( U32 Tag=0; Tag < MEMORY_TAGS_COUNT; Tag++ )
+			for ( U32 SizeClass=0; SizeClass < MEMORY_SIZE_CLASSES_COUNT; SizeClass++ )
+			{
+				const CachedClass&	Cache = pCache->ppClasses[Tag][SizeClass];
+				_Stats.AllocationsCount += Cache.AllocationsCount;
+				_Stats.FreesCount += Cache.FreesCount;
+				_Stats.pBlocksCount[SizeClass] += Cache.AllocationsCount - Cache.FreesCount;	// Blocks can be freed by another thread so only the total is meaningful
+			}
+
+	_Stats.SlabsCount = gs_SlabsCount;
+	_Stats.LargeAllocationsCount = gs_LargeAllocationsCount;
+	_Stats.LargeBytes = gs_LargeBytes;
+	_Stats.ReservedBytes = gs_ReservedBytes;
+	_Stats.PeakReservedBytes = gs_PeakReservedBytes;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Tags
+MEMORY_TAG	SetThreadMemoryTag( MEMORY_TAG _Tag )
+{
+	ASSERT( _Tag < MEMORY_TAGS_COUNT, "Invalid memory tag!" );
+	if ( gs_InitState != 2 )
+		InitMemory();
+
+	ThreadCache&	Thread = GetThreadCache();
+	MEMORY_TAG		PreviousTag = Thread.Tag;
+	Thread.Tag = _Tag;
+
+	return PreviousTag;
+}
+
+void	TrackExternalMemory( MEMORY_TAG _Tag, int _Size )
 {
-	gs_pMemoryBuffer = (U8*) GlobalAlloc( GMEM_ZEROINIT, MEMORY_POOL_SIZE );
-	ASSERT( gs_pMemoryBuffer != NULL, "Failed to allocate giant memory octop... never mind... POOL !" );
+	ASSERT( _Tag < MEMORY_TAGS_COUNT, "Invalid memory tag!" );
+	if ( _Size == 0 )
+		return;	// e.g. textures we don't own
 
-	gs_pMemoryBufferAligned = (U8*) (U32(gs_pMemoryBuffer+31) & (~31));
+	PublishTagStats( _Tag, _Size, _Size >= 0 ? 1 : -1, _Size >= 0 ? 1 : 0 );
 }
 
-void	FreeMemoryPool()
+void	SetMemoryBudget( MEMORY_TAG _Tag, U32 _MaxBytes )
 {
-	ASSERT( gs_MemoryOffset > 0, "You initialized the memory pool but didn't even use it in the end ! Nice wast of 64Mb dude !" );	// If this assert fires up then it means you didn't even use the memory pool ! Don't bother allocating 64Mb for nothing then ! ^^
-	GlobalFree( gs_pMemoryBuffer );
+	ASSERT( _Tag < MEMORY_TAGS_COUNT, "Invalid memory tag!" );
+	InterlockedExchange( &gs_pTagStats[_Tag].BudgetBytes, LONG(_MaxBytes) );
+	PublishTagStats( _Tag, 0, 0, 0 );	// Warn right away if the tag is already over budget
 }
 
-void*	Alloc( size_t _Size )
+void	GetMemoryTagStats( MEMORY_TAG _Tag, MemoryTagStats& _Stats )
 {
-	ASSERT( gs_pMemoryBuffer != NULL, "Alloc() called whereas memory pool is not initialized !	Did you forget to call AllocateMemoryPool() ?" );
+	ASSERT( _Tag < MEMORY_TAGS_COUNT, "Invalid memory tag!" );
+
+	// The statistics of the calling thread are exact
+	ThreadCache*	pCache = gs_InitState == 2 ? (ThreadCache*) TlsGetValue( gs_TlsIndex ) : NULL;
+	if ( pCache != NULL )
+		PublishPendingStats( pCache->pPendingStats[_Tag], _Tag );
+
+	const TagStats&	S = gs_pTagStats[_Tag];
+	_Stats.pName = gs_ppTagNames[_Tag];
+	_Stats.CurrentBytes = S.CurrentBytes;
+	_Stats.PeakBytes = S.PeakBytes;
+	_Stats.AllocationsCount = S.AllocationsCount;
+	_Stats.TotalAllocationsCount = S.TotalAllocationsCount;
+	_Stats.BudgetBytes = S.BudgetBytes;
+}
+
+bool	DumpMemorySnapshot( const char* _pFileName, const char* _pMilestone )
+{
+	HANDLE	hFile = CreateFileA( _pFileName, GENERIC_WRITE, FILE_SHARE_READ, NULL, gs_bSnapshotFileCreated ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return false;
+	SetFilePointer( hFile, 0, NULL, FILE_END );
+	gs_bSnapshotFileCreated = true;
+
+	MemoryStats	Stats;
+	GetMemoryStats( Stats );
+
+	// No CRT in the intro so we use wsprintf() (one call per line, as it's limited to 1024 characters) and sizes in KB
+	char	pText[4096];
+	char*	pLine = pText;
+	pLine += wsprintfA( pLine, "========== %.64s ==========\r\n", _pMilestone );
+	pLine += wsprintfA( pLine, "Reserved %u KB (peak %u KB), %u slabs, %u large allocations (%u KB)\r\n", Stats.ReservedBytes >> 10, Stats.PeakReservedBytes >> 10, Stats.SlabsCount, Stats.LargeAllocationsCount, Stats.LargeBytes >> 10 );
+	pLine += wsprintfA( pLine, "%-12s %12s %12s %12s %12s %12s\r\n", "Tag", "Current KB", "Peak KB", "Count", "Total count", "Budget KB" );
+	for ( int Tag=0; Tag < MEMORY_TAGS_COUNT; Tag++ )
+	{
+		MemoryTagStats	TagInfos;
+		GetMemoryTagStats( MEMORY_TAG( Tag ), TagInfos );
+		pLine += wsprintfA( pLine, "%-12s %12u %12u %12u %12u %12u%s\r\n", TagInfos.pName, TagInfos.CurrentBytes >> 10, TagInfos.PeakBytes >> 10, TagInfos.AllocationsCount, TagInfos.TotalAllocationsCount, TagInfos.BudgetBytes >> 10,
+			TagInfos.BudgetBytes == 0 || TagInfos.PeakBytes <= TagInfos.BudgetBytes ? "" : (TagInfos.CurrentBytes > TagInfos.BudgetBytes ? "  OVER BUDGET" : "  PEAK OVER BUDGET") );
+	}
+	pLine += wsprintfA( pLine, "\r\n" );
+
+	DWORD	WrittenSize = 0;
+	BOOL	bSuccess = WriteFile( hFile, pText, DWORD(pLine - pText), &WrittenSize, NULL );
+	CloseHandle( hFile );
+
+	return bSuccess && WrittenSize == DWORD(pLine - pText);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Micro-benchmarks
+#ifdef _DEBUG
+void	BenchmarkMemoryChurn( int _RoundsCount, MemoryChurnBenchmarkResults& _Results )
+{
+	const int	VALUES_COUNT = 4096;
+	U32*		pIDs = new U32[VALUES_COUNT];
+	TimeProfile	Profile;
+
+	// Dictionaries grow their arrays through all the small and medium sizes
+	LONG	SystemAllocations = gs_SlabsCount + gs_LargeAllocationsTotal;
+	Profile.Start();
+	for ( int RoundIndex=0; RoundIndex < _RoundsCount; RoundIndex++ )
+	{
+		Dictionary<U32>	D;
+		DictionaryU32	DU;
+		for ( int ValueIndex=0; ValueIndex < VALUES_COUNT; ValueIndex++ )
+		{
+			pIDs[ValueIndex] = (U32(ValueIndex) << 16) ^ U32(RoundIndex);
+			D.Add( pIDs[ValueIndex], ValueIndex );
+			DU.Add( pIDs[ValueIndex], pIDs );
+		}
+		for ( int ValueIndex=0; ValueIndex < VALUES_COUNT; ValueIndex++ )
+		{
+			D.Remove( pIDs[ValueIndex] );
+			DU.Remove( pIDs[ValueIndex] );
+		}
+	}
+	_Results.DictionariesTime = Profile.Stop();
+	_Results.DictionariesSystemAllocations = U32( gs_SlabsCount + gs_LargeAllocationsTotal - SystemAllocations );
 
-	void*	pResult = gs_pMemoryBufferAligned;
-	gs_pMemoryBufferAligned += gs_MemoryOffset;
+	// Octrees allocate blocks of values and grow the arrays of values of their nodes
+	SystemAllocations = gs_SlabsCount + gs_LargeAllocationsTotal;
+	Profile.Start();
+	for ( int RoundIndex=0; RoundIndex < _RoundsCount; RoundIndex++ )
+	{
+		Octree<int>	O;
+		O.Init( float3::Zero, 100.0f, 4.0f );
+		for ( int ValueIndex=0; ValueIndex < VALUES_COUNT; ValueIndex++ )
+			O.Append( float3( _frand( 0.0f, 100.0f ), _frand( 0.0f, 100.0f ), _frand( 0.0f, 100.0f ) ), _frand( 0.5f, 4.0f ), ValueIndex, &pIDs[ValueIndex] );
+		for ( int ValueIndex=0; ValueIndex < VALUES_COUNT; ValueIndex++ )
+			O.Remove( pIDs[ValueIndex] );
+	}
+	_Results.OctreesTime = Profile.Stop();
+	_Results.OctreesSystemAllocations = U32( gs_SlabsCount + gs_LargeAllocationsTotal - SystemAllocations );
 
-	return pResult;
+	delete[] pIDs;
 }
+#endif
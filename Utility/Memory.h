@@ -1,13 +1,99 @@
 //////////////////////////////////////////////////////////////////////////
 // Memory operators
+// Small and medium allocations are served by pools of fixed-size blocks, one pool per size class and tag. Each thread keeps a cache of free blocks
+//	for every size class and only locks a shared pool to grab or give back a whole batch of blocks.
+// Pools are made of slabs of MEMORY_SLAB_SIZE bytes that are never given back to the OS, large allocations directly reserve pages from the OS.
+// Medium size classes hold the largest blocks that fit 7, 6, 5, 4, 3, 2 and 1 times in a slab, so the growing arrays of hashtables, lists
+//	and octrees don't each reserve and release pages from the OS
+//
+// NOTE: The code relies on new returning zeroed memory (it used to be a GlobalAlloc( GMEM_ZEROINIT )) but fresh pages from the OS
+//	are already zeroed so only recycled blocks are cleared
+//
+// Allocations are tagged with the current tag of the calling thread (cf. MemoryTagScope) and every tag has its own pools so the tag
+//	of a block is found in its slab header when it's freed. Threads gather the statistics of their tags locally and only publish them
+//	once they changed by MEMORY_TAG_PUBLISH_SIZE bytes, so the current and peak sizes of a tag are exact to within that amount per thread.
+// Memory that isn't allocated by new (e.g. video memory) can be accounted for with TrackExternalMemory()
 //
 #pragma once
 
-#define MEMORY_POOL_SIZE	(64*1024*1024)	// 64Mb !
+#define MEMORY_SLAB_SIZE			(64*1024)	// Must match the allocation granularity of VirtualAlloc() as the header of a slab is found by masking an address
+#define MEMORY_MAX_SMALL_SIZE		8192		// Largest of the small size classes
+#define MEMORY_MAX_MEDIUM_SIZE		(MEMORY_SLAB_SIZE-64)	// A single block per slab after its header, larger allocations go straight to the OS
+#define MEMORY_SIZE_CLASSES_COUNT	39			// 16 to 128 bytes by steps of 16, then 4 classes per power of 2 up to MEMORY_MAX_SMALL_SIZE, then 7 medium classes
+#define MEMORY_TAG_PUBLISH_SIZE		(64*1024)
+
+enum	MEMORY_TAG
+{
+	MEMORY_TAG_DEFAULT = 0,
+	MEMORY_TAG_TEXTURES,		// Video memory of the textures and render targets
+	MEMORY_TAG_FAT_PIXELS,		// Texture builders
+	MEMORY_TAG_PROBES,			// Probes data of the global illumination
+	MEMORY_TAG_SCENE,			// Scene nodes, meshes and materials
+
+	MEMORY_TAGS_COUNT
+};
+
+struct	MemoryStats
+{
+	U32		AllocationsCount;								// Total amount of allocations and frees since startup
+	U32		FreesCount;
+	U32		pBlockSizes[MEMORY_SIZE_CLASSES_COUNT];
+	U32		pBlocksCount[MEMORY_SIZE_CLASSES_COUNT];		// Amount of blocks in use for each size class
+	U32		SlabsCount;
+	U32		LargeAllocationsCount;							// Amount of large allocations in use
+	U32		LargeBytes;
+	U32		ReservedBytes;									// Memory obtained from the OS (slabs + large allocations)
+	U32		PeakReservedBytes;
+};
+
+struct	MemoryTagStats
+{
+	const char*	pName;
+	U32			CurrentBytes;
+	U32			PeakBytes;
+	U32			AllocationsCount;		// Amount of allocations in use
+	U32			TotalAllocationsCount;	// Amount of allocations since startup
+	U32			BudgetBytes;			// 0 if the tag has no budget
+};
+
+void*	MemoryAlloc( size_t _Size );	// Always returns zeroed memory
+void	MemoryFree( void* _pMemory );
+void	FlushThreadMemoryCache();		// Gives the free blocks cached by the calling thread back to the shared pools (call it before a thread exits)
+void	GetMemoryStats( MemoryStats& _Stats );
+
+MEMORY_TAG	SetThreadMemoryTag( MEMORY_TAG _Tag );	// Returns the previous tag of the calling thread
+void		TrackExternalMemory( MEMORY_TAG _Tag, int _Size );	// Adds (or removes if negative) memory not allocated by new to a tag
+void		SetMemoryBudget( MEMORY_TAG _Tag, U32 _MaxBytes );	// A warning is issued each time the tag goes over budget (0 removes the budget)
+void		GetMemoryTagStats( MEMORY_TAG _Tag, MemoryTagStats& _Stats );
+bool		DumpMemorySnapshot( const char* _pFileName, const char* _pMilestone );	// Appends the statistics of every tag to the file (the first snapshot of the session clears the file)
+
+#ifdef _DEBUG
+// Allocations churn of the containers whose arrays grow through the medium sizes
+struct	MemoryChurnBenchmarkResults
+{
+	double	DictionariesTime;				// Milliseconds to fill dictionaries with 4096 entries then empty and destroy them
+	double	OctreesTime;					// Milliseconds to fill octrees with 4096 values then remove them and destroy the octrees
+	U32		DictionariesSystemAllocations;	// Amount of slabs and large allocations requested from the OS during each test
+	U32		OctreesSystemAllocations;
+};
+
+void		BenchmarkMemoryChurn( int _RoundsCount, MemoryChurnBenchmarkResults& _Results );
+#endif
+
+// Tags the allocations of the calling thread until the end of the scope
+class	MemoryTagScope
+{
+	MEMORY_TAG	m_PreviousTag;
+
+public:
+	MemoryTagScope( MEMORY_TAG _Tag ) : m_PreviousTag( SetThreadMemoryTag( _Tag ) )	{}
+	~MemoryTagScope()	{ SetThreadMemoryTag( m_PreviousTag ); }
+};
 
-void	AllocateMemoryPool();	// Allocates a big chunck of memory that will be used as a memory pool
-void	FreeMemoryPool();		// Frees a big chunk of memory
-void*	Alloc( size_t _Size );	// Allocates a small buffer (AllocateMemoryPool must have been called first !)
+class	LinearAllocator;
+LinearAllocator&	GetThreadScratch();	// Scratch allocator of the calling thread (cf. LinearAllocator.h)
 
-inline void* __cdecl	operator new( size_t _Size )	{ return GlobalAlloc( GMEM_ZEROINIT, _Size ); }
-inline void  __cdecl	operator delete( void* p )		{ GlobalFree( p ); }
+inline void* __cdecl	operator new( size_t _Size )	{ return MemoryAlloc( _Size ); }
+inline void* __cdecl	operator new[]( size_t _Size )	{ return MemoryAlloc( _Size ); }
+inline void  __cdecl	operator delete( void* p )		{ MemoryFree( p ); }
+inline void  __cdecl	operator delete[]( void* p )	{ MemoryFree( p ); }
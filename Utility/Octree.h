@@ -1,5 +1,12 @@
 //////////////////////////////////////////////////////////////////////////
 // Octree helper
+// Nearest neighbor queries are exact: nodes are visited best-first (i.e. sorted by their distance to the query position)
+//	and the search stops as soon as the closest unvisited node is farther than the farthest result we keep
+// A value is stored in all the nodes its sphere overlaps so queries skip the duplicates
+// Values can be moved and removed: a moving value is inserted with a loose margin around its sphere and is only reinserted
+//	once its sphere leaves these loose bounds. Nodes and values are pooled so a steady churn of values doesn't allocate anything
+// Many nearest queries (e.g. for all the dynamic objects of a frame) should be batched: they're sorted spatially and dispatched on all the cores,
+//	and the answers of the previous frame are reused when they're guaranteed to still be valid
 //
 #pragma once
 
@@ -7,6 +14,29 @@
 
 template<typename T> class	Octree
 {
+public:		// CONSTANTS
+
+	static const int	PARALLEL_QUERIES_COUNT = 64;	// Batches with less queries to search than that are processed on the calling thread
+	static const U32	CONTENT_BLOCK_SIZE = 256;		// Values are allocated by blocks so their address never changes
+
+public:		// NESTED TYPES
+
+	class	Node;
+
+	// The answer of a previous nearest query, to skip the search if the position didn't move much
+	// The nearest value can't change as long as the position stays within half the gap between the distances to the 2 nearest values
+	//	(i.e. moving by D makes the nearest value at most D closer and any other value at most D farther)
+	// WARNING: Hints must be reset (i.e. default constructed) when the octree changes (i.e. values are appended, moved or removed)
+	struct	NearestHint
+	{
+		float3		Position;			// Position of the previous query
+		float3		NearestPosition;	// Position of the nearest value
+		const T*	pNearestValue;
+		float		SafeRadius;			// Negative if the hint is invalid
+
+		NearestHint() : pNearestValue( NULL ), SafeRadius( -1.0f )	{}
+	};
+
 private:	// NESTED TYPES
 
 	struct	Content
@@ -14,9 +44,13 @@ private:	// NESTED TYPES
 		float3	Position;
 		float	Radius;
 		float	SqRadius;
+		float	LooseMargin;
+		float	LooseRadius;	// Radius and bounds the value was inserted with (i.e. its sphere grown by the loose margin)
 		float3	BBoxMin;
 		float3	BBoxMax;
 		T		Value;
+		U32		NextFreeID;		// Next removed value in the pool, only valid if !bUsed
+		bool	bUsed;
 
 		bool	Contains( const float3& _Position ) const
 		{
@@ -37,6 +71,57 @@ private:	// NESTED TYPES
 		}
 	};
 
+	// A candidate result of a nearest neighbors query
+	struct	Candidate
+	{
+		float			SqDistance;
+		const Content*	pContent;
+
+		// Ordered by distance then by content so duplicates are always neighbors once sorted
+		bool	IsFartherThan( const Candidate& _Other ) const	{ return SqDistance > _Other.SqDistance || (SqDistance == _Other.SqDistance && pContent > _Other.pContent); }
+	};
+
+	// A max-heap of candidates, so the farthest one can be quickly replaced by a closer one
+	struct	CandidateHeap
+	{
+		Candidate*	pCandidates;
+		int			Count;
+		int			Capacity;
+		Candidate	pLocalCandidates[32];
+
+		CandidateHeap() : pCandidates( pLocalCandidates ), Count( 0 ), Capacity( 32 )	{}
+		~CandidateHeap()	{ if ( pCandidates != pLocalCandidates ) delete[] pCandidates; }
+
+		const Candidate&	Top() const	{ return pCandidates[0]; }
+		void	Push( const Candidate& _Candidate );
+		void	Pop();
+		bool	Contains( const Content* _pContent ) const;
+	};
+
+	// A min-heap of the nodes to visit, sorted by their distance to the query position
+	struct	NodeQueue
+	{
+		struct	Entry
+		{
+			float		SqDistance;
+			const Node*	pNode;
+			float3		Min;
+			float		Size;
+			U32			OpenFaces;	// Bits 0-2 are set when the cell extends to -infinity on X, Y, Z and bits 3-5 when it extends to +infinity
+		};
+
+		Entry*	pEntries;
+		int		Count;
+		int		Capacity;
+		Entry	pLocalEntries[64];
+
+		NodeQueue() : pEntries( pLocalEntries ), Count( 0 ), Capacity( 64 )	{}
+		~NodeQueue()	{ if ( pEntries != pLocalEntries ) delete[] pEntries; }
+
+		void	Push( const Entry& _Entry );
+		void	Pop();
+	};
+
 public:
 
 	class	Node
@@ -44,10 +129,13 @@ public:
 	public:	// FIELDS
 
 		Octree&			m_Owner;
-		Node*			m_pParent;
+		Node*			m_pParent;		// Next free node when the node is in the pool
 		Node*			m_ppCells[8];
 
-		List<const Content*>	m_Content;
+		// Values stored in that node (the array is kept when the node returns to the pool)
+		int				m_ContentsCount;
+		int				m_ContentsCapacity;
+		const Content**	m_ppContents;
 
 	public:	// METHODS
 
@@ -55,11 +143,16 @@ public:
 		~Node();
 
 		int			Append( const Content& _Content, const float3& _Min, float _Size, U32 _Level );
+		int			Remove( const Content& _Content, const float3& _Min, float _Size );
 		void		Fetch( const float3& _Position, List<T>& _Result, const float3& _Min, float _Size ) const;
-		const T*	FetchNearest( const float3& _Position, const float3& _Min, float _Size, float& _SqDistance ) const;
+		const T*	FetchNearestApproximate( const float3& _Position, const float3& _Min, float _Size, float& _SqDistance ) const;
+
+		bool		IsEmpty() const	{ return m_ContentsCount == 0 && m_ppCells[0] == NULL && m_ppCells[1] == NULL && m_ppCells[2] == NULL && m_ppCells[3] == NULL && m_ppCells[4] == NULL && m_ppCells[5] == NULL && m_ppCells[6] == NULL && m_ppCells[7] == NULL; }
 
 	private:
 		Node&		GetOrCreateChildNode( U32 _X, U32 _Y, U32 _Z );
+		void		AppendContent( const Content* _pContent );
+		bool		RemoveContent( const Content* _pContent );
 	};
 
 private:	// FIELDS
@@ -69,8 +162,12 @@ private:	// FIELDS
 	float			m_Size;
 	float			m_MinCellSize;
 	Node*			m_pROOT;
+	Node*			m_pFreeNodes;			// Nodes returned to the pool, linked by their parent pointer
 
-	List<Content>	m_ContentPool;
+	int				m_ContentBlocksCount;
+	Content**		m_ppContentBlocks;
+	U32				m_ContentsCount;		// Amount of values ever allocated from the blocks (including the removed ones)
+	U32				m_FreeContentID;		// First removed value, ~0 if none
 
 #ifdef _DEBUG
 	U32				m_NodesCount;
@@ -85,7 +182,7 @@ public:		// METHODS
 	Octree();
 	~Octree();
 
-	// Initialize the root node of the octree with global scene diemensions
+	// Initialize the root node of the octree with global scene diemensions (all the values are removed but the memory is kept for the new values)
 	//	_MinCellSize, the minimum authorized cell size in the octree
 	//	_MaxElementsInOctree, if known, initializes the pool of values to the specified maximum. Leave to default if to be dynamically resized.
 	Node&		Init( const float3& _BoundMin, float _Size, float _MinCellSize, U32 _MaxElementsInOctree=0 );
@@ -94,8 +191,18 @@ public:		// METHODS
 	//	_Position, the position of the sphere containing the value
 	//	_Radius, the radius of the sphere containing the value
 	//	_Value, the value to append
+	//	_pID, an optional pointer that receives the ID of the value to move or remove it later
+	//	_LooseMargin, the margin added to the radius when inserting the value, so moving it by less than that doesn't require to reinsert it
 	// Returns the amount of nodes the value was added to
-	int			Append( const float3& _Position, float _Radius, T _Value );
+	int			Append( const float3& _Position, float _Radius, T _Value, U32* _pID=NULL, float _LooseMargin=0.0f );
+
+	// Moves or resizes a value
+	//	_ID, the ID of the value returned by Append()
+	// Returns true if the value left its loose bounds and had to be reinserted
+	bool		Update( U32 _ID, const float3& _Position, float _Radius );
+
+	// Removes a value (its ID may then be reused by the next appended value)
+	void		Remove( U32 _ID );
 
 	// Fetches the values overlapping the provided position
 	//	_Position, the position to find overlapping values for
@@ -105,6 +212,62 @@ public:		// METHODS
 	// Fetches the value closest to the provided position
 	//	_Distance, the distance to the retrieved value
 	const T*	FetchNearest( const float3& _Position, float& _Distance ) const;
+
+	// Fetches the _K values closest to the provided position, sorted by increasing distance
+	//	_ppValues, an array of _K pointers that will receive the values
+	//	_pDistances, an optional array of _K distances that will receive the distances to the values
+	// Returns the amount of retrieved values (less than _K if the octree doesn't contain enough values)
+	int			FetchNearest( const float3& _Position, int _K, const T** _ppValues, float* _pDistances=NULL ) const;
+
+	// Fetches the values within the provided radius of the position, sorted by increasing distance
+	//	_pDistances, an optional list that will be populated with the distances to the values
+	// Returns the amount of retrieved values
+	int			FetchRadius( const float3& _Position, float _Radius, List<T>& _Result, List<float>* _pDistances=NULL ) const;
+
+	// Fetches the value closest to the provided position by only descending into the cell containing the position
+	// This is cheaper than FetchNearest() but the result can be far off near the cells' boundaries
+	const T*	FetchNearestApproximate( const float3& _Position, float& _Distance ) const;
+
+	// Fetches the values closest to an array of positions
+	//	_ppValues, an array of _Count pointers that will receive the values (NULL if the octree is empty)
+	//	_pDistances, an optional array of _Count distances that will receive the distances to the values
+	//	_pHints, an optional array of _Count hints from the previous call for the same objects, updated with the new answers
+	// Returns the amount of queries resolved by their hint
+	int			FetchNearest( int _Count, const float3* _pPositions, const T** _ppValues, float* _pDistances=NULL, NearestHint* _pHints=NULL ) const;
+
+#ifdef _DEBUG
+	struct	BenchmarkResults
+	{
+		double	ExactTime;				// Durations of the queries in milliseconds
+		double	ApproximateTime;
+		int		ApproximateErrorsCount;	// Amount of queries where the approximate search didn't find the nearest value
+		float	ApproximateMaxError;	// Max extra distance of the values found by the approximate search (ignoring the queries where it found nothing)
+	};
+
+	// Compares FetchNearest() with FetchNearestApproximate() on random positions within the octree
+	void		BenchmarkNearest( int _QueriesCount, BenchmarkResults& _Results ) const;
+#endif
+
+private:
+
+	Content&	GetContent( U32 _ID ) const	{ return m_ppContentBlocks[_ID / CONTENT_BLOCK_SIZE][_ID % CONTENT_BLOCK_SIZE]; }
+	U32			AllocateContent();
+	Node*		AllocateNode( Node* _pParent );
+	void		ReleaseNode( Node* _pNode );
+
+	// Visits the nodes best-first and keeps the _K closest candidates within sqrt(_MaxSqDistance) of the position
+	void		FetchCandidates( const float3& _Position, int _K, float _MaxSqDistance, CandidateHeap& _Candidates ) const;
+
+	struct	BatchQueries
+	{
+		const Octree*	pOwner;
+		const float3*	pPositions;
+		const U32*		pQueryIndices;	// Indices of the queries to search, sorted along a Morton curve
+		const T**		ppValues;
+		float*			pDistances;
+		NearestHint*	pHints;
+	};
+	static void	FetchNearestRange( int _Start, int _End, void* _pData );
 };
 
 #include "Octree.inl"
\ No newline at end of file
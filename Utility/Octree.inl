@@ -1,26 +1,66 @@
 template<typename T> Octree<T>::Octree()
 	: m_pROOT( NULL )
+	, m_pFreeNodes( NULL )
+	, m_ContentBlocksCount( 0 )
+	, m_ppContentBlocks( NULL )
+	, m_ContentsCount( 0 )
+	, m_FreeContentID( ~0U )
 {
 }
 
 template<typename T> Octree<T>::~Octree()
 {
 	delete m_pROOT;
+	while ( m_pFreeNodes != NULL )
+	{
+		Node*	pNext = m_pFreeNodes->m_pParent;
+		delete m_pFreeNodes;
+		m_pFreeNodes = pNext;
+	}
+
+	for ( int BlockIndex=0; BlockIndex < m_ContentBlocksCount; BlockIndex++ )
+		delete[] m_ppContentBlocks[BlockIndex];
+	delete[] m_ppContentBlocks;
 }
 
 template<typename T> typename Octree<T>::Node&	Octree<T>::Init( const float3& _BoundMin, float _Size, float _MinCellSize, U32 _MaxElementsInOctree )
 {
-	delete m_pROOT;
-
 	m_Min = _BoundMin;
 	m_Size = _Size;
 	m_Max = _BoundMin + _Size * float3::One;
 	m_MinCellSize = _MinCellSize;
 
-	m_pROOT = new Node( *this, NULL );
+	// Return the previous nodes to the pool
+	if ( m_pROOT != NULL )
+	{
+		for ( int ChildIndex=0; ChildIndex < 8; ChildIndex++ )
+			if ( m_pROOT->m_ppCells[ChildIndex] != NULL )
+			{
+				ReleaseNode( m_pROOT->m_ppCells[ChildIndex] );
+				m_pROOT->m_ppCells[ChildIndex] = NULL;
+			}
+		m_pROOT->m_ContentsCount = 0;
+	}
+	else
+		m_pROOT = new Node( *this, NULL );
+
+	// Forget about the previous values and allocate enough blocks for the new ones
+	m_ContentsCount = 0;
+	m_FreeContentID = ~0U;
 
-	if ( _MaxElementsInOctree > 0 )
-		m_ContentPool.Init( _MaxElementsInOctree );
+	int	RequiredBlocksCount = (_MaxElementsInOctree + CONTENT_BLOCK_SIZE-1) / CONTENT_BLOCK_SIZE;
+	if ( RequiredBlocksCount > m_ContentBlocksCount )
+	{
+		Content**	ppNewBlocks = new Content*[RequiredBlocksCount];
+		if ( m_ppContentBlocks != NULL )
+			memcpy( ppNewBlocks, m_ppContentBlocks, m_ContentBlocksCount*sizeof(Content*) );
+		for ( int BlockIndex=m_ContentBlocksCount; BlockIndex < RequiredBlocksCount; BlockIndex++ )
+			ppNewBlocks[BlockIndex] = new Content[CONTENT_BLOCK_SIZE];
+
+		delete[] m_ppContentBlocks;
+		m_ppContentBlocks = ppNewBlocks;
+		m_ContentBlocksCount = RequiredBlocksCount;
+	}
 
 #ifdef _DEBUG
 	m_NodesCount = 1;
@@ -30,28 +70,204 @@ template<typename T> typename Octree<T>::Node&	Octree<T>::Init( const float3& _B
 	return *m_pROOT;
 }
 
-template<typename T> int	Octree<T>::Append( const float3& _Position, float _Radius, T _Value )
+template<typename T> int	Octree<T>::Append( const float3& _Position, float _Radius, T _Value, U32* _pID, float _LooseMargin )
 {
-	Content&	NewContent = m_ContentPool.Append();
+	U32			ID = AllocateContent();
+	Content&	NewContent = GetContent( ID );
 	NewContent.Position = _Position;
 	NewContent.Radius = _Radius;
 	NewContent.SqRadius = _Radius*_Radius;
-	NewContent.BBoxMin = _Position - _Radius * float3::One;
-	NewContent.BBoxMax = _Position + _Radius * float3::One;
+	NewContent.LooseMargin = _LooseMargin;
+	NewContent.LooseRadius = _Radius + _LooseMargin;
+	NewContent.BBoxMin = _Position - NewContent.LooseRadius * float3::One;
+	NewContent.BBoxMax = _Position + NewContent.LooseRadius * float3::One;
 	NewContent.Value = _Value;
 
+	if ( _pID != NULL )
+		*_pID = ID;
+
 	return m_pROOT->Append( NewContent, m_Min, m_Size, 0 );
 }
 
+template<typename T> bool	Octree<T>::Update( U32 _ID, const float3& _Position, float _Radius )
+{
+	ASSERT( _ID < m_ContentsCount && GetContent( _ID ).bUsed, "Invalid value ID!" );
+	Content&	C = GetContent( _ID );
+
+	// Stay in the same nodes as long as the sphere fits in the loose bounds
+	// (a smaller sphere stored in larger cells is still found by the queries)
+	C.Position = _Position;
+	C.Radius = _Radius;
+	C.SqRadius = _Radius*_Radius;
+
+	float3	BBoxMin = _Position - _Radius * float3::One;
+	float3	BBoxMax = _Position + _Radius * float3::One;
+	if (	BBoxMin.x >= C.BBoxMin.x && BBoxMin.y >= C.BBoxMin.y && BBoxMin.z >= C.BBoxMin.z
+		&&	BBoxMax.x <= C.BBoxMax.x && BBoxMax.y <= C.BBoxMax.y && BBoxMax.z <= C.BBoxMax.z )
+		return false;
+
+	// Reinsert with new loose bounds around the new sphere
+	int	RemovedNodesCount = m_pROOT->Remove( C, m_Min, m_Size );
+	ASSERT( RemovedNodesCount > 0, "Value was not found in the octree!" );
+
+	C.LooseRadius = _Radius + C.LooseMargin;
+	C.BBoxMin = _Position - C.LooseRadius * float3::One;
+	C.BBoxMax = _Position + C.LooseRadius * float3::One;
+	m_pROOT->Append( C, m_Min, m_Size, 0 );
+
+	return true;
+}
+
+template<typename T> void	Octree<T>::Remove( U32 _ID )
+{
+	ASSERT( _ID < m_ContentsCount && GetContent( _ID ).bUsed, "Invalid value ID!" );
+	Content&	C = GetContent( _ID );
+
+	int	RemovedNodesCount = m_pROOT->Remove( C, m_Min, m_Size );
+	ASSERT( RemovedNodesCount > 0, "Value was not found in the octree!" );
+
+	C.bUsed = false;
+	C.NextFreeID = m_FreeContentID;
+	m_FreeContentID = _ID;
+}
+
+template<typename T> U32	Octree<T>::AllocateContent()
+{
+	U32	ID;
+	if ( m_FreeContentID != ~0U )
+	{	// Reuse a removed value
+		ID = m_FreeContentID;
+		m_FreeContentID = GetContent( ID ).NextFreeID;
+	}
+	else
+	{
+		ID = m_ContentsCount++;
+		int	BlockIndex = ID / CONTENT_BLOCK_SIZE;
+		if ( BlockIndex == m_ContentBlocksCount )
+		{	// Allocate a new block
+			int			NewBlocksCount = MAX( 4, 2*m_ContentBlocksCount );
+			Content**	ppNewBlocks = new Content*[NewBlocksCount];
+			if ( m_ppContentBlocks != NULL )
+				memcpy( ppNewBlocks, m_ppContentBlocks, m_ContentBlocksCount*sizeof(Content*) );
+			for ( int NewBlockIndex=m_ContentBlocksCount; NewBlockIndex < NewBlocksCount; NewBlockIndex++ )
+				ppNewBlocks[NewBlockIndex] = new Content[CONTENT_BLOCK_SIZE];
+
+			delete[] m_ppContentBlocks;
+			m_ppContentBlocks = ppNewBlocks;
+			m_ContentBlocksCount = NewBlocksCount;
+		}
+	}
+
+	GetContent( ID ).bUsed = true;
+	return ID;
+}
+
+template<typename T> typename Octree<T>::Node*	Octree<T>::AllocateNode( Node* _pParent )
+{
+#ifdef _DEBUG
+	m_NodesCount++;
+#endif
+
+	if ( m_pFreeNodes == NULL )
+		return new Node( *this, _pParent );
+
+	Node*	pNode = m_pFreeNodes;
+	m_pFreeNodes = pNode->m_pParent;
+	pNode->m_pParent = _pParent;
+
+	return pNode;
+}
+
+template<typename T> void	Octree<T>::ReleaseNode( Node* _pNode )
+{
+	for ( int ChildIndex=0; ChildIndex < 8; ChildIndex++ )
+		if ( _pNode->m_ppCells[ChildIndex] != NULL )
+		{
+			ReleaseNode( _pNode->m_ppCells[ChildIndex] );
+			_pNode->m_ppCells[ChildIndex] = NULL;
+		}
+	_pNode->m_ContentsCount = 0;
+
+	_pNode->m_pParent = m_pFreeNodes;
+	m_pFreeNodes = _pNode;
+
+#ifdef _DEBUG
+	m_NodesCount--;
+#endif
+}
+
 template<typename T> void	Octree<T>::Fetch( const float3& _Position, List<T>& _Result ) const
 {
 	m_pROOT->Fetch( _Position, _Result, m_Min, m_Size );
 }
 
 template<typename T> const T*	Octree<T>::FetchNearest( const float3& _Position, float& _Distance ) const
+{
+	const T*	pResult = NULL;
+	if ( FetchNearest( _Position, 1, &pResult, &_Distance ) == 0 )
+		return NULL;
+
+	return pResult;
+}
+
+template<typename T> int	Octree<T>::FetchNearest( const float3& _Position, int _K, const T** _ppValues, float* _pDistances ) const
+{
+	if ( _K <= 0 )
+		return 0;
+
+	CandidateHeap	Candidates;
+	FetchCandidates( _Position, _K, MAX_FLOAT, Candidates );
+
+	// Pop the farthest candidates first
+	int	Count = Candidates.Count;
+	for ( int ValueIndex=Count-1; ValueIndex >= 0; ValueIndex-- )
+	{
+		const Candidate&	C = Candidates.Top();
+		_ppValues[ValueIndex] = &C.pContent->Value;
+		if ( _pDistances != NULL )
+			_pDistances[ValueIndex] = sqrtf( C.SqDistance );
+		Candidates.Pop();
+	}
+
+	return Count;
+}
+
+template<typename T> int	Octree<T>::FetchRadius( const float3& _Position, float _Radius, List<T>& _Result, List<float>* _pDistances ) const
+{
+	CandidateHeap	Candidates;
+	FetchCandidates( _Position, 0x7FFFFFFF, _Radius*_Radius, Candidates );
+
+	// Pop the farthest candidates first
+	int			Count = Candidates.Count;
+	Candidate*	pSorted = new Candidate[MAX( 1, Count )];
+	for ( int CandidateIndex=Count-1; CandidateIndex >= 0; CandidateIndex-- )
+	{
+		pSorted[CandidateIndex] = Candidates.Top();
+		Candidates.Pop();
+	}
+
+	// Skip the duplicates (they're neighbors once sorted)
+	int	ValuesCount = 0;
+	for ( int CandidateIndex=0; CandidateIndex < Count; CandidateIndex++ )
+	{
+		if ( CandidateIndex > 0 && pSorted[CandidateIndex].pContent == pSorted[CandidateIndex-1].pContent )
+			continue;
+
+		_Result.Append( pSorted[CandidateIndex].pContent->Value );
+		if ( _pDistances != NULL )
+			_pDistances->Append( sqrtf( pSorted[CandidateIndex].SqDistance ) );
+		ValuesCount++;
+	}
+
+	delete[] pSorted;
+
+	return ValuesCount;
+}
+
+template<typename T> const T*	Octree<T>::FetchNearestApproximate( const float3& _Position, float& _Distance ) const
 {
 	float		SqDistance = MAX_FLOAT;
-	const T*	pResult = m_pROOT->FetchNearest( _Position, m_Min, m_Size, SqDistance );
+	const T*	pResult = m_pROOT->FetchNearestApproximate( _Position, m_Min, m_Size, SqDistance );
 	if ( pResult == NULL )
 		return NULL;
 
@@ -59,9 +275,266 @@ template<typename T> const T*	Octree<T>::FetchNearest( const float3& _Position,
 	return pResult;
 }
 
+template<typename T> int	Octree<T>::FetchNearest( int _Count, const float3* _pPositions, const T** _ppValues, float* _pDistances, NearestHint* _pHints ) const
+{
+	if ( _Count <= 0 )
+		return 0;
+
+	LinearAllocator&		Scratch = GetThreadScratch();
+	LinearAllocator::Scope	ScratchScope( Scratch );
+
+	U32*	pKeys = Scratch.Allocate<U32>( 2*_Count );
+	U32*	pQueryIndices = Scratch.Allocate<U32>( 2*_Count );
+	int		SearchesCount = 0;
+	float	CellsPerUnit = 1024.0f / m_Size;
+	for ( int QueryIndex=0; QueryIndex < _Count; QueryIndex++ )
+	{
+		const float3&	Position = _pPositions[QueryIndex];
+
+		// Reuse the previous answer if it's still valid
+		if ( _pHints != NULL )
+		{
+			const NearestHint&	Hint = _pHints[QueryIndex];
+			if ( Hint.SafeRadius >= 0.0f && (Position - Hint.Position).LengthSq() <= Hint.SafeRadius*Hint.SafeRadius )
+			{
+				_ppValues[QueryIndex] = Hint.pNearestValue;
+				if ( _pDistances != NULL )
+					_pDistances[QueryIndex] = (Hint.NearestPosition - Position).Length();
+				continue;
+			}
+		}
+
+		// Compute the 30-bits Morton code of the position within the octree's bounds
+		int	X = CLAMP( int( (Position.x - m_Min.x) * CellsPerUnit ), 0, 1023 );
+		int	Y = CLAMP( int( (Position.y - m_Min.y) * CellsPerUnit ), 0, 1023 );
+		int	Z = CLAMP( int( (Position.z - m_Min.z) * CellsPerUnit ), 0, 1023 );
+		U32	Code = 0;
+		for ( U32 Bit=0; Bit < 10; Bit++ )
+			Code |= (((X >> Bit) & 1) | (((Y >> Bit) & 1) << 1) | (((Z >> Bit) & 1) << 2)) << (3*Bit);
+
+		pKeys[SearchesCount] = Code;
+		pQueryIndices[SearchesCount] = QueryIndex;
+		SearchesCount++;
+	}
+
+	// Radix sort the remaining queries along the Morton curve, 8 bits at a time, so consecutive queries visit the same nodes
+	U32*	pSourceKeys = pKeys;
+	U32*	pSourceIndices = pQueryIndices;
+	U32*	pTargetKeys = pKeys + _Count;
+	U32*	pTargetIndices = pQueryIndices + _Count;
+	for ( U32 Shift=0; Shift < 32; Shift+=8 )
+	{
+		U32	pOffsets[256];
+		memset( pOffsets, 0, 256*sizeof(U32) );
+		for ( int SearchIndex=0; SearchIndex < SearchesCount; SearchIndex++ )
+			pOffsets[(pSourceKeys[SearchIndex] >> Shift) & 0xFF]++;
+
+		U32	Offset = 0;
+		for ( int BucketIndex=0; BucketIndex < 256; BucketIndex++ )
+		{
+			U32	Count = pOffsets[BucketIndex];
+			pOffsets[BucketIndex] = Offset;
+			Offset += Count;
+		}
+
+		for ( int SearchIndex=0; SearchIndex < SearchesCount; SearchIndex++ )
+		{
+			U32	TargetIndex = pOffsets[(pSourceKeys[SearchIndex] >> Shift) & 0xFF]++;
+			pTargetKeys[TargetIndex] = pSourceKeys[SearchIndex];
+			pTargetIndices[TargetIndex] = pSourceIndices[SearchIndex];
+		}
+
+		U32*	pTemp = pSourceKeys; pSourceKeys = pTargetKeys; pTargetKeys = pTemp;
+				pTemp = pSourceIndices; pSourceIndices = pTargetIndices; pTargetIndices = pTemp;
+	}
+
+	// Search
+	BatchQueries	Batch;
+	Batch.pOwner = this;
+	Batch.pPositions = _pPositions;
+	Batch.pQueryIndices = pSourceIndices;
+	Batch.ppValues = _ppValues;
+	Batch.pDistances = _pDistances;
+	Batch.pHints = _pHints;
+	if ( SearchesCount >= PARALLEL_QUERIES_COUNT )
+		JobSystem::ParallelFor( SearchesCount, FetchNearestRange, &Batch );
+	else
+		FetchNearestRange( 0, SearchesCount, &Batch );
+
+	return _Count - SearchesCount;
+}
+
+template<typename T> void	Octree<T>::FetchNearestRange( int _Start, int _End, void* _pData )
+{
+	BatchQueries&	Batch = *((BatchQueries*) _pData);
+	for ( int SearchIndex=_Start; SearchIndex < _End; SearchIndex++ )
+	{
+		U32				QueryIndex = Batch.pQueryIndices[SearchIndex];
+		const float3&	Position = Batch.pPositions[QueryIndex];
+
+		// Fetch the 2 nearest values to know how far we can move before the nearest one changes
+		CandidateHeap	Candidates;
+		Batch.pOwner->FetchCandidates( Position, 2, MAX_FLOAT, Candidates );
+
+		float	SecondSqDistance = MAX_FLOAT;
+		if ( Candidates.Count == 2 )
+		{
+			SecondSqDistance = Candidates.Top().SqDistance;
+			Candidates.Pop();
+		}
+		const Content*	pNearest = Candidates.Count > 0 ? Candidates.Top().pContent : NULL;
+		float			Distance = Candidates.Count > 0 ? sqrtf( Candidates.Top().SqDistance ) : MAX_FLOAT;
+
+		Batch.ppValues[QueryIndex] = pNearest != NULL ? &pNearest->Value : NULL;
+		if ( Batch.pDistances != NULL )
+			Batch.pDistances[QueryIndex] = Distance;
+		if ( Batch.pHints != NULL )
+		{
+			NearestHint&	Hint = Batch.pHints[QueryIndex];
+			Hint.Position = Position;
+			Hint.pNearestValue = Batch.ppValues[QueryIndex];
+			Hint.NearestPosition = pNearest != NULL ? pNearest->Position : Position;
+			Hint.SafeRadius = pNearest == NULL ? -1.0f : (SecondSqDistance == MAX_FLOAT ? MAX_FLOAT : 0.5f * (sqrtf( SecondSqDistance ) - Distance));
+		}
+	}
+}
+
+template<typename T> void	Octree<T>::FetchCandidates( const float3& _Position, int _K, float _MaxSqDistance, CandidateHeap& _Candidates ) const
+{
+	bool	bBounded = _K != 0x7FFFFFFF;	// Unbounded queries keep the duplicates and let the caller skip them
+
+	// The root cell extends to infinity as values outside of it are stored in its boundary cells
+	NodeQueue	Queue;
+	typename NodeQueue::Entry	Root;
+	Root.SqDistance = 0.0f;
+	Root.pNode = m_pROOT;
+	Root.Min = m_Min;
+	Root.Size = m_Size;
+	Root.OpenFaces = 0x3F;
+	Queue.Push( Root );
+
+	while ( Queue.Count > 0 )
+	{
+		typename NodeQueue::Entry	E = Queue.pEntries[0];
+		Queue.Pop();
+
+		float	MaxSqDistance = _Candidates.Count == _K ? _Candidates.Top().SqDistance : _MaxSqDistance;
+		if ( E.SqDistance > MaxSqDistance )
+			break;	// All the remaining nodes are farther than our farthest candidate
+
+		// Test this node's values
+		int	ContentsCount = E.pNode->m_ContentsCount;
+		for ( int ContentIndex=0; ContentIndex < ContentsCount; ContentIndex++ )
+		{
+			Candidate	C;
+			C.pContent = E.pNode->m_ppContents[ContentIndex];
+			C.SqDistance = (C.pContent->Position - _Position).LengthSq();
+			if ( C.SqDistance > _MaxSqDistance )
+				continue;
+			if ( bBounded )
+			{
+				if ( _Candidates.Count == _K && !_Candidates.Top().IsFartherThan( C ) )
+					continue;
+				if ( _Candidates.Contains( C.pContent ) )
+					continue;
+				if ( _Candidates.Count == _K )
+					_Candidates.Pop();
+			}
+			_Candidates.Push( C );
+		}
+
+		// Queue the children that may contain closer values
+		MaxSqDistance = _Candidates.Count == _K ? _Candidates.Top().SqDistance : _MaxSqDistance;
+		float	HalfSize = 0.5f * E.Size;
+		float3	CellCenter = E.Min + HalfSize * float3::One;
+		for ( U32 ChildIndex=0; ChildIndex < 8; ChildIndex++ )
+		{
+			const Node*	pChild = E.pNode->m_ppCells[ChildIndex];
+			if ( pChild == NULL )
+				continue;
+
+			typename NodeQueue::Entry	Child;
+			Child.pNode = pChild;
+			Child.Size = HalfSize;
+			Child.OpenFaces = 0;
+			Child.SqDistance = 0.0f;
+			for ( int Axis=0; Axis < 3; Axis++ )
+			{	// A child only inherits the open face of its parent on its own side
+				bool	bUpper = ((ChildIndex >> Axis) & 1) != 0;
+				float	Min = bUpper ? (&CellCenter.x)[Axis] : (&E.Min.x)[Axis];
+				(&Child.Min.x)[Axis] = Min;
+				Child.OpenFaces |= E.OpenFaces & (bUpper ? (8 << Axis) : (1 << Axis));
+
+				float	Position = (&_Position.x)[Axis];
+				float	Delta = 0.0f;
+				if ( Position < Min && (Child.OpenFaces & (1 << Axis)) == 0 )
+					Delta = Min - Position;
+				else if ( Position > Min + HalfSize && (Child.OpenFaces & (8 << Axis)) == 0 )
+					Delta = Position - Min - HalfSize;
+				Child.SqDistance += Delta * Delta;
+			}
+
+			if ( Child.SqDistance <= MaxSqDistance )
+				Queue.Push( Child );
+		}
+	}
+}
+
+#ifdef _DEBUG
+template<typename T> void	Octree<T>::BenchmarkNearest( int _QueriesCount, BenchmarkResults& _Results ) const
+{
+	float3*	pPositions = new float3[_QueriesCount];
+	for ( int QueryIndex=0; QueryIndex < _QueriesCount; QueryIndex++ )
+		pPositions[QueryIndex].Set( _frand( m_Min.x, m_Max.x ), _frand( m_Min.y, m_Max.y ), _frand( m_Min.z, m_Max.z ) );
+
+	float*	pExactDistances = new float[_QueriesCount];
+	float*	pApproximateDistances = new float[_QueriesCount];
+	const T*	pResult;
+
+	TimeProfile	Profile;
+	Profile.Start();
+	for ( int QueryIndex=0; QueryIndex < _QueriesCount; QueryIndex++ )
+	{
+		pResult = FetchNearest( pPositions[QueryIndex], pExactDistances[QueryIndex] );
+		if ( pResult == NULL )
+			pExactDistances[QueryIndex] = MAX_FLOAT;
+	}
+	_Results.ExactTime = Profile.Stop();
+
+	Profile.Start();
+	for ( int QueryIndex=0; QueryIndex < _QueriesCount; QueryIndex++ )
+	{
+		pResult = FetchNearestApproximate( pPositions[QueryIndex], pApproximateDistances[QueryIndex] );
+		if ( pResult == NULL )
+			pApproximateDistances[QueryIndex] = MAX_FLOAT;
+	}
+	_Results.ApproximateTime = Profile.Stop();
+
+	_Results.ApproximateErrorsCount = 0;
+	_Results.ApproximateMaxError = 0.0f;
+	for ( int QueryIndex=0; QueryIndex < _QueriesCount; QueryIndex++ )
+	{
+		ASSERT( pExactDistances[QueryIndex] <= pApproximateDistances[QueryIndex], "The exact search should always find the nearest value!" );
+		if ( pApproximateDistances[QueryIndex] == pExactDistances[QueryIndex] )
+			continue;
+
+		_Results.ApproximateErrorsCount++;
+		if ( pApproximateDistances[QueryIndex] < MAX_FLOAT )
+			_Results.ApproximateMaxError = MAX( _Results.ApproximateMaxError, pApproximateDistances[QueryIndex] - pExactDistances[QueryIndex] );
+	}
+
+	delete[] pApproximateDistances;
+	delete[] pExactDistances;
+	delete[] pPositions;
+}
+#endif
+
 template<typename T> Octree<T>::Node::Node( Octree& _Owner, Node* _pParent )
 	: m_Owner( _Owner )
 	, m_pParent( _pParent )
+	, m_ContentsCount( 0 )
+	, m_ContentsCapacity( 0 )
+	, m_ppContents( NULL )
 {
 	for ( int i=0; i < 8; i++ )
 		m_ppCells[i] = NULL;
@@ -71,6 +544,7 @@ template<typename T> Octree<T>::Node::~Node()
 {
 	for ( int i=0; i < 8; i++ )
 		delete m_ppCells[i];
+	delete[] m_ppContents;
 }
 
 template<typename T> int	Octree<T>::Node::Append( const Content& _Content, const float3& _Min, float _Size, U32 _Level )
@@ -80,11 +554,10 @@ template<typename T> int	Octree<T>::Node::Append( const Content& _Content, const
 #endif
 
 	float	HalfSize = 0.5f * _Size;
-	if (	_Content.Radius >= HalfSize			// Either the content is big enough for that cell
+	if (	_Content.LooseRadius >= HalfSize	// Either the content is big enough for that cell
 		||	HalfSize <= m_Owner.m_MinCellSize )	// Or we reached the smallest possible cell size
 	{	// Store in that node and don't go any further...
-		const Content*	PHUCK = &_Content;
-		m_Content.Append( PHUCK );
+		AppendContent( &_Content );
 		return 1;
 	}
 
@@ -102,13 +575,13 @@ template<typename T> int	Octree<T>::Node::Append( const Content& _Content, const
 
 	int		NodesCount = 0;
 	float3	CellMin;
-	CellMin.z = _Min.z;
+	CellMin.z = ZStart == 0 ? _Min.z : CellCenter.z;
 	for ( U32 Z=ZStart; Z < ZEnd; Z++, CellMin.z=CellCenter.z )
 	{
-		CellMin.y = _Min.y;
+		CellMin.y = YStart == 0 ? _Min.y : CellCenter.y;
 		for ( U32 Y=YStart; Y < YEnd; Y++, CellMin.y=CellCenter.y )
 		{
-			CellMin.x = _Min.x;
+			CellMin.x = XStart == 0 ? _Min.x : CellCenter.x;
 			for ( U32 X=XStart; X < XEnd; X++, CellMin.x=CellCenter.x )
 			{
 				NodesCount += GetOrCreateChildNode( X, Y, Z ).Append( _Content, CellMin, HalfSize, _Level+1 );
@@ -119,13 +592,58 @@ template<typename T> int	Octree<T>::Node::Append( const Content& _Content, const
 	return NodesCount;
 }
 
+// Follows the same path as Append() so it finds all the nodes the value was added to, and returns the emptied nodes to the pool
+template<typename T> int	Octree<T>::Node::Remove( const Content& _Content, const float3& _Min, float _Size )
+{
+	float	HalfSize = 0.5f * _Size;
+	if (	_Content.LooseRadius >= HalfSize
+		||	HalfSize <= m_Owner.m_MinCellSize )
+		return RemoveContent( &_Content ) ? 1 : 0;
+
+	float3	CellCenter = _Min + HalfSize * float3::One;
+	U32		XStart = _Content.BBoxMin.x < CellCenter.x ? 0 : 1;
+	U32		XEnd = _Content.BBoxMax.x < CellCenter.x ? 1 : 2;
+	U32		YStart = _Content.BBoxMin.y < CellCenter.y ? 0 : 1;
+	U32		YEnd = _Content.BBoxMax.y < CellCenter.y ? 1 : 2;
+	U32		ZStart = _Content.BBoxMin.z < CellCenter.z ? 0 : 1;
+	U32		ZEnd = _Content.BBoxMax.z < CellCenter.z ? 1 : 2;
+
+	int		NodesCount = 0;
+	float3	CellMin;
+	CellMin.z = ZStart == 0 ? _Min.z : CellCenter.z;
+	for ( U32 Z=ZStart; Z < ZEnd; Z++, CellMin.z=CellCenter.z )
+	{
+		CellMin.y = YStart == 0 ? _Min.y : CellCenter.y;
+		for ( U32 Y=YStart; Y < YEnd; Y++, CellMin.y=CellCenter.y )
+		{
+			CellMin.x = XStart == 0 ? _Min.x : CellCenter.x;
+			for ( U32 X=XStart; X < XEnd; X++, CellMin.x=CellCenter.x )
+			{
+				U32		ChildIndex = X | (Y << 1) | (Z << 2);
+				Node*	pChild = m_ppCells[ChildIndex];
+				if ( pChild == NULL )
+					continue;
+
+				NodesCount += pChild->Remove( _Content, CellMin, HalfSize );
+				if ( pChild->IsEmpty() )
+				{
+					m_Owner.ReleaseNode( pChild );
+					m_ppCells[ChildIndex] = NULL;
+				}
+			}
+		}
+	}
+
+	return NodesCount;
+}
+
 template<typename T> void	Octree<T>::Node::Fetch( const float3& _Position, List<T>& _Result, const float3& _Min, float _Size ) const
 {
 	// Collect this node's values
-	int	ContentsCount = m_Content.GetCount();
+	int	ContentsCount = m_ContentsCount;
 	for ( int ContentIndex=0; ContentIndex < ContentsCount; ContentIndex++ )
 	{
-		Content&	C = *m_Content[ContentIndex];
+		const Content&	C = *m_ppContents[ContentIndex];
 		if ( C.Contains( _Position ) )
 			_Result.Append( C.Value );
 	}
@@ -157,14 +675,14 @@ template<typename T> void	Octree<T>::Node::Fetch( const float3& _Position, List<
 		pChild->Fetch( _Position, _Result, CellMin, HalfSize );
 }
 
-template<typename T> const T*	Octree<T>::Node::FetchNearest( const float3& _Position, const float3& _Min, float _Size, float& _SqDistance ) const
+template<typename T> const T*	Octree<T>::Node::FetchNearestApproximate( const float3& _Position, const float3& _Min, float _Size, float& _SqDistance ) const
 {
 	// Search this node's values
 	const T*	pResult = NULL;
-	int	ContentsCount = m_Content.GetCount();
+	int	ContentsCount = m_ContentsCount;
 	for ( int ContentIndex=0; ContentIndex < ContentsCount; ContentIndex++ )
 	{
-		const Content&	C = *m_Content[ContentIndex];
+		const Content&	C = *m_ppContents[ContentIndex];
 		if ( C.IsCloser( _Position, _SqDistance ) )
 			pResult = &C.Value;
 	}
@@ -194,7 +712,7 @@ template<typename T> const T*	Octree<T>::Node::FetchNearest( const float3& _Posi
 	const T*	pResultChild = NULL;
 	Node*		pChild = m_ppCells[ChildIndex];
 	if ( pChild != NULL )
-		pResultChild = pChild->FetchNearest( _Position, CellMin, HalfSize, _SqDistance );
+		pResultChild = pChild->FetchNearestApproximate( _Position, CellMin, HalfSize, _SqDistance );
 
 	return pResultChild != NULL ? pResultChild : pResult;
 }
@@ -203,12 +721,137 @@ template<typename T> typename Octree<T>::Node&	Octree<T>::Node::GetOrCreateChild
 {
 	U32	ChildIndex = _X | (_Y << 1) | (_Z << 2);
 	if ( m_ppCells[ChildIndex] == NULL )
+		m_ppCells[ChildIndex] = m_Owner.AllocateNode( this );
+
+	return *m_ppCells[ChildIndex];
+}
+
+template<typename T> void	Octree<T>::Node::AppendContent( const Content* _pContent )
+{
+	if ( m_ContentsCount == m_ContentsCapacity )
 	{
-		m_ppCells[ChildIndex] = new Node( m_Owner, this );
-#ifdef _DEBUG
-		m_Owner.m_NodesCount++;
-#endif
+		m_ContentsCapacity = MAX( 4, 2*m_ContentsCapacity );
+		const Content**	ppNewContents = new const Content*[m_ContentsCapacity];
+		if ( m_ppContents != NULL )
+			memcpy( ppNewContents, m_ppContents, m_ContentsCount*sizeof(const Content*) );
+		delete[] m_ppContents;
+		m_ppContents = ppNewContents;
 	}
 
-	return *m_ppCells[ChildIndex];
+	m_ppContents[m_ContentsCount++] = _pContent;
+}
+
+template<typename T> bool	Octree<T>::Node::RemoveContent( const Content* _pContent )
+{
+	for ( int ContentIndex=0; ContentIndex < m_ContentsCount; ContentIndex++ )
+		if ( m_ppContents[ContentIndex] == _pContent )
+		{	// Replace by the last one, the order doesn't matter
+			m_ppContents[ContentIndex] = m_ppContents[--m_ContentsCount];
+			return true;
+		}
+
+	return false;
+}
+
+template<typename T> void	Octree<T>::CandidateHeap::Push( const Candidate& _Candidate )
+{
+	if ( Count == Capacity )
+	{
+		Capacity *= 2;
+		Candidate*	pNewCandidates = new Candidate[Capacity];
+		memcpy( pNewCandidates, pCandidates, Count*sizeof(Candidate) );
+		if ( pCandidates != pLocalCandidates )
+			delete[] pCandidates;
+		pCandidates = pNewCandidates;
+	}
+
+	// Sift up
+	int	Index = Count++;
+	while ( Index > 0 )
+	{
+		int	ParentIndex = (Index-1) >> 1;
+		if ( !_Candidate.IsFartherThan( pCandidates[ParentIndex] ) )
+			break;
+		pCandidates[Index] = pCandidates[ParentIndex];
+		Index = ParentIndex;
+	}
+	pCandidates[Index] = _Candidate;
+}
+
+template<typename T> void	Octree<T>::CandidateHeap::Pop()
+{
+	ASSERT( Count > 0, "Heap is empty!" );
+	Candidate	Last = pCandidates[--Count];
+
+	// Sift down
+	int	Index = 0;
+	while ( true )
+	{
+		int	ChildIndex = 2*Index+1;
+		if ( ChildIndex >= Count )
+			break;
+		if ( ChildIndex+1 < Count && pCandidates[ChildIndex+1].IsFartherThan( pCandidates[ChildIndex] ) )
+			ChildIndex++;
+		if ( !pCandidates[ChildIndex].IsFartherThan( Last ) )
+			break;
+		pCandidates[Index] = pCandidates[ChildIndex];
+		Index = ChildIndex;
+	}
+	pCandidates[Index] = Last;
+}
+
+template<typename T> bool	Octree<T>::CandidateHeap::Contains( const Content* _pContent ) const
+{
+	for ( int CandidateIndex=0; CandidateIndex < Count; CandidateIndex++ )
+		if ( pCandidates[CandidateIndex].pContent == _pContent )
+			return true;
+
+	return false;
+}
+
+template<typename T> void	Octree<T>::NodeQueue::Push( const Entry& _Entry )
+{
+	if ( Count == Capacity )
+	{
+		Capacity *= 2;
+		Entry*	pNewEntries = new Entry[Capacity];
+		memcpy( pNewEntries, pEntries, Count*sizeof(Entry) );
+		if ( pEntries != pLocalEntries )
+			delete[] pEntries;
+		pEntries = pNewEntries;
+	}
+
+	// Sift up
+	int	Index = Count++;
+	while ( Index > 0 )
+	{
+		int	ParentIndex = (Index-1) >> 1;
+		if ( pEntries[ParentIndex].SqDistance <= _Entry.SqDistance )
+			break;
+		pEntries[Index] = pEntries[ParentIndex];
+		Index = ParentIndex;
+	}
+	pEntries[Index] = _Entry;
+}
+
+template<typename T> void	Octree<T>::NodeQueue::Pop()
+{
+	ASSERT( Count > 0, "Queue is empty!" );
+	Entry	Last = pEntries[--Count];
+
+	// Sift down
+	int	Index = 0;
+	while ( true )
+	{
+		int	ChildIndex = 2*Index+1;
+		if ( ChildIndex >= Count )
+			break;
+		if ( ChildIndex+1 < Count && pEntries[ChildIndex+1].SqDistance < pEntries[ChildIndex].SqDistance )
+			ChildIndex++;
+		if ( pEntries[ChildIndex].SqDistance >= Last.SqDistance )
+			break;
+		pEntries[Index] = pEntries[ChildIndex];
+		Index = ChildIndex;
+	}
+	pEntries[Index] = Last;
 }